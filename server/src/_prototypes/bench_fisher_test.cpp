@@ -0,0 +1,102 @@
+/**
+
+Micro-benchmark of math::fisher_test against the previous implementation,
+that sums the boost hypergeometric pdf over all the tables.
+
+⇒  g++ -std=c++11 -O3 -ffast-math -march=native -I. _prototypes/bench_fisher_test.cpp extras/math.cpp -o bench_fisher_test
+⇒  ./bench_fisher_test [tables] [universe]
+
+The tables are random, with the universe size of enrich_regions_fast by default.
+Half of them have symmetric margins, to compare the exact ties.
+The relative error is reported for the p-values above 1e-290, below it the
+previous implementation is dominated by the underflow of the pdf.
+
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <boost/math/distributions/hypergeometric.hpp>
+
+#include "extras/math.hpp"
+
+// The previous implementation, unmodified
+double boost_fisher_test(unsigned a, unsigned b, unsigned c, unsigned d)
+{
+  unsigned N = a + b + c + d;
+  unsigned r = a + c;
+  unsigned n = c + d;
+  unsigned max_for_k = std::min(r, n);
+  unsigned min_for_k = (unsigned) std::max(0, int(r + n - N));
+  boost::math::hypergeometric_distribution<> hgd(r, n, N);
+  double cutoff = pdf(hgd, c);
+  double tmp_p = 0.0;
+  for (unsigned k = min_for_k; k < max_for_k + 1; k++) {
+    double p = pdf(hgd, k);
+    if (p <= cutoff) tmp_p += p;
+  }
+  return tmp_p;
+}
+
+struct Table {
+  unsigned a, b, c, d;
+};
+
+int main(int argc, char *argv[])
+{
+  const size_t total = argc > 1 ? atol(argv[1]) : 200;
+  const unsigned universe = argc > 2 ? atol(argv[2]) : 1024 * 1024;
+
+  std::mt19937 gen(42);
+  std::vector<Table> tables;
+  while (tables.size() < total) {
+    // Experiment and query sets of different sizes, and their overlap
+    unsigned experiment = std::uniform_int_distribution<unsigned>(1, universe / 4)(gen);
+    // Half of the universe has symmetric terms, so the mirrored tables are exact ties
+    if (tables.size() % 2) {
+      experiment = universe / 2;
+    }
+    unsigned query = std::uniform_int_distribution<unsigned>(1, universe / 4)(gen);
+    double expected = (double) experiment * query / universe;
+    unsigned a = std::min(std::min(experiment, query),
+                          (unsigned) std::max(0.0, expected * std::uniform_real_distribution<double>(0.5, 1.5)(gen)));
+    tables.push_back(Table{ a, experiment - a, query - a, universe - experiment - query + a });
+  }
+
+  std::vector<double> previous(total);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < total; i++) {
+    previous[i] = boost_fisher_test(tables[i].a, tables[i].b, tables[i].c, tables[i].d);
+  }
+  auto middle = std::chrono::steady_clock::now();
+
+  std::vector<double> current(total);
+  for (size_t i = 0; i < total; i++) {
+    current[i] = epidb::math::fisher_test(tables[i].a, tables[i].b, tables[i].c, tables[i].d);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double max_error = 0.0;
+  size_t compared = 0;
+  for (size_t i = 0; i < total; i++) {
+    if (previous[i] > 1e-290) {
+      max_error = std::max(max_error, std::abs(current[i] - previous[i]) / previous[i]);
+      compared++;
+    }
+  }
+
+  double previous_us = std::chrono::duration<double, std::micro>(middle - start).count() / total;
+  double current_us = std::chrono::duration<double, std::micro>(end - middle).count() / total;
+
+  std::cout << "tables: " << total << " universe: " << universe << std::endl;
+  std::cout << "previous: " << previous_us << " us/table" << std::endl;
+  std::cout << "current: " << current_us << " us/table" << std::endl;
+  std::cout << "maximum relative error: " << max_error << " (" << compared << " p-values)" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,153 @@
+/**
+
+Micro-benchmark of the intersection of algorithms::Signature against the
+std::bitset of 1M bits with boost serialization, that enrich_regions_fast used before.
+
+⇒  g++ -std=c++11 -O3 -ffast-math -march=native -I. _prototypes/bench_signature.cpp algorithms/signature.cpp -lboost_serialization -o bench_signature
+⇒  ./bench_signature [signatures] [universe]
+
+Each round builds random signatures with densities from 0.01% to 50%, in
+uniform and clustered positions, checks the counts against the bitsets and
+reports the time of load + intersection of one pair.
+
+*/
+
+#include <bitset>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/serialization/bitset.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+
+#include "algorithms/signature.hpp"
+
+#define BITMAP_SIZE (1024 * 1024)
+
+typedef std::bitset<BITMAP_SIZE> Bitmap;
+
+std::vector<uint32_t> random_positions(std::mt19937_64& rng, uint32_t universe, double density, bool clustered)
+{
+  std::vector<uint32_t> positions;
+  std::uniform_real_distribution<double> uniform(0, 1);
+  if (!clustered) {
+    for (uint32_t p = 0; p < universe; p++) {
+      if (uniform(rng) < density) {
+        positions.push_back(p);
+      }
+    }
+    return positions;
+  }
+  // Runs of set positions, with the same density in average
+  std::geometric_distribution<uint32_t> run(1.0 / 64);
+  uint32_t p = 0;
+  while (p < universe) {
+    uint32_t length = run(rng) + 1;
+    if (uniform(rng) < density) {
+      for (uint32_t i = 0; i < length && p < universe; i++, p++) {
+        positions.push_back(p);
+      }
+    } else {
+      p += length;
+    }
+  }
+  return positions;
+}
+
+std::string serialize_bitmap(const Bitmap& bitmap)
+{
+  std::stringstream stream;
+  boost::archive::binary_oarchive ar(stream, boost::archive::no_header);
+  ar & bitmap;
+  return stream.str();
+}
+
+int main(int argc, char *argv[])
+{
+  size_t signatures = argc > 1 ? atol(argv[1]) : 64;
+  uint32_t universe = argc > 2 ? atol(argv[2]) : BITMAP_SIZE;
+  if (universe > BITMAP_SIZE) {
+    std::cerr << "The universe of the bitsets is at most " << BITMAP_SIZE << std::endl;
+    return 1;
+  }
+
+  std::mt19937_64 rng(42);
+  const double densities[] = {0.0001, 0.001, 0.01, 0.05, 0.2, 0.5};
+  std::uniform_int_distribution<size_t> pick(0, sizeof(densities) / sizeof(densities[0]) - 1);
+
+  std::vector<std::string> signature_data;
+  std::vector<std::string> bitmap_data;
+  size_t signature_bytes = 0;
+  for (size_t i = 0; i < signatures; i++) {
+    std::vector<uint32_t> positions = random_positions(rng, universe, densities[pick(rng)], i % 2);
+    epidb::algorithms::SignatureBuilder builder(universe);
+    Bitmap* bitmap = new Bitmap();
+    for (uint32_t p : positions) {
+      builder.add(p);
+      bitmap->set(p);
+    }
+    signature_data.push_back(builder.serialize());
+    bitmap_data.push_back(serialize_bitmap(*bitmap));
+    signature_bytes += signature_data.back().size();
+    delete bitmap;
+  }
+
+  size_t errors = 0;
+  size_t pairs = 0;
+  std::string msg;
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<size_t> signature_counts;
+  for (size_t i = 0; i < signatures; i++) {
+    epidb::algorithms::Signature a;
+    a.load(signature_data[i].data(), signature_data[i].size(), msg);
+    for (size_t j = 0; j < signatures; j++) {
+      epidb::algorithms::Signature b;
+      if (!b.load(signature_data[j].data(), signature_data[j].size(), msg)) {
+        std::cerr << msg << std::endl;
+        return 1;
+      }
+      signature_counts.push_back(a.and_count(b));
+    }
+  }
+  double signature_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  Bitmap* a = new Bitmap();
+  Bitmap* b = new Bitmap();
+  start = std::chrono::steady_clock::now();
+  std::vector<size_t> bitmap_counts;
+  for (size_t i = 0; i < signatures; i++) {
+    std::istringstream ss_a(bitmap_data[i]);
+    boost::archive::binary_iarchive ar_a(ss_a, boost::archive::no_header);
+    ar_a & *a;
+    for (size_t j = 0; j < signatures; j++) {
+      std::istringstream ss_b(bitmap_data[j]);
+      boost::archive::binary_iarchive ar_b(ss_b, boost::archive::no_header);
+      ar_b & *b;
+      bitmap_counts.push_back((*a & *b).count());
+    }
+  }
+  double bitmap_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  delete a;
+  delete b;
+
+  for (size_t i = 0; i < signature_counts.size(); i++) {
+    pairs++;
+    if (signature_counts[i] != bitmap_counts[i]) {
+      errors++;
+    }
+  }
+
+  std::cout << "pairs: " << pairs << " errors: " << errors << std::endl;
+  std::cout << "signature: " << signature_time / pairs * 1e6 << " us/pair, "
+            << signature_bytes / signatures << " bytes in average" << std::endl;
+  std::cout << "bitset:    " << bitmap_time / pairs * 1e6 << " us/pair, "
+            << bitmap_data[0].size() << " bytes" << std::endl;
+
+  return errors ? 1 : 0;
+}
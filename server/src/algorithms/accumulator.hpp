@@ -21,46 +21,224 @@
 #ifndef EPIDB_ALGORITHMS_ACCUMULATOR_HPP
 #define EPIDB_ALGORITHMS_ACCUMULATOR_HPP
 
+#include <algorithm>
+#include <cmath>
 #include <string>
+#include <vector>
 
 #include "../types.hpp"
 
 namespace epidb {
   namespace algorithms {
 
-    class Accumulator {
-    private:
-      std::vector<Score> values;
-      mutable bool _calculated;
+    // Statistics kept by a StreamAccumulator, besides the count
+    namespace stats {
+      const unsigned MIN = 1 << 0;
+      const unsigned MAX = 1 << 1;
+      const unsigned SUM = 1 << 2;
+      // Mean and variance, by the Welford method
+      const unsigned MOMENTS = 1 << 3;
+      // The pushed values, for the median and the values list
+      const unsigned VALUES = 1 << 4;
+
+      const unsigned ALL = MIN | MAX | SUM | MOMENTS | VALUES;
+    }
 
-      mutable Score _min;
-      mutable Score _max;
-      mutable Score _sum;
-      mutable Score _median;
-      mutable Score _mean;
-      mutable Score _var;
-      mutable Score _sd;
+    std::string values_string(const std::vector<Score> &values, const std::string &sep);
 
-      void calculate() const;
+    //
+    // Accumulator of the values of one range that keeps only the statistics STATS.
+    // Without VALUES it uses constant memory and does not allocate.
+    // When the values are kept the variance is computed from them in two passes,
+    // as the statistics of the aggregate command always were.
+    //
+    template <unsigned STATS>
+    class StreamAccumulator {
+    private:
+      size_t _count;
+      Score _min;
+      Score _max;
+      double _sum;
+      double _mean;
+      double _m2;
+      // Reordered by median()
+      mutable std::vector<Score> _values;
 
     public:
-      Accumulator();
-      void push(Score value);
-      size_t size() const;
-      Score min() const;
-      Score max() const;
-      Score sum() const;
-      Score mean() const;
-      Score var() const;
-      Score sd() const;
-      Score median() const;
-      Score count() const;
-      Score boolean() const;
-      const std::string string(std::string sep) const;
+      StreamAccumulator() :
+        _count(0),
+        _min(0.0),
+        _max(0.0),
+        _sum(0.0),
+        _mean(0.0),
+        _m2(0.0) {}
+
+      void push(const Score value)
+      {
+        _count++;
+        if (STATS & stats::MIN) {
+          if (_count == 1 || value < _min) {
+            _min = value;
+          }
+        }
+        if (STATS & stats::MAX) {
+          if (_count == 1 || value > _max) {
+            _max = value;
+          }
+        }
+        if (STATS & stats::SUM) {
+          _sum += value;
+        }
+        if ((STATS & stats::MOMENTS) && !(STATS & stats::VALUES)) {
+          const double delta = value - _mean;
+          _mean += delta / _count;
+          _m2 += delta * (value - _mean);
+        }
+        if (STATS & stats::VALUES) {
+          _values.push_back(value);
+        }
+      }
+
+      size_t size() const
+      {
+        return sizeof(StreamAccumulator) + (_values.size() * sizeof(Score));
+      }
+
+      Score count() const
+      {
+        return _count;
+      }
+
+      Score boolean() const
+      {
+        return _count > 0;
+      }
+
+      Score min() const
+      {
+        static_assert(STATS & stats::MIN, "min is not kept by this accumulator");
+        return _min;
+      }
+
+      Score max() const
+      {
+        static_assert(STATS & stats::MAX, "max is not kept by this accumulator");
+        return _max;
+      }
+
+      Score sum() const
+      {
+        static_assert(STATS & stats::SUM, "sum is not kept by this accumulator");
+        return _sum;
+      }
+
+      Score mean() const
+      {
+        static_assert(STATS & (stats::SUM | stats::MOMENTS), "mean is not kept by this accumulator");
+        if (!_count) {
+          return 0.0;
+        }
+        if (STATS & stats::SUM) {
+          return static_cast<Score>(_sum) / _count;
+        }
+        return _mean;
+      }
+
+      Score var() const
+      {
+        static_assert(STATS & stats::MOMENTS, "var is not kept by this accumulator");
+        if (!_count) {
+          return 0.0;
+        }
+        if (STATS & stats::VALUES) {
+          const Score m = mean();
+          double sq_sum = 0.0;
+          for (const Score value : _values) {
+            const Score diff = value - m;
+            sq_sum += diff * diff;
+          }
+          return static_cast<Score>(sq_sum) / _count;
+        }
+        return _m2 / _count;
+      }
+
+      Score sd() const
+      {
+        return std::sqrt(var());
+      }
+
+      Score median() const
+      {
+        static_assert(STATS & stats::VALUES, "median is not kept by this accumulator");
+        if (_values.empty()) {
+          return 0.0;
+        }
+        auto middle = _values.begin() + _values.size() / 2;
+        std::nth_element(_values.begin(), middle, _values.end());
+        return *middle;
+      }
+
+      // The values in the push order, if median() was not called
+      const std::string string(std::string sep) const
+      {
+        static_assert(STATS & stats::VALUES, "the values are not kept by this accumulator");
+        return values_string(_values, sep);
+      }
+    };
+
+    // All the statistics, for the aggregate command
+    typedef StreamAccumulator<stats::ALL> Accumulator;
+
+    enum AggregationFunction {
+      AGGREGATION_MIN,
+      AGGREGATION_MAX,
+      AGGREGATION_SUM,
+      AGGREGATION_MEAN,
+      AGGREGATION_VAR,
+      AGGREGATION_SD,
+      AGGREGATION_MEDIAN,
+      AGGREGATION_COUNT,
+      AGGREGATION_BOOLEAN,
+      // The list of the values
+      AGGREGATION_ACC
+    };
+
+    bool get_function_data(const std::string& function_name, AggregationFunction &function);
+
+    //
+    // The accumulator of each aggregation function and how its value is read,
+    // so the aggregation loops are compiled for the function requested.
+    //
+    template <AggregationFunction F> struct Aggregation;
+
+#define EPIDB_AGGREGATION(_FUNCTION, _STATS, _VALUE)                    \
+    template <> struct Aggregation<_FUNCTION> {                         \
+      typedef StreamAccumulator<_STATS> Accumulator;                   \
+      static Score value(const Accumulator &acc)                       \
+      {                                                                \
+        return acc._VALUE();                                           \
+      }                                                                \
     };
 
-    typedef Score (Accumulator::*GetDataPtr)() const;
-    GetDataPtr get_function_data(const std::string& function_name);
+    EPIDB_AGGREGATION(AGGREGATION_MIN, stats::MIN, min)
+    EPIDB_AGGREGATION(AGGREGATION_MAX, stats::MAX, max)
+    EPIDB_AGGREGATION(AGGREGATION_SUM, stats::SUM, sum)
+    EPIDB_AGGREGATION(AGGREGATION_MEAN, stats::SUM, mean)
+    EPIDB_AGGREGATION(AGGREGATION_VAR, stats::MOMENTS, var)
+    EPIDB_AGGREGATION(AGGREGATION_SD, stats::MOMENTS, sd)
+    EPIDB_AGGREGATION(AGGREGATION_MEDIAN, stats::VALUES, median)
+    EPIDB_AGGREGATION(AGGREGATION_COUNT, 0, count)
+    EPIDB_AGGREGATION(AGGREGATION_BOOLEAN, 0, boolean)
+
+#undef EPIDB_AGGREGATION
+
+    template <> struct Aggregation<AGGREGATION_ACC> {
+      typedef StreamAccumulator<stats::VALUES> Accumulator;
+      static std::string value(const Accumulator &acc)
+      {
+        return acc.string("|");
+      }
+    };
   }
 }
 
@@ -20,10 +20,12 @@
 
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <set>
 #include <vector>
 
 #include "accumulator.hpp"
+#include "interval_index.hpp"
 
 #include "../datatypes/column_types_def.hpp"
 #include "../datatypes/regions.hpp"
@@ -36,23 +38,28 @@
 
 #include "../extras/utils.hpp"
 
+#include "../threading/executor.hpp"
+
 #include "../errors.hpp"
 #include "../log.hpp"
 
 namespace epidb {
   namespace algorithms {
 
-    bool aggregate_regions(const std::string &chrom, Regions &data, const Regions &ranges, const std::string &field,
-                           dba::Metafield &metafield, processing::StatusPtr status, Regions &chr_regions, std::string &msg)
+    // Aggregate the data overlapping the ranges [range_begin, range_end).
+    // index is the interval index of the data.
+    bool aggregate_regions(const std::string &chrom, const Regions &data, const IntervalIndex &index,
+                           const Regions &ranges, const size_t range_begin, const size_t range_end,
+                           const std::string &field, dba::Metafield &metafield,
+                           processing::StatusPtr status, Regions &chr_regions, std::string &msg)
     {
       chr_regions = Regions();
-      auto it_ranges = ranges.begin();
 
       DatasetId dataset_id = -1;
+      int column_pos;
 
-     auto it_data_begin = data.begin();
-
-      while (it_ranges != ranges.end()) {
+      for (size_t range_pos = range_begin; range_pos < range_end; range_pos++) {
+        const RegionPtr &range = ranges[range_pos];
 
         // Check if processing was canceled
         bool is_canceled = false;
@@ -65,30 +72,24 @@ namespace epidb {
         }
         // ***
 
-        // Move to the begin of the range region
-        while ( it_data_begin != data.end()
-                && (*it_data_begin)->end() < (*it_ranges)->start() )  {
-          it_data_begin++;
-        }
-
-        int column_pos;
         Accumulator acc;
-        auto it_data = it_data_begin;
-        while (it_data != data.end() &&
-               (*it_ranges)->end() >= (*it_data)->start()) {
+        bool success = true;
+        index.visit(range->start(), range->end(), [&](const size_t data_pos) {
+          const RegionPtr &datum = data[data_pos];
 
-          if (((*it_data)->start() < (*it_ranges)->end()) && ((*it_data)->end() > (*it_ranges)->start())) {
-            auto begin = std::max((*it_data)->start(), (*it_ranges)->start());
-            auto end =  std::min((*it_data)->end(), (*it_ranges)->end());
+          if ((datum->start() < range->end()) && (datum->end() > range->start())) {
+            auto begin = std::max(datum->start(), range->start());
+            auto end =  std::min(datum->end(), range->end());
 
             double overlap_length = end - begin;
-            double original_length = (*it_data)->end() - (*it_data)->start();
+            double original_length = datum->end() - datum->start();
 
             auto correct_offset = (overlap_length / original_length );
 
             if (field[0] == '@') {
               std::string value;
-              if (!metafield.process(field, chrom, it_data->get(), status, value, msg)) {
+              if (!metafield.process(field, chrom, datum.get(), status, value, msg)) {
+                success = false;
                 return false;
               }
               Score s;
@@ -96,49 +97,120 @@ namespace epidb {
               utils::string_to_score(value, s);
               acc.push(s * correct_offset);
             } else if (field == "START") {
-              acc.push((*it_data)->start());
+              acc.push(datum->start());
             } else if (field == "END") {
-              acc.push((*it_data)->end());
+              acc.push(datum->end());
             } else {
-              if (dataset_id != (*it_data)->dataset_id()) {
-                dataset_id = (*it_data)->dataset_id();
+              if (dataset_id != datum->dataset_id()) {
+                dataset_id = datum->dataset_id();
                 if (!cache::get_column_position_from_dataset(dataset_id, field, column_pos, msg)) {
+                  success = false;
                   return false;
                 }
               }
-              Score score = (*it_data)->value(column_pos);
+              Score score = datum->value(column_pos);
               acc.push(score * correct_offset);
             }
           }
-          it_data++;
+          return true;
+        });
+
+        if (!success) {
+          return false;
         }
 
-        chr_regions.emplace_back(build_aggregte_region((*it_ranges)->start(), (*it_ranges)->end(), DATASET_EMPTY_ID,
+        chr_regions.emplace_back(build_aggregte_region(range->start(), range->end(), DATASET_EMPTY_ID,
                                  acc.min(), acc.max(), acc.sum(), acc.median(), acc.mean(), acc.var(), acc.sd(), acc.count()));
-        it_ranges++;
       }
 
       return true;
     }
 
+    //
+    // The ranges of each chromosome are split in parts aggregated in parallel,
+    // all of them probing the same interval index of the chromosome data.
+    // The meta fields (e.g. @SEQUENCE) use the request caches and are aggregated sequentially.
+    //
     bool aggregate(ChromosomeRegionsList &data, ChromosomeRegionsList &ranges, const std::string &field,
                    processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg)
     {
+      struct Part {
+        const std::string *chrom;
+        const Regions *data;
+        IntervalIndexPtr index;
+        const Regions *ranges;
+        size_t range_begin;
+        size_t range_end;
+        Regions result;
+        std::string msg;
+        bool success;
+      };
+
+      const size_t max_parts = field[0] == '@' ? 1 : threading::executor().size();
+
       // TODO :optimize it for finding the ChromosomeRegionsList data not in O(N) time
-      dba::Metafield metafield;
+      std::vector<Part> parts;
+      std::vector<std::pair<std::string, size_t>> chromosomes_parts;
       for (auto &range : ranges) {
         for (auto &datum : data) {
-          Regions chr_regions;
           if (range.first == datum.first) {
-            if (!aggregate_regions(range.first, datum.second, range.second, field, metafield, status, chr_regions, msg)) {
-              return false;
+            const Regions &chr_data = datum.second;
+            const Regions &chr_ranges = range.second;
+            const size_t total_parts = std::max<size_t>(1, std::min(max_parts, (chr_data.size() + chr_ranges.size()) / sweep::PARTITION_SIZE));
+
+            IntervalIndexPtr index = std::make_shared<IntervalIndex>(chr_data);
+            chromosomes_parts.emplace_back(range.first, total_parts);
+            size_t range_begin = 0;
+            for (size_t part = 1; part <= total_parts; part++) {
+              const size_t range_end = part * chr_ranges.size() / total_parts;
+              parts.push_back(Part{ &range.first, &chr_data, index, &chr_ranges, range_begin, range_end, Regions(), "", false });
+              range_begin = range_end;
             }
-            std::pair<std::string, Regions> r(range.first, std::move(chr_regions));
-            regions.push_back(std::move(r));
           }
         }
       }
 
+      if (field[0] == '@') {
+        dba::Metafield metafield;
+        for (auto &part : parts) {
+          part.success = aggregate_regions(*part.chrom, *part.data, *part.index, *part.ranges,
+                                           part.range_begin, part.range_end,
+                                           field, metafield, status, part.result, part.msg);
+          if (!part.success) {
+            msg = part.msg;
+            return false;
+          }
+        }
+      } else {
+        threading::TaskGroup tasks(status->task_limit());
+        for (size_t i = 0; i < parts.size(); i++) {
+          tasks.spawn([&, i]() {
+            Part &part = parts[i];
+            dba::Metafield metafield;
+            part.success = aggregate_regions(*part.chrom, *part.data, *part.index, *part.ranges,
+                                             part.range_begin, part.range_end,
+                                             field, metafield, status, part.result, part.msg);
+          });
+        }
+        tasks.wait();
+      }
+
+      size_t pos = 0;
+      for (const auto &chromosome_parts : chromosomes_parts) {
+        Regions chr_regions;
+        for (size_t i = 0; i < chromosome_parts.second; i++, pos++) {
+          if (!parts[pos].success) {
+            msg = parts[pos].msg;
+            return false;
+          }
+          for (auto &region : parts[pos].result) {
+            chr_regions.emplace_back(std::move(region));
+          }
+        }
+        std::pair<std::string, Regions> r(chromosome_parts.first, std::move(chr_regions));
+        regions.push_back(std::move(r));
+      }
+
       return true;
     }
   } // namespace algorithms
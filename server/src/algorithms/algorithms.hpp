@@ -27,6 +27,7 @@
 #include <unordered_map>
 
 #include "../datatypes/regions.hpp"
+#include "../datatypes/regions_block.hpp"
 #include "../processing/processing.hpp"
 
 namespace epidb {
@@ -61,15 +62,32 @@ namespace epidb {
                  processing::StatusPtr status,  ChromosomeRegionsList &overlaps, std::string &msg);
 
     bool intersect_count(const ChromosomeRegionsList &regions_data, const ChromosomeRegionsList &regions_overlap,
-                         size_t& count);
+                         processing::StatusPtr status, size_t& count);
 
     bool overlap_count(const ChromosomeRegionsList &regions_data, const ChromosomeRegionsList &regions_overlap,
                        const bool overlap, const double amount, const std::string amount_type,
-                       size_t& count);
+                       processing::StatusPtr status, size_t& count);
 
-    ChromosomeRegionsList disjoin(ChromosomeRegionsList &&regions_data);
+    ChromosomeRegionsList disjoin(ChromosomeRegionsList &&regions_data, processing::StatusPtr status);
 
     ChromosomeRegionsList merge_chromosome_regions(ChromosomeRegionsList& chrregions_a, ChromosomeRegionsList& chrregions_b);
+
+    // Columnar versions: operate on the RegionsBlock rows, without building region objects.
+    bool intersect(ChromosomeRegionsBlockList &regions_data, ChromosomeRegionsBlockList &regions_overlap,
+                   processing::StatusPtr status, ChromosomeRegionsBlockList &intersections, std::string &msg);
+
+    bool overlap(ChromosomeRegionsBlockList &regions_data, ChromosomeRegionsBlockList &regions_overlap,
+                 const bool overlap, const double amount, const std::string amount_type,
+                 processing::StatusPtr status, ChromosomeRegionsBlockList &overlaps, std::string &msg);
+
+    bool intersect_count(const ChromosomeRegionsBlockList &regions_data, const ChromosomeRegionsBlockList &regions_overlap,
+                         processing::StatusPtr status, size_t& count);
+
+    bool overlap_count(const ChromosomeRegionsBlockList &regions_data, const ChromosomeRegionsBlockList &regions_overlap,
+                       const bool overlap, const double amount, const std::string amount_type,
+                       processing::StatusPtr status, size_t& count);
+
+    ChromosomeRegionsBlockList merge_chromosome_regions(ChromosomeRegionsBlockList& chrregions_a, ChromosomeRegionsBlockList& chrregions_b);
   } // namespace algorithms
 } // namespace epidb
 
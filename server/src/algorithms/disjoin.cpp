@@ -19,14 +19,16 @@
 //
 
 #include <cmath>
-#include <future>
 #include <iostream>
 #include <set>
 #include <vector>
-#include <thread>
 
 #include "../datatypes/regions.hpp"
 
+#include "../processing/processing.hpp"
+
+#include "../threading/executor.hpp"
+
 #include "algorithms.hpp"
 
 namespace epidb {
@@ -117,25 +119,17 @@ namespace epidb {
       return ChromosomeRegions(chromosome, std::move(regions));
     }
 
-    ChromosomeRegionsList disjoin(ChromosomeRegionsList &&regions_data)
+    ChromosomeRegionsList disjoin(ChromosomeRegionsList &&regions_data, processing::StatusPtr status)
     {
-      // long times = clock();
-      std::vector<std::future<ChromosomeRegions > > threads;
-      std::vector<std::shared_ptr<ChromosomeRegionsList> > result_parts;
-
-      for (const auto& chromosome_regions : regions_data) {
-        auto t = std::async(std::launch::async, &disjoin_regions,
-                            std::move(chromosome_regions.second), std::ref(chromosome_regions.first));
-
-        threads.emplace_back(std::move(t));
-      }
+      ChromosomeRegionsList disjoin_set(regions_data.size());
 
-      ChromosomeRegionsList disjoin_set;
-      for (size_t i = 0; i < threads.size(); ++i) {
-        threads[i].wait();
-        auto result = threads[i].get();
-        disjoin_set.emplace_back(std::move(result));
+      threading::TaskGroup tasks(status->task_limit());
+      for (size_t i = 0; i < regions_data.size(); ++i) {
+        tasks.spawn([&, i]() {
+          disjoin_set[i] = disjoin_regions(std::move(regions_data[i].second), regions_data[i].first);
+        });
       }
+      tasks.wait();
 
       return disjoin_set;
     }
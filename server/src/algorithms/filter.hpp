@@ -67,6 +67,18 @@ namespace epidb {
       virtual bool is(const std::string &value) = 0;
       virtual bool is(const Score value) = 0;
 
+      // Used with the minimum and maximum values of a group of numbers (e.g. a regions block):
+      // may_match is false only if no value can match, all_match is true only if all values match.
+      virtual bool may_match(const Score min, const Score max)
+      {
+        return true;
+      }
+
+      virtual bool all_match(const Score min, const Score max)
+      {
+        return false;
+      }
+
       virtual ~Filter() {}
     };
 
@@ -96,6 +108,16 @@ namespace epidb {
         }
         return std::fabs(value - n_value) < std::numeric_limits<Score>::epsilon();
       }
+
+      bool may_match(const Score min, const Score max)
+      {
+        return check(NUMBER) && (min - n_value < std::numeric_limits<Score>::epsilon()) && (n_value - max < std::numeric_limits<Score>::epsilon());
+      }
+
+      bool all_match(const Score min, const Score max)
+      {
+        return is(min) && is(max);
+      }
     };
 
     class NotEqualsFilter: public Filter {
@@ -124,6 +146,12 @@ namespace epidb {
         }
         return std::fabs(value - n_value) > std::numeric_limits<Score>::epsilon();
       }
+
+      bool all_match(const Score min, const Score max)
+      {
+        // Both limits differ and are at the same side of the value
+        return is(min) && is(max) && (max < n_value || min > n_value);
+      }
     };
 
     class GreaterFilter: public Filter {
@@ -152,6 +180,16 @@ namespace epidb {
 
         return value > n_value;
       }
+
+      bool may_match(const Score min, const Score max)
+      {
+        return is(max);
+      }
+
+      bool all_match(const Score min, const Score max)
+      {
+        return is(min);
+      }
     };
 
     class GreaterEqualsFilter: public Filter {
@@ -178,6 +216,16 @@ namespace epidb {
         }
         return value >= n_value;
       }
+
+      bool may_match(const Score min, const Score max)
+      {
+        return is(max);
+      }
+
+      bool all_match(const Score min, const Score max)
+      {
+        return is(min);
+      }
     };
 
     class LessFilter: public Filter {
@@ -204,6 +252,16 @@ namespace epidb {
         }
         return value < n_value;
       }
+
+      bool may_match(const Score min, const Score max)
+      {
+        return is(min);
+      }
+
+      bool all_match(const Score min, const Score max)
+      {
+        return is(max);
+      }
     };
 
     class LessEqualsFilter: public Filter {
@@ -230,6 +288,16 @@ namespace epidb {
         }
         return value <= n_value;
       }
+
+      bool may_match(const Score min, const Score max)
+      {
+        return is(min);
+      }
+
+      bool all_match(const Score min, const Score max)
+      {
+        return is(max);
+      }
     };
 
     class FilterBuilder {
@@ -19,17 +19,19 @@
 //
 
 #include <cmath>
-#include <future>
 #include <iostream>
 #include <set>
 #include <vector>
-#include <thread>
 
 #include "../datatypes/regions.hpp"
+#include "../datatypes/regions_block.hpp"
 
 #include "../processing/processing.hpp"
 
+#include "../threading/executor.hpp"
+
 #include "algorithms.hpp"
+#include "overlap_sweep.hpp"
 
 namespace epidb {
   namespace algorithms {
@@ -70,171 +72,189 @@ namespace epidb {
         return ChromosomeRegions(chromosome, std::move(regions));
       }
 
+      for (const size_t pos : sweep::select(regions_data, regions_overlap, overlap, amount, amount_type, status->task_limit())) {
+        regions.emplace_back(std::move(regions_data[pos]));
+      }
 
-      bool dynamic_overlap_length = amount_type == "bp" ? false : true;
+      return ChromosomeRegions(chromosome, std::move(regions));
+    }
 
+    bool intersect(ChromosomeRegionsList &regions_data, ChromosomeRegionsList &regions_overlap,
+                   processing::StatusPtr status, ChromosomeRegionsList &intersections, std::string &msg)
+    {
+      return overlap(regions_data, regions_overlap, true, 0.0, "bp", status, intersections, msg);
+    }
+
+    bool overlap(ChromosomeRegionsList &regions_data, ChromosomeRegionsList &regions_overlap,
+                 const bool overlap, const double amount, const std::string amount_type,
+                 processing::StatusPtr status,  ChromosomeRegionsList &overlaps, std::string &msg)
+    {
+      processing::RunningOp runningOp = status->start_operation(processing::ALGORITHM_OVERLAP);
+      if (processing::is_canceled(status, msg)) {
+        return false;
+      }
 
-      size_t data_size = regions_data.size();
-      size_t data_pos = 0;
+      // long times = clock();
+      std::set<std::string> chromosomes;
+      merge_chromosomes(regions_data, regions_overlap, chromosomes);
 
-      auto it_ranges = regions_overlap.begin();
+      std::vector<std::string> chrs;
+      std::vector<Regions> chrs_regions_data;
+      std::vector<Regions> chrs_regions_overlap;
 
-      Length min_range_length = -1;
-      Length min_data_length = -1;
+      for (const auto& chr : chromosomes) {
+        Regions chr_regions_data;
+        Regions chr_regions_overlap;
 
-      while (it_ranges != regions_overlap.end()) {
+        bool has_data = get_chromosome_regions(regions_data, chr, chr_regions_data);
+        bool has_overlap = get_chromosome_regions(regions_overlap, chr, chr_regions_overlap);
 
-        if (dynamic_overlap_length) {
-          min_range_length = ceil(static_cast<double>( (*it_ranges)->end() - (*it_ranges)->start() ) * (amount / 100));
-        } else {
-          min_range_length = static_cast<Length>(amount);
+        // If is there no data, nothing to be made.
+        if (!has_data) {
+          continue;
         }
 
-        while ((data_pos < data_size) &&
-               (regions_data[data_pos]->end() <= (*it_ranges)->start()) )  {
-
-          if (dynamic_overlap_length) {
-            min_data_length = ceil(static_cast<double>((regions_data[data_pos]->end() - regions_data[data_pos]->start())) * (amount / 100));
-          } else {
-            min_data_length = static_cast<Length>(amount);
-          }
-
-          if (!overlap) {
-            Length distance = calculate_distance(regions_data[data_pos], *it_ranges);
-            if ((distance >= min_range_length) && (distance >= min_data_length)) {
-              regions.emplace_back(std::move(regions_data[data_pos]));
-            }
-          }
-          data_pos++;
+        // If I want overlaps, but nothing to overlap, nothing to be made.
+        if (overlap && !has_overlap) {
+          continue;
         }
 
-        while ((data_pos < data_size) &&
-               ((*it_ranges)->end() >= regions_data[data_pos]->start()) )  {
-
-          if (((*it_ranges)->start() < regions_data[data_pos]->end()) &&
-              ((*it_ranges)->end() > regions_data[data_pos]->start())) {
-
-            if (overlap) {
-              if (dynamic_overlap_length) {
-                min_data_length = ceil(static_cast<double>((regions_data[data_pos]->end() - regions_data[data_pos]->start())) * (amount / 100));
-              } else {
-                min_data_length = static_cast<Length>(amount);
-              }
+        // If I do not want overlaps, but nothing to overlap to... Add them all!
+        if (!overlap && !has_overlap) {
+          overlaps.emplace_back(ChromosomeRegions(chr, std::move(chr_regions_data)));
+          continue;
+        }
 
-              Length overlap_one = calculate_overlap(*it_ranges, regions_data[data_pos]);
-              Length overlap_two = calculate_overlap(regions_data[data_pos], *it_ranges);
+        chrs.push_back(chr);
+        chrs_regions_data.emplace_back(std::move(chr_regions_data));
+        chrs_regions_overlap.emplace_back(std::move(chr_regions_overlap));
+      }
 
-              if (((overlap_one >= min_range_length) || (overlap_two >= min_range_length)) &&
-                  ((overlap_one >= min_data_length)  || (overlap_two >= min_data_length))) {
+      std::vector<ChromosomeRegions> results(chrs.size());
+      threading::TaskGroup tasks(status->task_limit());
+      for (size_t i = 0; i < chrs.size(); ++i) {
+        tasks.spawn([&, i]() {
+          results[i] = overlap_regions(std::move(chrs_regions_data[i]), std::move(chrs_regions_overlap[i]), chrs[i],
+                                       overlap, amount, amount_type, status, msg);
+        });
+      }
+      tasks.wait();
 
-                regions.emplace_back(std::move(regions_data[data_pos]));
-              }
-            }
-          } else {
-            if (!overlap) {
+      for (auto &result : results) {
+        if (!result.second.empty()) {
+          overlaps.emplace_back(std::move(result));
+        }
+      }
 
-              Length distance_one = calculate_distance(*it_ranges, regions_data[data_pos]);
-              Length distance_two = calculate_distance(regions_data[data_pos], *it_ranges);
+      // long diffticks = clock() - times;
+      // "OVERLAP: " << ((diffticks) / (CLOCKS_PER_SEC / 1000)) << std::endl;
+      return true;
+    }
 
-              if ((distance_one >= min_range_length) && (distance_two >= min_range_length) &&
-                  (distance_one >= min_data_length)  && (distance_two >= min_data_length)) {
+    // -----------------------------------
+    // RegionsBlock
+    // -----------------------------------
 
-                regions.emplace_back(std::move(regions_data[data_pos]));
-              }
-            }
-          }
-          data_pos++;
+    bool get_chromosome_regions(ChromosomeRegionsBlockList &qr, const std::string &chr, RegionsBlock &chr_regions)
+    {
+      for (auto cit = qr.begin(); cit != qr.end(); ++cit) {
+        if (cit->first == chr) {
+          chr_regions = std::move(cit->second);
+          return true;
         }
-
-        it_ranges++;
       }
+      return false;
+    }
 
-      // Distance to the last element of the regions_overlap
-      if (!overlap) {
-        while (data_pos < data_size) {
-          if (dynamic_overlap_length) {
-            min_data_length = ceil(static_cast<double>((regions_data[data_pos]->end() - regions_data[data_pos]->start())) * (amount / 100));
-          } else {
-            min_data_length = static_cast<Length>(amount);
-          }
-
-          Length distance = calculate_distance(regions_overlap.back(), regions_data[data_pos]);
-          if (distance >= min_range_length) {
-            regions.emplace_back(std::move(regions_data[data_pos]));
-          }
-          data_pos++;
-        }
+    ChromosomeRegionsBlock overlap_regions_block(RegionsBlock &&regions_data, RegionsBlock &&regions_overlap, const std::string& chromosome,
+        const bool overlap, const double amount, const std::string amount_type,
+        processing::StatusPtr status, std::string &msg)
+    {
+      processing::RunningOp runningOp = status->start_operation(processing::ALGORITHM_OVERLAP_CHROMOSOME,
+                                        BSON(
+                                          "total_regions_data" << (int) regions_data.size() <<
+                                          "total_regions_overlap" << (int) regions_overlap.size() <<
+                                          "chromosome" << chromosome
+                                        ));
+
+      if (processing::is_canceled(status, msg)) {
+        return ChromosomeRegionsBlock(chromosome, RegionsBlock());
       }
 
-      return ChromosomeRegions(chromosome, std::move(regions));
+      // Only the selected rows are copied, no region object is created.
+      const std::vector<size_t> selected = sweep::select(regions_data, regions_overlap, overlap, amount, amount_type, status->task_limit());
+      return ChromosomeRegionsBlock(chromosome, regions_data.select(selected));
     }
 
-    bool intersect(ChromosomeRegionsList &regions_data, ChromosomeRegionsList &regions_overlap,
-                   processing::StatusPtr status, ChromosomeRegionsList &intersections, std::string &msg)
+    bool intersect(ChromosomeRegionsBlockList &regions_data, ChromosomeRegionsBlockList &regions_overlap,
+                   processing::StatusPtr status, ChromosomeRegionsBlockList &intersections, std::string &msg)
     {
       return overlap(regions_data, regions_overlap, true, 0.0, "bp", status, intersections, msg);
     }
 
-    bool overlap(ChromosomeRegionsList &regions_data, ChromosomeRegionsList &regions_overlap,
+    bool overlap(ChromosomeRegionsBlockList &regions_data, ChromosomeRegionsBlockList &regions_overlap,
                  const bool overlap, const double amount, const std::string amount_type,
-                 processing::StatusPtr status,  ChromosomeRegionsList &overlaps, std::string &msg)
+                 processing::StatusPtr status, ChromosomeRegionsBlockList &overlaps, std::string &msg)
     {
       processing::RunningOp runningOp = status->start_operation(processing::ALGORITHM_OVERLAP);
       if (processing::is_canceled(status, msg)) {
         return false;
       }
 
-      // long times = clock();
       std::set<std::string> chromosomes;
-      merge_chromosomes(regions_data, regions_overlap, chromosomes);
+      for (const auto &chr : regions_data) {
+        chromosomes.insert(chr.first);
+      }
+      for (const auto &chr : regions_overlap) {
+        chromosomes.insert(chr.first);
+      }
 
-      std::vector<std::future<ChromosomeRegions > > threads;
-      std::vector<std::shared_ptr<ChromosomeRegionsList> > result_parts;
+      std::vector<std::string> chrs;
+      std::vector<RegionsBlock> chrs_regions_data;
+      std::vector<RegionsBlock> chrs_regions_overlap;
 
       for (const auto& chr : chromosomes) {
-        Regions chr_regions_data;
-        Regions chr_regions_overlap;
+        RegionsBlock chr_regions_data;
+        RegionsBlock chr_regions_overlap;
 
         bool has_data = get_chromosome_regions(regions_data, chr, chr_regions_data);
         bool has_overlap = get_chromosome_regions(regions_overlap, chr, chr_regions_overlap);
 
-        // If is there no data, nothing to be made.
         if (!has_data) {
           continue;
         }
 
-        // If I want overlaps, but nothing to overlap, nothing to be made.
         if (overlap && !has_overlap) {
           continue;
         }
 
-        // If I do not want overlaps, but nothing to overlap to... Add them all!
         if (!overlap && !has_overlap) {
-          overlaps.emplace_back(ChromosomeRegions(chr, std::move(chr_regions_data)));
+          overlaps.emplace_back(ChromosomeRegionsBlock(chr, std::move(chr_regions_data)));
           continue;
         }
 
-        auto t = std::async(std::launch::async, &overlap_regions,
-                            std::move(chr_regions_data), std::move(chr_regions_overlap), std::ref(chr),
-                            std::ref(overlap), std::ref(amount), std::ref(amount_type), std::ref(status), std::ref(msg));
+        chrs.push_back(chr);
+        chrs_regions_data.emplace_back(std::move(chr_regions_data));
+        chrs_regions_overlap.emplace_back(std::move(chr_regions_overlap));
+      }
 
-        threads.emplace_back(std::move(t));
+      std::vector<ChromosomeRegionsBlock> results(chrs.size());
+      threading::TaskGroup tasks(status->task_limit());
+      for (size_t i = 0; i < chrs.size(); ++i) {
+        tasks.spawn([&, i]() {
+          results[i] = overlap_regions_block(std::move(chrs_regions_data[i]), std::move(chrs_regions_overlap[i]), chrs[i],
+                                             overlap, amount, amount_type, status, msg);
+        });
       }
+      tasks.wait();
 
-      for (size_t i = 0; i < threads.size(); ++i) {
-        threads[i].wait();
-        auto result = threads[i].get();
+      for (auto &result : results) {
         if (!result.second.empty()) {
           overlaps.emplace_back(std::move(result));
         }
       }
 
-
-
-      // long diffticks = clock() - times;
-      // "OVERLAP: " << ((diffticks) / (CLOCKS_PER_SEC / 1000)) << std::endl;
       return true;
     }
-
   }
 }
\ No newline at end of file
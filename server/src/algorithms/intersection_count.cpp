@@ -19,140 +19,44 @@
 //
 
 #include <cmath>
-#include <future>
 #include <iostream>
 #include <set>
 #include <vector>
-#include <thread>
 
 #include "../datatypes/regions.hpp"
+#include "../datatypes/regions_block.hpp"
+
+#include "../processing/processing.hpp"
+
+#include "../threading/executor.hpp"
 
 #include "algorithms.hpp"
+#include "overlap_sweep.hpp"
 
 namespace epidb {
   namespace algorithms {
 
     bool overlap_count(const ChromosomeRegionsList &regions_data, const ChromosomeRegionsList &regions_overlap,
                        const bool overlap, const double amount, const std::string amount_type,
-                       size_t& count);
-
-    size_t overlap_regions_count(const Regions &regions_data, const Regions &regions_overlap, const std::string& chromosome,
-                                 const bool overlap, const double amount, const std::string amount_type)
-    {
-      bool dynamic_overlap_length = amount_type == "bp" ? false : true;
-
-      size_t count = 0;
-      size_t data_size = regions_data.size();
-      size_t data_pos = 0;
-
-      auto it_ranges = regions_overlap.begin();
-
-      Length min_range_length = -1;
-      Length min_data_length = -1;
-
-      while (it_ranges != regions_overlap.end()) {
-
-        if (dynamic_overlap_length) {
-          min_range_length = ceil(static_cast<double>( (*it_ranges)->end() - (*it_ranges)->start() ) * (amount / 100));
-        } else {
-          min_range_length = static_cast<Length>(amount);
-        }
-
-        while ((data_pos < data_size) &&
-               (regions_data[data_pos]->end() <= (*it_ranges)->start()) )  {
-
-          if (dynamic_overlap_length) {
-            min_data_length = ceil(static_cast<double>((regions_data[data_pos]->end() - regions_data[data_pos]->start())) * (amount / 100));
-          } else {
-            min_data_length = static_cast<Length>(amount);
-          }
-
-          if (!overlap) {
-            Length distance = calculate_distance(regions_data[data_pos], *it_ranges);
-            if ((distance >= min_range_length) && (distance >= min_data_length)) {
-              count++;
-            }
-          }
-          data_pos++;
-        }
-
-        while ((data_pos < data_size) &&
-               ((*it_ranges)->end() >= regions_data[data_pos]->start()) )  {
-
-          if (((*it_ranges)->start() < regions_data[data_pos]->end()) &&
-              ((*it_ranges)->end() > regions_data[data_pos]->start())) {
-
-            if (overlap) {
-              if (dynamic_overlap_length) {
-                min_data_length = ceil(static_cast<double>((regions_data[data_pos]->end() - regions_data[data_pos]->start())) * (amount / 100));
-              } else {
-                min_data_length = static_cast<Length>(amount);
-              }
-
-              Length overlap_one = calculate_overlap(*it_ranges, regions_data[data_pos]);
-              Length overlap_two = calculate_overlap(regions_data[data_pos], *it_ranges);
-
-              if (((overlap_one >= min_range_length) || (overlap_two >= min_range_length)) &&
-                  ((overlap_one >= min_data_length)  || (overlap_two >= min_data_length))) {
-
-                count++;
-              }
-            }
-          } else {
-            if (!overlap) {
-
-              Length distance_one = calculate_distance(*it_ranges, regions_data[data_pos]);
-              Length distance_two = calculate_distance(regions_data[data_pos], *it_ranges);
-
-              if ((distance_one >= min_range_length) && (distance_two >= min_range_length) &&
-                  (distance_one >= min_data_length)  && (distance_two >= min_data_length)) {
-
-                count++;
-              }
-            }
-          }
-          data_pos++;
-        }
-
-        it_ranges++;
-      }
-
-      // Distance to the last element of the regions_overlap
-      if (!overlap) {
-        while (data_pos < data_size) {
-          if (dynamic_overlap_length) {
-            min_data_length = ceil(static_cast<double>((regions_data[data_pos]->end() - regions_data[data_pos]->start())) * (amount / 100));
-          } else {
-            min_data_length = static_cast<Length>(amount);
-          }
-
-          Length distance = calculate_distance(regions_overlap.back(), regions_data[data_pos]);
-          if (distance >= min_range_length) {
-            count++;
-          }
-          data_pos++;
-        }
-      }
-
-      return count;
-    }
+                       processing::StatusPtr status, size_t& count);
 
     bool intersect_count(const ChromosomeRegionsList &regions_data, const ChromosomeRegionsList &regions_overlap,
-                         size_t& count)
+                         processing::StatusPtr status, size_t& count)
     {
-      return overlap_count(regions_data, regions_overlap, true, 0.0, "bp", count);
+      return overlap_count(regions_data, regions_overlap, true, 0.0, "bp", status, count);
     }
 
     bool overlap_count(const ChromosomeRegionsList &regions_data, const ChromosomeRegionsList &regions_overlap,
                        const bool overlap, const double amount, const std::string amount_type,
-                       size_t& count)
+                       processing::StatusPtr status, size_t& count)
     {
       count = 0;
 
       std::set<std::string> chromosomes;
       merge_chromosomes(regions_data, regions_overlap, chromosomes);
 
-      std::vector<std::future<size_t > > threads;
+      std::vector<const Regions*> chrs_regions_data;
+      std::vector<const Regions*> chrs_regions_overlap;
 
       for (const auto& chr : chromosomes) {
 
@@ -192,24 +96,71 @@ namespace epidb {
           continue;
         }
 
-        auto t = std::async(std::launch::async, &overlap_regions_count,
-                            std::ref(cit_data->second), std::ref(cit_overlap->second), std::ref(chr),
-                            std::ref(overlap), std::ref(amount), std::ref(amount_type));
-
-        threads.emplace_back(std::move(t));
+        chrs_regions_data.push_back(&cit_data->second);
+        chrs_regions_overlap.push_back(&cit_overlap->second);
       }
 
-      size_t total = 0;
-      for (size_t i = 0; i < threads.size(); ++i) {
-        threads[i].wait();
-        auto result = threads[i].get();
-        total += result;
+      std::vector<size_t> counts(chrs_regions_data.size(), 0);
+      threading::TaskGroup tasks(status->task_limit());
+      for (size_t i = 0; i < counts.size(); ++i) {
+        tasks.spawn([&, i]() {
+          counts[i] = sweep::count(*chrs_regions_data[i], *chrs_regions_overlap[i], overlap, amount, amount_type, status->task_limit());
+        });
       }
+      tasks.wait();
 
-      count = total;
+      for (const auto c : counts) {
+        count += c;
+      }
 
       return true;
     }
 
+    bool intersect_count(const ChromosomeRegionsBlockList &regions_data, const ChromosomeRegionsBlockList &regions_overlap,
+                         processing::StatusPtr status, size_t& count)
+    {
+      return overlap_count(regions_data, regions_overlap, true, 0.0, "bp", status, count);
+    }
+
+    bool overlap_count(const ChromosomeRegionsBlockList &regions_data, const ChromosomeRegionsBlockList &regions_overlap,
+                       const bool overlap, const double amount, const std::string amount_type,
+                       processing::StatusPtr status, size_t& count)
+    {
+      std::vector<const RegionsBlock*> chrs_regions_data;
+      std::vector<const RegionsBlock*> chrs_regions_overlap;
+
+      count = 0;
+      for (const auto &chr_data : regions_data) {
+        auto cit_overlap = regions_overlap.begin();
+        while (cit_overlap != regions_overlap.end() && cit_overlap->first != chr_data.first) {
+          cit_overlap++;
+        }
+
+        if (cit_overlap == regions_overlap.end()) {
+          if (!overlap) {
+            count += chr_data.second.size();
+          }
+          continue;
+        }
+
+        chrs_regions_data.push_back(&chr_data.second);
+        chrs_regions_overlap.push_back(&cit_overlap->second);
+      }
+
+      std::vector<size_t> counts(chrs_regions_data.size(), 0);
+      threading::TaskGroup tasks(status->task_limit());
+      for (size_t i = 0; i < counts.size(); ++i) {
+        tasks.spawn([&, i]() {
+          counts[i] = sweep::count(*chrs_regions_data[i], *chrs_regions_overlap[i], overlap, amount, amount_type, status->task_limit());
+        });
+      }
+      tasks.wait();
+
+      for (const auto c : counts) {
+        count += c;
+      }
+
+      return true;
+    }
   }
 }
\ No newline at end of file
@@ -0,0 +1,114 @@
+//
+//  interval_index.cpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "interval_index.hpp"
+
+namespace epidb {
+  namespace algorithms {
+
+    IntervalIndex::IntervalIndex(const Regions &regions) :
+      _max_level(0)
+    {
+      load(regions);
+      build();
+    }
+
+    IntervalIndex::IntervalIndex(const RegionsBlock &block) :
+      _max_level(0)
+    {
+      load(block);
+      build();
+    }
+
+    template <typename Container>
+    void IntervalIndex::load(const Container &regions)
+    {
+      const size_t n = sweep::size(regions);
+
+      bool sorted = true;
+      for (size_t i = 1; i < n && sorted; i++) {
+        sorted = sweep::start(regions, i - 1) <= sweep::start(regions, i);
+      }
+
+      if (!sorted) {
+        // Stable, so the regions with the same start keep their order
+        _positions.resize(n);
+        std::iota(_positions.begin(), _positions.end(), 0);
+        std::stable_sort(_positions.begin(), _positions.end(), [&](const size_t a, const size_t b) {
+          return sweep::start(regions, a) < sweep::start(regions, b);
+        });
+      }
+
+      _starts.resize(n);
+      _ends.resize(n);
+      for (size_t i = 0; i < n; i++) {
+        _starts[i] = sweep::start(regions, position(i));
+        _ends[i] = sweep::end(regions, position(i));
+      }
+    }
+
+    void IntervalIndex::build()
+    {
+      const size_t n = _starts.size();
+      _max_ends.resize(n);
+      if (n == 0) {
+        return;
+      }
+
+      // Leaves
+      size_t last_i = 0;
+      Position last = 0;
+      for (size_t i = 0; i < n; i += 2) {
+        last_i = i;
+        last = _max_ends[i] = _ends[i];
+      }
+
+      // Inner nodes, level by level.
+      // last is the maximum end of the sub-tree of last_i, the last node of the level,
+      // used for the right children that are after the last region.
+      int k;
+      for (k = 1; (size_t(1) << k) <= n; k++) {
+        const size_t x = size_t(1) << (k - 1);
+        const size_t step = x << 2;
+        for (size_t i = (x << 1) - 1; i < n; i += step) {
+          const Position left = _max_ends[i - x];
+          const Position right = i + x < n ? _max_ends[i + x] : last;
+          _max_ends[i] = std::max(_ends[i], std::max(left, right));
+        }
+        last_i = (last_i >> k) & 1 ? last_i - x : last_i + x;
+        if (last_i < n && _max_ends[last_i] > last) {
+          last = _max_ends[last_i];
+        }
+      }
+      _max_level = k - 1;
+    }
+
+    size_t IntervalIndex::memory_size() const
+    {
+      return sizeof(IntervalIndex) +
+             (_starts.capacity() + _ends.capacity() + _max_ends.capacity()) * sizeof(Position) +
+             _positions.capacity() * sizeof(size_t);
+    }
+  }
+}
@@ -0,0 +1,186 @@
+//
+//  interval_index.hpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef EPIDB_ALGORITHMS_INTERVAL_INDEX_HPP
+#define EPIDB_ALGORITHMS_INTERVAL_INDEX_HPP
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "overlap_sweep.hpp"
+
+#include "../datatypes/regions.hpp"
+#include "../datatypes/regions_block.hpp"
+
+namespace epidb {
+  namespace algorithms {
+
+    //
+    // Implicit augmented interval tree over the regions of one chromosome.
+    // The coordinates are kept in arrays sorted by start, and the tree is the
+    // in-order layout of these arrays: the node at position i of level k has
+    // its k lower bits set, and stores the maximum end of its sub-tree.
+    // The index is immutable after built, so it can be shared by threads and
+    // kept for a dataset chromosome while it is used.
+    //
+    // Overlap is closed: the region [s, e] overlaps the query [qs, qe] when
+    // s <= qe and e >= qs. The callers check their own overlap definition on
+    // the returned regions.
+    //
+    class IntervalIndex {
+    private:
+      // Below this level the sub-trees are scanned linearly
+      static const int SCAN_LEVEL = 3;
+
+      std::vector<Position> _starts;
+      std::vector<Position> _ends;
+      std::vector<Position> _max_ends;
+      // Position of the region in the source, empty when it was already sorted by start
+      std::vector<size_t> _positions;
+      int _max_level;
+
+      template <typename Container>
+      void load(const Container &regions);
+      void build();
+
+      size_t position(const size_t i) const
+      {
+        return _positions.empty() ? i : _positions[i];
+      }
+
+    public:
+      explicit IntervalIndex(const Regions &regions);
+      explicit IntervalIndex(const RegionsBlock &block);
+
+      size_t size() const
+      {
+        return _starts.size();
+      }
+
+      size_t memory_size() const;
+
+      //
+      // Call fn(pos) for each region overlapping [start, end], where pos is its
+      // position in the source, in the start order. Stop when fn returns false.
+      //
+      template <typename Visit>
+      void visit(const Position start, const Position end, Visit fn) const
+      {
+        struct Node {
+          size_t x;
+          int k;
+          bool left_done;
+        };
+
+        const size_t n = _starts.size();
+        if (n == 0) {
+          return;
+        }
+
+        Node stack[64];
+        int t = 0;
+        stack[t++] = Node{ (size_t(1) << _max_level) - 1, _max_level, false };
+
+        while (t) {
+          const Node z = stack[--t];
+          if (z.k <= SCAN_LEVEL) {
+            // Small sub-tree: linear scan
+            const size_t i0 = z.x >> z.k << z.k;
+            const size_t i1 = std::min(n, i0 + (size_t(1) << (z.k + 1)) - 1);
+            for (size_t i = i0; i < i1 && _starts[i] <= end; i++) {
+              if (_ends[i] >= start && !fn(position(i))) {
+                return;
+              }
+            }
+          } else if (!z.left_done) {
+            // The left child may not exist, when it is after the last region
+            const size_t y = z.x - (size_t(1) << (z.k - 1));
+            stack[t++] = Node{ z.x, z.k, true };
+            if (y >= n || _max_ends[y] >= start) {
+              stack[t++] = Node{ y, z.k - 1, false };
+            }
+          } else if (z.x < n && _starts[z.x] <= end) {
+            if (_ends[z.x] >= start && !fn(position(z.x))) {
+              return;
+            }
+            stack[t++] = Node{ z.x + (size_t(1) << (z.k - 1)), z.k - 1, false };
+          }
+        }
+      }
+
+      template <typename Emit>
+      void overlaps(const Position start, const Position end, Emit emit) const
+      {
+        visit(start, end, [&](const size_t pos) {
+          emit(pos);
+          return true;
+        });
+      }
+
+      bool any_overlap(const Position start, const Position end) const
+      {
+        bool found = false;
+        visit(start, end, [&](const size_t) {
+          found = true;
+          return false;
+        });
+        return found;
+      }
+
+      size_t count_overlaps(const Position start, const Position end) const
+      {
+        size_t count = 0;
+        visit(start, end, [&](const size_t) {
+          count++;
+          return true;
+        });
+        return count;
+      }
+
+      //
+      // Bulk versions, for all the query ranges.
+      // stab calls emit(range_pos, pos) for each overlapping region.
+      //
+      template <typename Ranges, typename Emit>
+      void stab(const Ranges &ranges, Emit emit) const
+      {
+        for (size_t range_pos = 0; range_pos < sweep::size(ranges); range_pos++) {
+          overlaps(sweep::start(ranges, range_pos), sweep::end(ranges, range_pos), [&](const size_t pos) {
+            emit(range_pos, pos);
+          });
+        }
+      }
+
+      template <typename Ranges>
+      std::vector<size_t> count(const Ranges &ranges) const
+      {
+        std::vector<size_t> counts(sweep::size(ranges));
+        for (size_t range_pos = 0; range_pos < counts.size(); range_pos++) {
+          counts[range_pos] = count_overlaps(sweep::start(ranges, range_pos), sweep::end(ranges, range_pos));
+        }
+        return counts;
+      }
+    };
+
+    typedef std::shared_ptr<const IntervalIndex> IntervalIndexPtr;
+  }
+}
+
+#endif
@@ -25,6 +25,7 @@
 #include <iostream>
 
 #include "../datatypes/regions.hpp"
+#include "../datatypes/regions_block.hpp"
 
 namespace epidb {
   namespace algorithms {
@@ -103,5 +104,82 @@ namespace epidb {
       return results;
     }
 
+    // Both blocks are sorted, so they are merged in a single pass, without sorting again.
+    RegionsBlock merge_regions(const RegionsBlock &regions_a, const RegionsBlock &regions_b)
+    {
+      RegionsBlock results(regions_a.size() + regions_b.size());
+
+      auto is_duplicated = [&results](const RegionsBlock & block, const size_t row) {
+        if (results.empty()) {
+          return false;
+        }
+        const size_t last = results.size() - 1;
+        return block.start(row) == results.start(last) &&
+               block.end(row) == results.end(last) &&
+               block.dataset_id(row) == results.dataset_id(last);
+      };
+
+      size_t pos_a = 0;
+      size_t pos_b = 0;
+      while (pos_a < regions_a.size() || pos_b < regions_b.size()) {
+        bool take_a;
+        if (pos_a == regions_a.size()) {
+          take_a = false;
+        } else if (pos_b == regions_b.size()) {
+          take_a = true;
+        } else {
+          take_a = !((regions_b.start(pos_b) < regions_a.start(pos_a)) ||
+                     (regions_b.start(pos_b) == regions_a.start(pos_a) && regions_b.end(pos_b) < regions_a.end(pos_a)));
+        }
+
+        const RegionsBlock &block = take_a ? regions_a : regions_b;
+        size_t &pos = take_a ? pos_a : pos_b;
+        if (!is_duplicated(block, pos)) {
+          results.append_row(block, pos);
+        }
+        pos++;
+      }
+
+      return results;
+    }
+
+    // Same order of the chromosomes as the regions version: the common ones, then the ones only in a and only in b, each sorted.
+    ChromosomeRegionsBlockList merge_chromosome_regions(ChromosomeRegionsBlockList &chrregions_a, ChromosomeRegionsBlockList &chrregions_b)
+    {
+      ChromosomeRegionsBlockList results;
+      std::map<std::string, RegionsBlock> chromosomes_a;
+      std::map<std::string, RegionsBlock> chromosomes_b;
+      std::set<std::string> chromosomes;
+
+      for (auto &qra : chrregions_a) {
+        chromosomes_a[qra.first] = std::move(qra.second);
+      }
+
+      for (auto &qrb : chrregions_b) {
+        chromosomes_b[qrb.first] = std::move(qrb.second);
+        if (chromosomes_a.find(qrb.first) != chromosomes_a.end()) {
+          chromosomes.insert(qrb.first);
+        }
+      }
+
+      for (const auto &chromosome : chromosomes) {
+        results.push_back(ChromosomeRegionsBlock(chromosome, merge_regions(chromosomes_a[chromosome], chromosomes_b[chromosome])));
+      }
+
+      for (auto &qra : chromosomes_a) {
+        if (chromosomes.find(qra.first) == chromosomes.end()) {
+          results.push_back(ChromosomeRegionsBlock(qra.first, std::move(qra.second)));
+        }
+      }
+
+      for (auto &qrb : chromosomes_b) {
+        if (chromosomes.find(qrb.first) == chromosomes.end()) {
+          results.push_back(ChromosomeRegionsBlock(qrb.first, std::move(qrb.second)));
+        }
+      }
+
+      return results;
+    }
+
   } // namespace algorithms
 } // namespace epidb
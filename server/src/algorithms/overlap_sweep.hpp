@@ -0,0 +1,355 @@
+//
+//  overlap_sweep.hpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef EPIDB_ALGORITHMS_OVERLAP_SWEEP_HPP
+#define EPIDB_ALGORITHMS_OVERLAP_SWEEP_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "../datatypes/regions.hpp"
+#include "../datatypes/regions_block.hpp"
+
+#include "../threading/executor.hpp"
+
+namespace epidb {
+  namespace algorithms {
+    namespace sweep {
+
+      // Uniform access to the coordinates of Regions and RegionsBlock,
+      // so the sweeps are written only once for both containers.
+      inline size_t size(const Regions &regions)
+      {
+        return regions.size();
+      }
+
+      inline Position start(const Regions &regions, const size_t pos)
+      {
+        return regions[pos]->start();
+      }
+
+      inline Position end(const Regions &regions, const size_t pos)
+      {
+        return regions[pos]->end();
+      }
+
+      inline size_t size(const RegionsBlock &block)
+      {
+        return block.size();
+      }
+
+      inline Position start(const RegionsBlock &block, const size_t pos)
+      {
+        return block.start(pos);
+      }
+
+      inline Position end(const RegionsBlock &block, const size_t pos)
+      {
+        return block.end(pos);
+      }
+
+      //
+      // Part of the sweep: the ranges [range_begin, range_end) and the data from data_begin.
+      // The last partition also processes the data after the last range.
+      //
+      struct Partition {
+        size_t range_begin;
+        size_t range_end;
+        size_t data_begin;
+        // Value left by the previous partitions, read when looking for non overlapping data
+        Length min_data_length;
+        bool last;
+      };
+
+      // Minimum number of regions (data and ranges) of a partition.
+      const size_t PARTITION_SIZE = 64 * 1024;
+
+      //
+      // Sweep the sorted data against the sorted ranges of the partition.
+      // emit(pos) is called for every data position that overlaps (overlap = true)
+      // or that does not overlap (overlap = false) the ranges by the given amount.
+      //
+      template <typename Data, typename Ranges, typename Emit>
+      void overlap(const Data &data, const Ranges &ranges, const Partition &partition,
+                   const bool overlap, const double amount, const std::string &amount_type,
+                   Emit emit)
+      {
+        bool dynamic_overlap_length = amount_type == "bp" ? false : true;
+
+        const size_t data_size = size(data);
+        const size_t ranges_size = size(ranges);
+        size_t data_pos = partition.data_begin;
+
+        Length min_range_length = -1;
+        Length min_data_length = partition.min_data_length;
+
+        for (size_t range_pos = partition.range_begin; range_pos < partition.range_end; range_pos++) {
+          const Position range_start = start(ranges, range_pos);
+          const Position range_end = end(ranges, range_pos);
+
+          if (dynamic_overlap_length) {
+            min_range_length = ceil(static_cast<double>(range_end - range_start) * (amount / 100));
+          } else {
+            min_range_length = static_cast<Length>(amount);
+          }
+
+          while ((data_pos < data_size) &&
+                 (end(data, data_pos) <= range_start))  {
+
+            if (dynamic_overlap_length) {
+              min_data_length = ceil(static_cast<double>(end(data, data_pos) - start(data, data_pos)) * (amount / 100));
+            } else {
+              min_data_length = static_cast<Length>(amount);
+            }
+
+            if (!overlap) {
+              Length distance = range_start - end(data, data_pos);
+              if ((distance >= min_range_length) && (distance >= min_data_length)) {
+                emit(data_pos);
+              }
+            }
+            data_pos++;
+          }
+
+          while ((data_pos < data_size) &&
+                 (range_end >= start(data, data_pos)))  {
+
+            const Position data_start = start(data, data_pos);
+            const Position data_end = end(data, data_pos);
+
+            if ((range_start < data_end) && (range_end > data_start)) {
+
+              if (overlap) {
+                if (dynamic_overlap_length) {
+                  min_data_length = ceil(static_cast<double>(data_end - data_start) * (amount / 100));
+                } else {
+                  min_data_length = static_cast<Length>(amount);
+                }
+
+                Length overlap_one = range_end - data_start;
+                Length overlap_two = data_end - range_start;
+
+                if (((overlap_one >= min_range_length) || (overlap_two >= min_range_length)) &&
+                    ((overlap_one >= min_data_length)  || (overlap_two >= min_data_length))) {
+                  emit(data_pos);
+                }
+              }
+            } else {
+              if (!overlap) {
+                Length distance_one = data_start - range_end;
+                Length distance_two = range_start - data_end;
+
+                if ((distance_one >= min_range_length) && (distance_two >= min_range_length) &&
+                    (distance_one >= min_data_length)  && (distance_two >= min_data_length)) {
+                  emit(data_pos);
+                }
+              }
+            }
+            data_pos++;
+          }
+        }
+
+        // Distance to the last element of the ranges
+        if (!overlap && partition.last && ranges_size > 0) {
+          const Position last_range_end = end(ranges, ranges_size - 1);
+          while (data_pos < data_size) {
+            Length distance = start(data, data_pos) - last_range_end;
+            if (distance >= min_range_length) {
+              emit(data_pos);
+            }
+            data_pos++;
+          }
+        }
+      }
+
+      template <typename Data, typename Ranges, typename Emit>
+      void overlap(const Data &data, const Ranges &ranges,
+                   const bool overlap, const double amount, const std::string &amount_type,
+                   Emit emit)
+      {
+        Partition all = { 0, size(ranges), 0, static_cast<Length>(-1), true };
+        sweep::overlap(data, ranges, all, overlap, amount, amount_type, emit);
+      }
+
+      // First data position starting after the given position
+      template <typename Data>
+      size_t upper_bound(const Data &data, size_t low, const Position position)
+      {
+        size_t high = size(data);
+        while (low < high) {
+          const size_t mid = low + (high - low) / 2;
+          if (start(data, mid) <= position) {
+            low = mid + 1;
+          } else {
+            high = mid;
+          }
+        }
+        return low;
+      }
+
+      //
+      // Split the sweep in at most parts partitions, aligned to the positions of the data.
+      // The sweep reaches a range with its data position right after the last data starting
+      // before the end of any previous range, so every partition starts exactly where the
+      // sequential sweep would be. The min_data_length left by the previous ranges is found
+      // going back to the last data skipped before a range, and the concatenated results
+      // are the same as the sequential sweep.
+      // This only holds for sorted data and ranges without empty data regions:
+      // otherwise a single partition is returned.
+      //
+      template <typename Data, typename Ranges>
+      std::vector<Partition> partitions(const Data &data, const Ranges &ranges,
+                                        const double amount, const std::string &amount_type, size_t parts)
+      {
+        const bool dynamic_overlap_length = amount_type == "bp" ? false : true;
+        const size_t data_size = size(data);
+        const size_t ranges_size = size(ranges);
+
+        std::vector<Partition> result;
+        parts = std::min(parts, (data_size + ranges_size) / PARTITION_SIZE);
+
+        bool valid = parts > 1 && ranges_size > 0;
+        for (size_t pos = 0; valid && pos < data_size; pos++) {
+          valid = start(data, pos) < end(data, pos) && (pos == 0 || start(data, pos - 1) <= start(data, pos));
+        }
+
+        // Maximum end of the ranges until each position
+        std::vector<Position> max_range_end;
+        if (valid) {
+          max_range_end.reserve(ranges_size);
+        }
+        for (size_t pos = 0; valid && pos < ranges_size; pos++) {
+          valid = start(ranges, pos) <= end(ranges, pos) && (pos == 0 || start(ranges, pos - 1) <= start(ranges, pos));
+          max_range_end.push_back(pos == 0 ? end(ranges, pos) : std::max(max_range_end[pos - 1], end(ranges, pos)));
+        }
+
+        if (!valid) {
+          result.push_back(Partition{ 0, ranges_size, 0, static_cast<Length>(-1), true });
+          return result;
+        }
+
+        // Data position of the sequential sweep when it reaches the range
+        auto data_begin = [&](const size_t range_pos) -> size_t {
+          return range_pos == 0 ? 0 : upper_bound(data, 0, max_range_end[range_pos - 1]);
+        };
+
+        size_t range_pos = 0;
+        for (size_t part = 1; part <= parts && range_pos < ranges_size; part++) {
+          size_t range_end = ranges_size;
+          if (part < parts) {
+            const Position split = start(data, part * data_size / parts);
+            range_end = range_pos;
+            while (range_end < ranges_size && start(ranges, range_end) < split) {
+              range_end++;
+            }
+            if (range_end == range_pos || range_end == ranges_size) {
+              continue;
+            }
+          }
+
+          Length min_data_length = static_cast<Length>(-1);
+          const size_t begin = data_begin(range_pos);
+          for (size_t r = range_pos; r > 0; r--) {
+            // Data skipped before the range r - 1, the last one sets min_data_length
+            const size_t first = data_begin(r - 1);
+            size_t skipped = first;
+            while (skipped < begin && end(data, skipped) <= start(ranges, r - 1)) {
+              skipped++;
+            }
+            if (skipped > first) {
+              if (dynamic_overlap_length) {
+                min_data_length = ceil(static_cast<double>(end(data, skipped - 1) - start(data, skipped - 1)) * (amount / 100));
+              } else {
+                min_data_length = static_cast<Length>(amount);
+              }
+              break;
+            }
+          }
+
+          result.push_back(Partition{ range_pos, range_end, begin, min_data_length, range_end == ranges_size });
+          range_pos = range_end;
+        }
+
+        return result;
+      }
+
+      //
+      // Data positions selected by the sweep, in order. The partitions are processed in parallel.
+      //
+      template <typename Data, typename Ranges>
+      std::vector<size_t> select(const Data &data, const Ranges &ranges,
+                                 const bool overlap, const double amount, const std::string &amount_type,
+                                 threading::TaskLimitPtr limit)
+      {
+        const std::vector<Partition> parts = partitions(data, ranges, amount, amount_type, threading::executor().size());
+
+        std::vector<std::vector<size_t>> selected(parts.size());
+        threading::TaskGroup tasks(limit);
+        for (size_t i = 0; i < parts.size(); i++) {
+          tasks.spawn([&, i]() {
+            sweep::overlap(data, ranges, parts[i], overlap, amount, amount_type, [&](const size_t pos) {
+              selected[i].push_back(pos);
+            });
+          });
+        }
+        tasks.wait();
+
+        for (size_t i = 1; i < selected.size(); i++) {
+          selected[0].insert(selected[0].end(), selected[i].begin(), selected[i].end());
+        }
+        return std::move(selected[0]);
+      }
+
+      //
+      // Number of data positions selected by the sweep. The partitions are processed in parallel.
+      //
+      template <typename Data, typename Ranges>
+      size_t count(const Data &data, const Ranges &ranges,
+                   const bool overlap, const double amount, const std::string &amount_type,
+                   threading::TaskLimitPtr limit)
+      {
+        const std::vector<Partition> parts = partitions(data, ranges, amount, amount_type, threading::executor().size());
+
+        std::vector<size_t> counts(parts.size(), 0);
+        threading::TaskGroup tasks(limit);
+        for (size_t i = 0; i < parts.size(); i++) {
+          tasks.spawn([&, i]() {
+            size_t c = 0;
+            sweep::overlap(data, ranges, parts[i], overlap, amount, amount_type, [&c](const size_t) {
+              c++;
+            });
+            counts[i] = c;
+          });
+        }
+        tasks.wait();
+
+        size_t total = 0;
+        for (const auto c : counts) {
+          total += c;
+        }
+        return total;
+      }
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,319 @@
+//
+//  signature.cpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "signature.hpp"
+
+namespace epidb {
+  namespace algorithms {
+
+    static const char MAGIC[4] = {'D', 'B', 'S', 'G'};
+    static const uint32_t VERSION = 1;
+
+    static const size_t HEADER_SIZE = 20;
+    static const size_t CHUNK_ENTRY_SIZE = 12;
+
+    static const uint16_t CHUNK_ARRAY = 0;
+    static const uint16_t CHUNK_BITMAP = 1;
+
+    static const uint32_t CHUNK_POSITIONS = 1 << 16;
+    static const uint32_t ARRAY_MAX_COUNT = 4096;
+    static const size_t BITMAP_WORDS = CHUNK_POSITIONS / 64;
+
+    // Below this ratio of sizes the arrays are merged, above it the small one is searched in the large one
+    static const uint32_t GALLOP_RATIO = 32;
+
+    // The data of a stored signature has no alignment, the reads go through memcpy
+    template <typename T>
+    inline T read(const char* p)
+    {
+      T value;
+      std::memcpy(&value, p, sizeof(T));
+      return value;
+    }
+
+    template <typename T>
+    inline void write(char* p, const T value)
+    {
+      std::memcpy(p, &value, sizeof(T));
+    }
+
+    inline size_t align(const size_t size)
+    {
+      return (size + 7) & ~size_t(7);
+    }
+
+    inline size_t chunk_size(const uint16_t type, const uint32_t count)
+    {
+      return type == CHUNK_ARRAY ? count * sizeof(uint16_t) : BITMAP_WORDS * sizeof(uint64_t);
+    }
+
+    struct Chunk {
+      uint16_t key;
+      uint16_t type;
+      uint32_t count;
+      const char* data;
+    };
+
+    inline Chunk chunk_at(const char* data, const uint32_t i)
+    {
+      const char* entry = data + HEADER_SIZE + i * CHUNK_ENTRY_SIZE;
+      Chunk chunk;
+      chunk.key = read<uint16_t>(entry);
+      chunk.type = read<uint16_t>(entry + 2);
+      chunk.count = read<uint32_t>(entry + 4);
+      chunk.data = data + read<uint32_t>(entry + 8);
+      return chunk;
+    }
+
+    // First position of the array, from begin, that is not lower than value
+    inline uint32_t lower_bound(const char* array, uint32_t begin, const uint32_t end, const uint16_t value)
+    {
+      uint32_t count = end - begin;
+      while (count > 0) {
+        const uint32_t step = count / 2;
+        if (read<uint16_t>(array + (begin + step) * sizeof(uint16_t)) < value) {
+          begin += step + 1;
+          count -= step + 1;
+        } else {
+          count = step;
+        }
+      }
+      return begin;
+    }
+
+    static size_t array_and_count(const char* a, uint32_t a_count, const char* b, uint32_t b_count)
+    {
+      if (a_count > b_count) {
+        std::swap(a, b);
+        std::swap(a_count, b_count);
+      }
+
+      size_t total = 0;
+      if (a_count * GALLOP_RATIO < b_count) {
+        uint32_t j = 0;
+        for (uint32_t i = 0; i < a_count && j < b_count; i++) {
+          const uint16_t value = read<uint16_t>(a + i * sizeof(uint16_t));
+          j = lower_bound(b, j, b_count, value);
+          if (j < b_count && read<uint16_t>(b + j * sizeof(uint16_t)) == value) {
+            total++;
+          }
+        }
+        return total;
+      }
+
+      uint32_t i = 0;
+      uint32_t j = 0;
+      while (i < a_count && j < b_count) {
+        const uint16_t a_value = read<uint16_t>(a + i * sizeof(uint16_t));
+        const uint16_t b_value = read<uint16_t>(b + j * sizeof(uint16_t));
+        total += a_value == b_value;
+        i += a_value <= b_value;
+        j += b_value <= a_value;
+      }
+      return total;
+    }
+
+    static size_t array_bitmap_and_count(const char* array, const uint32_t count, const char* bitmap)
+    {
+      size_t total = 0;
+      for (uint32_t i = 0; i < count; i++) {
+        const uint16_t value = read<uint16_t>(array + i * sizeof(uint16_t));
+        const uint64_t word = read<uint64_t>(bitmap + (value >> 6) * sizeof(uint64_t));
+        total += (word >> (value & 63)) & 1;
+      }
+      return total;
+    }
+
+    // Straight loop over the words, vectorized by the compiler for the target of the build
+    static size_t bitmap_and_count(const char* a, const char* b)
+    {
+      size_t total = 0;
+      for (size_t i = 0; i < BITMAP_WORDS; i++) {
+        total += __builtin_popcountll(read<uint64_t>(a + i * sizeof(uint64_t)) & read<uint64_t>(b + i * sizeof(uint64_t)));
+      }
+      return total;
+    }
+
+    static size_t chunk_and_count(const Chunk& a, const Chunk& b)
+    {
+      if (a.type == CHUNK_BITMAP && b.type == CHUNK_BITMAP) {
+        return bitmap_and_count(a.data, b.data);
+      }
+      if (a.type == CHUNK_ARRAY && b.type == CHUNK_ARRAY) {
+        return array_and_count(a.data, a.count, b.data, b.count);
+      }
+      if (a.type == CHUNK_ARRAY) {
+        return array_bitmap_and_count(a.data, a.count, b.data);
+      }
+      return array_bitmap_and_count(b.data, b.count, a.data);
+    }
+
+    SignatureBuilder::SignatureBuilder(const uint32_t universe) :
+      _universe(universe)
+    { }
+
+    std::string SignatureBuilder::serialize() const
+    {
+      // Chunks as [begin, end) of the positions
+      std::vector<std::pair<size_t, size_t>> chunks;
+      size_t begin = 0;
+      while (begin < _positions.size()) {
+        const uint32_t key = _positions[begin] >> 16;
+        size_t end = begin + 1;
+        while (end < _positions.size() && (_positions[end] >> 16) == key) {
+          end++;
+        }
+        chunks.emplace_back(begin, end);
+        begin = end;
+      }
+
+      size_t size = align(HEADER_SIZE + chunks.size() * CHUNK_ENTRY_SIZE);
+      std::vector<uint32_t> offsets;
+      offsets.reserve(chunks.size());
+      for (const auto& chunk : chunks) {
+        const uint32_t count = chunk.second - chunk.first;
+        offsets.push_back(size);
+        size += align(chunk_size(count <= ARRAY_MAX_COUNT ? CHUNK_ARRAY : CHUNK_BITMAP, count));
+      }
+
+      std::string data(size, '\0');
+      char* out = &data[0];
+
+      std::memcpy(out, MAGIC, sizeof(MAGIC));
+      write<uint32_t>(out + 4, VERSION);
+      write<uint32_t>(out + 8, _universe);
+      write<uint32_t>(out + 12, _positions.size());
+      write<uint32_t>(out + 16, chunks.size());
+
+      for (size_t i = 0; i < chunks.size(); i++) {
+        const size_t chunk_begin = chunks[i].first;
+        const size_t chunk_end = chunks[i].second;
+        const uint32_t count = chunk_end - chunk_begin;
+        const uint16_t type = count <= ARRAY_MAX_COUNT ? CHUNK_ARRAY : CHUNK_BITMAP;
+
+        char* entry = out + HEADER_SIZE + i * CHUNK_ENTRY_SIZE;
+        write<uint16_t>(entry, _positions[chunk_begin] >> 16);
+        write<uint16_t>(entry + 2, type);
+        write<uint32_t>(entry + 4, count);
+        write<uint32_t>(entry + 8, offsets[i]);
+
+        char* chunk_data = out + offsets[i];
+        if (type == CHUNK_ARRAY) {
+          for (size_t p = chunk_begin; p < chunk_end; p++) {
+            write<uint16_t>(chunk_data + (p - chunk_begin) * sizeof(uint16_t), _positions[p] & 0xFFFF);
+          }
+        } else {
+          std::vector<uint64_t> words(BITMAP_WORDS, 0);
+          for (size_t p = chunk_begin; p < chunk_end; p++) {
+            const uint16_t value = _positions[p] & 0xFFFF;
+            words[value >> 6] |= uint64_t(1) << (value & 63);
+          }
+          std::memcpy(chunk_data, words.data(), BITMAP_WORDS * sizeof(uint64_t));
+        }
+      }
+
+      return data;
+    }
+
+    Signature::Signature() :
+      _data(nullptr),
+      _size(0),
+      _universe(0),
+      _count(0),
+      _chunks(0)
+    { }
+
+    bool Signature::load(const char* data, const size_t size, std::string& msg)
+    {
+      if (size < HEADER_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        msg = "Invalid signature data";
+        return false;
+      }
+
+      const uint32_t version = read<uint32_t>(data + 4);
+      if (version != VERSION) {
+        msg = "Invalid signature version: " + std::to_string(version);
+        return false;
+      }
+
+      const uint32_t universe = read<uint32_t>(data + 8);
+      const uint32_t count = read<uint32_t>(data + 12);
+      const uint32_t chunks = read<uint32_t>(data + 16);
+
+      if (chunks > CHUNK_POSITIONS || HEADER_SIZE + size_t(chunks) * CHUNK_ENTRY_SIZE > size) {
+        msg = "Invalid signature size";
+        return false;
+      }
+
+      size_t total = 0;
+      for (uint32_t i = 0; i < chunks; i++) {
+        const Chunk chunk = chunk_at(data, i);
+        const size_t offset = chunk.data - data;
+        if ((i > 0 && chunk.key <= chunk_at(data, i - 1).key) ||
+            chunk.count == 0 || chunk.count > CHUNK_POSITIONS ||
+            (chunk.type == CHUNK_ARRAY && chunk.count > ARRAY_MAX_COUNT) ||
+            (chunk.type != CHUNK_ARRAY && chunk.type != CHUNK_BITMAP) ||
+            offset + chunk_size(chunk.type, chunk.count) > size) {
+          msg = "Invalid signature chunk " + std::to_string(i);
+          return false;
+        }
+        total += chunk.count;
+      }
+
+      if (total != count) {
+        msg = "Invalid signature count";
+        return false;
+      }
+
+      _data = data;
+      _size = size;
+      _universe = universe;
+      _count = count;
+      _chunks = chunks;
+
+      return true;
+    }
+
+    size_t Signature::and_count(const Signature& other) const
+    {
+      size_t total = 0;
+      uint32_t i = 0;
+      uint32_t j = 0;
+      while (i < _chunks && j < other._chunks) {
+        const Chunk a = chunk_at(_data, i);
+        const Chunk b = chunk_at(other._data, j);
+        if (a.key < b.key) {
+          i++;
+        } else if (b.key < a.key) {
+          j++;
+        } else {
+          total += chunk_and_count(a, b);
+          i++;
+          j++;
+        }
+      }
+      return total;
+    }
+  }
+}
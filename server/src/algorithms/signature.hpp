@@ -0,0 +1,99 @@
+//
+//  signature.hpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef EPIDB_ALGORITHMS_SIGNATURE_HPP
+#define EPIDB_ALGORITHMS_SIGNATURE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace epidb {
+  namespace algorithms {
+
+    //
+    // Compressed bitmap of the positions of a universe, in the layout of the
+    // Roaring bitmaps: the positions are split in chunks of 2^16 by their
+    // upper 16 bits, and each non-empty chunk is stored as a sorted array of
+    // the lower 16 bits or, above 4096 positions, as a bitmap of 1024 words.
+    //
+    // The serialized form is the only representation: Signature reads it
+    // where it is, so a signature loaded from the database is used without
+    // copying or decoding it.
+    //
+    // Layout, in host byte order:
+    //   "DBSG", version (u32), universe (u32), count (u32), chunks (u32)
+    //   for each chunk: key (u16), type (u16), count (u32), offset (u32)
+    //   the chunk data, each one aligned to 8 bytes from the start
+    //
+    class SignatureBuilder {
+    private:
+      const uint32_t _universe;
+      std::vector<uint32_t> _positions;
+
+    public:
+      explicit SignatureBuilder(const uint32_t universe);
+
+      uint32_t universe() const
+      {
+        return _universe;
+      }
+
+      // The positions must be added in increasing order
+      void add(const uint32_t position)
+      {
+        _positions.push_back(position);
+      }
+
+      std::string serialize() const;
+    };
+
+    class Signature {
+    private:
+      const char* _data;
+      size_t _size;
+      uint32_t _universe;
+      uint32_t _count;
+      uint32_t _chunks;
+
+    public:
+      Signature();
+
+      // Check the serialized signature and refer to it.
+      // The data must be kept while the signature is used.
+      bool load(const char* data, const size_t size, std::string& msg);
+
+      uint32_t universe() const
+      {
+        return _universe;
+      }
+
+      uint32_t count() const
+      {
+        return _count;
+      }
+
+      // Number of positions set in both signatures
+      size_t and_count(const Signature& other) const;
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,108 @@
+//
+//  frequency_sketch.hpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef EPIDB_CACHE_FREQUENCY_SKETCH_HPP
+#define EPIDB_CACHE_FREQUENCY_SKETCH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace epidb {
+  namespace cache {
+
+    //
+    // Count-min sketch with small saturating counters, used as the TinyLFU
+    // admission filter: it estimates how often a key was requested recently.
+    // All counters are halved after a number of increments, so old popularity fades.
+    // Not thread safe, the owner must lock it.
+    //
+    class FrequencySketch {
+    private:
+      static const size_t DEPTH = 4;
+      static const uint8_t MAX_COUNT = 15;
+
+      std::vector<uint8_t> _counters;
+      size_t _width;
+      size_t _additions;
+      size_t _sample_size;
+
+      size_t index(const size_t hash, const size_t row) const
+      {
+        // Derive the row hashes from a single hash (Kirsch-Mitzenmacher)
+        size_t h = hash + row * ((hash >> 17) | (hash << 15) | 1);
+        return row * _width + (h % _width);
+      }
+
+      void reset()
+      {
+        for (auto &counter : _counters) {
+          counter >>= 1;
+        }
+        _additions /= 2;
+      }
+
+    public:
+      explicit FrequencySketch(const size_t width = 1024) :
+        _counters(DEPTH * width, 0),
+        _width(width),
+        _additions(0),
+        _sample_size(width * 10)
+      { }
+
+      void increment(const std::string &key)
+      {
+        const size_t hash = std::hash<std::string>()(key);
+        bool added = false;
+        for (size_t row = 0; row < DEPTH; row++) {
+          uint8_t &counter = _counters[index(hash, row)];
+          if (counter < MAX_COUNT) {
+            counter++;
+            added = true;
+          }
+        }
+
+        if (added && ++_additions >= _sample_size) {
+          reset();
+        }
+      }
+
+      uint8_t frequency(const std::string &key) const
+      {
+        const size_t hash = std::hash<std::string>()(key);
+        uint8_t freq = MAX_COUNT;
+        for (size_t row = 0; row < DEPTH; row++) {
+          freq = std::min(freq, _counters[index(hash, row)]);
+        }
+        return freq;
+      }
+
+      void clear()
+      {
+        std::fill(_counters.begin(), _counters.end(), 0);
+        _additions = 0;
+      }
+    };
+  }
+}
+
+#endif
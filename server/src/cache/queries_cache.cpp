@@ -18,88 +18,271 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 
-#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 
-#include <boost/bimap/set_of.hpp>
-
-#include "../algorithms/lru.hpp"
+#include "../config/config.hpp"
 
 #include "../datatypes/regions.hpp"
 
 #include "../dba/queries.hpp"
 
+#include "frequency_sketch.hpp"
 #include "queries_cache.hpp"
 
 namespace epidb {
   namespace cache {
 
-    std::condition_variable cv;
-    std::set<std::string> waiting_list;
-    std::mutex m;
+    namespace query {
+
+      //
+      // One part of the queries cache. The keys are distributed between the shards by
+      // their hash, so requests for different queries do not wait for the same mutex.
+      //
+      // Each shard has a bytes budget and keeps the entries in LRU order.
+      // A new result is only admitted if it is requested more often (TinyLFU sketch)
+      // than the entries that would be evicted to make room for it.
+      // Concurrent requests of the same missing query wait for the first one (single flight).
+      //
+      class QueryCacheShard {
+      private:
+        typedef std::list<std::string> LRUList;
+
+        struct Entry {
+          QUERY_RESULT result;
+          LRUList::iterator position;
+        };
+
+        std::mutex _mutex;
+        std::unordered_map<std::string, Entry> _entries;
+        LRUList _lru;
+        std::unordered_map<std::string, std::shared_future<QUERY_RESULT>> _flights;
+        FrequencySketch _sketch;
+        size_t _bytes;
+        size_t _generation;
+
+        void remove(std::unordered_map<std::string, Entry>::iterator it)
+        {
+          _bytes -= it->second.result.size;
+          _lru.erase(it->second.position);
+          _entries.erase(it);
+        }
+
+        // Must be called with the mutex locked
+        void admit(const std::string &query_id, const QUERY_RESULT &result, const size_t budget,
+                   QueryCacheStats &stats)
+        {
+          if (result.size > budget) {
+            stats.rejected++;
+            return;
+          }
+
+          // Select the victims before removing any of them
+          const uint8_t candidate_freq = _sketch.frequency(query_id);
+          size_t freed = 0;
+          std::vector<std::string> victims;
+          for (auto it = _lru.begin(); it != _lru.end() && _bytes - freed + result.size > budget; ++it) {
+            if (_sketch.frequency(*it) > candidate_freq) {
+              stats.rejected++;
+              return;
+            }
+            freed += _entries[*it].result.size;
+            victims.push_back(*it);
+          }
+
+          for (const auto &victim : victims) {
+            remove(_entries.find(victim));
+            stats.evictions++;
+          }
+
+          Entry entry;
+          entry.result = result;
+          entry.position = _lru.insert(_lru.end(), query_id);
+          _entries[query_id] = std::move(entry);
+          _bytes += result.size;
+        }
+
+      public:
+        QueryCacheShard() :
+          _bytes(0),
+          _generation(0)
+        { }
+
+        QUERY_RESULT get(const QUERY_KEY &qk, const size_t budget,
+                         std::function<QUERY_RESULT(const QUERY_KEY &)> fn, QueryCacheStats &stats)
+        {
+          std::promise<QUERY_RESULT> promise;
+          std::shared_future<QUERY_RESULT> flight;
+          size_t generation;
+          bool waited = false;
+
+          while (true) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!waited) {
+              _sketch.increment(qk.query_id);
+            }
+
+            auto it = _entries.find(qk.query_id);
+            if (it != _entries.end()) {
+              _lru.splice(_lru.end(), _lru, it->second.position);
+              stats.hits++;
+              return it->second.result;
+            }
+
+            auto fit = _flights.find(qk.query_id);
+            if (fit == _flights.end()) {
+              flight = promise.get_future().share();
+              _flights[qk.query_id] = flight;
+              generation = _generation;
+              break;
+            }
+
+            // Other request is processing this query: wait for its result
+            flight = fit->second;
+            lock.unlock();
+
+            QUERY_RESULT result = flight.get();
+            if (result.success || waited) {
+              stats.hits++;
+              return result;
+            }
+            // The other request failed (e.g. it was canceled). Try once by ourselves.
+            waited = true;
+          }
+
+          stats.misses++;
+          QUERY_RESULT result;
+          try {
+            result = fn(qk);
+          } catch (const std::exception &e) {
+            result.success = false;
+            result.msg = e.what();
+            result.count = 0;
+            result.size = 0;
+          }
+
+          {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _flights.erase(qk.query_id);
+            // Failures are not cached, neither results computed before an invalidation
+            if (result.success && generation == _generation) {
+              admit(qk.query_id, result, budget, stats);
+            }
+          }
+          promise.set_value(result);
+
+          return result;
+        }
+
+        void clear()
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _entries.clear();
+          _lru.clear();
+          _sketch.clear();
+          _bytes = 0;
+          _generation++;
+        }
+
+        void collect(size_t &entries, size_t &bytes)
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          entries += _entries.size();
+          bytes += _bytes;
+        }
+      };
+    }
+
+    static const size_t QUERY_CACHE_SHARDS = 16;
+
+    query::QueryCacheShard QUERY_CACHE[QUERY_CACHE_SHARDS];
+    query::QueryCacheStats QUERY_CACHE_STATS;
 
     query::QUERY_RESULT fn(const query::QUERY_KEY& qk)
     {
+      std::shared_ptr<ChromosomeRegionsList> regions = std::make_shared<ChromosomeRegionsList>();
+
       query::QUERY_RESULT result;
-      result.success = dba::query::retrieve_query(qk.user, qk.query_id, qk.status, result.regions, result.msg);
+      result.success = dba::query::retrieve_query(qk.user, qk.query_id, qk.status, *regions, result.msg);
+      result.count = 0;
+      result.size = 0;
+
+      // The sizes are computed once, when the result is stored
+      for (const auto& chromosome_regions_list : *regions) {
+        result.count += chromosome_regions_list.second.size();
+        for (const auto& region : chromosome_regions_list.second) {
+          result.size += region->size();
+        }
+      }
+      result.regions = regions;
 
       return result;
     }
 
-    lru_cache_using_boost<query::QUERY_KEY, query::QUERY_RESULT, boost::bimaps::set_of> QUERY_CACHE(fn, 16);
-
-
     bool get_query_cache(const datatypes::User& user,
                          const std::string &query_id,
-                         processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg)
+                         processing::StatusPtr status, ChromosomeRegionsListPtr &regions, std::string &msg)
     {
       query::QUERY_KEY qk;
       qk.user = user;
       qk.query_id = query_id;
       qk.status = status;
 
-      // this query is being processed
-      if (waiting_list.find(qk.query_id) != waiting_list.end()) {
-        std::unique_lock<std::mutex> lk(m);
-        cv.wait(lk, [qk] {
-          return waiting_list.find(qk.query_id) == waiting_list.end();
-        });
-      }
-
-      {
-        std::lock_guard<std::mutex> guard(m);
-        waiting_list.insert(qk.query_id);
-      }
+      const size_t shard = std::hash<std::string>()(query_id) % QUERY_CACHE_SHARDS;
+      const size_t budget = config::get_query_cache_max_memory() / QUERY_CACHE_SHARDS;
 
-      query::QUERY_RESULT qr = QUERY_CACHE(qk);
+      query::QUERY_RESULT qr = QUERY_CACHE[shard].get(qk, budget, fn, QUERY_CACHE_STATS);
 
-      {
-        std::lock_guard<std::mutex> guard(m);
-        waiting_list.erase(qk.query_id);
-        cv.notify_all();
-      }
+      regions = qr.regions;
+      status->sum_regions(qr.count);
+      status->sum_size(qr.size);
+      msg = qr.msg;
 
-      regions = std::move(qr.regions);
-      status->sum_regions(count_regions(regions));
-      size_t total_size = 0;
+      return qr.success;
+    }
 
-      for (auto& chromosome_regions_list : regions) {
-        const std::string &chromosome = chromosome_regions_list.first;
-        for (auto& region : chromosome_regions_list.second) {
-          total_size += region->size();
-        }
+    bool get_query_cache(const datatypes::User& user,
+                         const std::string &query_id,
+                         processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg)
+    {
+      ChromosomeRegionsListPtr shared_regions;
+      if (!get_query_cache(user, query_id, status, shared_regions, msg)) {
+        return false;
       }
 
-      status->sum_size(total_size);
-      msg = qr.msg;
-
-      return qr.success;
+      // Copy-on-write: the caller receives its own regions to modify.
+      regions = *shared_regions;
+      return true;
     }
 
     void queries_cache_invalidate()
     {
-      QUERY_CACHE.clear();
+      for (auto &shard : QUERY_CACHE) {
+        shard.clear();
+      }
+    }
+
+    void queries_cache_stats(size_t &hits, size_t &misses, size_t &evictions, size_t &rejected,
+                             size_t &entries, size_t &bytes, size_t &max_bytes)
+    {
+      hits = QUERY_CACHE_STATS.hits;
+      misses = QUERY_CACHE_STATS.misses;
+      evictions = QUERY_CACHE_STATS.evictions;
+      rejected = QUERY_CACHE_STATS.rejected;
+
+      entries = 0;
+      bytes = 0;
+      for (auto &shard : QUERY_CACHE) {
+        shard.collect(entries, bytes);
+      }
+      max_bytes = config::get_query_cache_max_memory();
     }
   }
 }
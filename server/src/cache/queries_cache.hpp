@@ -21,12 +21,9 @@
 #ifndef EPIDB_QUERIES_CACHE_HPP
 #define EPIDB_QUERIES_CACHE_HPP
 
+#include <atomic>
 #include <string>
 
-#include <boost/bimap/set_of.hpp>
-
-#include "../algorithms/lru.hpp"
-
 #include "../datatypes/regions.hpp"
 #include "../datatypes/user.hpp"
 
@@ -46,18 +43,40 @@ namespace epidb {
         }
       };
 
+      // The regions are shared with the requests and never modified.
       struct QUERY_RESULT {
         bool success;
-        ChromosomeRegionsList regions;
+        ChromosomeRegionsListPtr regions;
+        size_t count;
+        size_t size;
         std::string msg;
       };
+
+      struct QueryCacheStats {
+        std::atomic<size_t> hits;
+        std::atomic<size_t> misses;
+        std::atomic<size_t> evictions;
+        std::atomic<size_t> rejected;
+
+        QueryCacheStats() :
+          hits(0), misses(0), evictions(0), rejected(0) {}
+      };
     }
 
+    // Returns the cached regions without copying them.
+    bool get_query_cache(const datatypes::User& user,
+                         const std::string &query_id,
+                         processing::StatusPtr status, ChromosomeRegionsListPtr &regions, std::string &msg);
+
+    // Copy of the cached regions, for the operations that modify them.
     bool get_query_cache(const datatypes::User& user,
                          const std::string &query_id,
                          processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg);
 
     void queries_cache_invalidate();
+
+    void queries_cache_stats(size_t &hits, size_t &misses, size_t &evictions, size_t &rejected,
+                             size_t &entries, size_t &bytes, size_t &max_bytes);
   }
 }
 
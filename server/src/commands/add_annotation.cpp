@@ -25,17 +25,14 @@
 
 #include "../dba/dba.hpp"
 #include "../dba/exists.hpp"
-#include "../dba/insert.hpp"
 
 #include "../engine/commands.hpp"
+#include "../engine/engine.hpp"
 
 #include "../extras/utils.hpp"
 #include "../extras/serialize.hpp"
 
-#include "../parser/parser_factory.hpp"
-#include "../parser/bedgraph_parser.hpp"
-#include "../parser/wig_parser.hpp"
-#include "../parser/wig.hpp"
+#include "../processing/processing.hpp"
 
 #include "../errors.hpp"
 
@@ -66,7 +63,7 @@ namespace epidb {
       static Parameters results_()
       {
         Parameter p[] = {
-          Parameter("id", serialize::STRING, "id of the newly inserted annotation")
+          Parameter("id", serialize::STRING, "id of the newly inserted annotation, or the request id of its insertion when the extra_metadata contains __async__")
         };
         Parameters results(&p[0], &p[0] + 1);
         return results;
@@ -115,106 +112,40 @@ namespace epidb {
           return false;
         }
 
-        bool ret;
-        std::string id;
-
-        std::unique_ptr<std::istream> _input = std::unique_ptr<std::istream>(new std::stringstream(data));
-
-        if (format == "wig" || format == "bedgraph") {
-          parser::WigPtr wig;
-          if (format == "wig") {
-            parser::WIGParser wig_parser(std::move(_input));
-            if (!wig_parser.get(wig, msg)) {
-              result.add_error(msg);
-              return false;
-            }
-          } else {
-            parser::BedGraphParser bedgraph_parser(std::move(_input));
-            if (!bedgraph_parser.get(wig, msg)) {
-              result.add_error(msg);
-              return false;
-            }
-          }
-
-          std::string id;
-
-          ret = dba::insert_annotation(user, name, norm_name, genome, norm_genome, description, norm_description, extra_metadata,
-                                       ip, wig, id, msg);
-          if (ret) {
-            result.add_string(id);
-            return true;
-          } else {
+        mongo::BSONObjBuilder dataset;
+        dataset.append("name", name);
+        dataset.append("norm_name", norm_name);
+        dataset.append("genome", genome);
+        dataset.append("norm_genome", norm_genome);
+        dataset.append("description", description);
+        dataset.append("norm_description", norm_description);
+        dataset.append("format", format);
+        dataset.append("ip", ip);
+
+        // The data is parsed and inserted by a request processor, the request id is returned
+        if (extra_metadata.find("__async__") != extra_metadata.end()) {
+          extra_metadata.erase("__async__");
+          dataset.append("extra_metadata", datatypes::metadata_to_bson(extra_metadata));
+
+          std::string request_id;
+          if (!epidb::Engine::instance().queue_upload(user, "add_annotation", dataset.obj(), data, request_id, msg)) {
             result.add_error(msg);
             return false;
           }
-        } else {
-          parser::FileFormat fileFormat;
-          if (!parser::FileFormatBuilder::build(format, fileFormat, msg)) {
-            result.add_error(msg);
-            return false;
-          }
-
-          parser::Parser parser(std::move(_input), fileFormat);
-          if (!parser.check_format(msg)) {
-            result.add_error(msg);
-            return false;
-          }
-
-          parser::ChromosomeRegionsMap map_regions;
-
-          while (!parser.eof()) {
-            parser::BedLine bed_line;
-
-            if (!parser.parse_line(bed_line, msg)) {
-              // Ignore Empty Line Error
-              if (msg != "Empty line") {
-                std::stringstream m;
-                m << "Error while reading the BED file. Line: ";
-                m << parser.actual_line();
-                m << ". - '";
-                m << msg;
-                m << "'";
-                result.add_error(m.str());
-                return false;
-              }
-            }
-
-            // Ignore empty line
-            if (msg == "Empty line") {
-              continue;
-            }
-
-            if (!parser.check_length(bed_line)) {
-              std::stringstream m;
-              m << "Error while reading the BED file. Line: ";
-              m << parser.actual_line();
-              m << ". - '";
-              m << parser.actual_line_content();
-              m << "'. The number of tokens (" ;
-              m << bed_line.size() ;
-              m << ") is different from the format size (" ;
-              m << parser.count_fields();
-              m << ") - ";
-              m << fileFormat.format();
-              result.add_error(m.str());
-              return false;
-            } else {
-              map_regions.insert(std::move(bed_line));
-            }
-          }
-
-          map_regions.finish();
-
-          ret = dba::insert_annotation(user, name, norm_name, genome, norm_genome, description, norm_description, extra_metadata,
-                                       ip, map_regions, fileFormat, id, msg);
+          result.add_string(request_id);
+          return true;
         }
+        dataset.append("extra_metadata", datatypes::metadata_to_bson(extra_metadata));
 
-        if (ret) {
-          result.add_string(id);
-        } else {
+        std::string id;
+        std::unique_ptr<std::istream> _input = std::unique_ptr<std::istream>(new std::stringstream(data));
+        if (!processing::insert_dataset(user, "add_annotation", dataset.obj(), std::move(_input), nullptr,
+                                        processing::build_dummy_status(), id, msg)) {
           result.add_error(msg);
+          return false;
         }
-        return ret;
+        result.add_string(id);
+        return true;
       }
 
     } addAnnotationCommand;
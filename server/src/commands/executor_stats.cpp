@@ -0,0 +1,92 @@
+//
+//  executor_stats.cpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <string>
+
+#include "../threading/executor.hpp"
+
+#include "../datatypes/user.hpp"
+
+#include "../engine/commands.hpp"
+
+#include "../extras/serialize.hpp"
+
+#include "../errors.hpp"
+
+namespace epidb {
+  namespace command {
+
+    class ExecutorStatsCommand : public Command {
+
+    private:
+      static CommandDescription desc_()
+      {
+        return CommandDescription(categories::ADMINISTRATION, "Statistics of the threads processing the requests: threads, queued and running tasks, executed tasks and tasks stolen by idle threads.");
+      }
+
+      static Parameters parameters_()
+      {
+        Parameter p[] = {
+          parameters::UserKey
+        };
+        Parameters params(&p[0], &p[0] + 1);
+        return params;
+      }
+
+      static Parameters results_()
+      {
+        Parameter p[] = {
+          Parameter("statistics", serialize::MAP, "executor statistics")
+        };
+        Parameters results(&p[0], &p[0] + 1);
+        return results;
+      }
+
+    public:
+      ExecutorStatsCommand() : Command("executor_stats", parameters_(), results_(), desc_()) {}
+
+      virtual bool run(const std::string &ip,
+                       const serialize::Parameters &parameters, serialize::Parameters &result) const
+      {
+        const std::string admin_key = parameters[0]->as_string();
+
+        std::string msg;
+        datatypes::User user;
+
+        if (!check_permissions(admin_key, datatypes::ADMIN, user, msg )) {
+          result.add_error(msg);
+          return false;
+        }
+
+        size_t threads, queued, active, executed, steals;
+        threading::executor().stats(threads, queued, active, executed, steals);
+
+        serialize::ParameterPtr stats(new serialize::MapParameter);
+        stats->add_child("threads", serialize::ParameterPtr(new serialize::SimpleParameter((long long) threads)));
+        stats->add_child("queued", serialize::ParameterPtr(new serialize::SimpleParameter((long long) queued)));
+        stats->add_child("active", serialize::ParameterPtr(new serialize::SimpleParameter((long long) active)));
+        stats->add_child("executed", serialize::ParameterPtr(new serialize::SimpleParameter((long long) executed)));
+        stats->add_child("steals", serialize::ParameterPtr(new serialize::SimpleParameter((long long) steals)));
+
+        result.add_param(stats);
+        return true;
+      }
+    } executorStatsCommand;
+  }
+}
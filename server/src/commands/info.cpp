@@ -100,6 +100,8 @@ namespace epidb {
         map["message"] = job.status.message;
         map["command"] = job.command;
         map["user_id"] = job.user_id;
+        map["class"] = job.job_class;
+        map["wait_time"] = utils::integer_to_string(job.wait_time);
         for (const auto& kv : job.misc) {
           if (kv.first.substr(0, 11).compare("experiment:") == 0) {
             extra_metadata[kv.first.substr(11, kv.first.size())] = kv.second;
@@ -0,0 +1,94 @@
+//
+//  query_cache_stats.cpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <string>
+
+#include "../cache/queries_cache.hpp"
+
+#include "../datatypes/user.hpp"
+
+#include "../engine/commands.hpp"
+
+#include "../extras/serialize.hpp"
+
+#include "../errors.hpp"
+
+namespace epidb {
+  namespace command {
+
+    class QueryCacheStatsCommand : public Command {
+
+    private:
+      static CommandDescription desc_()
+      {
+        return CommandDescription(categories::ADMINISTRATION, "Statistics of the cached query results: hits, misses, evictions, rejected admissions, entries and memory usage (in bytes).");
+      }
+
+      static Parameters parameters_()
+      {
+        Parameter p[] = {
+          parameters::UserKey
+        };
+        Parameters params(&p[0], &p[0] + 1);
+        return params;
+      }
+
+      static Parameters results_()
+      {
+        Parameter p[] = {
+          Parameter("statistics", serialize::MAP, "query cache statistics")
+        };
+        Parameters results(&p[0], &p[0] + 1);
+        return results;
+      }
+
+    public:
+      QueryCacheStatsCommand() : Command("query_cache_stats", parameters_(), results_(), desc_()) {}
+
+      virtual bool run(const std::string &ip,
+                       const serialize::Parameters &parameters, serialize::Parameters &result) const
+      {
+        const std::string admin_key = parameters[0]->as_string();
+
+        std::string msg;
+        datatypes::User user;
+
+        if (!check_permissions(admin_key, datatypes::ADMIN, user, msg )) {
+          result.add_error(msg);
+          return false;
+        }
+
+        size_t hits, misses, evictions, rejected, entries, bytes, max_bytes;
+        cache::queries_cache_stats(hits, misses, evictions, rejected, entries, bytes, max_bytes);
+
+        serialize::ParameterPtr stats(new serialize::MapParameter);
+        stats->add_child("hits", serialize::ParameterPtr(new serialize::SimpleParameter((long long) hits)));
+        stats->add_child("misses", serialize::ParameterPtr(new serialize::SimpleParameter((long long) misses)));
+        stats->add_child("evictions", serialize::ParameterPtr(new serialize::SimpleParameter((long long) evictions)));
+        stats->add_child("rejected", serialize::ParameterPtr(new serialize::SimpleParameter((long long) rejected)));
+        stats->add_child("entries", serialize::ParameterPtr(new serialize::SimpleParameter((long long) entries)));
+        stats->add_child("bytes", serialize::ParameterPtr(new serialize::SimpleParameter((long long) bytes)));
+        stats->add_child("max_bytes", serialize::ParameterPtr(new serialize::SimpleParameter((long long) max_bytes)));
+
+        result.add_param(stats);
+        return true;
+      }
+    } queryCacheStatsCommand;
+  }
+}
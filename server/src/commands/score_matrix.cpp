@@ -32,6 +32,8 @@
 #include "../extras/serialize.hpp"
 #include "../extras/utils.hpp"
 
+#include "../processing/processing.hpp"
+
 #include "../errors.hpp"
 #include "../log.hpp"
 
@@ -50,7 +52,7 @@ namespace epidb {
       static Parameters parameters_()
       {
         Parameter p[] = {
-          Parameter("experiments_columns", serialize::MAP, "map with experiments names and columns to be processed. Example : {'wgEncodeBroadHistoneDnd41H3k27acSig.wig':'VALUE', 'wgEncodeBroadHistoneCd20ro01794H3k27acSig.wig':'VALUE'}"),
+          Parameter("experiments_columns", serialize::MAP, "map with experiments names and columns to be processed. Example : {'wgEncodeBroadHistoneDnd41H3k27acSig.wig':'VALUE', 'wgEncodeBroadHistoneCd20ro01794H3k27acSig.wig':'VALUE'}. The entry '__output_format__':'binary' builds a float32 matrix, that is only available with the download URL."),
           Parameter("aggregation_function", serialize::STRING, "aggregation function name: min, max, sum, mean, var, sd, median, count, boolean"),
           Parameter("aggregation_regions_id", serialize::STRING, "query ID of the regions that will be used as the aggregation boundaries"),
           parameters::UserKey
@@ -101,6 +103,17 @@ namespace epidb {
           result.add_error("unable to read metadata");
           return false;
         }
+        std::string output_format = processing::SCORE_MATRIX_TEXT;
+        auto format_it = map_.find("__output_format__");
+        if (format_it != map_.end()) {
+          output_format = format_it->second->as_string();
+          if (output_format != processing::SCORE_MATRIX_TEXT && output_format != processing::SCORE_MATRIX_BINARY) {
+            result.add_error("Invalid score matrix output format " + output_format + ". The formats are " + processing::SCORE_MATRIX_TEXT + " and " + processing::SCORE_MATRIX_BINARY + ".");
+            return false;
+          }
+          map_.erase(format_it);
+        }
+
         std::vector<std::pair<std::string, std::string>> experiments_formats;
         std::map<std::string, serialize::ParameterPtr>::iterator mit;
         for (mit = map_.begin(); mit != map_.end(); ++mit) {
@@ -120,7 +133,7 @@ namespace epidb {
         }
 
         std::string request_id;
-        if (!epidb::Engine::instance().queue_score_matrix(user, experiments_formats, aggregation_function, regions_query_id, request_id, msg)) {
+        if (!epidb::Engine::instance().queue_score_matrix(user, experiments_formats, aggregation_function, regions_query_id, output_format, request_id, msg)) {
           result.add_error(msg);
           return false;
         }
@@ -43,6 +43,7 @@ namespace epidb {
     std::string database_name;
     mongo::ConnectionString mongodb_server_connection;
     long long processing_max_memory;
+    unsigned long long query_cache_max_memory = 2ll * 1024 * 1024 * 1024;
 
     unsigned long long default_old_request_age_in_sec;
     unsigned long long old_request_age_in_sec;
@@ -118,6 +119,16 @@ namespace epidb {
       return processing_max_memory;
     }
 
+    void set_query_cache_max_memory(const unsigned long long memory)
+    {
+      query_cache_max_memory = memory;
+    }
+
+    unsigned long long get_query_cache_max_memory()
+    {
+      return query_cache_max_memory;
+    }
+
     void set_default_old_request_age_in_sec(const unsigned long long default_oo)
     {
       default_old_request_age_in_sec = default_oo;
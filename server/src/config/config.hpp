@@ -60,6 +60,9 @@ namespace epidb {
     void set_processing_max_memory(const long long memory);
     long long get_processing_max_memory();
 
+    void set_query_cache_max_memory(const unsigned long long memory);
+    unsigned long long get_query_cache_max_memory();
+
     unsigned long long get_old_request_age_in_sec();
     void set_old_request_age_in_sec(const unsigned long long oo);
     unsigned long long get_default_old_request_age_in_sec();
@@ -296,6 +296,11 @@ namespace epidb {
       return *this;
     }
 
+    Regions& operator=(Regions&& other) noexcept
+    {
+      _regions = std::move(other._regions);
+      return *this;
+    }
 
     template<typename RegionPtr>
     void emplace_back(RegionPtr && value)
@@ -369,6 +374,9 @@ namespace epidb {
   typedef std::pair<std::string, Regions> ChromosomeRegions;
   typedef std::vector<ChromosomeRegions> ChromosomeRegionsList;
 
+  // Immutable regions set, shared by reference (e.g. the cached query results).
+  typedef std::shared_ptr<const ChromosomeRegionsList> ChromosomeRegionsListPtr;
+
   size_t count_regions(const ChromosomeRegionsList& regions);
 
   // The value returned indicates whether the element passed as first argument is considered to go before the second in the specific strict weak ordering it defines.
@@ -0,0 +1,370 @@
+//
+//  regions_block.cpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "../types.hpp"
+
+#include "regions.hpp"
+#include "regions_block.hpp"
+
+namespace epidb {
+
+  // -----------------------------------
+  // StringDictionary
+  // -----------------------------------
+  StringDictionary::StringDictionary()
+  {
+    encode(std::string());
+  }
+
+  uint32_t StringDictionary::encode(const std::string &value)
+  {
+    auto it = _codes.find(value);
+    if (it != _codes.end()) {
+      return it->second;
+    }
+
+    uint32_t code = _values.size();
+    _values.push_back(value);
+    _codes[value] = code;
+    return code;
+  }
+
+  const std::string &StringDictionary::decode(const uint32_t code) const
+  {
+    return _values[code];
+  }
+
+  size_t StringDictionary::size() const
+  {
+    return _values.size();
+  }
+
+  size_t StringDictionary::memory_size() const
+  {
+    size_t size = sizeof(StringDictionary);
+    for (const auto &value : _values) {
+      // The string is stored in the vector and as the map key
+      size += (value.capacity() * 2) + sizeof(uint32_t);
+    }
+    return size;
+  }
+
+  // -----------------------------------
+  // RegionsBlock
+  // -----------------------------------
+  RegionsBlock::RegionsBlock() :
+    _dictionary(std::make_shared<StringDictionary>()),
+    _row_numeric(0),
+    _row_strings(0)
+  { }
+
+  RegionsBlock::RegionsBlock(size_t s) :
+    RegionsBlock()
+  {
+    reserve(s);
+  }
+
+  RegionsBlock::RegionsBlock(const RegionsBlock &other) :
+    _starts(other._starts),
+    _ends(other._ends),
+    _dataset_ids(other._dataset_ids),
+    _numeric_columns(other._numeric_columns),
+    _string_columns(other._string_columns),
+    _dictionary(other._dictionary),
+    _row_numeric(other._row_numeric),
+    _row_strings(other._row_strings)
+  { }
+
+  RegionsBlock::RegionsBlock(RegionsBlock &&other) noexcept :
+    _starts(std::move(other._starts)),
+    _ends(std::move(other._ends)),
+    _dataset_ids(std::move(other._dataset_ids)),
+    _numeric_columns(std::move(other._numeric_columns)),
+    _string_columns(std::move(other._string_columns)),
+    _dictionary(std::move(other._dictionary)),
+    _row_numeric(other._row_numeric),
+    _row_strings(other._row_strings)
+  { }
+
+  RegionsBlock &RegionsBlock::operator=(const RegionsBlock &other)
+  {
+    if (&other == this) {
+      return *this;
+    }
+
+    _starts = other._starts;
+    _ends = other._ends;
+    _dataset_ids = other._dataset_ids;
+    _numeric_columns = other._numeric_columns;
+    _string_columns = other._string_columns;
+    _dictionary = other._dictionary;
+    _row_numeric = other._row_numeric;
+    _row_strings = other._row_strings;
+
+    return *this;
+  }
+
+  RegionsBlock &RegionsBlock::operator=(RegionsBlock &&other) noexcept
+  {
+    _starts = std::move(other._starts);
+    _ends = std::move(other._ends);
+    _dataset_ids = std::move(other._dataset_ids);
+    _numeric_columns = std::move(other._numeric_columns);
+    _string_columns = std::move(other._string_columns);
+    _dictionary = std::move(other._dictionary);
+    _row_numeric = other._row_numeric;
+    _row_strings = other._row_strings;
+
+    return *this;
+  }
+
+  // The dictionary is shared between copies and selections of a block.
+  // Copy it before adding new strings, so the other blocks are not modified.
+  void RegionsBlock::unique_dictionary()
+  {
+    if (!_dictionary) {
+      _dictionary = std::make_shared<StringDictionary>();
+    } else if (_dictionary.use_count() > 1) {
+      _dictionary = std::make_shared<StringDictionary>(*_dictionary);
+    }
+  }
+
+  void RegionsBlock::reserve(size_t new_cap)
+  {
+    _starts.reserve(new_cap);
+    _ends.reserve(new_cap);
+    _dataset_ids.reserve(new_cap);
+  }
+
+  size_t RegionsBlock::add(const Position s, const Position e, const DatasetId id)
+  {
+    _starts.push_back(s);
+    _ends.push_back(e);
+    _dataset_ids.push_back(id);
+    _row_numeric = 0;
+    _row_strings = 0;
+    return _starts.size() - 1;
+  }
+
+  void RegionsBlock::insert(const std::string &value)
+  {
+    size_t row = _starts.size() - 1;
+    size_t pos = _row_strings++;
+
+    if (pos >= _string_columns.size()) {
+      _string_columns.resize(pos + 1);
+    }
+
+    unique_dictionary();
+    std::vector<uint32_t> &column = _string_columns[pos];
+    column.resize(row, 0);
+    column.push_back(_dictionary->encode(value));
+  }
+
+  void RegionsBlock::insert(const Score value)
+  {
+    size_t row = _starts.size() - 1;
+    size_t pos = _row_numeric++;
+
+    if (pos >= _numeric_columns.size()) {
+      _numeric_columns.resize(pos + 1);
+    }
+
+    std::vector<Score> &column = _numeric_columns[pos];
+    column.resize(row, std::numeric_limits<Score>::min());
+    column.push_back(value);
+  }
+
+  void RegionsBlock::insert(const int value)
+  {
+    insert(static_cast<Score>(value));
+  }
+
+  Score RegionsBlock::value(const size_t row, const size_t pos) const
+  {
+    if (pos >= _numeric_columns.size() || row >= _numeric_columns[pos].size()) {
+      return std::numeric_limits<Score>::min();
+    }
+    return _numeric_columns[pos][row];
+  }
+
+  const std::string &RegionsBlock::get_string(const size_t row, const size_t pos) const
+  {
+    if (pos >= _string_columns.size() || row >= _string_columns[pos].size()) {
+      return _dictionary->decode(0);
+    }
+    return _dictionary->decode(_string_columns[pos][row]);
+  }
+
+  void RegionsBlock::append_row(const RegionsBlock &other, const size_t row)
+  {
+    add(other._starts[row], other._ends[row], other._dataset_ids[row]);
+
+    size_t numerics = std::max(_numeric_columns.size(), other._numeric_columns.size());
+    for (size_t pos = 0; pos < numerics; pos++) {
+      insert(other.value(row, pos));
+    }
+
+    size_t strings = std::max(_string_columns.size(), other._string_columns.size());
+    for (size_t pos = 0; pos < strings; pos++) {
+      insert(other.get_string(row, pos));
+    }
+  }
+
+  void RegionsBlock::append(RegionsBlock &&other)
+  {
+    if (empty()) {
+      *this = std::move(other);
+      return;
+    }
+
+    reserve(size() + other.size());
+    for (size_t row = 0; row < other.size(); row++) {
+      append_row(other, row);
+    }
+    other = RegionsBlock();
+  }
+
+  RegionsBlock RegionsBlock::select(const std::vector<size_t> &rows) const
+  {
+    RegionsBlock selected(rows.size());
+    selected._dictionary = _dictionary;
+
+    for (const size_t row : rows) {
+      selected._starts.push_back(_starts[row]);
+      selected._ends.push_back(_ends[row]);
+      selected._dataset_ids.push_back(_dataset_ids[row]);
+    }
+
+    selected._numeric_columns.resize(_numeric_columns.size());
+    for (size_t pos = 0; pos < _numeric_columns.size(); pos++) {
+      std::vector<Score> &column = selected._numeric_columns[pos];
+      column.reserve(rows.size());
+      for (const size_t row : rows) {
+        column.push_back(value(row, pos));
+      }
+    }
+
+    selected._string_columns.resize(_string_columns.size());
+    for (size_t pos = 0; pos < _string_columns.size(); pos++) {
+      const std::vector<uint32_t> &source = _string_columns[pos];
+      std::vector<uint32_t> &column = selected._string_columns[pos];
+      column.reserve(rows.size());
+      for (const size_t row : rows) {
+        column.push_back(row < source.size() ? source[row] : 0);
+      }
+    }
+
+    return selected;
+  }
+
+  void RegionsBlock::sort()
+  {
+    if (is_sorted()) {
+      return;
+    }
+
+    std::vector<size_t> permutation(size());
+    std::iota(permutation.begin(), permutation.end(), 0);
+    std::stable_sort(permutation.begin(), permutation.end(), RegionsBlockComparer(*this));
+
+    *this = select(permutation);
+  }
+
+  bool RegionsBlock::is_sorted() const
+  {
+    RegionsBlockComparer comparer(*this);
+    for (size_t row = 1; row < size(); row++) {
+      if (comparer(row, row - 1)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  RegionPtr RegionsBlock::region(const size_t row) const
+  {
+    if (_numeric_columns.empty() && _string_columns.empty()) {
+      return build_simple_region(_starts[row], _ends[row], _dataset_ids[row]);
+    }
+
+    RegionPtr region = build_bed_region(_starts[row], _ends[row], _dataset_ids[row]);
+    for (size_t pos = 0; pos < _string_columns.size(); pos++) {
+      region->insert(get_string(row, pos));
+    }
+    for (size_t pos = 0; pos < _numeric_columns.size(); pos++) {
+      region->insert(value(row, pos));
+    }
+    return region;
+  }
+
+  Regions RegionsBlock::to_regions() const
+  {
+    Regions regions;
+    regions.reserve(size());
+    for (size_t row = 0; row < size(); row++) {
+      regions.emplace_back(region(row));
+    }
+    return regions;
+  }
+
+  size_t RegionsBlock::row_size() const
+  {
+    return sizeof(Position) + sizeof(Position) + sizeof(DatasetId) +
+           (_numeric_columns.size() * sizeof(Score)) +
+           (_string_columns.size() * sizeof(uint32_t));
+  }
+
+  size_t RegionsBlock::memory_size() const
+  {
+    size_t size = sizeof(RegionsBlock);
+    size += _starts.capacity() * sizeof(Position);
+    size += _ends.capacity() * sizeof(Position);
+    size += _dataset_ids.capacity() * sizeof(DatasetId);
+    for (const auto &column : _numeric_columns) {
+      size += column.capacity() * sizeof(Score);
+    }
+    for (const auto &column : _string_columns) {
+      size += column.capacity() * sizeof(uint32_t);
+    }
+    if (_dictionary) {
+      size += _dictionary->memory_size();
+    }
+    return size;
+  }
+
+  // Auxiliar functions
+
+  size_t count_regions(const ChromosomeRegionsBlockList &regions)
+  {
+    size_t count = 0;
+    for (const auto &chromosome : regions) {
+      count += chromosome.second.size();
+    }
+    return count;
+  }
+
+} // namespace epidb
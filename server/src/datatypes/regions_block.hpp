@@ -0,0 +1,218 @@
+//
+//  regions_block.hpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef EPIDB_REGIONS_BLOCK_HPP
+#define EPIDB_REGIONS_BLOCK_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "regions.hpp"
+
+#include "../types.hpp"
+
+namespace epidb {
+
+  // -----------------------------------
+  // StringDictionary
+  // -----------------------------------
+  // Each distinct string of a block is stored only once, the regions keep its code.
+  // The code 0 is always the empty string.
+  class StringDictionary {
+  private:
+    std::vector<std::string> _values;
+    std::unordered_map<std::string, uint32_t> _codes;
+
+  public:
+    StringDictionary();
+
+    uint32_t encode(const std::string &value);
+    const std::string &decode(const uint32_t code) const;
+    size_t size() const;
+    size_t memory_size() const;
+  };
+
+  typedef std::shared_ptr<StringDictionary> StringDictionaryPtr;
+
+  // -----------------------------------
+  // RegionsBlock
+  // -----------------------------------
+  // Columnar (struct-of-arrays) storage for the regions of one chromosome.
+  // Coordinates and dataset ids are kept in contiguous arrays, the BED columns
+  // in typed per-column arrays (numeric and dictionary encoded strings), using the
+  // same positions as BedRegion::value() and BedRegion::get_string().
+  // A region only exists as an AbstractRegion object when region() is called.
+  class RegionsBlock {
+  private:
+    std::vector<Position> _starts;
+    std::vector<Position> _ends;
+    std::vector<DatasetId> _dataset_ids;
+
+    std::vector<std::vector<Score>> _numeric_columns;
+    std::vector<std::vector<uint32_t>> _string_columns;
+    StringDictionaryPtr _dictionary;
+
+    // Columns already filled for the last added row
+    size_t _row_numeric;
+    size_t _row_strings;
+
+    void unique_dictionary();
+
+  public:
+    RegionsBlock();
+    explicit RegionsBlock(size_t s);
+
+    RegionsBlock(const RegionsBlock &other);
+    RegionsBlock(RegionsBlock &&other) noexcept;
+    RegionsBlock &operator=(const RegionsBlock &other);
+    RegionsBlock &operator=(RegionsBlock &&other) noexcept;
+
+    size_t size() const
+    {
+      return _starts.size();
+    }
+
+    bool empty() const
+    {
+      return _starts.empty();
+    }
+
+    Position start(const size_t row) const
+    {
+      return _starts[row];
+    }
+
+    Position end(const size_t row) const
+    {
+      return _ends[row];
+    }
+
+    DatasetId dataset_id(const size_t row) const
+    {
+      return _dataset_ids[row];
+    }
+
+    Length length(const size_t row) const
+    {
+      return _ends[row] - _starts[row];
+    }
+
+    void set_start(const size_t row, const Position s)
+    {
+      _starts[row] = s;
+    }
+
+    void set_end(const size_t row, const Position e)
+    {
+      _ends[row] = e;
+    }
+
+    const std::vector<Position> &starts() const
+    {
+      return _starts;
+    }
+
+    const std::vector<Position> &ends() const
+    {
+      return _ends;
+    }
+
+    const std::vector<DatasetId> &dataset_ids() const
+    {
+      return _dataset_ids;
+    }
+
+    size_t numeric_columns() const
+    {
+      return _numeric_columns.size();
+    }
+
+    size_t string_columns() const
+    {
+      return _string_columns.size();
+    }
+
+    void reserve(size_t new_cap);
+
+    // Adds a new row. The values inserted after it belong to this row.
+    size_t add(const Position s, const Position e, const DatasetId id);
+    void insert(const std::string &value);
+    void insert(const Score value);
+    void insert(const int value);
+
+    Score value(const size_t row, const size_t pos) const;
+    const std::string &get_string(const size_t row, const size_t pos) const;
+
+    // Copy one row from another block, including its columns.
+    void append_row(const RegionsBlock &other, const size_t row);
+
+    // Move all rows from the other block to the end of this one.
+    void append(RegionsBlock &&other);
+
+    // New block with the given rows, sharing the string dictionary.
+    RegionsBlock select(const std::vector<size_t> &rows) const;
+
+    // Sort the rows by (start, end), as RegionPtrComparer does.
+    void sort();
+    bool is_sorted() const;
+
+    // Build an AbstractRegion for the row. Only for the code that still requires it.
+    RegionPtr region(const size_t row) const;
+    Regions to_regions() const;
+
+    // Bytes used by one row, for the Status memory accounting.
+    size_t row_size() const;
+    size_t memory_size() const;
+  };
+
+  typedef std::pair<std::string, RegionsBlock> ChromosomeRegionsBlock;
+  typedef std::vector<ChromosomeRegionsBlock> ChromosomeRegionsBlockList;
+
+  size_t count_regions(const ChromosomeRegionsBlockList &regions);
+
+  // The same ordering as RegionPtrComparer, over the rows of a block.
+  class RegionsBlockComparer {
+  private:
+    const RegionsBlock &_block;
+
+  public:
+    explicit RegionsBlockComparer(const RegionsBlock &block) :
+      _block(block) {}
+
+    bool operator()(const size_t lhs, const size_t rhs) const
+    {
+      if (_block.start(lhs) < _block.start(rhs)) {
+        return true;
+      }
+
+      if (_block.start(rhs) < _block.start(lhs)) {
+        return false;
+      }
+
+      return _block.end(lhs) < _block.end(rhs);
+    }
+  };
+
+} // namespace epidb
+
+#endif
@@ -0,0 +1,410 @@
+//
+//  block_inserter.cpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <mongo/bson/bson.h>
+
+#include "../connection/connection.hpp"
+
+#include "../extras/compress.hpp"
+#include "../extras/utils.hpp"
+
+#include "../threading/executor.hpp"
+
+#include "block_inserter.hpp"
+#include "key_mapper.hpp"
+
+namespace epidb {
+  namespace dba {
+
+    static const size_t MAXIMUM_BLOCK_SIZE = 10000;
+    static const size_t MAXIMUM_BULK_SIZE = 100000;
+
+    static bool read_size(const datatypes::Metadata &extra_metadata, const std::string &key, const size_t maximum,
+                          size_t &size, std::string &msg)
+    {
+      auto it = extra_metadata.find(key);
+      if (it == extra_metadata.end()) {
+        return true;
+      }
+
+      if (!utils::string_to_long(it->second, size) || size == 0 || size > maximum) {
+        msg = "The " + key + " must be an integer between 1 and " + utils::size_t_to_string(maximum) + ".";
+        return false;
+      }
+      return true;
+    }
+
+    bool insert_sizes(const datatypes::Metadata &extra_metadata, datatypes::Metadata &dataset_metadata,
+                      size_t &block_size, size_t &bulk_size, std::string &msg)
+    {
+      block_size = BLOCK_SIZE;
+      bulk_size = BULK_SIZE;
+      if (!read_size(extra_metadata, "__block_size__", MAXIMUM_BLOCK_SIZE, block_size, msg) ||
+          !read_size(extra_metadata, "__bulk_size__", MAXIMUM_BULK_SIZE, bulk_size, msg)) {
+        return false;
+      }
+
+      dataset_metadata = extra_metadata;
+      dataset_metadata.erase("__block_size__");
+      dataset_metadata.erase("__bulk_size__");
+      return true;
+    }
+
+    //
+    // Zone map of a block: minimum, maximum and number of values of each numeric column.
+    // With START (minimum start), END (maximum end) and FEATURES (number of regions)
+    // it lets the retriever skip, or accept as a whole, the blocks of a column filter.
+    // The NaN values are not counted, so the column is used only if all its values are numbers.
+    //
+    struct ZoneMapColumn {
+      double min;
+      double max;
+      int count;
+    };
+
+    static void update_zone_map(const mongo::BSONObj &region, std::map<std::string, ZoneMapColumn> &zone_map)
+    {
+      mongo::BSONObjIterator i(region);
+      while (i.more()) {
+        const mongo::BSONElement &e = i.next();
+        if (!e.isNumber() || (e.fieldName() == KeyMapper::START()) || (e.fieldName() == KeyMapper::END())) {
+          continue;
+        }
+
+        const double value = e.numberDouble();
+        if (std::isnan(value)) {
+          continue;
+        }
+
+        auto it = zone_map.find(e.fieldName());
+        if (it == zone_map.end()) {
+          zone_map[e.fieldName()] = ZoneMapColumn{ value, value, 1 };
+        } else {
+          it->second.min = std::min(it->second.min, value);
+          it->second.max = std::max(it->second.max, value);
+          it->second.count++;
+        }
+      }
+    }
+
+    static void append_zone_map(const std::map<std::string, ZoneMapColumn> &zone_map, mongo::BSONObjBuilder &block_builder)
+    {
+      if (zone_map.empty()) {
+        return;
+      }
+
+      mongo::BSONObjBuilder zone_map_builder;
+      for (const auto &column : zone_map) {
+        zone_map_builder.append(column.first, BSON_ARRAY(column.second.min << column.second.max << column.second.count));
+      }
+      block_builder.append(KeyMapper::BED_ZONE_MAP(), zone_map_builder.obj());
+    }
+
+    // compress a block (vector of regions)
+    static mongo::BSONObj compress_block(const int dataset_id, const long long id, const std::vector<mongo::BSONObj> &block)
+    {
+      mongo::BSONArrayBuilder ab;
+
+      size_t features = 0;
+      int min = std::numeric_limits<int>::max();
+      int max = std::numeric_limits<int>::min();
+      std::map<std::string, ZoneMapColumn> zone_map;
+      for (std::vector<mongo::BSONObj>::const_iterator it = block.begin(); it != block.end(); it++) {
+        int start = (*it)[KeyMapper::START()].Int();
+        int end = (*it)[KeyMapper::END()].Int();
+
+        if (start < min) {
+          min = start;
+        }
+        if (end > max) {
+          max = end;
+        }
+        update_zone_map(*it, zone_map);
+        features++;
+        ab.append(*it);
+      }
+
+      std::shared_ptr<char> compressed_data;
+      size_t compressed_size = 0;
+      bool compressed = false;
+      mongo::BSONObj o = ab.arr();
+      compressed_data = epidb::compress::compress(o.objdata(), o.objsize(), compressed_size, compressed);
+
+      mongo::BSONObjBuilder block_builder;
+
+      block_builder.append("_id", id);
+      block_builder.append(KeyMapper::DATASET(), (int) dataset_id);
+
+      block_builder.append(KeyMapper::START(), min);
+      block_builder.append(KeyMapper::END(), max);
+      append_zone_map(zone_map, block_builder);
+
+      if (compressed) {
+        block_builder.append(KeyMapper::FEATURES(), (int) features);
+        block_builder.append(KeyMapper::BED_COMPRESSED(), true);
+        block_builder.append(KeyMapper::BED_DATASIZE(), o.objsize());
+        block_builder.appendBinData(KeyMapper::BED_DATA(), compressed_size, mongo::BinDataGeneral, (void *) compressed_data.get());
+      } else {
+        block_builder.append(KeyMapper::FEATURES(), (int) features);
+        block_builder.append(KeyMapper::BED_COMPRESSED(), false);
+        block_builder.appendBinData(KeyMapper::BED_DATA(), o.objsize(), mongo::BinDataGeneral, o.objdata());
+      }
+
+      return block_builder.obj();
+    }
+
+    struct BlockInserter::Block {
+      std::string collection;
+      long long id;
+      BlockBuilder builder;
+      threading::TaskPtr task;
+      // Set by the task, empty when the block has no regions
+      mongo::BSONObj obj;
+      bool ok;
+      std::string msg;
+    };
+
+    BlockInserter::BlockInserter(const int dataset_id, const size_t bulk_size) :
+      _dataset_id(dataset_id),
+      _bulk_size(bulk_size),
+      _max_blocks(4 * threading::executor().size()),
+      _count(0),
+      _total_size(0),
+      _finish(false),
+      _abort(false),
+      _failed(false),
+      _failed_id(0)
+    {
+      for (size_t i = 0; i < WRITERS; i++) {
+        _writers.emplace_back(&BlockInserter::write, this);
+      }
+    }
+
+    BlockInserter::~BlockInserter()
+    {
+      stop(true);
+    }
+
+    bool BlockInserter::add(const std::string &collection, BlockBuilder builder)
+    {
+      BlockPtr block = std::make_shared<Block>();
+      block->collection = collection;
+      block->builder = std::move(builder);
+      block->ok = true;
+
+      // The block outlives its task: it is waited by a writer, or by stop
+      Block *b = block.get();
+      block->task = std::make_shared<threading::Task>([this, b]() {
+        build(*b);
+      });
+
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _not_full.wait(lock, [this] { return _abort || _blocks.size() < _max_blocks; });
+        if (_abort) {
+          return false;
+        }
+        // The blocks are numbered in the order of the regions
+        block->id = (long long) _dataset_id << 32 | (long long) _count++;
+        _blocks.push_back(block);
+      }
+      _not_empty.notify_one();
+
+      threading::executor().submit(block->task, threading::PRIORITY_LOW);
+      return true;
+    }
+
+    void BlockInserter::build(Block &block)
+    {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_abort) {
+          return;
+        }
+      }
+
+      std::vector<mongo::BSONObj> regions;
+      block.ok = block.builder(regions, block.msg);
+      if (block.ok && !regions.empty()) {
+        block.obj = compress_block(_dataset_id, block.id, regions);
+      }
+      block.builder = nullptr;
+    }
+
+    void BlockInserter::write()
+    {
+      std::string collection;
+      std::vector<mongo::BSONObj> bulk;
+      size_t bulk_size = 0;
+      std::string msg;
+
+      while (true) {
+        BlockPtr block;
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          _not_empty.wait(lock, [this] { return _abort || _finish || !_blocks.empty(); });
+          if (_abort) {
+            return;
+          }
+          if (_blocks.empty()) {
+            break;
+          }
+          block = _blocks.front();
+          _blocks.pop_front();
+        }
+        _not_full.notify_one();
+
+        // Built here when no executor thread took it yet
+        try {
+          block->task->wait();
+        } catch (const std::exception &e) {
+          fail(block->id, e.what());
+          return;
+        }
+        if (!block->ok) {
+          fail(block->id, block->msg);
+          return;
+        }
+        if (block->obj.isEmpty()) {
+          continue;
+        }
+
+        // A bulk has the blocks of one collection, in any order
+        if (!bulk.empty() && (block->collection != collection || bulk.size() >= _bulk_size || bulk_size >= MAXIMUM_SIZE)) {
+          if (!insert(collection, bulk, msg)) {
+            fail(0, msg);
+            return;
+          }
+          bulk.clear();
+          bulk_size = 0;
+        }
+
+        collection = block->collection;
+        bulk_size += block->obj.objsize();
+        bulk.push_back(block->obj);
+      }
+
+      if (!bulk.empty() && !insert(collection, bulk, msg)) {
+        fail(0, msg);
+      }
+    }
+
+    bool BlockInserter::insert(const std::string &collection, const std::vector<mongo::BSONObj> &bulk, std::string &msg)
+    {
+      size_t size = 0;
+      for (const auto &block : bulk) {
+        size += block.objsize();
+      }
+
+      try {
+        Connection c;
+        c->insert(collection, bulk, mongo::InsertOption_ContinueOnError);
+        if (!c->getLastError().empty()) {
+          msg = c->getLastError();
+          c.done();
+          return false;
+        }
+        c.done();
+      } catch (const std::exception &e) {
+        msg = e.what();
+        return false;
+      }
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      _total_size += size;
+      return true;
+    }
+
+    void BlockInserter::fail(const long long id, const std::string &msg)
+    {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // The error of the first region, as if they were inserted in order
+        if (!_failed || id < _failed_id) {
+          _failed_id = id;
+          _msg = msg;
+        }
+        _failed = true;
+        _abort = true;
+      }
+      _not_empty.notify_all();
+      _not_full.notify_all();
+    }
+
+    void BlockInserter::stop(const bool abort)
+    {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (abort) {
+          _abort = true;
+        } else {
+          _finish = true;
+        }
+      }
+      _not_empty.notify_all();
+      _not_full.notify_all();
+
+      for (auto &writer : _writers) {
+        if (writer.joinable()) {
+          writer.join();
+        }
+      }
+
+      // The tasks of the blocks that were not inserted use the data of the producer
+      std::deque<BlockPtr> blocks;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        blocks.swap(_blocks);
+      }
+      for (auto &block : blocks) {
+        try {
+          block->task->wait();
+        } catch (...) {
+        }
+      }
+    }
+
+    bool BlockInserter::finish(size_t &total_size, std::string &msg)
+    {
+      stop(false);
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_failed) {
+        msg = _msg;
+        return false;
+      }
+      total_size = _total_size;
+      return true;
+    }
+
+    void BlockInserter::abort()
+    {
+      stop(true);
+    }
+  }
+}
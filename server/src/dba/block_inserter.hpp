@@ -0,0 +1,115 @@
+//
+//  block_inserter.hpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef EPIDB_DBA_BLOCK_INSERTER_HPP
+#define EPIDB_DBA_BLOCK_INSERTER_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mongo/bson/bson.h>
+
+#include "../datatypes/metadata.hpp"
+
+namespace epidb {
+  namespace dba {
+
+    // Regions in a block and blocks in a bulk insert, when not set for the dataset
+    const size_t BLOCK_SIZE = 100;
+    const size_t BULK_SIZE = 10000;
+    const size_t MAXIMUM_SIZE = 10000000; // from mongodb maximum message size: 48000000
+
+    //
+    // Block and bulk sizes of a dataset, set by the extra metadata
+    // __block_size__ and __bulk_size__.
+    // dataset_metadata is the extra metadata without them, stored with the dataset.
+    //
+    bool insert_sizes(const datatypes::Metadata &extra_metadata, datatypes::Metadata &dataset_metadata,
+                      size_t &block_size, size_t &bulk_size, std::string &msg);
+
+    //
+    // Inserts the regions of a dataset in compressed blocks.
+    // The regions of each block are built and compressed by the executor threads,
+    // while the writer threads insert the built blocks in unordered bulks, each
+    // writer with its own connection. The producer waits when too many blocks are
+    // pending, so the memory used does not depend on the dataset size.
+    //
+    class BlockInserter {
+    public:
+      // Builds the regions of a block, in the order of their starts
+      typedef std::function<bool(std::vector<mongo::BSONObj> &regions, std::string &msg)> BlockBuilder;
+
+    private:
+      static const size_t WRITERS = 4;
+
+      struct Block;
+      typedef std::shared_ptr<Block> BlockPtr;
+
+      const int _dataset_id;
+      const size_t _bulk_size;
+      const size_t _max_blocks;
+      long long _count;
+
+      std::deque<BlockPtr> _blocks;
+      size_t _total_size;
+      bool _finish;
+      bool _abort;
+      bool _failed;
+      long long _failed_id;
+      std::string _msg;
+
+      std::mutex _mutex;
+      std::condition_variable _not_empty;
+      std::condition_variable _not_full;
+      std::vector<std::thread> _writers;
+
+      void build(Block &block);
+      void write();
+      bool insert(const std::string &collection, const std::vector<mongo::BSONObj> &bulk, std::string &msg);
+      void fail(const long long id, const std::string &msg);
+      void stop(const bool abort);
+
+    public:
+      BlockInserter(const int dataset_id, const size_t bulk_size = BULK_SIZE);
+      // Aborts the insertion if it was not finished
+      ~BlockInserter();
+
+      BlockInserter(const BlockInserter &) = delete;
+      BlockInserter &operator=(const BlockInserter &) = delete;
+
+      // Returns false when the insertion failed, the error is returned by finish
+      bool add(const std::string &collection, BlockBuilder builder);
+
+      // Wait until all the blocks are inserted
+      bool finish(size_t &total_size, std::string &msg);
+
+      // Stop without inserting the pending blocks, before the dataset is removed
+      void abort();
+    };
+  }
+}
+
+#endif
@@ -18,6 +18,8 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 #include <map>
 #include <string>
@@ -42,6 +44,7 @@
 #include "../parser/wig.hpp"
 
 #include "annotations.hpp"
+#include "block_inserter.hpp"
 #include "dba.hpp"
 #include "collections.hpp"
 #include "experiments.hpp"
@@ -60,13 +63,25 @@
 namespace epidb {
   namespace dba {
 
-    const size_t BLOCK_SIZE = 100;
-    const size_t BULK_SIZE = 10000;
-    const size_t MAXIMUM_SIZE = 10000000; // from mongodb maximum message size: 48000000
+    // Short names of the columns of a format, resolved before the regions are built by several threads
+    static bool format_short_names(const parser::FileFormat &file_format, std::vector<std::string> &names, std::string &msg)
+    {
+      for(const dba::columns::ColumnTypePtr & column_type: file_format) {
+        std::string field_name = column_type->name();
+
+        std::string name;
+        if ((field_name != "CHROMOSOME") && (field_name != "START") && (field_name != "END") &&
+            !KeyMapper::to_short(field_name, name, msg)) {
+          return false;
+        }
+        names.push_back(name);
+      }
+      return true;
+    }
 
     static const bool fill_region_builder(mongo::BSONObjBuilder &builder,
                                           const parser::BedLine &bed_line, const parser::FileFormat &file_format,
-                                          std::string &msg)
+                                          const std::vector<std::string> &names, std::string &msg)
     {
       if (bed_line.size() != file_format.size()) {
         msg = "number of line elements doesn't match the file format size.";
@@ -77,17 +92,15 @@ namespace epidb {
       builder.append(KeyMapper::END(), bed_line.end);
 
       size_t i(0);
+      size_t column(0);
       for(const dba::columns::ColumnTypePtr & column_type: file_format) {
         std::string field_name = column_type->name();
+        const std::string &name = names[column++];
 
         if ((field_name == "CHROMOSOME") || (field_name == "START") || (field_name == "END")) {
           continue;
         }
 
-        std::string name;
-        if (!KeyMapper::to_short(field_name, name, msg)) {
-          return false;
-        }
         std::string token = bed_line.tokens[i++];
 
         if (!column_type->check(token)) {
@@ -145,117 +158,133 @@ namespace epidb {
     }
 
 
-    // compress a block (vector of regions) and insert into blocks_bulk
-    bool compress_block(const int dataset_id, const std::string &collection,
-                        size_t &count,
-                        std::vector<mongo::BSONObj> &block,
-                        std::vector<mongo::BSONObj> &blocks_bulk, size_t &bulk_size, size_t &total_size)
+    static bool build_region(const parser::BedLine &line, const parser::FileFormat &format, const std::vector<std::string> &names,
+                             const size_t size, const bool trim_to_chromosome_size,
+                             std::vector<mongo::BSONObj> &regions, std::string &msg)
     {
-      mongo::BSONArrayBuilder ab;
-
-      size_t features = 0;
-      size_t uncompress_size = 0;
-      int min = std::numeric_limits<int>::max();
-      int max = std::numeric_limits<int>::min();
-      for (std::vector<mongo::BSONObj>::const_iterator it = block.begin(); it != block.end(); it++) {
-        uncompress_size += (*it).objsize();
-        int start = (*it)[KeyMapper::START()].Int();
-        int end = (*it)[KeyMapper::END()].Int();
-
-        if (start < min) {
-          min = start;
-        }
-        if (end > max) {
-          max = end;
-        }
-        features++;
-        ab.append(*it);
+      const parser::BedLine *bed_line = &line;
+      parser::BedLine trimmed;
+      if (trim_to_chromosome_size && line.end > size) {
+        trimmed = line;
+        trimmed.end = size;
+        bed_line = &trimmed;
       }
 
-      std::shared_ptr<char> compressed_data;
-      size_t compressed_size = 0;
-      bool compressed = false;
-      mongo::BSONObj o = ab.arr();
-      compressed_data = epidb::compress::compress(o.objdata(), o.objsize(), compressed_size, compressed);
-
-      mongo::BSONObjBuilder block_builder;
-
-      long long id = (long long) dataset_id << 32 | (long long) count++ ;
-      block_builder.append("_id", id);
-      block_builder.append(KeyMapper::DATASET(), (int) dataset_id);
-
-      block_builder.append(KeyMapper::START(), min);
-      block_builder.append(KeyMapper::END(), max);
-
-      if (compressed) {
-        block_builder.append(KeyMapper::FEATURES(), (int) features);
-        block_builder.append(KeyMapper::BED_COMPRESSED(), true);
-        block_builder.append(KeyMapper::BED_DATASIZE(), o.objsize());
-        block_builder.appendBinData(KeyMapper::BED_DATA(), compressed_size, mongo::BinDataGeneral, (void *) compressed_data.get());
-      } else {
-        block_builder.append(KeyMapper::FEATURES(), (int) features);
-        block_builder.append(KeyMapper::BED_COMPRESSED(), false);
-        block_builder.appendBinData(KeyMapper::BED_DATA(), o.objsize(), mongo::BinDataGeneral, o.objdata());
+      if (bed_line->start > size || bed_line->end > size) {
+        msg = out_of_range_message(bed_line->start, bed_line->end, bed_line->chromosome);
+        return false;
       }
 
-      block.clear();
-      mongo::BSONObj block_obj = block_builder.obj();
-      blocks_bulk.push_back(block_obj);
-      int block_size = block_obj.objsize();
-      total_size += block_size;
-      bulk_size += block_size;
-
+      mongo::BSONObjBuilder region_builder;
+      if (!fill_region_builder(region_builder, *bed_line, format, names, msg)) {
+        return false;
+      }
+      regions.push_back(region_builder.obj());
       return true;
     }
 
-    inline bool compress_and_insert_region_block(const int dataset_id,
-        const std::string &collection, size_t &count,
-        std::vector<mongo::BSONObj> &block, std::vector<mongo::BSONObj> &blocks_bulk,
-        size_t &bulk_size, size_t &total_size,
-        std::string &msg, size_t min_block_size = 1, size_t min_bulk_size = 1)
+    //
+    // Add the blocks of the lines of each chromosome, in the order of the lines.
+    // The regions of the blocks are built by the executor threads, so the lines
+    // and the format must be kept until the inserter is finished.
+    // Returns false for the errors found here, the errors of the blocks are returned by the inserter.
+    //
+    static bool add_line_blocks(const parser::ChromosomeRegionsMap &map_regions, const parser::FileFormat &format,
+                                const std::string &genome, const genomes::GenomeInfoPtr &genome_info,
+                                const bool ignore_unknow_chromosomes, const bool trim_to_chromosome_size,
+                                const size_t block_size, BlockInserter &inserter, std::string &msg)
     {
-      if (collection.empty()) {
-        return true;
-      }
-      if (block.size() >= min_block_size) {
-        compress_block(dataset_id, collection, count, block, blocks_bulk, bulk_size, total_size);
+      auto names = std::make_shared<std::vector<std::string>>();
+      if (!format_short_names(format, *names, msg)) {
+        return false;
       }
 
-      if (blocks_bulk.size() >= min_bulk_size || bulk_size >= MAXIMUM_SIZE) {
-        Connection c;
-        c->insert(collection, blocks_bulk);
-        if (!c->getLastError().empty()) {
-          msg = c->getLastError();
-          c.done();
+      for (const auto &chrom_lines : map_regions) {
+
+        std::string internal_chromosome;
+        if (!genome_info->internal_chromosome(chrom_lines.first, internal_chromosome, msg)) {
+          if (ignore_unknow_chromosomes) {
+            msg = "";
+            continue;
+          }
           return false;
         }
-        bulk_size = 0;
-        blocks_bulk.clear();
-        c.done();
-      }
 
-      return true;
-    }
+        size_t size;
+        if (!genome_info->chromosome_size(internal_chromosome, size, msg)) {
+          return false;
+        }
 
-    inline bool check_bulk_size(const int dataset_id, const std::string &collection, size_t &count,
-                                std::vector<mongo::BSONObj> &block, std::vector<mongo::BSONObj> &blocks_bulk,
-                                size_t &bulk_size, size_t &total_size,
-                                std::string &msg)
-    {
-      if (!compress_and_insert_region_block(dataset_id, collection, count, block, blocks_bulk, bulk_size, total_size, msg, BLOCK_SIZE, BULK_SIZE)) {
-        return false;
+        std::string collection = helpers::region_collection_name(genome, internal_chromosome);
+
+        const parser::BedLines &lines = chrom_lines.second;
+        for (size_t first = 0; first < lines.size(); first += block_size) {
+          const size_t last = std::min(lines.size(), first + block_size);
+          bool added = inserter.add(collection, [&lines, &format, names, first, last, size, trim_to_chromosome_size]
+          (std::vector<mongo::BSONObj> &regions, std::string &msg) {
+            regions.reserve(last - first);
+            for (size_t i = first; i < last; i++) {
+              if (!build_region(lines[i], format, *names, size, trim_to_chromosome_size, regions, msg)) {
+                return false;
+              }
+            }
+            return true;
+          });
+          if (!added) {
+            return true;
+          }
+        }
       }
 
       return true;
     }
 
-    inline bool check_remainings(const int dataset_id, const std::string &collection, size_t &count,
-                                 std::vector<mongo::BSONObj> &block, std::vector<mongo::BSONObj> &blocks_bulk,
-                                 size_t &bulk_size, size_t &total_size,
-                                 std::string &msg)
+    //
+    // Add the blocks of the regions of each chromosome, as add_line_blocks.
+    //
+    static bool add_region_blocks(const ChromosomeRegionsList &regions,
+                                  const std::string &genome, const genomes::GenomeInfoPtr &genome_info,
+                                  const size_t block_size, BlockInserter &inserter, std::string &msg)
     {
-      if (!compress_and_insert_region_block(dataset_id, collection, count, block, blocks_bulk, bulk_size, total_size, msg)) {
-        return false;
+      for (const ChromosomeRegions &chromosome_regions : regions) {
+        const std::string &chromosome = chromosome_regions.first;
+        std::string internal_chromosome;
+        size_t chromosome_size;
+
+        if (!genome_info->internal_chromosome(chromosome, internal_chromosome, msg)) {
+          return false;
+        }
+
+        if (!genome_info->chromosome_size(internal_chromosome, chromosome_size, msg)) {
+          return false;
+        }
+
+        std::string collection = helpers::region_collection_name(genome, internal_chromosome);
+
+        const Regions &chromosome_regions_list = chromosome_regions.second;
+        for (size_t first = 0; first < chromosome_regions_list.size(); first += block_size) {
+          const size_t last = std::min(chromosome_regions_list.size(), first + block_size);
+          bool added = inserter.add(collection, [&chromosome_regions_list, &chromosome, first, last, chromosome_size]
+          (std::vector<mongo::BSONObj> &block, std::string &msg) {
+            block.reserve(last - first);
+            for (size_t i = first; i < last; i++) {
+              const RegionPtr &region = chromosome_regions_list[i];
+              if (region->start() > chromosome_size || region->end() > chromosome_size) {
+                msg = out_of_range_message(region->start(), region->end(), chromosome);
+                return false;
+              }
+
+              mongo::BSONObjBuilder region_builder;
+              region_builder.append(KeyMapper::START(), (int) region->start());
+              region_builder.append(KeyMapper::END(), (int) region->end());
+              block.push_back(region_builder.obj());
+            }
+            return true;
+          });
+          if (!added) {
+            return true;
+          }
+        }
       }
 
       return true;
@@ -510,7 +539,14 @@ namespace epidb {
                            std::string &experiment_id, std::string &msg)
     {
       mongo::BSONObj experiment_metadata;
-      mongo::BSONObj extra_metadata_obj = datatypes::metadata_to_bson(extra_metadata);
+      size_t block_size;
+      size_t bulk_size;
+      datatypes::Metadata dataset_metadata;
+      if (!insert_sizes(extra_metadata, dataset_metadata, block_size, bulk_size, msg)) {
+        return false;
+      }
+
+      mongo::BSONObj extra_metadata_obj = datatypes::metadata_to_bson(dataset_metadata);
       int dataset_id;
       if (!experiments::build_metadata(name, norm_name, genome, norm_genome,
                                        epigenetic_mark, norm_epigenetic_mark,
@@ -562,90 +598,26 @@ namespace epidb {
         return false;
       }
 
-      size_t count = 0;
-      size_t total_size = 0;
-
-      for(parser::ChromosomeBedLines chrom_lines: map_regions) {
-
-        std::string internal_chromosome;
-        if (!genome_info->internal_chromosome(chrom_lines.first, internal_chromosome, msg)) {
-          if (ignore_unknow_chromosomes) {
-            msg = "";
-            continue;
-          }
-          c.done();
-          std::string new_msg;
-          if (!remove::experiment(user, experiment_id, new_msg)) {
-            msg = msg + " " + new_msg;
-          }
-          return false;
-        }
-
-        size_t size;
-        if (!genome_info->chromosome_size(internal_chromosome, size, msg)) {
-          c.done();
-          std::string new_msg;
-          if (!remove::experiment(user, experiment_id, new_msg)) {
-            msg = msg + " " + new_msg;
-          }
-          return false;
-        }
-
-        std::string collection = helpers::region_collection_name(genome, internal_chromosome);
-
-
-        size_t bulk_size = 0;
-        std::vector<mongo::BSONObj> block;
-        std::vector<mongo::BSONObj> blocks_bulk;
-        for(parser::BedLine & bed_line: chrom_lines.second) {
-
-          if (trim_to_chromosome_size && bed_line.end > size) {
-            bed_line.end = size;
-          }
-
-          if (bed_line.start > size || bed_line.end > size) {
-            msg = out_of_range_message(bed_line.start, bed_line.end, bed_line.chromosome);
-            c.done();
-            std::string new_msg;
-            if (!remove::experiment(user, experiment_id, new_msg)) {
-              msg = msg + " " + new_msg;
-            }
-            return false;
-          }
-
-          mongo::BSONObjBuilder region_builder;
-          if (!fill_region_builder(region_builder, bed_line, format, msg)) {
-            c.done();
-            std::string new_msg;
-            if (!remove::experiment(user, experiment_id, new_msg)) {
-              msg = msg + " " + new_msg;
-            }
-            return false;
-          }
-
-          mongo::BSONObj r = region_builder.obj();
-          std::string collection = helpers::region_collection_name(genome, internal_chromosome);
-
-          block.push_back(r);
-
-          if (!check_bulk_size(dataset_id, collection, count, block, blocks_bulk, bulk_size, total_size, msg)) {
-            c.done();
-            std::string new_msg;
-            if (!remove::experiment(user, experiment_id, new_msg)) {
-              msg = msg + " " + new_msg;
-            }
-            return false;
-          }
+      BlockInserter inserter(dataset_id, bulk_size);
+      if (!add_line_blocks(map_regions, format, genome, genome_info, ignore_unknow_chromosomes, trim_to_chromosome_size,
+                           block_size, inserter, msg)) {
+        inserter.abort();
+        c.done();
+        std::string new_msg;
+        if (!remove::experiment(user, experiment_id, new_msg)) {
+          msg = msg + " " + new_msg;
         }
+        return false;
+      }
 
-        if (!check_remainings(dataset_id, collection, count, block, blocks_bulk, bulk_size, total_size, msg)) {
-          c.done();
-          std::string new_msg;
-          if (!remove::experiment(user, experiment_id, new_msg)) {
-            msg = msg + " " + new_msg;
-          }
-          return false;
+      size_t total_size = 0;
+      if (!inserter.finish(total_size, msg)) {
+        c.done();
+        std::string new_msg;
+        if (!remove::experiment(user, experiment_id, new_msg)) {
+          msg = msg + " " + new_msg;
         }
+        return false;
       }
 
       if (!update_upload_info(Collections::EXPERIMENTS(), experiment_id, total_size, msg)) {
@@ -672,7 +644,14 @@ namespace epidb {
     {
       int dataset_id;
       mongo::BSONObj annotation_metadata;
-      mongo::BSONObj extra_metadata_obj = datatypes::metadata_to_bson(extra_metadata);
+      size_t block_size;
+      size_t bulk_size;
+      datatypes::Metadata dataset_metadata;
+      if (!insert_sizes(extra_metadata, dataset_metadata, block_size, bulk_size, msg)) {
+        return false;
+      }
+
+      mongo::BSONObj extra_metadata_obj = datatypes::metadata_to_bson(dataset_metadata);
       if (!annotations::build_metadata(name, norm_name, genome, norm_genome,
                                        description, norm_description, extra_metadata_obj,
                                        ip, format,
@@ -718,80 +697,25 @@ namespace epidb {
         return false;
       }
 
-      size_t count = 0;
-      size_t total_size = 0;
-      size_t bulk_size = 0;
-      std::vector<mongo::BSONObj> block;
-      std::vector<mongo::BSONObj> blocks_bulk;
-
-      for(parser::ChromosomeBedLines chrom_lines: map_regions) {
-
-        std::string internal_chromosome;
-        if (!genome_info->internal_chromosome(chrom_lines.first, internal_chromosome, msg)) {
-          c.done();
-          std::string new_msg;
-          if (!remove::annotation(user, annotation_id, new_msg)) {
-            msg = msg + " " + new_msg;
-          }
-          return false;
-        }
-
-        size_t size;
-        if (!genome_info->chromosome_size(internal_chromosome, size, msg)) {
-          c.done();
-          std::string new_msg;
-          if (!remove::annotation(user, annotation_id, new_msg)) {
-            msg = msg + " " + new_msg;
-          }
-          return false;
-        }
-
-        std::string collection = helpers::region_collection_name(genome, internal_chromosome);
-
-        for(const parser::BedLine & bed_line: chrom_lines.second) {
-
-          if (bed_line.start > size || bed_line.end > size) {
-            // TODO: Include the right message (the region's start can be after the region's end)
-            msg = out_of_range_message(bed_line.start, bed_line.end, bed_line.chromosome);
-            c.done();
-            std::string new_msg;
-            if (!remove::annotation(user, annotation_id, new_msg)) {
-              msg = msg + " " + new_msg;
-            }
-            return false;
-          }
-
-          mongo::BSONObjBuilder region_builder;
-          if (!fill_region_builder(region_builder, bed_line, format, msg)) {
-            c.done();
-            std::string new_msg;
-            if (!remove::annotation(user, annotation_id, new_msg)) {
-              msg = msg + " " + new_msg;
-            }
-            return false;
-          }
-
-          mongo::BSONObj r = region_builder.obj();
-          block.push_back(r);
-          if (!check_bulk_size(dataset_id, collection, count, block, blocks_bulk, bulk_size, total_size, msg)) {
-            c.done();
-            std::string new_msg;
-            if (!remove::annotation(user, annotation_id, new_msg)) {
-              msg = msg + " " + new_msg;
-            }
-            return false;
-          }
+      BlockInserter inserter(dataset_id, bulk_size);
+      if (!add_line_blocks(map_regions, format, genome, genome_info, false, false, block_size, inserter, msg)) {
+        inserter.abort();
+        c.done();
+        std::string new_msg;
+        if (!remove::annotation(user, annotation_id, new_msg)) {
+          msg = msg + " " + new_msg;
         }
+        return false;
+      }
 
-        if (!check_remainings(dataset_id, collection, count, block, blocks_bulk, bulk_size, total_size, msg)) {
-          c.done();
-          std::string new_msg;
-          if (!remove::annotation(user, annotation_id, new_msg)) {
-            msg = msg + " " + new_msg;
-          }
-          return false;
+      size_t total_size = 0;
+      if (!inserter.finish(total_size, msg)) {
+        c.done();
+        std::string new_msg;
+        if (!remove::annotation(user, annotation_id, new_msg)) {
+          msg = msg + " " + new_msg;
         }
-
+        return false;
       }
 
       if (!update_upload_info(Collections::ANNOTATIONS(), annotation_id, total_size, msg)) {
@@ -818,7 +742,14 @@ namespace epidb {
     {
       int dataset_id;
       mongo::BSONObj annotation_metadata;
-      mongo::BSONObj extra_metadata_obj = datatypes::metadata_to_bson(extra_metadata);
+      size_t block_size;
+      size_t bulk_size;
+      datatypes::Metadata dataset_metadata;
+      if (!insert_sizes(extra_metadata, dataset_metadata, block_size, bulk_size, msg)) {
+        return false;
+      }
+
+      mongo::BSONObj extra_metadata_obj = datatypes::metadata_to_bson(dataset_metadata);
       if (!annotations::build_metadata(name, norm_name, genome, norm_genome,
                                        description, norm_description, extra_metadata_obj,
                                        ip, format,
@@ -864,73 +795,25 @@ namespace epidb {
         return false;
       }
 
-      size_t count = 0;
-      size_t total_size = 0;
-      size_t bulk_size = 0;
-      std::vector<mongo::BSONObj> block;
-      std::vector<mongo::BSONObj> blocks_bulk;
-
-      for(const ChromosomeRegions & chromosome_regions: regions) {
-        std::string chromosome = chromosome_regions.first;
-        std::string internal_chromosome;
-        size_t chromosome_size;
-
-        if (!genome_info->internal_chromosome(chromosome, internal_chromosome, msg)) {
-          c.done();
-          std::string new_msg;
-          if (!remove::annotation(user, annotation_id, new_msg)) {
-            msg = msg + " " + new_msg;
-          }
-          return false;
-        }
-
-        if (!genome_info->chromosome_size(internal_chromosome, chromosome_size, msg)) {
-          c.done();
-          std::string new_msg;
-          if (!remove::annotation(user, annotation_id, new_msg)) {
-            msg = msg + " " + new_msg;
-          }
-          return false;
+      BlockInserter inserter(dataset_id, bulk_size);
+      if (!add_region_blocks(regions, genome, genome_info, block_size, inserter, msg)) {
+        inserter.abort();
+        c.done();
+        std::string new_msg;
+        if (!remove::annotation(user, annotation_id, new_msg)) {
+          msg = msg + " " + new_msg;
         }
+        return false;
+      }
 
-        std::string collection = helpers::region_collection_name(genome, internal_chromosome);
-
-        for (auto &region : chromosome_regions.second) {
-          mongo::BSONObjBuilder region_builder;
-
-          if (region->start() > chromosome_size || region->end() > chromosome_size) {
-            msg = out_of_range_message(region->start(), region->end(), chromosome);
-            c.done();
-            std::string new_msg;
-            if (!remove::annotation(user, annotation_id, new_msg)) {
-              msg = msg + " " + new_msg;
-            }
-            return false;
-          }
-
-          region_builder.append(KeyMapper::START(), (int) region->start());
-          region_builder.append(KeyMapper::END(), (int) region->end());
-
-          mongo::BSONObj r = region_builder.obj();
-          block.push_back(r);
-
-          if (!check_bulk_size(dataset_id, collection, count, block, blocks_bulk, bulk_size, total_size, msg)) {
-            c.done();
-            std::string new_msg;
-            if (!remove::annotation(user, annotation_id, new_msg)) {
-              msg = msg + " " + new_msg;
-            }
-            return false;
-          }
-        }
-        if (!check_remainings(dataset_id, collection, count, block, blocks_bulk, bulk_size, total_size, msg)) {
-          c.done();
-          std::string new_msg;
-          if (!remove::annotation(user, annotation_id, new_msg)) {
-            msg = msg + " " + new_msg;
-          }
-          return false;
+      size_t total_size = 0;
+      if (!inserter.finish(total_size, msg)) {
+        c.done();
+        std::string new_msg;
+        if (!remove::annotation(user, annotation_id, new_msg)) {
+          msg = msg + " " + new_msg;
         }
+        return false;
       }
 
       if (!update_upload_info(Collections::ANNOTATIONS(), annotation_id, total_size, msg)) {
@@ -1155,78 +1038,25 @@ namespace epidb {
         return false;
       }
 
-      size_t count = 0;
-      size_t total_size = 0;
-      size_t bulk_size = 0;
-      std::vector<mongo::BSONObj> block;
-      std::vector<mongo::BSONObj> blocks_bulk;
-
-      for(parser::ChromosomeBedLines chrom_lines: map_regions) {
-
-        std::string internal_chromosome;
-        if (!genome_info->internal_chromosome(chrom_lines.first, internal_chromosome, msg)) {
-          c.done();
-          std::string new_msg;
-          if (!remove::dataset(dataset_id, norm_genome, msg)) {
-            msg = msg + " " + new_msg;
-          }
-          return false;
-        }
-
-        size_t size;
-        if (!genome_info->chromosome_size(internal_chromosome, size, msg)) {
-          c.done();
-          std::string new_msg;
-          if (!remove::dataset(dataset_id, norm_genome, msg)) {
-            msg = msg + " " + new_msg;
-          }
-          return false;
-        }
-
-        std::string collection = helpers::region_collection_name(genome, internal_chromosome);
-
-        for(const parser::BedLine & bed_line: chrom_lines.second) {
-
-          if (bed_line.start > size || bed_line.end > size) {
-            msg = out_of_range_message(bed_line.start, bed_line.end, bed_line.chromosome);
-            c.done();
-            std::string new_msg;
-            if (!remove::dataset(dataset_id, norm_genome, msg)) {
-              msg = msg + " " + new_msg;
-            }
-            return false;
-          }
-
-          mongo::BSONObjBuilder region_builder;
-          if (!fill_region_builder(region_builder, bed_line, format, msg)) {
-            c.done();
-            std::string new_msg;
-            if (!remove::dataset(dataset_id, norm_genome, msg)) {
-              msg = msg + " " + new_msg;
-            }
-            return false;
-          }
-
-          mongo::BSONObj r = region_builder.obj();
-          block.push_back(r);
-          if (!check_bulk_size(dataset_id, collection, count, block, blocks_bulk, bulk_size, total_size, msg)) {
-            c.done();
-            std::string new_msg;
-            if (!remove::dataset(dataset_id, norm_genome, msg)) {
-              msg = msg + " " + new_msg;
-            }
-            return false;
-          }
+      BlockInserter inserter(dataset_id);
+      if (!add_line_blocks(map_regions, format, genome, genome_info, false, false, BLOCK_SIZE, inserter, msg)) {
+        inserter.abort();
+        c.done();
+        std::string new_msg;
+        if (!remove::dataset(dataset_id, norm_genome, new_msg)) {
+          msg = msg + " " + new_msg;
         }
+        return false;
+      }
 
-        if (!check_remainings(dataset_id, collection, count, block, blocks_bulk, bulk_size, total_size, msg)) {
-          c.done();
-          std::string new_msg;
-          if (!remove::dataset(dataset_id, norm_genome, msg)) {
-            msg = msg + " " + new_msg;
-          }
-          return false;
+      size_t total_size = 0;
+      if (!inserter.finish(total_size, msg)) {
+        c.done();
+        std::string new_msg;
+        if (!remove::dataset(dataset_id, norm_genome, new_msg)) {
+          msg = msg + " " + new_msg;
         }
+        return false;
       }
 
       c.done();
@@ -125,6 +125,12 @@ namespace epidb {
       return BED_DATA;
     }
 
+    const std::string &KeyMapper::BED_ZONE_MAP()
+    {
+      static std::string BED_ZONE_MAP = epidb::dba::KeyMapper::build_default("BED_ZONE_MAP");
+      return BED_ZONE_MAP;
+    }
+
     const std::string &KeyMapper::DATASET()
     {
       static std::string DATASET = epidb::dba::KeyMapper::build_default("DATASET");
@@ -38,6 +38,7 @@ namespace epidb {
       static const std::string& BED_COMPRESSED();
       static const std::string& BED_DATA();
       static const std::string& BED_DATASIZE();
+      static const std::string& BED_ZONE_MAP();
       static const std::string& DATASET();
       static const std::string& END();
       static const std::string& FEATURES();
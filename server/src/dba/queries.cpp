@@ -22,6 +22,7 @@
 #include <cstring>
 #include <set>
 #include <iterator>
+#include <memory>
 #include <unordered_map>
 #include <utility>
 
@@ -49,6 +50,8 @@
 
 #include "../processing/running_cache.hpp"
 
+#include "../threading/executor.hpp"
+
 #include "annotations.hpp"
 #include "collections.hpp"
 #include "dba.hpp"
@@ -286,22 +289,149 @@ namespace epidb {
         return true;
       }
 
+      //
+      // The two sub-queries of a binary operation are independent: the second one is
+      // submitted to the executor while this thread retrieves the first one.
+      // Both use the same status, so a canceled request stops both of them.
+      //
+      template <typename ChromosomeList, typename Retrieve>
+      bool retrieve_sub_queries(const std::string &query_a_id, const std::string &query_b_id,
+                                processing::StatusPtr status, Retrieve retrieve,
+                                ChromosomeList &regions_a, ChromosomeList &regions_b, std::string &msg)
+      {
+        bool ret_b = false;
+        std::string msg_b;
+        threading::TaskGroup tasks(status->task_limit());
+        tasks.spawn([&]() {
+          ret_b = retrieve(query_b_id, regions_b, msg_b);
+        });
+
+        std::string msg_a;
+        bool ret_a = retrieve(query_a_id, regions_a, msg_a);
+        tasks.wait();
+
+        if (!ret_a) {
+          msg = "Cannot retrieve first region set: " + msg_a;
+          return false;
+        }
+        if (!ret_b) {
+          msg = "Cannot retrieve second region set: " + msg_b;
+          return false;
+        }
+        return true;
+      }
+
+      template <typename ChromosomeList>
+      bool retrieve_sub_queries(const datatypes::User& user,
+                                const std::string &query_a_id, const std::string &query_b_id,
+                                processing::StatusPtr status,
+                                ChromosomeList &regions_a, ChromosomeList &regions_b, std::string &msg)
+      {
+        auto retrieve = [&](const std::string & query_id, ChromosomeList & regions, std::string & err) {
+          return retrieve_query(user, query_id, status, regions, err);
+        };
+        return retrieve_sub_queries(query_a_id, query_b_id, status, retrieve, regions_a, regions_b, msg);
+      }
+
       bool retrieve_query(const datatypes::User& user,
                           const std::string &query_id,
-                          processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg,
+                          processing::StatusPtr status, ChromosomeRegionsListPtr &regions, std::string &msg,
                           bool reduced_mode)
       {
-        processing::RunningOp runningOp = status->start_operation(processing::PROCESS_QUERY);
-        if (processing::is_canceled(status, msg)) {
+        mongo::BSONObj query;
+        if (!helpers::get_one(Collections::QUERIES(), BSON("_id" << query_id), query)) {
+          msg = Error::m(ERR_INVALID_QUERY_ID, query_id);
+          return false;
+        }
+
+        const mongo::BSONObj& args = query["args"].Obj();
+        if (args.hasField("cache") && args["cache"].String() == "yes") {
+          processing::RunningOp runningOp = status->start_operation(processing::PROCESS_QUERY);
+          if (processing::is_canceled(status, msg)) {
+            return false;
+          }
+          return cache::get_query_cache(user, query["derived_from"].String(), status, regions, msg);
+        }
+
+        std::shared_ptr<ChromosomeRegionsList> query_regions = std::make_shared<ChromosomeRegionsList>();
+        if (!retrieve_query(user, query_id, status, *query_regions, msg, reduced_mode)) {
+          return false;
+        }
+        regions = query_regions;
+        return true;
+      }
+
+      // Count the uses of the query and of its sub-queries in the plan, visiting each query once.
+      // The sub-queries of a query known by the memo were counted by the plan that counted it.
+      static bool plan_sub_queries(const std::string &query_id, const mongo::BSONObj &query,
+                                   processing::StatusPtr status, processing::QueryMemo::Plan &plan, std::string &msg)
+      {
+        auto it = plan.find(query_id);
+        if (it != plan.end()) {
+          it->second.uses++;
+          return true;
+        }
+
+        processing::QueryMemo::Planned planned;
+        planned.uses = 1;
+        planned.query = query;
+        plan.emplace(query_id, planned);
+
+        std::unique_ptr<processing::QueryMemo>& memo = status->query_memo();
+        if (memo->is_known(query_id)) {
+          return true;
+        }
+
+        // Cached queries do not retrieve their sub-queries
+        const mongo::BSONObj& args = query["args"].Obj();
+        if (args.hasField("cache") && args["cache"].String() == "yes") {
+          return true;
+        }
+
+        for (const char* field : {"qid_1", "qid_2", "query_id", "query", "data_id", "ranges_id"}) {
+          if (args.hasField(field) && args[field].type() == mongo::String) {
+            const std::string sub_query_id = args[field].str();
+            mongo::BSONObj sub_query;
+            if (plan.find(sub_query_id) == plan.end() && !memo->planned_query(sub_query_id, sub_query) &&
+                !helpers::get_one(Collections::QUERIES(), BSON("_id" << sub_query_id), sub_query)) {
+              msg = Error::m(ERR_INVALID_QUERY_ID, sub_query_id);
+              return false;
+            }
+            if (!plan_sub_queries(sub_query_id, sub_query, status, plan, msg)) {
+              return false;
+            }
+          }
+        }
+
+        return true;
+      }
+
+      static bool plan_query(const std::string &query_id, const mongo::BSONObj &query,
+                             processing::StatusPtr status, std::string &msg)
+      {
+        processing::QueryMemo::Plan plan;
+        if (!plan_sub_queries(query_id, query, status, plan, msg)) {
           return false;
         }
+        status->query_memo()->add_plan(plan);
+        return true;
+      }
 
+      bool plan_query(const std::string &query_id, processing::StatusPtr status, std::string &msg)
+      {
         mongo::BSONObj query;
         if (!helpers::get_one(Collections::QUERIES(), BSON("_id" << query_id), query)) {
           msg = Error::m(ERR_INVALID_QUERY_ID, query_id);
           return false;
         }
+        return plan_query(query_id, query, status, msg);
+      }
 
+      bool evaluate_query(const datatypes::User& user,
+                          const mongo::BSONObj &query,
+                          processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg,
+                          bool reduced_mode)
+      {
         const mongo::BSONObj& args = query["args"].Obj();
         if (args.hasField("cache") && args["cache"].String() == "yes") {
           return cache::get_query_cache(user, query["derived_from"].String(), status, regions, msg);
@@ -379,6 +509,39 @@ namespace epidb {
         return true;
       }
 
+      bool retrieve_query(const datatypes::User& user,
+                          const std::string &query_id,
+                          processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg,
+                          bool reduced_mode)
+      {
+        processing::RunningOp runningOp = status->start_operation(processing::PROCESS_QUERY);
+        if (processing::is_canceled(status, msg)) {
+          return false;
+        }
+
+        // A query planned before, as a sub-query or by the request, was loaded by its plan
+        std::unique_ptr<processing::QueryMemo>& memo = status->query_memo();
+        mongo::BSONObj query;
+        if (!memo->planned_query(query_id, query)) {
+          if (!helpers::get_one(Collections::QUERIES(), BSON("_id" << query_id), query)) {
+            msg = Error::m(ERR_INVALID_QUERY_ID, query_id);
+            return false;
+          }
+          if (!plan_query(query_id, query, status, msg)) {
+            return false;
+          }
+        }
+
+        if (memo->claim_single(query_id)) {
+          return evaluate_query(user, query, status, regions, msg, reduced_mode);
+        }
+
+        // The shared result is evaluated with all columns, as other uses may need them.
+        return memo->get(query_id, [&](ChromosomeRegionsList & evaluated, std::string & err) {
+          return evaluate_query(user, query, status, evaluated, err, false);
+        }, status, regions, msg);
+      }
+
       bool get_experiments_by_query(const datatypes::User& user, const std::string &query_id,
                                     processing::StatusPtr status, std::vector<utils::IdName> &datasets, std::string &msg)
       {
@@ -435,12 +598,26 @@ namespace epidb {
         mongo::BSONObj query = result[0];
         mongo::BSONObj args = query["args"].Obj();
 
-        ChromosomeRegionsList regions;
+        // Plain selects are counted directly from the stored blocks.
+        if (!(args.hasField("cache") && args["cache"].String() == "yes")) {
+          const std::string& type = query["type"].str();
+          if (type == "experiment_select") {
+            return count_experiment_select_query(user, query, status, count, msg);
+          }
+          if (type == "annotation_select") {
+            return count_annotation_select_query(query, status, count, msg);
+          }
+          if (type == "input_regions") {
+            return count_query_region_set(query, status, count, msg);
+          }
+        }
+
+        ChromosomeRegionsListPtr regions;
         if (!retrieve_query(user, query_id, status, regions, msg)) {
           return false;
         }
 
-        count = count_regions(regions);
+        count = count_regions(*regions);
 
         return true;
       }
@@ -558,24 +735,16 @@ namespace epidb {
         return true;
       }
 
-      bool retrieve_experiment_select_query(const datatypes::User& user,
-                                            const mongo::BSONObj &query,
-                                            processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg,
-                                            bool reduced_mode)
+      bool build_experiment_select(const datatypes::User& user, const mongo::BSONObj &query,
+                                   mongo::BSONObj &regions_query, std::set<std::string> &genomes,
+                                   std::vector<std::string> &chromosomes, std::string &msg)
       {
-        processing::RunningOp runningOp = status->start_operation(processing::RETRIEVE_EXPERIMENT_SELECT_QUERY, query);
-        if (processing::is_canceled(status, msg)) {
-          return false;
-        }
-
-        mongo::BSONObj regions_query;
         mongo::BSONObj args = query["args"].Obj();
 
         if (!build_experiment_query(user, args, regions_query, msg)) {
           return false;
         }
 
-        std::set<std::string> genomes;
         if (args.hasField("norm_genomes")) {
           genomes = utils::build_set(args["norm_genomes"].Array());
         } else {
@@ -589,7 +758,6 @@ namespace epidb {
           }
         }
 
-        std::vector<std::string> chromosomes;
         if (args.hasField("chromosomes")) {
           chromosomes = utils::build_vector(args["chromosomes"].Array());
         } else {
@@ -600,22 +768,137 @@ namespace epidb {
           chromosomes = std::vector<std::string>(chrom.begin(), chrom.end());
         }
 
-        std::vector<ChromosomeRegionsList> genome_regions;
+        return true;
+      }
+
+      // Each genome has its own regions collections, so the counts are summed.
+      bool count_experiment_select_query(const datatypes::User& user,
+                                         const mongo::BSONObj &query,
+                                         processing::StatusPtr status, size_t &count, std::string &msg)
+      {
+        processing::RunningOp runningOp = status->start_operation(processing::RETRIEVE_EXPERIMENT_SELECT_QUERY, query);
+        if (processing::is_canceled(status, msg)) {
+          return false;
+        }
+
+        mongo::BSONObj regions_query;
+        std::set<std::string> genomes;
+        std::vector<std::string> chromosomes;
+        if (!build_experiment_select(user, query, regions_query, genomes, chromosomes, msg)) {
+          return false;
+        }
+
+        count = 0;
         for (const auto& genome : genomes) {
-          ChromosomeRegionsList reg;
-          if (!retrieve::get_regions(genome, chromosomes, regions_query, false, status, reg, msg, reduced_mode)) {
+          size_t genome_count;
+          if (!retrieve::count_regions(genome, chromosomes, regions_query, false, status, genome_count, msg)) {
+            return false;
+          }
+          count += genome_count;
+        }
+
+        return true;
+      }
+
+      // The datasets of the annotations are in a single genome, so the counts of the genomes are summed
+      bool count_annotation_select_query(const mongo::BSONObj &query,
+                                         processing::StatusPtr status, size_t &count, std::string &msg)
+      {
+        processing::RunningOp runningOp = status->start_operation(processing::RETRIEVE_ANNOTATION_SELECT_QUERY, query);
+        if (processing::is_canceled(status, msg)) {
+          return false;
+        }
+
+        mongo::BSONObj regions_query;
+        if (!build_annotation_query(query, regions_query, msg)) {
+          return false;
+        }
+
+        mongo::BSONObj args = query["args"].Obj();
+
+        std::vector<mongo::BSONElement> genome_arr;
+        if (args.hasField("norm_genomes")) {
+          genome_arr = args["norm_genomes"].Array();
+        } else if (args.hasField("norm_genome")) {
+          genome_arr.push_back(args["norm_genome"]);
+        }
+
+        count = 0;
+        for (const auto& genome_elem : genome_arr) {
+          std::string genome = genome_elem.str();
+
+          std::vector<std::string> chromosomes;
+          if (args.hasField("chromosomes")) {
+            chromosomes = utils::build_vector(args["chromosomes"].Array());
+          } else {
+            std::set<std::string> chrom;
+            if (!dba::genomes::get_chromosomes(genome, chrom, msg)) {
+              return false;
+            }
+            chromosomes = std::vector<std::string>(chrom.begin(), chrom.end());
+          }
+
+          size_t genome_count;
+          if (!retrieve::count_regions(genome, chromosomes, regions_query, false, status, genome_count, msg)) {
+            return false;
+          }
+          count += genome_count;
+        }
+
+        return true;
+      }
+
+      bool count_query_region_set(const mongo::BSONObj &query,
+                                  processing::StatusPtr status, size_t &count, std::string &msg)
+      {
+        mongo::BSONObj args = query["args"].Obj();
+        processing::RunningOp runningOp = status->start_operation(processing::RETRIEVE_QUERY_REGION_SET, query);
+        if (processing::is_canceled(status, msg)) {
+          return false;
+        }
+
+        mongo::BSONObj regions_query = BSON(KeyMapper::DATASET() << args["dataset_id"].Int());
+
+        std::vector<std::string> chromosomes = utils::build_vector(args["chromosomes"].Array());
+        std::string genome = args["norm_genome"].String();
+
+        return retrieve::count_regions(genome, chromosomes, regions_query, false, status, count, msg);
+      }
+
+      template <typename ChromosomeList>
+      bool __retrieve_experiment_select_query(const datatypes::User& user,
+                                              const mongo::BSONObj &query,
+                                              processing::StatusPtr status, ChromosomeList &regions, std::string &msg,
+                                              bool reduced_mode, const retrieve::ColumnFilter *filter = nullptr)
+      {
+        processing::RunningOp runningOp = status->start_operation(processing::RETRIEVE_EXPERIMENT_SELECT_QUERY, query);
+        if (processing::is_canceled(status, msg)) {
+          return false;
+        }
+
+        mongo::BSONObj regions_query;
+        std::set<std::string> genomes;
+        std::vector<std::string> chromosomes;
+        if (!build_experiment_select(user, query, regions_query, genomes, chromosomes, msg)) {
+          return false;
+        }
+
+        std::vector<ChromosomeList> genome_regions;
+        for (const auto& genome : genomes) {
+          ChromosomeList reg;
+          if (!retrieve::get_regions(genome, chromosomes, regions_query, false, status, reg, msg, reduced_mode, filter)) {
             return false;
           }
           genome_regions.push_back(std::move(reg));
         }
 
         // merge region data of all genomes
-        std::vector<ChromosomeRegionsList>::iterator rit = genome_regions.begin();
+        typename std::vector<ChromosomeList>::iterator rit = genome_regions.begin();
         if (rit == genome_regions.end()) {
           return true;
         }
 
-        ChromosomeRegionsList &last = *rit;
+        ChromosomeList &last = *rit;
         rit++;
         for (; rit != genome_regions.end(); ++rit) {
           last = algorithms::merge_chromosome_regions(last, *rit);
@@ -625,9 +908,26 @@ namespace epidb {
         return true;
       }
 
+      bool retrieve_experiment_select_query(const datatypes::User& user,
+                                            const mongo::BSONObj &query,
+                                            processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg,
+                                            bool reduced_mode)
+      {
+        return __retrieve_experiment_select_query(user, query, status, regions, msg, reduced_mode);
+      }
 
-      bool retrieve_query_region_set(const mongo::BSONObj &query,
-                                     processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg)
+      bool retrieve_experiment_select_query(const datatypes::User& user,
+                                            const mongo::BSONObj &query,
+                                            processing::StatusPtr status, ChromosomeRegionsBlockList &regions, std::string &msg,
+                                            bool reduced_mode)
+      {
+        return __retrieve_experiment_select_query(user, query, status, regions, msg, reduced_mode);
+      }
+
+
+      template <typename ChromosomeList>
+      bool __retrieve_query_region_set(const mongo::BSONObj &query,
+                                       processing::StatusPtr status, ChromosomeList &regions, std::string &msg)
       {
         mongo::BSONObj args = query["args"].Obj();
         processing::RunningOp runningOp = status->start_operation(processing::RETRIEVE_QUERY_REGION_SET, query);
@@ -647,9 +947,16 @@ namespace epidb {
         return true;
       }
 
-      bool retrieve_annotation_select_query(const datatypes::User& user,
-                                            const mongo::BSONObj &query,
-                                            processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg)
+      bool retrieve_query_region_set(const mongo::BSONObj &query,
+                                     processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg)
+      {
+        return __retrieve_query_region_set(query, status, regions, msg);
+      }
+
+      template <typename ChromosomeList>
+      bool __retrieve_annotation_select_query(const datatypes::User& user,
+                                              const mongo::BSONObj &query,
+                                              processing::StatusPtr status, ChromosomeList &regions, std::string &msg)
       {
         processing::RunningOp runningOp = status->start_operation(processing::RETRIEVE_ANNOTATION_SELECT_QUERY, query);
         if (processing::is_canceled(status, msg)) {
@@ -670,7 +977,7 @@ namespace epidb {
           genome_arr.push_back(args["norm_genome"]);
         }
 
-        std::vector<ChromosomeRegionsList> genome_regions;
+        std::vector<ChromosomeList> genome_regions;
         std::vector<mongo::BSONElement>::iterator git;
 
         for (git = genome_arr.begin(); git != genome_arr.end(); ++git) {
@@ -687,7 +994,7 @@ namespace epidb {
             chromosomes = std::vector<std::string>(chrom.begin(), chrom.end());
           }
 
-          ChromosomeRegionsList reg;
+          ChromosomeList reg;
           if (!retrieve::get_regions(genome, chromosomes, regions_query, false, status, reg, msg)) {
             return false;
           }
@@ -695,8 +1002,8 @@ namespace epidb {
         }
 
         // merge region data of all genomes
-        std::vector<ChromosomeRegionsList>::iterator rit = genome_regions.begin();
-        ChromosomeRegionsList &last = *rit;
+        typename std::vector<ChromosomeList>::iterator rit = genome_regions.begin();
+        ChromosomeList &last = *rit;
         rit++;
         for (; rit != genome_regions.end(); ++rit) {
           last = algorithms::merge_chromosome_regions(last, *rit);
@@ -706,6 +1013,112 @@ namespace epidb {
         return true;
       }
 
+      bool retrieve_annotation_select_query(const datatypes::User& user,
+                                            const mongo::BSONObj &query,
+                                            processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg)
+      {
+        return __retrieve_annotation_select_query(user, query, status, regions, msg);
+      }
+
+      bool is_columnar_query(const std::string &query_id, bool &columnar, QueryObjects &queries, std::string &msg)
+      {
+        mongo::BSONObj query;
+        if (!helpers::get_one(Collections::QUERIES(), BSON("_id" << query_id), query)) {
+          msg = Error::m(ERR_INVALID_QUERY_ID, query_id);
+          return false;
+        }
+        queries[query_id] = query;
+
+        const mongo::BSONObj& args = query["args"].Obj();
+        const std::string& type = query["type"].str();
+
+        if (args.hasField("cache") && args["cache"].String() == "yes") {
+          columnar = false;
+          return true;
+        }
+
+        if (type == "experiment_select" || type == "annotation_select" || type == "input_regions") {
+          columnar = true;
+          return true;
+        }
+
+        if (type == "intersect" || type == "overlap" || type == "merge") {
+          if (!is_columnar_query(args["qid_1"].str(), columnar, queries, msg)) {
+            return false;
+          }
+          if (!columnar) {
+            return true;
+          }
+          return is_columnar_query(args["qid_2"].str(), columnar, queries, msg);
+        }
+
+        columnar = false;
+        return true;
+      }
+
+      bool retrieve_query(const datatypes::User& user,
+                          const std::string &query_id, const QueryObjects &queries,
+                          processing::StatusPtr status, ChromosomeRegionsBlockList &regions, std::string &msg,
+                          bool reduced_mode)
+      {
+        processing::RunningOp runningOp = status->start_operation(processing::PROCESS_QUERY);
+        if (processing::is_canceled(status, msg)) {
+          return false;
+        }
+
+        mongo::BSONObj query;
+        auto loaded = queries.find(query_id);
+        if (loaded != queries.end()) {
+          query = loaded->second;
+        } else if (!helpers::get_one(Collections::QUERIES(), BSON("_id" << query_id), query)) {
+          msg = Error::m(ERR_INVALID_QUERY_ID, query_id);
+          return false;
+        }
+
+        const mongo::BSONObj& args = query["args"].Obj();
+        const std::string& type = query["type"].str();
+
+        if (type == "experiment_select") {
+          return __retrieve_experiment_select_query(user, query, status, regions, msg, reduced_mode);
+
+        } else if (type == "annotation_select") {
+          return __retrieve_annotation_select_query(user, query, status, regions, msg);
+
+        } else if (type == "input_regions") {
+          return __retrieve_query_region_set(query, status, regions, msg);
+
+        } else if (type == "intersect" || type == "overlap" || type == "merge") {
+          ChromosomeRegionsBlockList regions_a;
+          ChromosomeRegionsBlockList regions_b;
+          auto retrieve = [&](const std::string & sub_query_id, ChromosomeRegionsBlockList & sub_regions, std::string & err) {
+            return retrieve_query(user, sub_query_id, queries, status, sub_regions, err);
+          };
+          if (!retrieve_sub_queries(args["qid_1"].str(), args["qid_2"].str(), status, retrieve, regions_a, regions_b, msg)) {
+            return false;
+          }
+
+          if (type == "intersect") {
+            processing::RunningOp runningOp = status->start_operation(processing::RETRIEVE_INTERSECTION_QUERY, query);
+            return algorithms::intersect(regions_a, regions_b, status, regions, msg);
+          }
+
+          if (type == "overlap") {
+            processing::RunningOp runningOp = status->start_operation(processing::RETRIEVE_OVERLAP_QUERY, query);
+            const bool overlap = args["overlap"].Bool();
+            const double amount = args["amount"].Number();
+            const std::string amount_type = args["amount_type"].str();
+            return algorithms::overlap(regions_a, regions_b, overlap, amount, amount_type, status, regions, msg);
+          }
+
+          processing::RunningOp mergeOp = status->start_operation(processing::RETRIEVE_MERGE_QUERY, query);
+          regions = algorithms::merge_chromosome_regions(regions_a, regions_b);
+          return true;
+        }
+
+        msg = Error::m(ERR_UNKNOW_QUERY_TYPE, type);
+        return false;
+      }
+
       bool retrieve_genes_select_query(const datatypes::User& user,
                                        const mongo::BSONObj &query,
                                        processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg)
@@ -868,19 +1281,11 @@ namespace epidb {
           return false;
         }
 
+        // Load both region sets: query 1 data and the regions that will be used for the overlap
         ChromosomeRegionsList regions_a;
-        // Load all data from query 1, and intersect.
-        // load both region sets.
-        if (!retrieve_query(user, args["qid_1"].str(), status, regions_a, msg)) {
-          msg = "Cannot retrieve first region set: " + msg;
-          return false;
-        }
-
-        // Load regions that will be used for the overlap
         ChromosomeRegionsList range_regions;
         const std::string query_b_id = args["qid_2"].str();
-        if (!retrieve_query(user, query_b_id, status, range_regions, msg)) {
-          msg = "Cannot retrieve second region set: " + msg;
+        if (!retrieve_sub_queries(user, query_a_id, query_b_id, status, regions_a, range_regions, msg)) {
           return false;
         }
 
@@ -905,19 +1310,11 @@ namespace epidb {
           return false;
         }
 
+        // Load both region sets: query 1 data and the regions that will be used for the overlap
         ChromosomeRegionsList regions_a;
-        // Load all data from query 1, and intersect.
-        // load both region sets.
-        if (!retrieve_query(user, args["qid_1"].str(), status, regions_a, msg)) {
-          msg = "Cannot retrieve first region set: " + msg;
-          return false;
-        }
-
-        // Load regions that will be used for the overlap
         ChromosomeRegionsList range_regions;
         const std::string query_b_id = args["qid_2"].str();
-        if (!retrieve_query(user, query_b_id, status, range_regions, msg)) {
-          msg = "Cannot retrieve second region set: " + msg;
+        if (!retrieve_sub_queries(user, query_a_id, query_b_id, status, regions_a, range_regions, msg)) {
           return false;
         }
 
@@ -990,16 +1387,8 @@ namespace epidb {
 
         // load both region sets.
         ChromosomeRegionsList regions_a;
-        bool ret = retrieve_query(user, args["qid_1"].str(), status, regions_a, msg);
-        if (!ret) {
-          msg = "Cannot retrieve first region set: " + msg;
-          return false;
-        }
-
         ChromosomeRegionsList regions_b;
-        ret = retrieve_query(user, args["qid_2"].str(), status, regions_b, msg);
-        if (!ret) {
-          msg = "Cannot retrieve second region set: " + msg;
+        if (!retrieve_sub_queries(user, args["qid_1"].str(), args["qid_2"].str(), status, regions_a, regions_b, msg)) {
           return false;
         }
 
@@ -1040,6 +1429,75 @@ namespace epidb {
         }
       }
 
+      //
+      // A filter of a column of an experiments selection is evaluated while its regions are read,
+      // so the zone maps of the stored blocks are used to skip or to accept whole blocks.
+      // Only when the selection is not cached, not used by other parts of the request,
+      // and all its experiments have the column.
+      //
+      bool retrieve_filtered_experiment_select(const datatypes::User& user, const std::string &query_id,
+                                               const std::string &field, algorithms::FilterBuilder::FilterPtr filter,
+                                               processing::StatusPtr status, ChromosomeRegionsList & regions,
+                                               bool &retrieved, std::string & msg)
+      {
+        retrieved = false;
+        if ((field == "START") || (field == "END") || (field == "CHROMOSOME") || dba::Metafield::is_meta(field)) {
+          return true;
+        }
+
+        std::unique_ptr<processing::QueryMemo>& memo = status->query_memo();
+        mongo::BSONObj query;
+        if (!memo->planned_query(query_id, query) &&
+            !helpers::get_one(Collections::QUERIES(), BSON("_id" << query_id), query)) {
+          msg = Error::m(ERR_INVALID_QUERY_ID, query_id);
+          return false;
+        }
+
+        const mongo::BSONObj& args = query["args"].Obj();
+        if ((query["type"].str() != "experiment_select") || (args.hasField("cache") && args["cache"].String() == "yes")) {
+          return true;
+        }
+
+        mongo::BSONObj regions_query;
+        if (!build_experiment_query(user, args, regions_query, msg)) {
+          return false;
+        }
+        // The column is compared by its type, that must be the same in all experiments
+        bool numeric = false;
+        bool first = true;
+        for (const auto &dataset : regions_query[KeyMapper::DATASET()]["$in"].Array()) {
+          dba::columns::ColumnTypePtr column;
+          std::string column_msg;
+          if (!cache::get_column_type_from_dataset(dataset.Int(), field, column, column_msg)) {
+            return true;
+          }
+          bool column_numeric = !datatypes::column_type_is_compatible(column->type(), datatypes::COLUMN_STRING);
+          if (!first && column_numeric != numeric) {
+            return true;
+          }
+          numeric = column_numeric;
+          first = false;
+        }
+
+        retrieve::ColumnFilter column_filter;
+        if (!KeyMapper::to_short(field, column_filter.key, msg)) {
+          return false;
+        }
+        column_filter.filter = filter;
+        column_filter.numeric = numeric;
+
+        // The use is claimed only when the selection is read here, otherwise retrieve_query claims it
+        if (!memo->claim_single(query_id)) {
+          return true;
+        }
+
+        if (!__retrieve_experiment_select_query(user, query, status, regions, msg, false, &column_filter)) {
+          return false;
+        }
+        retrieved = true;
+        return true;
+      }
+
       bool retrieve_filter_query(const datatypes::User& user,
                                  const mongo::BSONObj & query,
                                  processing::StatusPtr status, ChromosomeRegionsList & filtered_regions, std::string & msg)
@@ -1051,13 +1509,6 @@ namespace epidb {
 
         mongo::BSONObj args = query["args"].Obj();
 
-        // load original query
-        ChromosomeRegionsList regions;
-        bool ret = retrieve_query(user, args["query"].str(), status, regions, msg);
-        if (!ret) {
-          return false;
-        }
-
         std::string type = args["type"].str();
         std::string operation = args["operation"].str();
         std::string value = args["value"].str();
@@ -1081,6 +1532,23 @@ namespace epidb {
           return false;
         }
 
+        ChromosomeRegionsList regions;
+        bool filtered;
+        if (!retrieve_filtered_experiment_select(user, args["query"].str(), field, filter, status, regions, filtered, msg)) {
+          return false;
+        }
+        if (filtered) {
+          for (auto& chromosome_regions : regions) {
+            filtered_regions.push_back(std::move(chromosome_regions));
+          }
+          return true;
+        }
+
+        // load original query
+        if (!retrieve_query(user, args["query"].str(), status, regions, msg)) {
+          return false;
+        }
+
         DatasetId dataset_id = -1;
         dba::columns::ColumnTypePtr column;
 
@@ -1336,14 +1804,8 @@ namespace epidb {
         const std::string field = args["field"].str();
 
         ChromosomeRegionsList data;
-        bool ret = retrieve_query(user, query_id, status, data, msg);
-        if (!ret) {
-          return false;
-        }
-
         ChromosomeRegionsList ranges;
-        ret = retrieve_query(user, regions_id, status, ranges, msg);
-        if (!ret) {
+        if (!retrieve_sub_queries(user, query_id, regions_id, status, data, ranges, msg)) {
           return false;
         }
 
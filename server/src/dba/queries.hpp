@@ -29,6 +29,7 @@
 #include "dba.hpp"
 
 #include "../datatypes/regions.hpp"
+#include "../datatypes/regions_block.hpp"
 #include "../datatypes/user.hpp"
 
 #include "../extras/utils.hpp"
@@ -48,11 +49,35 @@ namespace epidb {
                         const std::string &query_id, const std::string &key, const std::string &value,
                         std::string &new_query_id, std::string &msg);
 
+      // Count the uses of the query and its sub-queries in the request.
+      // The queries used more than once are evaluated only once (see processing::QueryMemo).
+      // Called on the first retrieve of a query, or before, when the request retrieves more than one query.
+      bool plan_query(const std::string &query_id, processing::StatusPtr status, std::string &msg);
+
       bool retrieve_query(const datatypes::User& user,
                           const std::string &query_id,
                           processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg,
                           bool reduced_mode = false);
 
+      // Read only access to the query regions. The cached results are shared, not copied.
+      bool retrieve_query(const datatypes::User& user,
+                          const std::string &query_id,
+                          processing::StatusPtr status, ChromosomeRegionsListPtr &regions, std::string &msg,
+                          bool reduced_mode = false);
+
+      // Query objects by their ids
+      typedef std::map<std::string, mongo::BSONObj> QueryObjects;
+
+      // Verify if the query can be entirely processed as RegionsBlock,
+      // i.e. selects and intersect, overlap and merge of them.
+      // The loaded query objects are kept in queries, to be retrieved without loading them again.
+      bool is_columnar_query(const std::string &query_id, bool &columnar, QueryObjects &queries, std::string &msg);
+
+      bool retrieve_query(const datatypes::User& user,
+                          const std::string &query_id, const QueryObjects &queries,
+                          processing::StatusPtr status, ChromosomeRegionsBlockList &regions, std::string &msg,
+                          bool reduced_mode = false);
+
       bool get_experiments_by_query(const datatypes::User& user,
                                     const std::string &query_id,
                                     processing::StatusPtr status, std::vector<utils::IdName> &experiments_name, std::string &msg);
@@ -62,10 +87,25 @@ namespace epidb {
                                             processing::StatusPtr status, ChromosomeRegionsList &regions, std::string &msg,
                                             bool reduced_mode = false);
 
+      bool retrieve_experiment_select_query(const datatypes::User& user,
+                                            const mongo::BSONObj &query,
+                                            processing::StatusPtr status, ChromosomeRegionsBlockList &regions, std::string &msg,
+                                            bool reduced_mode = false);
+
       bool count_regions(const datatypes::User& user,
                          const std::string &query_id,
                          processing::StatusPtr status, size_t &count, std::string &msg);
 
+      bool count_experiment_select_query(const datatypes::User& user,
+                                         const mongo::BSONObj &query,
+                                         processing::StatusPtr status, size_t &count, std::string &msg);
+
+      bool count_annotation_select_query(const mongo::BSONObj &query,
+                                         processing::StatusPtr status, size_t &count, std::string &msg);
+
+      bool count_query_region_set(const mongo::BSONObj &query,
+                                  processing::StatusPtr status, size_t &count, std::string &msg);
+
       bool build_annotation_query(const datatypes::User& user,
                                   const mongo::BSONObj &query,
                                   mongo::BSONObj &regions_query, std::vector<std::string> &annotations_id,
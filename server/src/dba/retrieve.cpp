@@ -20,20 +20,11 @@
 
 #include <algorithm>
 #include <cstdlib>
-#include <future>
 #include <limits>
-#include <numeric>
 #include <memory>
 #include <string>
-#include <thread>
-#include <tuple>
 #include <vector>
 
-#include <boost/ref.hpp>
-#include <boost/thread.hpp>
-#include <boost/function.hpp>
-#include <boost/bind.hpp>
-
 #include <mongo/bson/bson.h>
 
 #include "collections.hpp"
@@ -48,12 +39,15 @@
 #include "../connection/connection.hpp"
 
 #include "../datatypes/regions.hpp"
+#include "../datatypes/regions_block.hpp"
 
 #include "../extras/compress.hpp"
 #include "../extras/utils.hpp"
 
 #include "../parser/wig.hpp"
 
+#include "../threading/executor.hpp"
+
 #include "../log.hpp"
 
 #include "retrieve.hpp"
@@ -62,33 +56,263 @@ namespace epidb {
   namespace dba {
     namespace retrieve {
 
-      void insert_bed_regions(const mongo::BSONObj& arrobj, Regions &_regions, size_t& _it_count, size_t& _it_size,
+      template <typename Container>
+      void insert_bed_regions(const mongo::BSONObj& arrobj, Container &_regions, size_t& _it_count, size_t& _it_size,
                               const Position _query_start, const Position _query_end, DatasetId dataset_id,
-                              const bool full_overlap, const bool reduced_mode);
+                              const bool full_overlap, const bool reduced_mode,
+                              const bool check_window, const ColumnFilter *filter);
 
       const size_t BULK_SIZE = 20000;
 
+      //
+      // The decoded regions are stored either as region objects (Regions)
+      // or directly into the columns of a RegionsBlock.
+      // Each function returns the memory used by the stored region.
+      //
+      inline size_t store_wig_region(Regions &regions, const Position start, const Position end, const DatasetId dataset_id, const Score value)
+      {
+        RegionPtr region = build_wig_region(start, end, dataset_id, value);
+        size_t size = region->size();
+        regions.emplace_back(std::move(region));
+        return size;
+      }
+
+      inline size_t store_wig_region(RegionsBlock &block, const Position start, const Position end, const DatasetId dataset_id, const Score value)
+      {
+        block.add(start, end, dataset_id);
+        block.insert(value);
+        return block.row_size();
+      }
+
+      template <typename Target>
+      inline void store_bed_values(Target &target, mongo::BSONObjIterator &i)
+      {
+        while ( i.more() ) {
+          const mongo::BSONElement &e = i.next();
+          switch (e.type()) {
+          case mongo::String :
+            target.insert(e.str());
+            break;
+          case mongo::NumberDouble :
+            target.insert((float) e._numberDouble());
+            break;
+          case mongo::NumberInt :
+            target.insert(e._numberInt());
+            break;
+          default:
+            target.insert(e.toString(false));
+          }
+        }
+      }
+
+      inline size_t store_bed_region(Regions &regions, const Position start, const Position end, const DatasetId dataset_id,
+                                     mongo::BSONObjIterator &i, const bool reduced_mode)
+      {
+        RegionPtr region;
+        if (reduced_mode) {
+          region = build_simple_region(start, end, dataset_id);
+        } else {
+          region = build_bed_region(start, end, dataset_id);
+          store_bed_values(*region, i);
+        }
+        size_t size = region->size();
+        regions.emplace_back(std::move(region));
+        return size;
+      }
+
+      inline size_t store_bed_region(RegionsBlock &block, const Position start, const Position end, const DatasetId dataset_id,
+                                     mongo::BSONObjIterator &i, const bool reduced_mode)
+      {
+        block.add(start, end, dataset_id);
+        if (!reduced_mode) {
+          store_bed_values(block, i);
+        }
+        return block.row_size();
+      }
+
+      //
+      // Counting sink: the regions are only counted, nothing is stored.
+      //
+      struct RegionsCount {
+        size_t _count;
+
+        RegionsCount() :
+          _count(0) {}
+
+        size_t size() const
+        {
+          return _count;
+        }
+
+        void reserve(size_t) {}
+      };
+
+      inline size_t store_wig_region(RegionsCount &counter, const Position, const Position, const DatasetId, const Score)
+      {
+        counter._count++;
+        return 0;
+      }
+
+      inline size_t store_bed_region(RegionsCount &counter, const Position, const Position, const DatasetId,
+                                     mongo::BSONObjIterator &, const bool)
+      {
+        counter._count++;
+        return 0;
+      }
+
+      inline void sort_regions(RegionsCount &) {}
+
+      //
+      // The block START, END and FEATURES are the minimum start, the maximum end and the number of regions.
+      // When the whole block is inside the query range, all its regions are accepted without checking them,
+      // and the counter does not need to decompress it.
+      //
+      inline bool block_inside(const mongo::BSONObj &region_bson, const Position query_start, const Position query_end,
+                               const bool full_overlap)
+      {
+        if (!region_bson.hasField(KeyMapper::FEATURES()) ||
+            !region_bson.hasField(KeyMapper::START()) || !region_bson.hasField(KeyMapper::END())) {
+          return false;
+        }
+
+        // The WIG regions are always selected by overlap, the BED regions by the full_overlap flag.
+        const bool is_wig = region_bson.hasField(KeyMapper::WIG_TRACK_TYPE());
+        const Position block_start = region_bson[KeyMapper::START()].numberInt();
+        const Position block_end = region_bson[KeyMapper::END()].numberInt();
+
+        if (full_overlap && !is_wig) {
+          return (block_start >= query_start) && (block_end <= query_end);
+        }
+        // Strict, so empty regions at the borders are still checked one by one
+        return (block_start > query_start) && (block_end < query_end);
+      }
+
+      inline bool count_whole_block(Regions &, const mongo::BSONObj &, const Position, const Position, const bool, size_t &)
+      {
+        return false;
+      }
+
+      inline bool count_whole_block(RegionsBlock &, const mongo::BSONObj &, const Position, const Position, const bool, size_t &)
+      {
+        return false;
+      }
+
+      inline bool count_whole_block(RegionsCount &counter, const mongo::BSONObj &region_bson,
+                                    const Position query_start, const Position query_end, const bool full_overlap,
+                                    size_t &count)
+      {
+        if (!block_inside(region_bson, query_start, query_end, full_overlap)) {
+          return false;
+        }
+
+        const size_t features = region_bson[KeyMapper::FEATURES()].numberInt();
+        counter._count += features;
+        count += features;
+        return true;
+      }
+
+      enum ZoneMapMatch {
+        ZONE_MAP_NONE,
+        ZONE_MAP_SOME,
+        ZONE_MAP_ALL
+      };
+
+      //
+      // The BED_ZONE_MAP of a block has the minimum, maximum and number of values of its numeric columns.
+      // It is used only when the filtered column is numeric and all regions of the block have a number in it.
+      //
+      inline ZoneMapMatch zone_map_match(const mongo::BSONObj &region_bson, const ColumnFilter &filter)
+      {
+        if (!filter.numeric || !region_bson.hasField(KeyMapper::BED_ZONE_MAP()) || !region_bson.hasField(KeyMapper::FEATURES())) {
+          return ZONE_MAP_SOME;
+        }
+
+        const mongo::BSONObj zone_map = region_bson[KeyMapper::BED_ZONE_MAP()].Obj();
+        if (!zone_map.hasField(filter.key)) {
+          return ZONE_MAP_SOME;
+        }
+
+        const std::vector<mongo::BSONElement> column = zone_map[filter.key].Array();
+        if (column.size() != 3 || column[2].numberInt() != region_bson[KeyMapper::FEATURES()].numberInt()) {
+          return ZONE_MAP_SOME;
+        }
+
+        // The regions keep the values as Score
+        const Score min = column[0].numberDouble();
+        const Score max = column[1].numberDouble();
+        if (!filter.filter->may_match(min, max)) {
+          return ZONE_MAP_NONE;
+        }
+        if (filter.filter->all_match(min, max)) {
+          return ZONE_MAP_ALL;
+        }
+        return ZONE_MAP_SOME;
+      }
+
+      // Same value used by the filter query on the stored region, with the same defaults for a missing value
+      inline bool column_filter_match(const mongo::BSONObj &region_bson, const ColumnFilter &filter)
+      {
+        const mongo::BSONElement &e = region_bson[filter.key];
+        if (filter.numeric) {
+          switch (e.type()) {
+          case mongo::NumberDouble :
+            return filter.filter->is((Score) e._numberDouble());
+          case mongo::NumberInt :
+            return filter.filter->is((Score) e._numberInt());
+          default:
+            return filter.filter->is(std::numeric_limits<Score>::min());
+          }
+        }
+
+        switch (e.type()) {
+        case mongo::String :
+          return filter.filter->is(e.str());
+        case mongo::EOO :
+          return filter.filter->is(std::string());
+        default:
+          return filter.filter->is(e.toString(false));
+        }
+      }
+
+      inline void sort_regions(Regions &regions)
+      {
+        std::sort(regions.begin(), regions.end(), RegionPtrComparer);
+      }
+
+      inline void sort_regions(RegionsBlock &block)
+      {
+        block.sort();
+      }
+
+      template <typename Container>
       struct RegionProcess {
         bool _full_overlap;
         bool _reduced_mode;
         size_t _it_count;
         size_t _it_size;
-        Regions &_regions;
+        Container &_regions;
         Position _query_start;
         Position _query_end;
+        const ColumnFilter *_filter;
 
-        RegionProcess(Regions &regions, Position query_start, Position query_end, bool full_overlap, bool reduced_mode) :
+        RegionProcess(Container &regions, Position query_start, Position query_end, bool full_overlap, bool reduced_mode,
+                      const ColumnFilter *filter = nullptr) :
           _full_overlap(full_overlap),
           _reduced_mode(reduced_mode),
           _it_count(0),
           _it_size(0),
           _regions(regions),
           _query_start(query_start),
-          _query_end(query_end)
+          _query_end(query_end),
+          _filter(filter)
         { }
 
         void read_region(const mongo::BSONObj &region_bson)
         {
+          if (!_filter && count_whole_block(_regions, region_bson, _query_start, _query_end, _full_overlap, _it_count)) {
+            return;
+          }
+
           if (region_bson.hasField(KeyMapper::WIG_TRACK_TYPE())) {
             DatasetId dataset_id = region_bson[KeyMapper::DATASET()].Int();
 
@@ -131,9 +355,7 @@ namespace epidb {
 
                 if ((start + (i * step) < _query_end) &&  // Region START < Range END
                     (start + (i * step) + span > _query_start)) { // Region END > Range START
-                  RegionPtr region = build_wig_region(start + (i * step), start + (i * step) + span, dataset_id, scores[i]);
-                  _it_size += region->size();
-                  _regions.emplace_back(std::move(region));
+                  _it_size += store_wig_region(_regions, start + (i * step), start + (i * step) + span, dataset_id, scores[i]);
                   _it_count++;
                 }
               }
@@ -154,9 +376,7 @@ namespace epidb {
                 if ((starts[i] < _query_end) &&  // Region START < Range END
                     ((starts[i] + span) > _query_start)) { // Region END > Range START
 
-                  RegionPtr region = build_wig_region(starts[i], starts[i] + span, dataset_id, scores[i]);
-                  _it_size += region->size();
-                  _regions.emplace_back(std::move(region));
+                  _it_size += store_wig_region(_regions, starts[i], starts[i] + span, dataset_id, scores[i]);
                   _it_count++;
                 }
               }
@@ -180,9 +400,7 @@ namespace epidb {
                 if ((starts[i] < _query_end) &&
                     (ends[i] > _query_start)) {
 
-                  RegionPtr region = build_wig_region(starts[i], ends[i], dataset_id, scores[i]);
-                  _it_size += region->size();
-                  _regions.emplace_back(std::move(region));
+                  _it_size += store_wig_region(_regions, starts[i], ends[i], dataset_id, scores[i]);
                   _it_count++;
                 }
               }
@@ -194,6 +412,18 @@ namespace epidb {
           }
 
           else if (region_bson.hasField(KeyMapper::BED_COMPRESSED())) {
+            const ColumnFilter *filter = _filter;
+            if (filter) {
+              const ZoneMapMatch match = zone_map_match(region_bson, *filter);
+              if (match == ZONE_MAP_NONE) {
+                return;
+              }
+              if (match == ZONE_MAP_ALL) {
+                filter = nullptr;
+              }
+            }
+            const bool check_window = !block_inside(region_bson, _query_start, _query_end, _full_overlap);
+
             bool compressed = region_bson[KeyMapper::BED_COMPRESSED()].Bool();
             DatasetId dataset_id = region_bson[KeyMapper::DATASET()].Int();
             int db_data_size;
@@ -207,7 +437,8 @@ namespace epidb {
               mongo::BSONObj arrobj((char *) data);
               // TODO: check uncompressed_size == real_size
 
-              insert_bed_regions(arrobj, _regions, _it_count, _it_size, _query_start, _query_end, dataset_id, _full_overlap, _reduced_mode);
+              insert_bed_regions(arrobj, _regions, _it_count, _it_size, _query_start, _query_end, dataset_id, _full_overlap, _reduced_mode,
+                                 check_window, filter);
               free(data);
 
               // Grouped in blocks but not compressed
@@ -216,15 +447,18 @@ namespace epidb {
 
               mongo::BSONObj arrobj((char *) data);
 
-              insert_bed_regions(arrobj, _regions, _it_count, _it_size, _query_start, _query_end, dataset_id, _full_overlap, _reduced_mode);
+              insert_bed_regions(arrobj, _regions, _it_count, _it_size, _query_start, _query_end, dataset_id, _full_overlap, _reduced_mode,
+                                 check_window, filter);
             }
           }
         }
       };
 
-      inline void insert_bed_regions(const mongo::BSONObj& arrobj, Regions &_regions, size_t& _it_count, size_t& _it_size,
+      template <typename Container>
+      inline void insert_bed_regions(const mongo::BSONObj& arrobj, Container &_regions, size_t& _it_count, size_t& _it_size,
                                      const Position _query_start, const Position _query_end, DatasetId dataset_id,
-                                     bool full_overlap, bool reduced_mode)
+                                     bool full_overlap, bool reduced_mode,
+                                     const bool check_window, const ColumnFilter *filter)
       {
         auto regions_it = arrobj.begin();
 
@@ -235,40 +469,23 @@ namespace epidb {
           Position start = i.next().Int();
           Position end = i.next().Int();
 
-          if (full_overlap) {
-            if ((start < _query_start) || (end > _query_end)) {
-              continue;
-            }
-          } else {
-            if ((start >= _query_end) || (end <= _query_start)) {
-              continue;
+          if (check_window) {
+            if (full_overlap) {
+              if ((start < _query_start) || (end > _query_end)) {
+                continue;
+              }
+            } else {
+              if ((start >= _query_end) || (end <= _query_start)) {
+                continue;
+              }
             }
           }
 
-          RegionPtr region;
-          if (reduced_mode) {
-            region = build_simple_region(start, end, dataset_id);
-          } else {
-            region = build_bed_region(start, end, dataset_id);
-            while ( i.more() ) {
-              const mongo::BSONElement &e = i.next();
-              switch (e.type()) {
-              case mongo::String :
-                region->insert(e.str());
-                break;
-              case mongo::NumberDouble :
-                region->insert((float) e._numberDouble());
-                break;
-              case mongo::NumberInt :
-                region->insert(e._numberInt());
-                break;
-              default:
-                region->insert(e.toString(false));
-              }
-            }
+          if (filter && !column_filter_match(region_bson, *filter)) {
+            continue;
           }
-          _it_size += region->size();
-          _regions.emplace_back(std::move(region));
+
+          _it_size += store_bed_region(_regions, start, end, dataset_id, i, reduced_mode);
           _it_count++;
         }
       }
@@ -294,9 +511,10 @@ namespace epidb {
                .hint("D_1_S_1_E_1");
       }
 
+      template <typename Container>
       bool get_regions_from_collection(const std::string &collection, const mongo::BSONObj &regions_query, const bool full_overlap,
-                                       processing::StatusPtr status, Regions &regions, std::string &msg,
-                                       bool reduced_mode)
+                                       processing::StatusPtr status, Container &regions, std::string &msg,
+                                       bool reduced_mode, const ColumnFilter *filter = nullptr)
       {
         Position start;
         Position end;
@@ -314,7 +532,7 @@ namespace epidb {
         regions.reserve(count);
         auto cursor( c->query(collection, query, 0, 0, NULL, queryOptions) );
         cursor->setBatchSize(BULK_SIZE);
-        RegionProcess rp(regions, start, end, full_overlap, reduced_mode);
+        RegionProcess<Container> rp(regions, start, end, full_overlap, reduced_mode, filter);
         while ( cursor->more() ) {
           while (cursor->moreInCurrentBatch()) {
             mongo::BSONObj o = cursor->nextSafe();
@@ -346,34 +564,12 @@ namespace epidb {
           }
         }
 
-        std::sort(regions.begin(), regions.end(), RegionPtrComparer);
+        sort_regions(regions);
 
         c.done();
         return true;
       }
 
-      std::tuple<bool, std::string> get_regions_job(const std::string &genome, const std::shared_ptr<std::vector<std::string> > chromosomes,
-          const mongo::BSONObj &regions_query, const bool full_overlap, const bool reduced_mode,
-          processing::StatusPtr status, std::shared_ptr<ChromosomeRegionsList> result)
-      {
-
-        for (std::vector<std::string>::const_iterator chrom_it = chromosomes->begin(); chrom_it != chromosomes->end(); chrom_it++) {
-          std::string collection = helpers::region_collection_name(genome, *chrom_it);
-          Regions regions = Regions();
-          std::string msg;
-          if (!get_regions_from_collection(collection, regions_query, full_overlap, status, regions, msg, reduced_mode)) {
-            return std::make_tuple(false, msg);
-          }
-
-          if (regions.size() > 0) {
-            ChromosomeRegions chromosomeRegions(*chrom_it, std::move(regions));
-            result->push_back(std::move(chromosomeRegions));
-          }
-        }
-
-        return std::make_tuple(true, std::string(""));
-      }
-
       bool get_regions_preview(const std::string &genome, const std::string &chromosome, const mongo::BSONObj &regions_query,
                                Regions& regions, std::string &msg)
       {
@@ -390,7 +586,7 @@ namespace epidb {
         mongo::BSONObj o = c->findOne(collection, query);
         c.done();
 
-        RegionProcess rp(regions, start, end, true, false);
+        RegionProcess<Regions> rp(regions, start, end, true, false);
         rp.read_region(o);
 
         return true;
@@ -411,130 +607,119 @@ namespace epidb {
         return true;
       }
 
-      bool get_regions(const std::string &genome, const std::vector<std::string> &chromosomes,
+      bool get_regions(const std::string &genome, const std::string &chromosome,
                        const mongo::BSONObj &regions_query, const bool full_overlap,
-                       processing::StatusPtr status, ChromosomeRegionsList &results, std::string &msg,
+                       processing::StatusPtr status,
+                       RegionsBlock &regions, std::string &msg,
                        bool reduced_mode)
       {
-        const size_t max_threads = 8;
-        std::vector<std::future<std::tuple<bool, std::string> > > threads;
-        std::vector<std::shared_ptr<ChromosomeRegionsList> > result_parts;
-
-        size_t chunk_size = ceil(double(chromosomes.size()) / double(max_threads));
-
-        for (size_t i = 0; i < max_threads; ++i) {
-          std::vector<std::string>::const_iterator start = chromosomes.begin() + i * chunk_size;
-          if (start >= chromosomes.end()) {
-            break;
-          }
-          std::vector<std::string>::const_iterator end = start + chunk_size;
-          if (end > chromosomes.end()) {
-            end = chromosomes.end();
-          }
-
-          std::shared_ptr<std::vector<std::string> > chrs(new std::vector<std::string>(start, end));
-          std::shared_ptr<ChromosomeRegionsList> result_part(new ChromosomeRegionsList);
-
-          auto t = std::async(std::launch::async,
-                              &get_regions_job,
-                              std::ref(genome), chrs, std::ref(regions_query),
-                              full_overlap, reduced_mode, status, result_part);
+        std::string collection = helpers::region_collection_name(genome, chromosome);
+        regions = RegionsBlock();
+        if (!get_regions_from_collection(collection, regions_query, full_overlap, status, regions, msg, reduced_mode)) {
+          EPIDB_LOG_ERR(msg);
+          return false;
+        }
+        return true;
+      }
 
-          threads.push_back(std::move(t));
-          result_parts.push_back(result_part);
+      //
+      // One task for each chromosome, so the largest chromosomes do not hold back
+      // the ones grouped with them. The results keep the order of the chromosomes.
+      //
+      template <typename ChromosomeList>
+      bool get_chromosomes_regions(const std::string &genome, const std::vector<std::string> &chromosomes,
+                                   const mongo::BSONObj &regions_query, const bool full_overlap,
+                                   processing::StatusPtr status, ChromosomeList &results, std::string &msg,
+                                   bool reduced_mode, const ColumnFilter *filter = nullptr)
+      {
+        typedef typename ChromosomeList::value_type::second_type Container;
+
+        std::vector<Container> parts(chromosomes.size());
+        std::vector<std::string> errors(chromosomes.size());
+        std::vector<char> success(chromosomes.size(), false);
+
+        threading::TaskGroup tasks(status->task_limit());
+        for (size_t i = 0; i < chromosomes.size(); ++i) {
+          tasks.spawn([&, i]() {
+            std::string collection = helpers::region_collection_name(genome, chromosomes[i]);
+            success[i] = get_regions_from_collection(collection, regions_query, full_overlap, status, parts[i], errors[i], reduced_mode, filter);
+          });
         }
+        tasks.wait();
 
-        // kill threads
-        size_t thread_count = threads.size();
-        for (size_t i = 0; i < thread_count; ++i) {
-          threads[i].wait();
-          auto result = threads[i].get();
-          if (!std::get<0>(result)) {
-            msg = std::get<1>(result);
+        for (size_t i = 0; i < chromosomes.size(); ++i) {
+          if (!success[i]) {
+            msg = errors[i];
             return false;
           }
         }
 
-        // unite results
-        for (auto &chromosome_regions_pre_result : result_parts) {
-          for (auto &chromosome_regions_list : *chromosome_regions_pre_result) {
-            results.push_back(std::move(chromosome_regions_list));
+        for (size_t i = 0; i < chromosomes.size(); ++i) {
+          if (parts[i].size() > 0) {
+            results.emplace_back(chromosomes[i], std::move(parts[i]));
           }
         }
         return true;
       }
 
+      bool get_regions(const std::string &genome, const std::vector<std::string> &chromosomes,
+                       const mongo::BSONObj &regions_query, const bool full_overlap,
+                       processing::StatusPtr status, ChromosomeRegionsList &results, std::string &msg,
+                       bool reduced_mode, const ColumnFilter *filter)
+      {
+        return get_chromosomes_regions(genome, chromosomes, regions_query, full_overlap, status, results, msg, reduced_mode, filter);
+      }
+
+      bool get_regions(const std::string &genome, const std::vector<std::string> &chromosomes,
+                       const mongo::BSONObj &regions_query, const bool full_overlap,
+                       processing::StatusPtr status, ChromosomeRegionsBlockList &results, std::string &msg,
+                       bool reduced_mode, const ColumnFilter *filter)
+      {
+        return get_chromosomes_regions(genome, chromosomes, regions_query, full_overlap, status, results, msg, reduced_mode, filter);
+      }
+
       bool count_regions(const std::string &genome, const std::string &chromosome, const mongo::BSONObj &regions_query, const bool full_overlap,
                          processing::StatusPtr status, size_t &count)
       {
         std::string collection_name = helpers::region_collection_name(genome, chromosome);
         std::string msg;
-        Regions regions = Regions();
-        if (!get_regions_from_collection(collection_name, regions_query, full_overlap, status, regions, msg, true)) {
+        RegionsCount counter;
+        if (!get_regions_from_collection(collection_name, regions_query, full_overlap, status, counter, msg, true)) {
           EPIDB_LOG_ERR(msg);
           count = 0;
           return false;
         }
-        count = regions.size();
+        count = counter.size();
         return true;
       }
 
-      void count_regions_job(const std::string &genome, const std::shared_ptr<std::vector<std::string> > chromosomes, const mongo::BSONObj &regions_query, const bool full_overlap,
-                             processing::StatusPtr status, std::shared_ptr<std::vector<size_t> > results)
-      {
-        size_t size = 0;
-        for (std::vector<std::string>::const_iterator it = chromosomes->begin(); it != chromosomes->end(); ++it) {
-          std::string collection_name = helpers::region_collection_name(genome, *it);
-          Regions regions = Regions();
-          std::string msg;
-          if (!get_regions_from_collection(collection_name, regions_query, full_overlap, status, regions, msg, true)) {
-            EPIDB_LOG_ERR(msg);
-            return;
-          }
-          size += regions.size();;
-        }
-        results->push_back(size);
-      }
-
       bool count_regions(const std::string &genome, const std::vector<std::string> &chromosomes,
                          const mongo::BSONObj &regions_query, const bool full_overlap,
                          processing::StatusPtr status, size_t &size, std::string &msg)
       {
-        const size_t max_threads = 8;
-        std::vector<boost::thread *> threads;
-        std::vector<std::shared_ptr<std::vector<size_t> > > result_parts;
-
-        size_t chunk_size = ceil(double(chromosomes.size()) / double(max_threads));
-
-        for (size_t i = 0; i < max_threads; ++i) {
-          std::vector<std::string>::const_iterator start = chromosomes.begin() + i * chunk_size;
-          if (start >= chromosomes.end()) {
-            break;
-          }
-          std::vector<std::string>::const_iterator end = start + chunk_size;
-          if (end > chromosomes.end()) {
-            end = chromosomes.end();
-          }
-          std::shared_ptr<std::vector<std::string> > chrs(new std::vector<std::string>(start, end));
-          std::shared_ptr<std::vector<size_t> > result_part(new std::vector<size_t>);
-          boost::thread *t = new boost::thread(&count_regions_job, boost::cref(genome), chrs,
-                                               boost::cref(regions_query), full_overlap, status, result_part);
-          threads.push_back(t);
-          result_parts.push_back(result_part);
-        }
-
-        // kill threads
-        size_t thread_count = threads.size();
-        for (size_t i = 0; i < thread_count; ++i) {
-          threads[i]->join();
-          delete threads[i];
+        std::vector<size_t> counts(chromosomes.size(), 0);
+        std::vector<std::string> errors(chromosomes.size());
+        std::vector<char> success(chromosomes.size(), false);
+
+        threading::TaskGroup tasks(status->task_limit());
+        for (size_t i = 0; i < chromosomes.size(); ++i) {
+          tasks.spawn([&, i]() {
+            std::string collection_name = helpers::region_collection_name(genome, chromosomes[i]);
+            RegionsCount counter;
+            success[i] = get_regions_from_collection(collection_name, regions_query, full_overlap, status, counter, errors[i], true);
+            counts[i] = counter.size();
+          });
         }
+        tasks.wait();
 
         size = 0;
-        std::vector<std::shared_ptr<std::vector<size_t> > >::iterator it;
-        for (it = result_parts.begin(); it != result_parts.end(); ++it) {
-          std::vector<size_t> v = **it;
-          size += std::accumulate(v.begin(), v.end(), 0ll);
+        for (size_t i = 0; i < chromosomes.size(); ++i) {
+          if (!success[i]) {
+            EPIDB_LOG_ERR(errors[i]);
+            msg = errors[i];
+            return false;
+          }
+          size += counts[i];
         }
         return true;
       }
@@ -27,7 +27,10 @@
 
 #include <mongo/bson/bson.h>
 
+#include "../algorithms/filter.hpp"
+
 #include "../datatypes/regions.hpp"
+#include "../datatypes/regions_block.hpp"
 #include "../processing/processing.hpp"
 
 
@@ -35,25 +38,53 @@ namespace epidb {
   namespace dba {
     namespace retrieve {
 
+      //
+      // Filter of a BED column evaluated while the regions are read.
+      // The blocks that the zone map shows without matching regions are not decompressed,
+      // and the regions of the blocks where all regions match are not checked.
+      //
+      struct ColumnFilter {
+        // Short name of the column (KeyMapper)
+        std::string key;
+        algorithms::FilterBuilder::FilterPtr filter;
+        // The column is compared as a number, as its ColumnType is not compatible with strings
+        bool numeric;
+      };
+
       bool get_regions(const std::string &genome, const std::string &chromosome,
                        const mongo::BSONObj &regions_query, const bool full_overlap,
                        processing::StatusPtr status,
                        Regions &regions, std::string &msg,
                        bool reduced_mode = false);
 
+      // Retrieve the regions of one chromosome into the columns of RegionsBlock.
+      bool get_regions(const std::string &genome, const std::string &chromosome,
+                       const mongo::BSONObj &regions_query, const bool full_overlap,
+                       processing::StatusPtr status,
+                       RegionsBlock &regions, std::string &msg,
+                       bool reduced_mode = false);
+
       bool get_regions(const std::string &genome, const std::vector<std::string> &chromosomes,
                        const mongo::BSONObj &regions_query, const bool full_overlap,
                        processing::StatusPtr status,
                        ChromosomeRegionsList &results, std::string &msg,
-                       bool reduced_mode = false);
+                       bool reduced_mode = false, const ColumnFilter *filter = nullptr);
+
+      // Retrieve the regions into the columns of RegionsBlock, without creating the region objects.
+      bool get_regions(const std::string &genome, const std::vector<std::string> &chromosomes,
+                       const mongo::BSONObj &regions_query, const bool full_overlap,
+                       processing::StatusPtr status,
+                       ChromosomeRegionsBlockList &results, std::string &msg,
+                       bool reduced_mode = false, const ColumnFilter *filter = nullptr);
 
       bool count_regions(const std::string &genome, const std::string &chromosome,
                          const mongo::BSONObj &regions_query, const bool full_overlap,
                          processing::StatusPtr status,
                          size_t &count);
 
+      // Count the regions without storing them.
       bool count_regions(const std::string &genome,
-                         std::vector<std::string> &chromosomes,
+                         const std::vector<std::string> &chromosomes,
                          const mongo::BSONObj &regions_query, const bool full_overlap,
                          processing::StatusPtr status,
                          size_t &size, std::string &msg);
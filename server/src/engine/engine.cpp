@@ -18,16 +18,12 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <memory>
 #include <regex>
 #include <string>
 #include <sstream>
 #include <vector>
 
-#include <boost/iostreams/filtering_streambuf.hpp>
-#include <boost/iostreams/copy.hpp>
-#include <boost/iostreams/filter/bzip2.hpp>
-#include <boost/iostreams/stream.hpp>
-
 #include "commands.hpp"
 #include "engine.hpp"
 
@@ -44,6 +40,7 @@
 
 #include "../processing/processing.hpp"
 
+#include "../storage/compression.hpp"
 #include "../storage/storage.hpp"
 
 #include "../log.hpp"
@@ -148,7 +145,7 @@ namespace epidb {
   bool Engine::queue_score_matrix(const datatypes::User& user,
                                   const std::vector<std::pair<std::string, std::string>> &experiments_formats,
                                   const std::string &aggregation_function, const std::string &regions_query_id,
-                                  std::string &id, std::string &msg)
+                                  const std::string &output_format, std::string &id, std::string &msg)
   {
     mongo::BSONObjBuilder bob_formats;
 
@@ -156,7 +153,7 @@ namespace epidb {
       bob_formats.appendElements(BSON(exp_format.first << exp_format.second));
     }
 
-    if (!queue(BSON("command" << "score_matrix" << "experiments_formats" << bob_formats.obj() << "aggregation_function" << aggregation_function << "query_id" << regions_query_id << "user_id" << user.id()), 60 * 60, id, msg)) {
+    if (!queue(BSON("command" << "score_matrix" << "experiments_formats" << bob_formats.obj() << "aggregation_function" << aggregation_function << "query_id" << regions_query_id << "output_format" << output_format << "user_id" << user.id()), 60 * 60, id, msg)) {
       return false;
     }
 
@@ -211,6 +208,47 @@ namespace epidb {
     return true;
   }
 
+  bool Engine::queue_upload(const datatypes::User& user, const std::string &command, const mongo::BSONObj &dataset,
+                            const std::string &data, std::string &id, std::string &msg)
+  {
+    mongo::BSONObjBuilder bob;
+    bob.append("command", command);
+    bob.append("dataset", dataset);
+
+    // The job keeps only the name of the data, stored compressed in the GridFS
+    std::string filename;
+    if (!dataset.hasField("local_file")) {
+      filename = "upload_" + mongo::OID::gen().toString();
+      const storage::Codec codec = storage::get_result_codec();
+      storage::CompressedFileWriter writer(filename, codec);
+      for (size_t pos = 0; pos < data.size(); pos += UPLOAD_PART_SIZE) {
+        writer.write(data.substr(pos, UPLOAD_PART_SIZE));
+      }
+
+      size_t original_size;
+      size_t compressed_size;
+      std::vector<long long> frames;
+      if (!writer.close(original_size, compressed_size, frames, msg)) {
+        return false;
+      }
+
+      bob.append("upload", filename);
+      bob.append("codec", storage::codec_name(codec));
+      bob.append("frames", frames);
+      bob.append("size", (long long) original_size);
+    }
+    bob.append("user_id", user.id());
+
+    if (!queue(bob.obj(), 60 * 60, id, msg)) {
+      if (!filename.empty()) {
+        mdbq::remove_result(filename);
+      }
+      return false;
+    }
+
+    return true;
+  }
+
   bool Engine::queue_get_experiments_by_query(const datatypes::User& user, const std::string &query_id, std::string &request_id, std::string &msg)
   {
     if (!queue(BSON("command" << "get_experiments_by_query" << "query_id" << query_id << "user_id" << user.id()), 60 * 60, request_id, msg)) {
@@ -243,6 +281,8 @@ namespace epidb {
     job.status = status;
 
     job.create_time = mdbq::Hub::get_create_time(o);
+    job.job_class = mdbq::Hub::class_name(mdbq::Hub::get_class(o));
+    job.wait_time = mdbq::Hub::get_wait_time(o);
     if (status.state == mdbq::Hub::state_name(mdbq::TS_DONE)) {
       job.finish_time = mdbq::Hub::get_finish_time(o);
     }
@@ -250,7 +290,9 @@ namespace epidb {
     const mongo::BSONObj &misc = mdbq::Hub::get_misc(o);
     job.command = misc["command"].String();
     job.user_id = misc["user_id"].String();
-    job.query_id = misc["query_id"].String();
+    if (misc.hasElement("query_id")) {
+      job.query_id = misc["query_id"].String();
+    }
 
     if (misc.hasElement("format")) {
       job.misc["format"] = misc["format"].String();
@@ -268,6 +310,23 @@ namespace epidb {
       }
     }
 
+    if (misc.hasElement("dataset")) {
+      const mongo::BSONObj& dataset = misc["dataset"].Obj();
+      job.misc["name"] = dataset["name"].String();
+      job.misc["format"] = dataset["format"].String();
+    }
+
+    if (misc.hasElement("size")) {
+      job.misc["size"] = utils::long_to_string(misc["size"].numberLong());
+    }
+
+    if (o.hasField("progress")) {
+      const mongo::BSONObj& progress = o["progress"].Obj();
+      job.misc["progress"] = progress["step"].String() + ": " +
+                             utils::long_to_string(progress["done"].numberLong()) + " of " +
+                             utils::long_to_string(progress["total"].numberLong());
+    }
+
     job._id = mdbq::Hub::get_id(o);
 
     return job;
@@ -322,8 +381,46 @@ namespace epidb {
     return true;
   }
 
+  // Codec and frames of a stored result, the results stored before the codecs are a single bzip2 stream
+  static bool result_codec(const mongo::BSONObj &result, storage::Codec &codec, std::vector<long long> &frames, std::string &msg)
+  {
+    codec = storage::CODEC_BZIP2;
+    if (result.hasField("__codec__") && !storage::codec_from_name(result["__codec__"].str(), codec, msg)) {
+      return false;
+    }
+    if (result.hasField("__frames__")) {
+      for (const mongo::BSONElement &e : result["__frames__"].Array()) {
+        frames.push_back(e.numberLong());
+      }
+    }
+    return true;
+  }
+
+  bool Engine::request_download_file(const datatypes::User& user, const std::string & request_id,
+                                     std::string &file_name, storage::Codec &codec, std::string& msg)
+  {
+    if (!check_request(user, request_id, msg)) {
+      return false;
+    }
+
+    mongo::BSONObj o = _hub.get_job(request_id);
+    mongo::BSONObj result = o["result"].Obj();
+
+    if (!result.hasField("__file__")) {
+      msg = "Request ID " + request_id + " does not contain a file has result.";
+      return false;
+    }
+
+    std::vector<long long> frames;
+    if (!result_codec(result, codec, frames, msg)) {
+      return false;
+    }
+    file_name = result["__file__"].str();
+    return true;
+  }
+
   bool Engine::request_download_data(const datatypes::User& user, const std::string & request_id,
-                                     std::string &request_data, std::string& msg)
+                                     std::string &request_data, bool &compressed, std::string& msg)
   {
     if (!check_request(user, request_id, msg)) {
       return false;
@@ -334,9 +431,25 @@ namespace epidb {
 
     if (result.hasField("__file__")) {
       std::string file_name = result["__file__"].str();
-      std::string file_content;
+      storage::Codec codec;
+      std::vector<long long> frames;
+      if (!result_codec(result, codec, frames, msg)) {
+        return false;
+      }
+
       // Get compressed file from mongo filesystem
-      return storage::load(file_name, request_data, msg);
+      if (codec == storage::CODEC_BZIP2) {
+        compressed = true;
+        return storage::load(file_name, request_data, msg);
+      }
+
+      // The LZO frames are not a format known by the users
+      std::string file_content;
+      if (!storage::load(file_name, file_content, msg)) {
+        return false;
+      }
+      compressed = false;
+      return storage::decompress(file_content, codec, frames, request_data, msg);
     }
 
     msg = "Request ID " + request_id + " does not contain a file has result.";
@@ -361,25 +474,29 @@ namespace epidb {
       return true;
     }
 
+    if (result.hasField("__binary__")) {
+      request_data.add_error("The result of the request " + request_id + " is binary. Download it with /download?r_id=" + request_id + "&key=USER_KEY");
+      return false;
+    }
+
     if (result.hasField("__file__")) {
-      std::string file_name = result["__file__"].str();
-      std::string file_content;
-      // Get compressed file from mongo filesystem
-      if (!storage::load(file_name, file_content, msg)) {
+      storage::Codec codec;
+      std::vector<long long> frames;
+      if (!result_codec(result, codec, frames, msg)) {
         request_data.add_error(msg);
         return false;
       }
 
-      // uncompress
-      std::istringstream inStream(file_content, std::ios::binary);
-      std::stringstream outStream;
-      boost::iostreams::filtering_streambuf< boost::iostreams::input> in;
-      in.push( boost::iostreams::bzip2_decompressor());
-      in.push( inStream );
-      // copy output
-      boost::iostreams::copy(in, outStream);
+      // The file is read and decompressed by parts while the response is sent
+      auto reader = std::make_shared<storage::DecompressedFileReader>(codec, frames);
+      if (!reader->open(result["__file__"].str(), msg)) {
+        request_data.add_error(msg);
+        return false;
+      }
 
-      request_data.add_string_content(outStream.str());
+      request_data.add_string_content([reader](std::string &part, std::string &msg) {
+        return reader->next(part, msg);
+      });
       return true;
     }
 
@@ -396,6 +513,13 @@ namespace epidb {
   bool Engine::reprocess_request(const datatypes::User& user, const std::string & request_id, std::string & msg)
   {
     mongo::BSONObj o = _hub.get_job(request_id);
+
+    // The data of an upload is removed once it is inserted
+    if (o["misc"].Obj().hasField("upload") && o["state"].numberInt() == mdbq::TS_DONE) {
+      msg = "The request " + request_id + " uploaded a dataset that was already inserted. It can not be reprocessed.";
+      return false;
+    }
+
     return _hub.reprocess_job(o);
   }
 
@@ -28,6 +28,8 @@
 
 #include "../mdbq/hub.hpp"
 
+#include "../storage/compression.hpp"
+
 #include "../log.hpp"
 
 namespace epidb {
@@ -38,6 +40,9 @@ namespace epidb {
   private:
     mdbq::Hub _hub;
 
+    // Size of the parts of the uploaded data given to the compression
+    static const size_t UPLOAD_PART_SIZE = 1024 * 1024;
+
     Engine();
     Engine(Engine const &);
     void operator=(Engine const &);
@@ -77,7 +82,12 @@ namespace epidb {
 
     bool check_request(const datatypes::User& user, const std::string & request_id, std::string& msg);
 
-    bool request_download_data(const datatypes::User& user, const std::string & request_id, std::string &request_data, std::string& msg);
+    bool request_download_data(const datatypes::User& user, const std::string & request_id, std::string &request_data, bool &compressed, std::string& msg);
+
+    /*
+    * \brief Get the name and codec of the file with the request result
+    */
+    bool request_download_file(const datatypes::User& user, const std::string & request_id, std::string &file_name, storage::Codec &codec, std::string& msg);
 
     bool reprocess_request(const datatypes::User& user, const std::string & request_id, std::string & msg);
 
@@ -95,7 +105,7 @@ namespace epidb {
 
     bool queue_get_regions(const datatypes::User& user, const std::string &query_id, const std::string &output_format, std::string &id, std::string &msg);
 
-    bool queue_score_matrix(const datatypes::User& user, const std::vector<std::pair<std::string, std::string>> &experiments_formats, const std::string &aggregation_function, const std::string &regions_query_id, std::string &request_id, std::string &msg);
+    bool queue_score_matrix(const datatypes::User& user, const std::vector<std::pair<std::string, std::string>> &experiments_formats, const std::string &aggregation_function, const std::string &regions_query_id, const std::string &output_format, std::string &request_id, std::string &msg);
 
     bool queue_lola(const datatypes::User& user, const std::string& query_id, const std::string& universe_query_id, const std::unordered_map<std::string, std::vector<std::pair<std::string, std::string>>> &databases, const std::string& genome, std::string &id, std::string &msg);
 
@@ -103,6 +113,13 @@ namespace epidb {
 
     bool queue_region_enrich_fast(const datatypes::User& user, const std::string& query_id, const mongo::BSONObj &query, std::string &id, std::string &msg);
 
+    /*
+    * \brief Queue the insertion of the dataset of an add_experiment or add_annotation.
+    *         The data is stored for the job, unless the dataset has a local_file.
+    */
+    bool queue_upload(const datatypes::User& user, const std::string &command, const mongo::BSONObj &dataset,
+                      const std::string &data, std::string &id, std::string &msg);
+
     /*
     * \brief Returns whether given user owns given request
     * \return False also if request_id or user_id do not exist
@@ -26,11 +26,6 @@
 #include <boost/asio.hpp>
 #include <boost/thread.hpp>
 
-#include <boost/iostreams/filtering_streambuf.hpp>
-#include <boost/iostreams/copy.hpp>
-#include <boost/iostreams/filter/bzip2.hpp>
-#include <boost/iostreams/stream.hpp>
-
 #include <mongo/client/dbclient.h>
 
 #include "../config/config.hpp"
@@ -43,12 +38,18 @@
 #include "../extras/stringbuilder.hpp"
 #include "../extras/utils.hpp"
 
+#include "../mdbq/cleaner.hpp"
 #include "../mdbq/client.hpp"
+#include "../mdbq/hub.hpp"
 #include "../mdbq/janitor.hpp"
 
 
 #include "../processing/processing.hpp"
 
+#include "../storage/compression.hpp"
+
+#include "../threading/executor.hpp"
+
 #include "../errors.hpp"
 #include "../log.hpp"
 
@@ -57,6 +58,9 @@
 namespace epidb {
   namespace engine {
 
+    // The handlers are woken up by the requests queued here, the polling finds the others.
+    const float POLL_INTERVAL = 5;
+
     QueueHandler::QueueHandler(size_t id, std::string &url, std::string &prefix) :
       mdbq::Client(url, prefix),
       _id(id) {}
@@ -64,8 +68,7 @@ namespace epidb {
     void QueueHandler::run()
     {
       EPIDB_LOG_TRACE("Starting QueueHandler - " << utils::integer_to_string(_id));
-      this->reg(ios, 1);
-      ios.run();
+      this->serve(POLL_INTERVAL);
     }
 
     void QueueHandler::handle_task(const std::string& id, const mongo::BSONObj &o)
@@ -106,9 +109,24 @@ namespace epidb {
       finish(result, success);
     }
 
+    // Priority of the request tasks in the executor, from the job class:
+    // the long analyses do not delay the short requests.
+    static threading::Priority job_priority(const mongo::BSONObj &job)
+    {
+      switch (mdbq::Hub::job_class(job)) {
+      case mdbq::JC_INTERACTIVE:
+        return threading::PRIORITY_HIGH;
+      case mdbq::JC_HEAVY:
+        return threading::PRIORITY_LOW;
+      default:
+        return threading::PRIORITY_NORMAL;
+      }
+    }
+
     bool QueueHandler::process(const datatypes::User &user, const mongo::BSONObj &job, processing::StatusPtr status, mongo::BSONObj& result)
     {
       std::string command = job["command"].str();
+      status->task_limit()->set_priority(job_priority(job));
 
       if (command == "count_regions") {
         return process_count(user, job["query_id"].str(), status, result);
@@ -120,7 +138,9 @@ namespace epidb {
         return process_get_regions(user, job["query_id"].str(), job["format"].str(), status, result);
       }
       if (command == "score_matrix") {
-        return process_score_matrix(user, job["experiments_formats"].Obj(), job["aggregation_function"].str(), job["query_id"].str(), status, result);
+        // Jobs queued without an output format produce text
+        std::string output_format = job.hasField("output_format") ? job["output_format"].str() : processing::SCORE_MATRIX_TEXT;
+        return process_score_matrix(user, job["experiments_formats"].Obj(), job["aggregation_function"].str(), job["query_id"].str(), output_format, status, result);
       }
       if (command == "get_experiments_by_query") {
         return process_get_experiments_by_query(user, job["query_id"].str(), status, result);
@@ -139,6 +159,9 @@ namespace epidb {
       }
       if (command == "enrich_regions_fast") {
         return process_enrich_regions_fast(user, job["query_id"].str(), job["experiments_query"].Obj(), status, result);
+      }
+      if (command == "add_experiment" || command == "add_annotation") {
+        return process_upload(user, job, status, result);
 
       } else {
         mongo::BSONObjBuilder bob;
@@ -360,6 +383,28 @@ namespace epidb {
       return true;
     }
 
+    // Finish the result file and describe it in the request result
+    static bool store_compressed_result(const std::string &filename, storage::CompressedFileWriter &writer,
+                                        processing::StatusPtr status, mongo::BSONObjBuilder &bob, std::string &msg)
+    {
+      size_t original_size;
+      size_t compressed_size;
+      std::vector<long long> frames;
+      if (!writer.close(original_size, compressed_size, frames, msg)) {
+        return false;
+      }
+
+      bob.append("__file__", filename);
+      bob.append("__original_size__", (long long) original_size);
+      bob.append("__compressed_size__", (long long) compressed_size);
+      bob.append("__codec__", storage::codec_name(storage::get_result_codec()));
+      bob.append("__frames__", frames);
+
+      status->set_total_stored_data(original_size);
+      status->set_total_stored_data_compressed(compressed_size);
+      return true;
+    }
+
     bool QueueHandler::process_get_regions(const datatypes::User &user,
                                            const std::string &query_id, const std::string &format,
 
@@ -367,39 +412,30 @@ namespace epidb {
     {
 
       std::string msg;
-      StringBuilder sb;
       mongo::BSONObjBuilder bob;
 
+      // The output is compressed and stored while it is formatted
+      std::string filename = result_filename();
+      storage::CompressedFileWriter writer(filename, storage::get_result_codec());
+      StringBuilder sb([&writer](std::string && block) {
+        writer.write(std::move(block));
+      });
+
       if (!processing::get_regions(user, query_id, format, status, sb, msg)) {
         bob.append("__error__", msg);
         result = bob.obj();
         return false;
       }
-
-      status->start_operation(processing::BUILDING_OUTPUT,
-                              BSON("string_builder_size" << (long long) sb.size()));
-
-      std::string result_string = sb.to_string();
+      sb.flush();
 
       status->start_operation(processing::COMPRESSING_OUTPUT,
-                              BSON("string_size" << (long long) result_string.size()));
-      std::stringbuf inStream(std::move(result_string));
-      std::stringbuf outStream;
-      boost::iostreams::filtering_streambuf< boost::iostreams::input> in;
-      in.push( boost::iostreams::bzip2_compressor());
-      in.push( inStream );
-      boost::iostreams::copy(in, outStream);
-
-      std::string compressed_s = outStream.str();
-      const char* compressed = compressed_s.data();
-
-      std::string filename = store_result(compressed, compressed_s.size());
-      bob.append("__file__", filename);
-      bob.append("__original_size__", (long long) result_string.size());
-      bob.append("__compressed_size__", (long long) compressed_s.size());
+                              BSON("string_size" << (long long) sb.size()));
 
-      status->set_total_stored_data(result_string.size());
-      status->set_total_stored_data_compressed(compressed_s.size());
+      if (!store_compressed_result(filename, writer, status, bob, msg)) {
+        bob.append("__error__", msg);
+        result = bob.obj();
+        return false;
+      }
 
       result = bob.obj();
 
@@ -412,6 +448,7 @@ namespace epidb {
 
     bool QueueHandler::process_score_matrix(const datatypes::User &user,
                                             const mongo::BSONObj &experiments_formats_bson, const std::string &aggregation_function, const std::string &regions_query_id,
+                                            const std::string &output_format,
                                             processing::StatusPtr status, mongo::BSONObj& result)
     {
       std::string msg;
@@ -428,32 +465,29 @@ namespace epidb {
         experiments_formats.emplace_back(experiment_name, columns_name);
       }
 
-      StringBuilder sb;
-      if (!processing::score_matrix(user, experiments_formats, aggregation_function, regions_query_id, status, sb, msg)) {
+      std::string filename = result_filename();
+      storage::CompressedFileWriter writer(filename, storage::get_result_codec());
+      StringBuilder sb([&writer](std::string && block) {
+        writer.write(std::move(block));
+      });
+
+      if (!processing::score_matrix(user, experiments_formats, aggregation_function, regions_query_id, output_format, status, sb, msg)) {
         bob.append("__error__", msg);
         result = bob.obj();
         return false;
       }
+      sb.flush();
 
-      std::string matrix = sb.to_string();
-      size_t matrix_size = matrix.size();
-      std::stringbuf inStream(std::move(matrix));
-      std::stringbuf outStream;
-      boost::iostreams::filtering_streambuf< boost::iostreams::input> in;
-      in.push( boost::iostreams::bzip2_compressor());
-      in.push( inStream );
-      boost::iostreams::copy(in, outStream);
-
-      std::string compressed_s = outStream.str();
-      const char* compressed = compressed_s.data();
-
-      std::string filename = store_result(compressed, compressed_s.size());
-      bob.append("__file__", filename);
-      bob.append("__original_size__", (long long) matrix_size);
-      bob.append("__compressed_size__", (long long) compressed_s.size());
+      // Only downloaded, it can not be sent in the XML-RPC responses
+      if (output_format == processing::SCORE_MATRIX_BINARY) {
+        bob.append("__binary__", true);
+      }
 
-      status->set_total_stored_data(matrix_size);
-      status->set_total_stored_data_compressed(compressed_s.size());
+      if (!store_compressed_result(filename, writer, status, bob, msg)) {
+        bob.append("__error__", msg);
+        result = bob.obj();
+        return false;
+      }
 
       result = bob.obj();
 
@@ -464,6 +498,27 @@ namespace epidb {
       return true;
     }
 
+    bool QueueHandler::process_upload(const datatypes::User &user, const mongo::BSONObj &job,
+                                      processing::StatusPtr status, mongo::BSONObj& result)
+    {
+      std::string msg;
+      std::string id;
+      // The uploaded data of a failed upload is kept for its reprocessing,
+      // it is removed with the request (see mdbq::remove_request_data)
+      if (!processing::upload_dataset(user, job, status, id, msg)) {
+        result = BSON("__error__" << msg);
+        return false;
+      }
+
+      // The uploaded data is not used after the dataset is inserted
+      if (job.hasField("upload")) {
+        mdbq::remove_result(job["upload"].str());
+      }
+
+      result = BSON("id" << id);
+      return true;
+    }
+
     bool QueueHandler::process_get_experiments_by_query(const datatypes::User &user,
         const std::string &query_id,
         processing::StatusPtr status, mongo::BSONObj& result)
@@ -512,8 +567,6 @@ namespace epidb {
 
     void queue_processer_run(size_t num)
     {
-      boost::asio::io_service io;
-
       std::string server = config::get_mongodb_server();
       std::string collection = config::DATABASE_NAME();
 
@@ -21,8 +21,6 @@
 #ifndef EPIDB_ENGINE_QUEUE_PROCESSER_HPP
 #define EPIDB_ENGINE_QUEUE_PROCESSER_HPP
 
-#include <boost/asio.hpp>
-
 #include "../mdbq/client.hpp"
 #include "../processing/processing.hpp"
 
@@ -35,7 +33,6 @@ namespace epidb {
     void queue_processer_run(size_t num);
     class QueueHandler : public mdbq::Client {
     public:
-      boost::asio::io_service ios;
       size_t _id;
       QueueHandler(size_t id, std::string &url, std::string &prefix);
       void handle_task(const std::string& _id, const mongo::BSONObj &o);
@@ -64,6 +61,7 @@ namespace epidb {
 
       bool process_score_matrix(const datatypes::User &user, const mongo::BSONObj &experiments_formats,
                                 const std::string &aggregation_function, const std::string &regions_query_id,
+                                const std::string &output_format,
                                 processing::StatusPtr status, mongo::BSONObj& result);
 
       bool process_get_experiments_by_query(const datatypes::User &user, const std::string &query_id,
@@ -77,6 +75,9 @@ namespace epidb {
                                   const std::string &query_id, const mongo::BSONObj &experiments_query,
                                   processing::StatusPtr status, mongo::BSONObj& result);
 
+      bool process_upload(const datatypes::User &user, const mongo::BSONObj &job,
+                          processing::StatusPtr status, mongo::BSONObj& result);
+
       bool is_canceled(processing::StatusPtr status, std::string& msg);
     };
   }
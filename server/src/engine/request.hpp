@@ -46,6 +46,11 @@ namespace epidb {
       */
       boost::posix_time::ptime finish_time;
       std::string query_id;
+      std::string job_class;
+      /*
+      * \brief Seconds waited in the queue
+      */
+      long wait_time;
     } Job;
   }
 }
@@ -18,27 +18,129 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 
-#include <algorithm> // for min and max
-#include <boost/math/distributions/hypergeometric.hpp>
-using namespace boost::math;
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include <unordered_map>
+
+#include "math.hpp"
 
 namespace epidb {
   namespace math {
+
+    // Relative rounding error of each ratio between neighbour terms
+    static const double STEP_ROUNDING = 4 * DBL_EPSILON;
+
+    // The sums stop when the terms are this far below the p-value
+    static const double STOP_PRECISION = DBL_EPSILON * 1e-3;
+
+    // Tables memoized by each thread
+    static const size_t MEMO_SIZE = 64 * 1024;
+
+    struct Table {
+      unsigned a;
+      unsigned b;
+      unsigned c;
+      unsigned d;
+
+      bool operator==(const Table &other) const
+      {
+        return a == other.a && b == other.b && c == other.c && d == other.d;
+      }
+    };
+
+    struct TableHash {
+      size_t operator()(const Table &t) const
+      {
+        size_t h = std::hash<unsigned>()(t.a);
+        h = h * 31 + std::hash<unsigned>()(t.b);
+        h = h * 31 + std::hash<unsigned>()(t.c);
+        return h * 31 + std::hash<unsigned>()(t.d);
+      }
+    };
+
+    static double hypergeometric_two_sided(unsigned a, unsigned b, unsigned c, unsigned d)
+    {
+      // c of the n draws are from the r marked items of the N total
+      const double N = (double) a + b + c + d;
+      const double r = (double) a + c;
+      const double n = (double) c + d;
+      const double x = c;
+      const double min_k = std::max(0.0, r + n - N);
+      const double max_k = std::min(r, n);
+
+      // Ratio between the terms k + 1 and k
+      auto up = [&](const double k) {
+        return ((r - k) * (n - k)) / ((k + 1) * (N - r - n + k + 1));
+      };
+
+      const double mode = std::min(max_k, std::max(min_k, std::floor((n + 1) * (r + 1) / (N + 2))));
+
+      // The term of the table, relative to the mode
+      double term_x = 1.0;
+      for (double k = mode; k < x && term_x > 0.0; k++) {
+        term_x *= up(k);
+      }
+      for (double k = mode; k > x && term_x > 0.0; k--) {
+        term_x /= up(k - 1);
+      }
+      // Below the smallest double, as the sum of the previous implementation
+      if (term_x == 0.0) {
+        return 0.0;
+      }
+      // The terms not above the term of the table are summed, as the previous implementation.
+      // The tolerance is only the rounding of the walk from the mode, so the exact ties,
+      // as the mirrored tables of symmetric margins, are summed as ties.
+      const double cutoff = term_x * (1 + 2 * STEP_ROUNDING * (std::abs(x - mode) + 1));
+
+      double total = 1.0;
+      double p = 1.0 <= cutoff ? 1.0 : 0.0;
+
+      double term = 1.0;
+      for (double k = mode; k < max_k; k++) {
+        term *= up(k);
+        total += term;
+        if (term <= cutoff) {
+          p += term;
+          if (term < p * STOP_PRECISION || term == 0.0) {
+            break;
+          }
+        }
+      }
+
+      term = 1.0;
+      for (double k = mode; k > min_k; k--) {
+        term /= up(k - 1);
+        total += term;
+        if (term <= cutoff) {
+          p += term;
+          if (term < p * STOP_PRECISION || term == 0.0) {
+            break;
+          }
+        }
+      }
+
+      return std::min(1.0, p / total);
+    }
+
     double fisher_test(unsigned a, unsigned b, unsigned c, unsigned d)
     {
-      unsigned N = a + b + c + d;
-      unsigned r = a + c;
-      unsigned n = c + d;
-      unsigned max_for_k = std::min(r, n);
-      unsigned min_for_k = (unsigned) std::max(0, int(r + n - N));
-      hypergeometric_distribution<> hgd(r, n, N);
-      double cutoff = pdf(hgd, c);
-      double tmp_p = 0.0;
-      for(unsigned k = min_for_k; k < max_for_k + 1; k++) {
-        double p = pdf(hgd, k);
-        if(p <= cutoff) tmp_p += p;
-      }
-      return tmp_p;
+      static thread_local std::unordered_map<Table, double, TableHash> memo;
+
+      const Table table = { a, b, c, d };
+      auto it = memo.find(table);
+      if (it != memo.end()) {
+        return it->second;
+      }
+
+      if (memo.size() >= MEMO_SIZE) {
+        memo.clear();
+      }
+
+      double p = hypergeometric_two_sided(a, b, c, d);
+      memo.emplace(table, p);
+      return p;
     }
   }
 }
@@ -23,6 +23,12 @@
 
 namespace epidb {
   namespace math {
+    //
+    // Two sided Fisher exact test of the table [[a, b], [c, d]]: the probability of the
+    // tables with the same margins that are not more likely than it.
+    // The hypergeometric terms are computed relative to the mode, each one from the ratio
+    // to its neighbour, until they are below the precision of the result.
+    //
     double fisher_test(unsigned a, unsigned b, unsigned c, unsigned d);
   }
 }
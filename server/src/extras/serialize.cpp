@@ -110,7 +110,7 @@ namespace epidb {
     Parameter::Parameter() {}
     Parameter::~Parameter() {}
 
-    bool Parameter::set_value(const std::string &v)
+    bool Parameter::set_value(std::string v)
     {
       return false;
     }
@@ -190,6 +190,70 @@ namespace epidb {
       return type() == DATABIN;
     }
 
+    const std::string Parameter::get_xml() const
+    {
+      XmlWriter writer(*this);
+      std::string xml;
+      std::string part;
+      std::string msg;
+      while (!writer.done() && writer.next(part, msg)) {
+        xml += part;
+      }
+      return xml;
+    }
+
+    XmlCursor::~XmlCursor()
+    { }
+
+    class IndexCursor : public XmlCursor {
+     private:
+      const Parameter& param_;
+      size_t child_;
+
+     public:
+      explicit IndexCursor(const Parameter& param) :
+        param_(param), child_(0)
+      { }
+
+      const Parameter* next(std::string& out)
+      {
+        if (child_ == param_.xml_children()) {
+          return nullptr;
+        }
+        return &param_.xml_child(child_++, out);
+      }
+    };
+
+    XmlCursorPtr Parameter::xml_cursor() const
+    {
+      return XmlCursorPtr(new IndexCursor(*this));
+    }
+
+    size_t Parameter::xml_children() const
+    {
+      return 0;
+    }
+
+    const Parameter &Parameter::xml_child(const size_t i, std::string &out) const
+    {
+      return *this;
+    }
+
+    void Parameter::xml_child_end(std::string &out) const
+    {
+      //
+    }
+
+    ContentReader Parameter::xml_content() const
+    {
+      return ContentReader();
+    }
+
+    void Parameter::xml_close(std::string &out) const
+    {
+      //
+    }
+
     const std::string Parameter::as_string() const
     {
       return value();
@@ -261,9 +325,9 @@ namespace epidb {
       type_ = type;
     }
 
-    bool SimpleParameter::set_value(const std::string &v)
+    bool SimpleParameter::set_value(std::string v)
     {
-      value_ = v;
+      value_ = std::move(v);
       return true;
     }
 
@@ -278,16 +342,41 @@ namespace epidb {
       return value_;
     }
 
-    const std::string SimpleParameter::get_xml() const
+    void SimpleParameter::xml_open(std::string &out) const
     {
-      std::stringstream ss;
-      std::string ts = xmlrpc::type_string(to_xml_type(type_));
-      ss << "<value>";
-      ss << "<" << ts << ">";
-      ss << value_;
-      ss << "</" << ts << ">";
-      ss << "</value>";
-      return ss.str();
+      const std::string ts = xmlrpc::type_string(to_xml_type(type_));
+      out.append("<value><").append(ts).append(">");
+      out.append(value_);
+      out.append("</").append(ts).append("></value>");
+    }
+
+    ContentParameter::ContentParameter(ContentReader reader) :
+      reader_(std::move(reader))
+    {}
+
+    Type ContentParameter::type() const
+    {
+      return DATASTRING;
+    }
+
+    const std::string ContentParameter::value() const
+    {
+      return std::string();
+    }
+
+    void ContentParameter::xml_open(std::string &out) const
+    {
+      out.append("<value><string>");
+    }
+
+    ContentReader ContentParameter::xml_content() const
+    {
+      return reader_;
+    }
+
+    void ContentParameter::xml_close(std::string &out) const
+    {
+      out.append("</string></value>");
     }
 
     ListParameter::ListParameter() {}
@@ -322,21 +411,29 @@ namespace epidb {
       return ss.str();
     }
 
-    const std::string ListParameter::get_xml() const
+    void ListParameter::xml_open(std::string &out) const
     {
-      std::stringstream ss;
-      ss << "<value>";
-      ss << "<array>";
-      ss << "<data>" << std::endl;
-      // add array content
-      std::vector<ParameterPtr>::const_iterator it;
-      for (it = array_.begin(); it != array_.end(); ++it) {
-        ss << (*it)->get_xml() << std::endl;
-      }
-      ss << "</data>";
-      ss << "</array>";
-      ss << "</value>";
-      return ss.str();
+      out.append("<value><array><data>\n");
+    }
+
+    size_t ListParameter::xml_children() const
+    {
+      return array_.size();
+    }
+
+    const Parameter &ListParameter::xml_child(const size_t i, std::string &out) const
+    {
+      return *array_[i];
+    }
+
+    void ListParameter::xml_child_end(std::string &out) const
+    {
+      out.append("\n");
+    }
+
+    void ListParameter::xml_close(std::string &out) const
+    {
+      out.append("</data></array></value>");
     }
 
     bool ListParameter::add_child(const ParameterPtr &p)
@@ -404,34 +501,60 @@ namespace epidb {
       return ss.str();
     }
 
-    const std::string MapParameter::get_xml() const
+    void MapParameter::xml_open(std::string &out) const
     {
-      std::stringstream ss;
-      ss << "<value>";
-      ss << "<struct>" << std::endl;
+      out.append("<value><struct>\n");
+    }
 
-      if (ordered_) {
-        // add array content
-        std::vector<std::string>::const_iterator it;
-        for (it = key_order_.begin(); it != key_order_.end(); ++it) {
-          ss << "<member>";
-          ss << "<name>" << *it << "</name>";
-          ss << (*(const_cast<std::map<std::string, ParameterPtr> *>(&map_)))[*it]->get_xml();
-          ss << "</member>" << std::endl;
+    // The members in the order of their insertion, or of their keys when the map is not ordered
+    class MapCursor : public XmlCursor {
+     private:
+      const std::map<std::string, ParameterPtr>& map_;
+      const std::vector<std::string>* key_order_;
+      std::map<std::string, ParameterPtr>::const_iterator member_;
+      std::vector<std::string>::const_iterator key_;
+
+     public:
+      MapCursor(const std::map<std::string, ParameterPtr>& map, const std::vector<std::string>* key_order) :
+        map_(map), key_order_(key_order), member_(map.begin())
+      {
+        if (key_order_) {
+          key_ = key_order_->begin();
         }
-      } else {
+      }
+
+      const Parameter* next(std::string& out)
+      {
         std::map<std::string, ParameterPtr>::const_iterator it;
-        for (it = map_.begin(); it != map_.end(); ++it) {
-          ss << "<member>";
-          ss << "<name>" << it->first << "</name>";
-          ss << it->second->get_xml();
-          ss << "</member>" << std::endl;
+        if (key_order_) {
+          if (key_ == key_order_->end()) {
+            return nullptr;
+          }
+          it = map_.find(*key_++);
+        } else {
+          if (member_ == map_.end()) {
+            return nullptr;
+          }
+          it = member_++;
         }
+        out.append("<member><name>").append(it->first).append("</name>");
+        return it->second.get();
       }
+    };
 
-      ss << "</struct>";
-      ss << "</value>";
-      return ss.str();
+    XmlCursorPtr MapParameter::xml_cursor() const
+    {
+      return XmlCursorPtr(new MapCursor(map_, ordered_ ? &key_order_ : nullptr));
+    }
+
+    void MapParameter::xml_child_end(std::string &out) const
+    {
+      out.append("</member>\n");
+    }
+
+    void MapParameter::xml_close(std::string &out) const
+    {
+      out.append("</struct></value>");
     }
 
     bool MapParameter::add_child(const std::string &key, const ParameterPtr &p)
@@ -467,6 +590,63 @@ namespace epidb {
     }
 
 
+    XmlWriter::XmlWriter(const Parameter &root) :
+      root_(root), started_(false)
+    {}
+
+    XmlWriter::XmlWriter(ParameterPtr root) :
+      root_owner_(root), root_(*root), started_(false)
+    {}
+
+    void XmlWriter::push(const Parameter &param, std::string &out)
+    {
+      param.xml_open(out);
+      content_ = param.xml_content();
+      stack_.push_back(Frame{&param, param.xml_cursor()});
+    }
+
+    bool XmlWriter::next(std::string &part, std::string &msg)
+    {
+      part.clear();
+      if (!started_) {
+        started_ = true;
+        push(root_, part);
+      }
+
+      std::string data;
+      while (part.size() < PART_SIZE && !done()) {
+        if (content_) {
+          if (!content_(data, msg)) {
+            return false;
+          }
+          if (data.empty()) {
+            content_ = ContentReader();
+          } else {
+            utils::escape_xml(data.data(), data.size(), part);
+          }
+          continue;
+        }
+
+        Frame &frame = stack_.back();
+        const Parameter *child = frame.children->next(part);
+        if (child) {
+          push(*child, part);
+        } else {
+          frame.param->xml_close(part);
+          stack_.pop_back();
+          if (!stack_.empty()) {
+            stack_.back().param->xml_child_end(part);
+          }
+        }
+      }
+      return true;
+    }
+
+    bool XmlWriter::done() const
+    {
+      return started_ && stack_.empty() && !content_;
+    }
+
     Parameters::Parameters() : as_array_(false) {}
 
     const std::vector<ParameterPtr> Parameters::get() const
@@ -544,10 +724,9 @@ namespace epidb {
       params_.push_back(ParameterPtr(new SimpleParameter(STRING, value)));
     }
 
-    void Parameters::add_string_content(std::string&& content)
+    void Parameters::add_string_content(ContentReader reader)
     {
-      // TODO: In fact, read the file content only when build the xml response.
-      params_.push_back(ParameterPtr(new SimpleParameter(STRING, std::move(content))));
+      params_.push_back(ParameterPtr(new ContentParameter(std::move(reader))));
     }
 
     void Parameters::add_int(size_t i)
@@ -21,6 +21,7 @@
 #ifndef EPIDB_EXTRAS_SERIALIZE_HPP_
 #define EPIDB_EXTRAS_SERIALIZE_HPP_
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <map>
@@ -46,17 +47,44 @@ namespace epidb {
 
     std::string type_name(const Type t);
 
+    // Reads a content by parts. The part is empty at the end of the content.
+    typedef std::function<bool(std::string& part, std::string& msg)> ContentReader;
+
+    class Parameter;
+
+    // Position of the XmlWriter in the children of a parameter
+    class XmlCursor {
+     public:
+      virtual ~XmlCursor();
+
+      // The next child, with its prefix in out, or nullptr after the last one
+      virtual const Parameter* next(std::string& out) = 0;
+    };
+
+    typedef std::unique_ptr<XmlCursor> XmlCursorPtr;
+
     class Parameter {
      public:
 
       explicit Parameter();
       virtual ~Parameter();
 
-      virtual const std::string get_xml() const = 0;
+      const std::string get_xml() const;
+
+      // The XML by parts, for the XmlWriter: the opening, the children with their
+      // prefix and suffix, the content read by parts and the closing.
+      // The children are walked by the cursor, that indexes them by default.
+      virtual void xml_open(std::string& out) const = 0;
+      virtual XmlCursorPtr xml_cursor() const;
+      virtual size_t xml_children() const;
+      virtual const Parameter& xml_child(const size_t i, std::string& out) const;
+      virtual void xml_child_end(std::string& out) const;
+      virtual ContentReader xml_content() const;
+      virtual void xml_close(std::string& out) const;
 
       virtual Type type() const = 0;
 
-      virtual bool set_value(const std::string& v);
+      virtual bool set_value(std::string v);
 
       virtual void set_type(Type type);
 
@@ -115,11 +143,33 @@ namespace epidb {
       Type type() const;
       const std::string value() const;
 
-      bool set_value(const std::string& v);
+      bool set_value(std::string v);
 
       void set_type(Type type);
 
-      const std::string get_xml() const;
+      void xml_open(std::string& out) const;
+    };
+
+    //
+    // String content read only when its XML is written, by parts,
+    // so it is never kept whole in the memory.
+    //
+    class ContentParameter
+    : public Parameter
+    {
+     private:
+      ContentReader reader_;
+
+     public:
+      explicit ContentParameter(ContentReader reader);
+
+      Type type() const;
+      // The content is not available before the XML is written
+      const std::string value() const;
+
+      void xml_open(std::string& out) const;
+      ContentReader xml_content() const;
+      void xml_close(std::string& out) const;
     };
 
     class ListParameter
@@ -137,7 +187,11 @@ namespace epidb {
 
       const std::string value() const;
 
-      const std::string get_xml() const;
+      void xml_open(std::string& out) const;
+      size_t xml_children() const;
+      const Parameter& xml_child(const size_t i, std::string& out) const;
+      void xml_child_end(std::string& out) const;
+      void xml_close(std::string& out) const;
 
       bool add_child(const ParameterPtr& p);
 
@@ -167,7 +221,10 @@ namespace epidb {
       Type type() const;
       const std::string value() const;
 
-      const std::string get_xml() const;
+      void xml_open(std::string& out) const;
+      XmlCursorPtr xml_cursor() const;
+      void xml_child_end(std::string& out) const;
+      void xml_close(std::string& out) const;
 
       bool add_child(const std::string& key, const ParameterPtr& p);
 
@@ -177,6 +234,37 @@ namespace epidb {
     };
 
 
+    //
+    // Writes the XML of a parameter by parts of about PART_SIZE, so it can be
+    // sent while it is written. The contents are read when they are reached.
+    //
+    class XmlWriter {
+     private:
+      struct Frame {
+        const Parameter* param;
+        XmlCursorPtr children;
+      };
+
+      ParameterPtr root_owner_;
+      const Parameter& root_;
+      std::vector<Frame> stack_;
+      ContentReader content_;
+      bool started_;
+
+      void push(const Parameter& param, std::string& out);
+
+     public:
+      static const size_t PART_SIZE = 64 * 1024;
+
+      explicit XmlWriter(const Parameter& root);
+      explicit XmlWriter(ParameterPtr root);
+
+      // Next part of the XML, empty at its end
+      bool next(std::string& part, std::string& msg);
+
+      bool done() const;
+    };
+
     class Parameters {
      private:
       std::vector<ParameterPtr> params_;
@@ -210,7 +298,7 @@ namespace epidb {
 
       void add_string(const std::string& str);
 
-      void add_string_content(std::string&& content);
+      void add_string_content(ContentReader reader);
 
       void add_string(int i);
 
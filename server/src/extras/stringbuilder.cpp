@@ -33,13 +33,29 @@ namespace epidb {
     block.reserve(MAX_BLOCK_SIZE);
   }
 
+  StringBuilder::StringBuilder(std::function<void(std::string &&)> sink) :
+    total_size(0),
+    sink(std::move(sink))
+  {
+    block.reserve(MAX_BLOCK_SIZE);
+  }
+
+  void StringBuilder::push_block()
+  {
+    if (sink) {
+      sink(std::move(block));
+    } else {
+      buffer.emplace_back(std::move(block));
+    }
+    block.clear();
+    block.reserve(MAX_BLOCK_SIZE);
+  }
+
   void StringBuilder::append(const std::string &src)
   {
     if (block.size() + src.size() > MAX_BLOCK_SIZE) {
       if (!block.empty()) {
-        buffer.emplace_back(std::move(block));
-        block.clear();
-        block.reserve(MAX_BLOCK_SIZE);
+        push_block();
       }
     }
 
@@ -51,9 +67,7 @@ namespace epidb {
   {
     if (block.size() + src.size() > MAX_BLOCK_SIZE) {
       if (!block.empty()) {
-        buffer.emplace_back(std::move(block));
-        block.clear();
-        block.reserve(MAX_BLOCK_SIZE);
+        push_block();
       }
     }
 
@@ -61,6 +75,18 @@ namespace epidb {
     total_size += src.size();
   }
 
+  void StringBuilder::append(const char *src, const size_t size)
+  {
+    if (block.size() + size > MAX_BLOCK_SIZE) {
+      if (!block.empty()) {
+        push_block();
+      }
+    }
+
+    block.append(src, size);
+    total_size += size;
+  }
+
   void StringBuilder::tab()
   {
     static std::string tab("\t");
@@ -88,6 +114,13 @@ namespace epidb {
     return result;
   }
 
+  void StringBuilder::flush()
+  {
+    if (sink && !block.empty()) {
+      push_block();
+    }
+  }
+
   bool StringBuilder::empty()
   {
     return total_size == 0;
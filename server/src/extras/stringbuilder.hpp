@@ -21,6 +21,7 @@
 #ifndef EPIDB_STRINGBUILDER_HPP
 #define EPIDB_STRINGBUILDER_HPP
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -35,20 +36,35 @@ namespace epidb {
     std::string block;
     static constexpr size_t MAX_BLOCK_SIZE = 4096;
 
+    // Receives the filled blocks instead of the buffer, when set
+    std::function<void(std::string &&)> sink;
+
+    void push_block();
+
   public:
     StringBuilder();
+    explicit StringBuilder(std::function<void(std::string &&)> sink);
     StringBuilder(const StringBuilder &) = delete;
     StringBuilder & operator = (const StringBuilder &) = delete;
 
     void append(const std::string &src);
     void append(std::string &&src);
+    void append(const char *src, const size_t size);
     void tab();
     void endLine();
     std::string to_string();
+    // Send the last block to the sink
+    void flush();
 
     bool empty();
 
     size_t size();
+
+    // The content is sent to the sink and is not kept in memory
+    bool streams() const
+    {
+      return static_cast<bool>(sink);
+    }
   };
 }
 
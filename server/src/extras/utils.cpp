@@ -24,6 +24,9 @@
 #include <cctype>
 #include <ctime>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
@@ -283,6 +286,51 @@ namespace epidb {
       return fmt::format("{:-.4f}", s);
     }
 
+    size_t score_to_chars(const Score s, char *out)
+    {
+      // The bits are checked directly, because the fast math build assumes finite values
+      uint32_t bits;
+      memcpy(&bits, &s, sizeof(bits));
+      if (bits == 0x7f800000u) {
+        memcpy(out, "Infinity", 8);
+        return 8;
+      }
+
+      // The float is exact in the long double, and so is its product by 10^4
+      const long double scaled = std::fabs(static_cast<long double>(s)) * 10000;
+      if ((bits & 0x7f800000u) == 0x7f800000u || scaled >= 1e18L) {
+        return snprintf(out, SCORE_CHARS, "%.4f", s);
+      }
+
+      unsigned long long units = static_cast<unsigned long long>(scaled);
+      const long double rest = scaled - units;
+      // Round half to even, as printf
+      if (rest > 0.5L || (rest == 0.5L && (units & 1))) {
+        units++;
+      }
+
+      char digits[24];
+      size_t n = 0;
+      for (int i = 0; i < 4; i++) {
+        digits[n++] = '0' + (units % 10);
+        units /= 10;
+      }
+      digits[n++] = '.';
+      do {
+        digits[n++] = '0' + (units % 10);
+        units /= 10;
+      } while (units);
+
+      size_t size = 0;
+      if (bits >> 31) {
+        out[size++] = '-';
+      }
+      while (n) {
+        out[size++] = digits[--n];
+      }
+      return size;
+    }
+
     std::string size_t_to_string(const size_t t)
     {
       return fmt::FormatInt(t).str();
@@ -573,32 +621,42 @@ namespace epidb {
     }
 
 
-    std::string sanitize(const std::string &data)
+    void escape_xml(const char *data, const size_t size, std::string &out)
     {
-      std::string buffer;
-      buffer.reserve(data.size() * 1.05);
-      for (size_t pos = 0; pos != data.size(); ++pos) {
+      size_t begin = 0;
+      for (size_t pos = 0; pos < size; ++pos) {
+        const char *entity;
         switch (data[pos]) {
         case '&':
-          buffer.append("&amp;");
+          entity = "&amp;";
           break;
         case '\"':
-          buffer.append("&quot;");
+          entity = "&quot;";
           break;
         case '\'':
-          buffer.append("&apos;");
+          entity = "&apos;";
           break;
         case '<':
-          buffer.append("&lt;");
+          entity = "&lt;";
           break;
         case '>':
-          buffer.append("&gt;");
+          entity = "&gt;";
           break;
         default:
-          buffer.append(&data[pos], 1);
-          break;
+          continue;
         }
+        out.append(data + begin, pos - begin);
+        out.append(entity);
+        begin = pos + 1;
       }
+      out.append(data + begin, size - begin);
+    }
+
+    std::string sanitize(const std::string &data)
+    {
+      std::string buffer;
+      buffer.reserve(data.size() * 1.05);
+      escape_xml(data.data(), data.size(), buffer);
       return buffer;
     }
 
@@ -126,6 +126,12 @@ namespace epidb {
 
     std::string score_to_string(const Score s);
 
+    // Enough for any score written by score_to_chars
+    const size_t SCORE_CHARS = 48;
+
+    // Write score_to_string(s) into out, without allocating. Returns the number of chars written.
+    size_t score_to_chars(const Score s, char *out);
+
     std::string integer_to_string(const int d);
 
     std::string size_t_to_string(const size_t t);
@@ -154,6 +160,9 @@ namespace epidb {
 
     std::string sanitize(const std::string &data);
 
+    // Append the data to out with the XML special characters escaped
+    void escape_xml(const char *data, const size_t size, std::string &out);
+
     mongo::BSONArray build_array(const std::vector<std::string> &params);
     mongo::BSONArray build_array(const std::vector<long> &params);
     mongo::BSONArray build_array(const std::vector<Score> &params);
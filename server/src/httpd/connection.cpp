@@ -50,7 +50,6 @@ namespace epidb {
       :
       m_read_length(0),
       m_expected_length(0),
-      m_content_(new std::vector<char>()),
       strand_(io_service),
       socket_(io_service),
       request_handler_(handler),
@@ -83,15 +82,9 @@ namespace epidb {
 
         static std::string DOWNLOAD_STRING("/download");
         if (request_.path.substr(0, DOWNLOAD_STRING.length()) == DOWNLOAD_STRING) {
-          reply_ = get_download_data(request_.path);
-          buffers_ = reply_.to_buffers();
-          boost::asio::async_write(socket_, reply_.to_buffers(),
-                                   strand_.wrap(
-                                      boost::bind(&Connection::handle_write, shared_from_this(),
-                                               boost::asio::placeholders::error,
-                                               boost::asio::placeholders::bytes_transferred)));
+          handle_download();
         } else {
-          m_content_->reserve(m_expected_length);
+          xmlrpc_parser_.set_content_length(m_expected_length);
           request_.ip =  socket_.remote_endpoint().address().to_string();
           if (result) {
             read_data();
@@ -123,30 +116,20 @@ namespace epidb {
 
     void Connection::read_data()
     {
-      std::istream stream(&streambuf_);
-
-      while (!stream.eof()) {
-        char buf[4096] = {};
-        stream.read(buf, 4096);
-        std::streamsize tocopy = stream.gcount();
-        if ((m_read_length + tocopy > m_expected_length) && m_expected_length) {
-          tocopy = m_expected_length - m_read_length;
-        }
-        std::copy(buf, buf + tocopy, std::back_inserter(*m_content_.get()));
-
-        m_read_length += tocopy;
+      // The received content is parsed from the receive buffer, without copying it
+      std::streamsize received = streambuf_.size();
+      if ((m_read_length + received > m_expected_length) && m_expected_length) {
+        received = m_expected_length - m_read_length;
+      }
+      if (received > 0 && request_.method == "POST" && !xmlrpc_parser_.error()) {
+        xmlrpc_parser_.parse(boost::asio::buffer_cast<const char *>(streambuf_.data()), received);
       }
+      m_read_length += received;
+      streambuf_.consume(streambuf_.size());
 
       if (m_read_length == m_expected_length) {
-        content_ = std::string(m_content_.get()->begin(), m_content_.get()->end());
-        m_content_.reset();
-        reply_ = request_handler_.handle_request(request_, content_);
-        buffers_ = reply_.to_buffers();
-        boost::asio::async_write(socket_, reply_.to_buffers(),
-                                 strand_.wrap(
-                                   boost::bind(&Connection::handle_write, shared_from_this(),
-                                               boost::asio::placeholders::error,
-                                               boost::asio::placeholders::bytes_transferred)));
+        reply_ = request_handler_.handle_request(request_, xmlrpc_parser_);
+        write_reply();
 
       } else {
 
@@ -159,6 +142,55 @@ namespace epidb {
       }
     }
 
+    void Connection::handle_download()
+    {
+      reply_ = get_download_data(request_);
+      write_reply();
+    }
+
+    void Connection::write_reply()
+    {
+      if (!reply_.stream) {
+        boost::asio::async_write(socket_, reply_.to_buffers(),
+                                 strand_.wrap(
+                                   boost::bind(&Connection::handle_write, shared_from_this(),
+                                               boost::asio::placeholders::error,
+                                               boost::asio::placeholders::bytes_transferred)));
+        return;
+      }
+
+      // The headers, then one part at a time: the next part is read only when the previous one was sent
+      boost::asio::async_write(socket_, reply_.to_buffers(),
+                               strand_.wrap(
+                                 boost::bind(&Connection::handle_stream_write, shared_from_this(),
+                                             boost::asio::placeholders::error,
+                                             boost::asio::placeholders::bytes_transferred)));
+    }
+
+    void Connection::handle_stream_write(const boost::system::error_code &e, size_t bytes_transferred)
+    {
+      if (!e) {
+        std::string msg;
+        if (reply_.stream(stream_part_, msg)) {
+          if (!stream_part_.empty()) {
+            boost::asio::async_write(socket_, boost::asio::buffer(stream_part_),
+                                     strand_.wrap(
+                                       boost::bind(&Connection::handle_stream_write, shared_from_this(),
+                                                   boost::asio::placeholders::error,
+                                                   boost::asio::placeholders::bytes_transferred)));
+            return;
+          }
+        } else {
+          // The headers were sent already, the client sees a short body
+          EPIDB_LOG_ERR("Reply " << request_.path << " (" << id_ << "): " << msg);
+        }
+      }
+
+      reply_.stream = nullptr;
+      std::string().swap(stream_part_);
+      handle_write(e, bytes_transferred);
+    }
+
     void Connection::handle_write(const boost::system::error_code &e, size_t bytes_transferred)
     {
       if (e) {
@@ -42,6 +42,7 @@
 #include "request.hpp"
 #include "request_handler.hpp"
 #include "request_parser.hpp"
+#include "xmlrpc_parser.hpp"
 
 namespace epidb {
   namespace httpd {
@@ -67,7 +68,6 @@ namespace epidb {
     private:
       std::streamsize m_read_length;
       std::streamsize m_expected_length;
-      vector_ptr m_content_;
 
       /// Handle completion of a read operation.
       void handle_read(const boost::system::error_code &e, std::size_t bytes_transferred);
@@ -77,7 +77,13 @@ namespace epidb {
 
       void handle_content(const boost::system::error_code &e, std::size_t bytes_transferred);
 
-      void handle_download(const std::string& uri);
+      void handle_download();
+
+      /// Send the reply, and its stream when there is one.
+      void write_reply();
+
+      /// Send the next part of the reply stream after the previous one was written.
+      void handle_stream_write(const boost::system::error_code &e, std::size_t bytes_transferred);
 
       void read_data();
 
@@ -96,10 +102,14 @@ namespace epidb {
       /// The reply to be sent back to the client.
       Reply reply_;
 
-      std::string content_;
+      /// The parser of the content, given to it as it is received.
+      XMLRPCParser xmlrpc_parser_;
 
       std::vector<boost::asio::const_buffer> buffers_;
 
+      /// The part of the reply stream being sent.
+      std::string stream_part_;
+
       /// The parser for the incoming request.
       request_parser request_parser_;
 
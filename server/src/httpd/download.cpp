@@ -18,6 +18,7 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <algorithm>
 #include <iostream>
 #include <regex>
 #include <string>
@@ -27,13 +28,59 @@
 
 #include "../dba/users.hpp"
 #include "../engine/engine.hpp"
+#include "../storage/storage.hpp"
+#include "download.hpp"
 #include "reply.hpp"
 
 namespace epidb {
   namespace httpd {
 
-    Reply get_download_data(const std::string& uri)
+    enum RangeResult {
+      RANGE_NONE,
+      RANGE_OK,
+      RANGE_INVALID
+    };
+
+    //
+    // Parse a single range "bytes=begin-end", "bytes=begin-" or "bytes=-suffix_length".
+    // Multiple ranges are not supported and the whole file is sent.
+    //
+    static RangeResult parse_range(const std::string& value, const size_t file_size, size_t& begin, size_t& end)
     {
+      static const std::regex range_regex("^\\s*bytes\\s*=\\s*(\\d{0,19})\\s*-\\s*(\\d{0,19})\\s*$");
+
+      std::smatch match;
+      if (value.find(',') != std::string::npos || !std::regex_match(value, match, range_regex)) {
+        return RANGE_NONE;
+      }
+
+      const std::string first = match[1].str();
+      const std::string last = match[2].str();
+      if (first.empty() && last.empty()) {
+        return RANGE_NONE;
+      }
+
+      if (first.empty()) {
+        size_t suffix = std::stoull(last);
+        if (suffix == 0) {
+          return RANGE_INVALID;
+        }
+        begin = file_size - std::min(suffix, file_size);
+        end = file_size;
+      } else {
+        begin = std::stoull(first);
+        end = last.empty() ? file_size : std::min<size_t>(std::stoull(last) + 1, file_size);
+      }
+
+      if (begin >= file_size || begin >= end) {
+        return RANGE_INVALID;
+      }
+      return RANGE_OK;
+    }
+
+    Reply get_download_data(const Request& request)
+    {
+      const std::string& uri = request.path;
       std::vector<std::string> strs;
       boost::split(strs, uri, boost::is_any_of("?"));
 
@@ -47,12 +94,12 @@ namespace epidb {
         return Reply::stock_reply(Reply::bad_request, "Invalid request, it was not possible to read the parameters. It must be: /download?r_id=REQUEST_ID&key=USER_KEY");
       }
 
-      std::vector<std::string> request;
-      boost::split(request, params[0], boost::is_any_of("="));
-      if (request.size() != 2) {
+      std::vector<std::string> request_param;
+      boost::split(request_param, params[0], boost::is_any_of("="));
+      if (request_param.size() != 2) {
         return Reply::stock_reply(Reply::bad_request, "Invalid request, it was not possible to read the request ID. It must be: /download?r_id=REQUEST_ID&key=USER_KEY");
       }
-      const std::string request_id = request[1];
+      const std::string request_id = request_param[1];
 
 
       std::vector<std::string> key;
@@ -72,12 +119,62 @@ namespace epidb {
         return Reply::stock_reply(Reply::bad_request, "Invalid request: User " + user.name() + "/" + user.id() + " does not have the request " + request_id);
       }
 
-      std::string content;
-      if (!epidb::Engine::instance().request_download_data(user, request_id, content, msg)) {
+      std::string file_name;
+      storage::Codec codec;
+      if (!epidb::Engine::instance().request_download_file(user, request_id, file_name, codec, msg)) {
         return Reply::stock_reply(Reply::bad_request, "Invalid request: " + msg);
       }
 
-      return Reply::stock_reply_download(Reply::ok, request_id, std::move(content));
+      // The LZO results are decompressed here, they are sent whole
+      if (codec != storage::CODEC_BZIP2) {
+        std::string content;
+        bool compressed;
+        if (!epidb::Engine::instance().request_download_data(user, request_id, content, compressed, msg)) {
+          return Reply::stock_reply(Reply::bad_request, "Invalid request: " + msg);
+        }
+        return Reply::stock_reply_download(Reply::ok, request_id, std::move(content), compressed);
+      }
+
+      std::shared_ptr<storage::FileReader> file = std::make_shared<storage::FileReader>();
+      if (!file->open(file_name, msg)) {
+        return Reply::stock_reply(Reply::bad_request, "Invalid request: " + msg);
+      }
+
+      size_t begin = 0;
+      size_t end = file->size();
+      bool partial = false;
+
+      for (const header& h : request.headers) {
+        if (!boost::iequals(h.name, "Range")) {
+          continue;
+        }
+        size_t range_begin;
+        size_t range_end;
+        RangeResult range = parse_range(h.value, file->size(), range_begin, range_end);
+        if (range == RANGE_INVALID) {
+          return Reply::range_not_satisfiable_reply(file->size());
+        }
+        if (range == RANGE_OK) {
+          begin = range_begin;
+          end = range_end;
+          partial = true;
+        }
+      }
+
+      Reply reply = Reply::download_headers(request_id, file->size(), begin, end, partial);
+      // One chunk of the file at a time, from begin until end
+      reply.stream = [file, begin, end](std::string& part, std::string& msg) mutable {
+        if (begin >= end) {
+          part.clear();
+          return true;
+        }
+        if (!file->read(begin, end - begin, part, msg)) {
+          return false;
+        }
+        begin += part.size();
+        return true;
+      };
+      return reply;
     }
 
   } // namespace httpd
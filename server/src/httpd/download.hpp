@@ -30,12 +30,14 @@
 
 #include "../../third_party/expat/lib/expat.h"
 
+#include "reply.hpp"
+#include "request.hpp"
 #include "xmlrpc_request.hpp"
 
 namespace epidb {
   namespace httpd {
 
-    Reply get_download_data(const std::string& uri);
+    Reply get_download_data(const Request& request);
 
   } // namespace httpd
 } // namespace epidb
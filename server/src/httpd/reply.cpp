@@ -48,6 +48,8 @@ namespace epidb {
       "HTTP/1.0 202 Accepted\r\n";
       const std::string no_content =
       "HTTP/1.0 204 No Content\r\n";
+      const std::string partial_content =
+      "HTTP/1.0 206 Partial Content\r\n";
       const std::string multiple_choices =
       "HTTP/1.0 300 Multiple Choices\r\n";
       const std::string moved_permanently =
@@ -64,6 +66,8 @@ namespace epidb {
       "HTTP/1.0 403 Forbidden\r\n";
       const std::string not_found =
       "HTTP/1.0 404 Not Found\r\n";
+      const std::string range_not_satisfiable =
+      "HTTP/1.0 416 Range Not Satisfiable\r\n";
       const std::string internal_server_error =
       "HTTP/1.0 500 Internal Server Error\r\n";
       const std::string not_implemented =
@@ -85,6 +89,8 @@ namespace epidb {
             return boost::asio::buffer(accepted);
           case Reply::no_content:
             return boost::asio::buffer(no_content);
+          case Reply::partial_content:
+            return boost::asio::buffer(partial_content);
           case Reply::multiple_choices:
             return boost::asio::buffer(multiple_choices);
           case Reply::moved_permanently:
@@ -101,6 +107,8 @@ namespace epidb {
             return boost::asio::buffer(forbidden);
           case Reply::not_found:
             return boost::asio::buffer(not_found);
+          case Reply::range_not_satisfiable:
+            return boost::asio::buffer(range_not_satisfiable);
           case Reply::internal_server_error:
             return boost::asio::buffer(internal_server_error);
           case Reply::not_implemented:
@@ -198,6 +206,11 @@ namespace epidb {
       "<head><title>Not Found</title></head>"
       "<body><h1>404 Not Found</h1></body>"
       "</html>";
+      const char range_not_satisfiable[] =
+      "<html>"
+      "<head><title>Range Not Satisfiable</title></head>"
+      "<body><h1>416 Range Not Satisfiable</h1></body>"
+      "</html>";
       const char internal_server_error[] =
       "<html>"
       "<head><title>Internal Server Error</title></head>"
@@ -247,6 +260,8 @@ namespace epidb {
             return forbidden;
           case Reply::not_found:
             return not_found;
+          case Reply::range_not_satisfiable:
+            return range_not_satisfiable;
           case Reply::internal_server_error:
             return internal_server_error;
           case Reply::not_implemented:
@@ -284,7 +299,22 @@ namespace epidb {
       return rep;
     }
 
-    Reply Reply::stock_reply_download(Reply::ReplyType status, const std::string& file_name, std::string&& content)
+    Reply Reply::stream_reply(Reply::ReplyType status, std::string&& first_part,
+                              std::function<bool(std::string& part, std::string& msg)> stream)
+    {
+      Reply rep;
+      rep.type = status;
+      rep.content = std::move(first_part);
+      rep.stream = std::move(stream);
+      rep.headers.resize(2);
+      rep.headers[0].name = "content-type";
+      rep.headers[0].value = "application/xml";
+      rep.headers[1].name = "Access-Control-Allow-Origin";
+      rep.headers[1].value = "*";
+      return rep;
+    }
+
+    Reply Reply::stock_reply_download(Reply::ReplyType status, const std::string& file_name, std::string&& content, const bool compressed)
     {
       Reply rep;
       rep.type = status;
@@ -297,17 +327,52 @@ namespace epidb {
       rep.headers.resize(4);
       // header('Content-Disposition: ");
       rep.headers[0].name = "content-type";
-      rep.headers[0].value = "application/x-bzip2";
+      rep.headers[0].value = compressed ? "application/x-bzip2" : "text/plain";
       rep.headers[1].name = "Access-Control-Allow-Origin";
       rep.headers[1].value = "*";
       rep.headers[2].name = "Content-Disposition";
-      rep.headers[2].value = "attachment; filename=deepblue_data_"+file_name+".bed.bz2";
+      rep.headers[2].value = "attachment; filename=deepblue_data_" + file_name + (compressed ? ".bed.bz2" : ".bed");
       rep.headers[3].name = "Content-Length";
       rep.headers[3].value = utils::size_t_to_string(rep.content.size());
 
       return rep;
     }
 
+    Reply Reply::download_headers(const std::string& file_name, const size_t file_size,
+                                  const size_t begin, const size_t end, const bool partial)
+    {
+      Reply rep;
+      rep.type = partial ? partial_content : ok;
+      rep.headers.resize(partial ? 6 : 5);
+      rep.headers[0].name = "content-type";
+      rep.headers[0].value = "application/x-bzip2";
+      rep.headers[1].name = "Access-Control-Allow-Origin";
+      rep.headers[1].value = "*";
+      rep.headers[2].name = "Content-Disposition";
+      rep.headers[2].value = "attachment; filename=deepblue_data_" + file_name + ".bed.bz2";
+      rep.headers[3].name = "Content-Length";
+      rep.headers[3].value = utils::size_t_to_string(end - begin);
+      rep.headers[4].name = "Accept-Ranges";
+      rep.headers[4].value = "bytes";
+      if (partial) {
+        rep.headers[5].name = "Content-Range";
+        rep.headers[5].value = "bytes " + utils::size_t_to_string(begin) + "-" + utils::size_t_to_string(end - 1) +
+                               "/" + utils::size_t_to_string(file_size);
+      }
+
+      return rep;
+    }
+
+    Reply Reply::range_not_satisfiable_reply(const size_t file_size)
+    {
+      Reply rep = stock_reply(range_not_satisfiable, "");
+      header content_range;
+      content_range.name = "Content-Range";
+      content_range.value = "bytes */" + utils::size_t_to_string(file_size);
+      rep.headers.push_back(content_range);
+      return rep;
+    }
+
     // TODO: get Access-Control-Allow-Origin from a configuration/option
     Reply Reply::options_reply()
     {
@@ -32,6 +32,7 @@
 #ifndef EPIDB_HTTPD_REPLY_HPP
 #define EPIDB_HTTPD_REPLY_HPP
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <boost/asio.hpp>
@@ -49,6 +50,7 @@ namespace epidb {
         created = 201,
         accepted = 202,
         no_content = 204,
+        partial_content = 206,
         multiple_choices = 300,
         moved_permanently = 301,
         moved_temporarily = 302,
@@ -57,6 +59,7 @@ namespace epidb {
         unauthorized = 401,
         forbidden = 403,
         not_found = 404,
+        range_not_satisfiable = 416,
         request_limit_exceeded = 429,
         internal_server_error = 500,
         not_implemented = 501,
@@ -67,6 +70,10 @@ namespace epidb {
       std::vector<header> headers;
       std::string content;
 
+      /// When set, the rest of the content is read from it by parts after the content
+      /// was sent, until an empty part. The connection is closed at its end.
+      std::function<bool(std::string& part, std::string& msg)> stream;
+
       /// Convert the reply into a vector of buffers. The buffers do not own the
       /// underlying memory blocks, therefore the reply object must remain valid and
       /// not be changed until the write operation has completed.
@@ -75,7 +82,18 @@ namespace epidb {
       /// Get a stock reply.
       static Reply stock_reply(Reply::ReplyType status, std::string&& content);
 
-      static Reply stock_reply_download(Reply::ReplyType status, const std::string& file_name, std::string&& content);
+      /// A reply with its content sent by parts, delimited by the connection close.
+      static Reply stream_reply(Reply::ReplyType status, std::string&& first_part,
+                                std::function<bool(std::string& part, std::string& msg)> stream);
+
+      static Reply stock_reply_download(Reply::ReplyType status, const std::string& file_name, std::string&& content, const bool compressed = true);
+
+      /// Headers of a file sent after them, or of the bytes [begin, end) of the file when partial.
+      static Reply download_headers(const std::string& file_name, const size_t file_size,
+                                    const size_t begin, const size_t end, const bool partial);
+
+      /// The requested range is not in the file.
+      static Reply range_not_satisfiable_reply(const size_t file_size);
 
       static Reply options_reply();
     };
@@ -31,6 +31,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include <string>
 
@@ -47,7 +48,7 @@
 namespace epidb {
   namespace httpd {
 
-    Reply request_handler::handle_request(const Request& req, std::string& content)
+    Reply request_handler::handle_request(const Request& req, XMLRPCParser& parser)
     {
       Reply reply;
       if (req.method == "GET") {
@@ -59,51 +60,28 @@ namespace epidb {
       }
 
       else if (req.method == "POST") {
-        bool error = true;
-        std::string message = process_content(req, content, error);
-
-        if (error) {
-          reply = Reply::stock_reply(Reply::bad_request, std::move(message));
-        } else {
-          reply = Reply::stock_reply(Reply::ok, std::move(message));
-        }
+        reply = process_content(req, parser);
       }
       return reply;
     }
 
-    const std::string request_handler::process_content(
-      const Request& request, std::string& content, bool& error)
+    Reply request_handler::process_content(const Request& request, XMLRPCParser& parser)
     {
-      XMLRPCParser parser;
       std::shared_ptr<XmlrpcRequest> xmlrpc_request;
 
-      char buf[8192] = {};
-      size_t len = 0;
-
-      for (size_t i = 0; i < content.length(); ++i) {
-        buf[len++] = content[i];
-        bool done = (i + 1) == content.length();
-        if (len == 8192 || done) {
-          if (!parser.parse(buf, len)) {
-            error = true;
-            EPIDB_LOG("[1] request from " << request.ip << ": parsing error.");
-            return XmlrpcResponse::error_response("[1] parsing error");
-          }
-          if (done) {
-            if (!parser.done(xmlrpc_request)) {
-              error = true;
-              EPIDB_LOG("[2] request from " << request.ip << ": parsing error.");
-              return XmlrpcResponse::error_response("[2] parsing error on done");
-            }
-            break;
-          }
-          len = 0;
-        }
+      if (parser.error()) {
+        EPIDB_LOG("[1] request from " << request.ip << ": parsing error.");
+        return Reply::stock_reply(Reply::bad_request, XmlrpcResponse::error_response("[1] parsing error"));
+      }
+
+      if (!parser.done(xmlrpc_request)) {
+        EPIDB_LOG("[2] request from " << request.ip << ": parsing error.");
+        return Reply::stock_reply(Reply::bad_request, XmlrpcResponse::error_response("[2] parsing error on done"));
       }
 
       if (!xmlrpc_request) {
         EPIDB_LOG("[3] request from " << request.ip << ": parsing error.");
-        return XmlrpcResponse::error_response("[3] Error parsing the request data.");
+        return Reply::stock_reply(Reply::bad_request, XmlrpcResponse::error_response("[3] Error parsing the request data."));
       }
 
       xmlrpc_request->set_ip(request.ip);
@@ -111,12 +89,26 @@ namespace epidb {
 
       XmlrpcResponse xmlrpc_response(xmlrpc_request->method_name());
       if (!XmlrpcRequestHandler::xmlrpc_request_handle(*xmlrpc_request, xmlrpc_response)) {
-        error = true;
-        return XmlrpcResponse::error_response("failed request handle");
+        return Reply::stock_reply(Reply::bad_request, XmlrpcResponse::error_response("failed request handle"));
+      }
+
+      // A response that fits in the first part is sent whole, with its length.
+      // The others are sent while they are written, reading their contents by parts.
+      std::shared_ptr<serialize::XmlWriter> writer = xmlrpc_response.writer();
+      std::string part;
+      std::string msg;
+      if (!writer->next(part, msg)) {
+        EPIDB_LOG_ERR("request " << xmlrpc_request->method_name() << " from " << request.ip << ": " << msg);
+        return Reply::stock_reply(Reply::bad_request, XmlrpcResponse::error_response(msg));
+      }
+
+      if (writer->done()) {
+        return Reply::stock_reply(Reply::ok, std::move(part));
       }
 
-      error = false;
-      return xmlrpc_response.buffer();
+      return Reply::stream_reply(Reply::ok, std::move(part), [writer](std::string& part, std::string& msg) {
+        return writer->next(part, msg);
+      });
     }
 
   } // namespace httpd
@@ -37,6 +37,7 @@
 
 // #include "rate_limiter.hpp"
 #include "reply.hpp"
+#include "xmlrpc_parser.hpp"
 
 namespace epidb {
   namespace httpd {
@@ -48,11 +49,12 @@ namespace epidb {
     : private boost::noncopyable
     {
      public:
-      /// Handle a request and produce a reply.
-      Reply handle_request(const Request& req, std::string& content);
+      /// Handle a request and produce a reply. The content of a POST request
+      /// was given to the parser while it was received.
+      Reply handle_request(const Request& req, XMLRPCParser& parser);
 
      private:
-      const std::string process_content(const Request& request, std::string& content, bool& ok);
+      Reply process_content(const Request& request, XMLRPCParser& parser);
     };
 
   } // namespace httpd
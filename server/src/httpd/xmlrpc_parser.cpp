@@ -18,6 +18,8 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <algorithm>
+#include <climits>
 #include <string>
 #include <string.h>
 
@@ -35,7 +37,7 @@ namespace epidb {
   namespace httpd {
 
     XMLRPCParser::XMLRPCParser()
-      : request_(), error_(false) {
+      : request_(), content_length_(0), error_(false) {
       parser_ = XML_ParserCreate(NULL);
 
       XML_SetUserData(parser_, this);
@@ -47,8 +49,17 @@ namespace epidb {
       XML_ParserFree(parser_);
     }
 
-    bool XMLRPCParser::parse(char* buf, int len) {
-      XML_Parse(parser_, buf, len, 0);
+    void XMLRPCParser::set_content_length(const size_t length) {
+      content_length_ = length;
+    }
+
+    bool XMLRPCParser::parse(const char* buf, size_t len) {
+      while (len > 0 && !error_) {
+        const int part = std::min<size_t>(len, INT_MAX);
+        XML_Parse(parser_, buf, part, 0);
+        buf += part;
+        len -= part;
+      }
       return !error_;
     }
 
@@ -237,7 +248,7 @@ namespace epidb {
         }
         // if a primitive type, set the actual value
         if (last_param->type() != serialize::LIST && last_param->type() != serialize::MAP) {
-          last_param->set_value(self->buf_);
+          last_param->set_value(std::move(self->buf_));
           self->buf_.clear();
         }
         // remove closed element from param stack
@@ -279,8 +290,18 @@ namespace epidb {
 
       if (self->stack_.size() > 0) {
         State last = self->stack_.back();
-        if (last == TYPE || last == METHOD_NAME || last == NAME)
-          self->buf_.append(s, len);
+        if (last == TYPE || last == METHOD_NAME || last == NAME) {
+          std::string& buf = self->buf_;
+          // A large value can not be longer than the content not parsed yet:
+          // reserve it at once instead of copying the value at each growth
+          if (buf.size() + len > buf.capacity() && buf.size() >= LARGE_VALUE_SIZE) {
+            const XML_Index parsed = XML_GetCurrentByteIndex(self->parser_);
+            if (parsed >= 0 && self->content_length_ > (size_t) parsed) {
+              buf.reserve(buf.size() + self->content_length_ - parsed);
+            }
+          }
+          buf.append(s, len);
+        }
       }
     }
 
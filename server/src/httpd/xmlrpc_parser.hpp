@@ -40,9 +40,17 @@ namespace epidb {
       XMLRPCParser();
       ~XMLRPCParser();
 
-      bool parse(char* buf, int len);
+      // Length of the whole content, used to size the buffer of a large value once
+      void set_content_length(const size_t length);
+
+      // Parse the next piece of the content, as it is received
+      bool parse(const char* buf, size_t len);
       bool done(std::shared_ptr<XmlrpcRequest>& req);
 
+      bool error() const {
+        return error_;
+      }
+
      private:
       typedef enum { METHOD_CALL, METHOD_NAME, PARAMS, PARAM, TYPE, MEMBER, NAME, VALUE, NONE } State;
 
@@ -50,6 +58,9 @@ namespace epidb {
       static void end_handler(void *data, const XML_Char *name);
       static void char_handler(void *data, const XML_Char *s, int len);
 
+      // Values larger than it are not grown by doubling
+      static const size_t LARGE_VALUE_SIZE = 1024 * 1024;
+
       XML_Parser parser_;
       std::shared_ptr<XmlrpcRequest> request_;
 
@@ -59,6 +70,7 @@ namespace epidb {
 
       std::vector<serialize::ParameterPtr> params_;
 
+      size_t content_length_;
       bool error_;
     };
 
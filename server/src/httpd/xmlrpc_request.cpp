@@ -108,7 +108,7 @@ namespace epidb {
       return m.str();
     }
 
-    const std::string XmlrpcResponse::error_response(const std::string& error) {
+    std::string XmlrpcResponse::error_response(const std::string& error) {
       std::stringstream m;
       m << message_header();
       m << serialize::SimpleParameter(serialize::ERROR, error).get_xml();
@@ -116,27 +116,51 @@ namespace epidb {
       return m.str();
     }
 
-    const std::string XmlrpcResponse::buffer() const {
-      std::stringstream m;
+    //
+    // The methodResponse, with the parameters as the items of its array.
+    //
+    class ResponseParameter : public serialize::Parameter {
+     private:
+      const serialize::Parameters parameters_;
 
-      m << message_header();
-      m << "<param>" << std::endl;
-      m << "<value>" << std::endl;
-      m << "<array>" << std::endl;
-      m << "<data>" << std::endl;
-
-      for(const serialize::ParameterPtr& p:  parameters_)
-      {
-        m << p->get_xml() << std::endl;
+     public:
+      explicit ResponseParameter(const serialize::Parameters& parameters) :
+        parameters_(parameters)
+      {}
+
+      serialize::Type type() const {
+        return serialize::LIST;
       }
 
-      m << "</data>" << std::endl;
-      m << "</array>" << std::endl;
-      m << "</value>" << std::endl;
-      m << "</param>" << std::endl;
-      m << message_tail();
+      const std::string value() const {
+        return std::string();
+      }
 
-      return m.str();
+      void xml_open(std::string& out) const {
+        out.append(XmlrpcResponse::message_header());
+        out.append("<param>\n<value>\n<array>\n<data>\n");
+      }
+
+      size_t xml_children() const {
+        return parameters_.size();
+      }
+
+      const serialize::Parameter& xml_child(const size_t i, std::string& out) const {
+        return *parameters_[i];
+      }
+
+      void xml_child_end(std::string& out) const {
+        out.append("\n");
+      }
+
+      void xml_close(std::string& out) const {
+        out.append("</data>\n</array>\n</value>\n</param>\n");
+        out.append(XmlrpcResponse::message_tail());
+      }
+    };
+
+    std::shared_ptr<serialize::XmlWriter> XmlrpcResponse::writer() const {
+      return std::make_shared<serialize::XmlWriter>(std::make_shared<ResponseParameter>(parameters_));
     }
 
   } // namespace httpd
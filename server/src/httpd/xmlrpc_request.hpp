@@ -20,6 +20,7 @@
 #ifndef EPIDB_HTTPD_XMLRPC_REQUEST_HPP
 #define EPIDB_HTTPD_XMLRPC_REQUEST_HPP
 
+#include <memory>
 #include <string>
 #include <sstream>
 
@@ -83,22 +84,23 @@ namespace epidb {
       std::string method_name_;
       serialize::Parameters parameters_;
 
+     public:
       static std::string message_header();
       static std::string message_tail();
 
-     public:
 
       XmlrpcResponse(const std::string& method_name) :
         method_name_(method_name)
       {}
 
-      static const std::string error_response(const std::string& error);
+      static std::string error_response(const std::string& error);
 
       serialize::Parameters& parameters() {
         return parameters_;
       }
 
-      const std::string buffer() const;
+      // Writes the response by parts, reading the contents only when they are sent
+      std::shared_ptr<serialize::XmlWriter> writer() const;
     };
 
 
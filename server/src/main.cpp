@@ -45,6 +45,7 @@
 #include "engine/queue_processer.hpp"
 #include "extras/compress.hpp"
 #include "httpd/server.hpp"
+#include "storage/compression.hpp"
 
 #include "parser/wig.hpp"
 
@@ -66,8 +67,10 @@ int main(int argc, char *argv[])
   std::string mongodb_server;
   std::string database_name;
   unsigned long long processing_max_memory;
+  unsigned long long query_cache_max_memory;
   unsigned long long old_request_age_in_sec;
   unsigned long long janitor_periodicity;
+  std::string result_codec;
 
   // Declare the supported options.
   po::options_description desc("DeepBlue parameters");
@@ -81,9 +84,11 @@ int main(int argc, char *argv[])
   ("database_name,D", po::value<std::string>(&database_name)->default_value("epidb"), "Database name")
   ("processing_threads,R", po::value<size_t>(&processing_threads)->default_value(4), "Number of concurrent threads for processing request data")
   ("processing_max_memory,O", po::value<unsigned long long>(&processing_max_memory)->default_value(8ll * 1024 * 1024 * 1024), "Maximum memory available for request data processing (in bytes)")
+  ("query_cache_max_memory,Q", po::value<unsigned long long>(&query_cache_max_memory)->default_value(2ll * 1024 * 1024 * 1024), "Maximum memory used by the cached query results (in bytes)")
   ("old_request_age_in_sec,I", po::value<unsigned long long>(&old_request_age_in_sec)->default_value(60l * 60l * 24l * 30l * 1l), "How old is a request to be considered old and cleared (in seconds)")
   ("sharding,S", "Use DeepBlue with sharding in the MongoDB")
-  ("janitor_periodicity,J", po::value<unsigned long long>(&janitor_periodicity)->default_value(60l), "Periodicity that the janitor will be executed (in seconds)");
+  ("janitor_periodicity,J", po::value<unsigned long long>(&janitor_periodicity)->default_value(60l), "Periodicity that the janitor will be executed (in seconds)")
+  ("result_codec,C", po::value<std::string>(&result_codec)->default_value("bzip2"), "Compression of the stored request results: bzip2 or lzo (faster, larger)");
 
   po::variables_map vm;
   try {
@@ -119,12 +124,20 @@ int main(int argc, char *argv[])
   epidb::config::set_mongodb_server(mongodb_server);
   epidb::config::set_database_name(database_name);
   epidb::config::set_processing_max_memory(processing_max_memory);
+  epidb::config::set_query_cache_max_memory(query_cache_max_memory);
   epidb::config::set_old_request_age_in_sec(old_request_age_in_sec);
   epidb::config::set_default_old_request_age_in_sec(old_request_age_in_sec);
   epidb::config::set_janitor_periodicity(janitor_periodicity);
   epidb::config::set_default_janitor_periodicity(janitor_periodicity);
 
   std::string msg;
+  epidb::storage::Codec codec;
+  if (!epidb::storage::codec_from_name(result_codec, codec, msg)) {
+    EPIDB_LOG_ERR(msg);
+    return 1;
+  }
+  epidb::storage::set_result_codec(codec);
+
   if (!epidb::config::check_mongodb(msg)) {
     EPIDB_LOG_ERR(msg);
     return 1;
@@ -40,6 +40,14 @@
 
 namespace epidb {
   namespace mdbq {
+    // The data of a queued upload is stored until it is inserted or its job is removed
+    static void remove_upload(const mongo::BSONObj &job)
+    {
+      if (job.hasField("misc") && job["misc"].Obj().hasField("upload")) {
+        remove_result(job["misc"].Obj()["upload"].str());
+      }
+    }
+
     bool remove_request_data(const std::string& request_id, TaskState state, std::string& msg)
     {
       // This function has 3 steps:
@@ -80,6 +88,7 @@ namespace epidb {
 
       // 3.
       remove_result(request_id);
+      remove_upload(res["value"].Obj());
 
       c.done();
       return true;
@@ -18,19 +18,22 @@
 // Code from https://github.com/temporaer/MDBQ/
 // adapted to DeepBlue by Felipe Albrecht on 22.01.2015
 
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
 #include <random>
 #include <vector>
 
 #include <boost/format.hpp>
-#include <boost/asio.hpp>
-#include <boost/bind.hpp>
 
 #include <mongo/client/dbclient.h>
 #include <mongo/client/gridfs.h>
 
 #include "client.hpp"
 #include "common.hpp"
+#include "hub.hpp"
 
 #include "../config/config.hpp"
 
@@ -65,30 +68,37 @@ namespace epidb {
       long long int             m_running_nr;
       //std::auto_ptr<mongo::BSONArrayBuilder>   m_log;
       std::vector<mongo::BSONObj> m_log;
-      float              m_interval;
-      std::auto_ptr<boost::asio::deadline_timer> m_timer;
+    };
+
+    // Tasks queued by this process and not taken yet by one of its clients
+    static std::mutex dispatch_mutex;
+    static std::condition_variable dispatch_cv;
+    static size_t dispatch_pending = 0;
 
-      void update_check(Client *c, const boost::system::error_code &error)
+    void notify_new_task()
+    {
       {
-        std::string _id;
-        mongo::BSONObj task;
+        std::lock_guard<std::mutex> lock(dispatch_mutex);
+        dispatch_pending++;
+      }
+      dispatch_cv.notify_one();
+    }
 
-        if (c->get_next_task(_id, task)) {
-          c->handle_task(_id, task);
-        }
+    // Wait for a task queued by this process, or until the fallback interval passes.
+    static void wait_new_task(const float interval)
+    {
+      long ms;
+      if (interval <= 1.f) {
+        ms = 1000 * (interval / 2 + drand48() * (interval / 2));
+      } else {
+        ms = 1000 * (1 + drand48() * (interval - 1));
+      }
 
-        if (!error) {
-          unsigned int ms;
-          if (m_interval <= 1.f) {
-            ms = 1000 * (m_interval / 2 + drand48() * (m_interval / 2));
-          } else {
-            ms = 1000 * (1 + drand48() * (m_interval - 1));
-          }
-          m_timer->expires_at(m_timer->expires_at() + boost::posix_time::millisec(ms));
-          m_timer->async_wait(boost::bind(&ClientImpl::update_check, this, c, boost::asio::placeholders::error));
-        }
+      std::unique_lock<std::mutex> lock(dispatch_mutex);
+      if (dispatch_cv.wait_for(lock, std::chrono::milliseconds(ms), [] { return dispatch_pending > 0; })) {
+        dispatch_pending--;
       }
-    };
+    }
 
     Client::Client(const std::string &url, const std::string &prefix)
       : m_jobcol(dba::helpers::collection_name(dba::Collections::JOBS()))
@@ -110,6 +120,82 @@ namespace epidb {
       m_db = prefix;
     }
 
+    // Weight of a job in the recent load of its user, by class
+    static const int CLASS_WEIGHT[_JC_END] = { 1, 4, 16 };
+    // Jobs booked in this period count in the load of their users
+    static const long FAIR_WINDOW_SECONDS = 15 * 60;
+    // Heavy jobs of a user running at the same time
+    static const int MAX_HEAVY_PER_USER = 2;
+    // A waiting job goes to the previous class after this time, so the heavy jobs are not starved
+    static const long CLASS_AGING_SECONDS = 10 * 60;
+    // Oldest ready jobs considered when selecting the next one
+    static const int MAX_CANDIDATES = 1000;
+    static const int MAX_BOOK_ATTEMPTS = 3;
+
+    struct UserLoad {
+      int load = 0;
+      int heavy = 0;
+    };
+
+    //
+    // Select the next job: the lowest class first, then the user with the lowest recent load,
+    // then the oldest job. Users already running the maximum heavy jobs are skipped for heavy jobs.
+    //
+    static bool select_next_task(const mongo::BSONObj &ready, const boost::posix_time::ptime &now, mongo::BSONObj &selected)
+    {
+      const std::string jobs = dba::helpers::collection_name(dba::Collections::JOBS());
+      std::map<std::string, UserLoad> loads;
+
+      Connection c;
+
+      boost::posix_time::ptime since = now - boost::posix_time::seconds(FAIR_WINDOW_SECONDS);
+      mongo::BSONObj load_fields = BSON("misc.user_id" << 1 << "class" << 1 << "state" << 1);
+      auto booked = c->query(jobs,
+                             BSON("$or" << BSON_ARRAY(
+                                    BSON("state" << TS_RUNNING) <<
+                                    BSON("book_time" << BSON("$gte" << epidb::extras::to_mongo_date(since))))),
+                             0, 0, &load_fields);
+      while (booked->more()) {
+        mongo::BSONObj o = booked->next();
+        const JobClass job_class = Hub::get_class(o);
+        UserLoad &load = loads[o.getFieldDotted("misc.user_id").str()];
+        load.load += CLASS_WEIGHT[job_class];
+        if (job_class == JC_HEAVY && o["state"].numberInt() == TS_RUNNING) {
+          load.heavy++;
+        }
+      }
+
+      bool found = false;
+      int best_class = _JC_END;
+      int best_load = 0;
+
+      mongo::BSONObj ready_fields = BSON("_id" << 1 << "misc.user_id" << 1 << "class" << 1 << "create_time" << 1);
+      auto cursor = c->query(jobs, mongo::Query(ready).sort("create_time"), MAX_CANDIDATES, 0, &ready_fields);
+      while (cursor->more()) {
+        mongo::BSONObj o = cursor->next();
+        const JobClass job_class = Hub::get_class(o);
+        const UserLoad load = loads[o.getFieldDotted("misc.user_id").str()];
+
+        if (job_class == JC_HEAVY && load.heavy >= MAX_HEAVY_PER_USER) {
+          continue;
+        }
+
+        const long waiting = (now - Hub::get_create_time(o)).total_seconds();
+        const int effective_class = std::max(0L, job_class - waiting / CLASS_AGING_SECONDS);
+
+        // The candidates come oldest first
+        if (!found || effective_class < best_class || (effective_class == best_class && load.load < best_load)) {
+          found = true;
+          best_class = effective_class;
+          best_load = load.load;
+          selected = o.getOwned();
+        }
+      }
+
+      c.done();
+      return found;
+    }
+
     bool Client::get_next_task(std::string& _id, mongo::BSONObj &o)
     {
       boost::posix_time::ptime now = epidb::extras::universal_date_time();
@@ -118,35 +204,49 @@ namespace epidb {
       gethostname(&hostname[0], 256);
       std::string hostname_pid = (boost::format("%s:%d") % &hostname[0] % getpid()).str();
 
-      mongo::BSONObjBuilder queryb;
-      mongo::BSONObj res, cmd, query;
-      queryb.append("state", BSON("$in" << BSON_ARRAY(TS_NEW << TS_RENEW << TS_REPROCESS)));
-
+      mongo::BSONObjBuilder readyb;
+      readyb.append("state", BSON("$in" << BSON_ARRAY(TS_NEW << TS_RENEW << TS_REPROCESS)));
       if (! m_ptr->m_task_selector.isEmpty()) {
-        queryb.appendElements(m_ptr->m_task_selector);
+        readyb.appendElements(m_ptr->m_task_selector);
       }
+      mongo::BSONObj ready = readyb.obj();
+
+      mongo::BSONObj res;
+      // Another worker can book the selected job first
+      for (int attempt = 0; attempt < MAX_BOOK_ATTEMPTS; attempt++) {
+        mongo::BSONObj selected;
+        if (!select_next_task(ready, now, selected)) {
+          if (m_verbose)
+            std::cout << "No task available, query:" << ready << std::endl;
+          return false;
+        }
 
-      query = queryb.obj();
-      cmd = BSON(
-              "findAndModify" << dba::Collections::JOBS() <<
-              "query" << query <<
-              "update" << BSON("$set" <<
-                               BSON("book_time" << epidb::extras::to_mongo_date(now)
-                                    << "state" << TS_RUNNING
-                                    << "refresh_time" << epidb::extras::to_mongo_date(now)
-                                    << "owner" << hostname_pid)));
-
-      Connection c;
-      c->runCommand(m_db, cmd, res);
-      CHECK_DB_ERR(c);
-      c.done();
+        mongo::BSONObjBuilder queryb;
+        queryb.append(selected["_id"]);
+        queryb.appendElements(ready);
+
+        mongo::BSONObj cmd = BSON(
+                               "findAndModify" << dba::Collections::JOBS() <<
+                               "query" << queryb.obj() <<
+                               "update" << BSON("$set" <<
+                                   BSON("book_time" << epidb::extras::to_mongo_date(now)
+                                        << "state" << TS_RUNNING
+                                        << "refresh_time" << epidb::extras::to_mongo_date(now)
+                                        << "owner" << hostname_pid)));
+
+        Connection c;
+        c->runCommand(m_db, cmd, res);
+        CHECK_DB_ERR(c);
+        c.done();
+
+        if (res["value"].isABSONObj()) {
+          break;
+        }
+      }
 
       if (!res["value"].isABSONObj()) {
-        if (m_verbose)
-          std::cout << "No task available, cmd:" << cmd << std::endl;
         return false;
       }
-
       m_ptr->m_current_task = res["value"].Obj().copy();
 
       int timeout_s = INT_MAX;
@@ -219,13 +319,18 @@ namespace epidb {
       c.done();
     }
 
-    void Client::reg(boost::asio::io_service &io_service, float interval)
+    void Client::serve(float interval)
     {
-      m_ptr->m_interval = interval;
-      m_ptr->m_timer.reset(new boost::asio::deadline_timer(io_service,
-                           boost::posix_time::seconds(interval) +
-                           boost::posix_time::millisec((int)(1000 * (interval - (int)interval)))));
-      m_ptr->m_timer->async_wait(boost::bind(&ClientImpl::update_check, m_ptr.get(), this, boost::asio::placeholders::error));
+      std::string _id;
+      mongo::BSONObj task;
+
+      while (true) {
+        // Take the next task right after finishing one, while there are tasks in the queue
+        while (get_next_task(_id, task)) {
+          handle_task(_id, task);
+        }
+        wait_new_task(interval);
+      }
     }
 
     void Client::handle_task(const std::string& _id, const mongo::BSONObj &o)
@@ -237,15 +342,18 @@ namespace epidb {
     Client::~Client() { }
 
 
-    std::string Client::store_result(const char *ptr, size_t len)
+    std::string Client::result_filename()
     {
       mongo::BSONObj &ct = m_ptr->m_current_task;
       if (ct.isEmpty()) {
         throw std::runtime_error("MDBQC: get a task first before you store something about it!");
       }
-      std::string filename = ct["_id"].str();
+      return ct["_id"].str();
+    }
 
-      return storage::store(filename, ptr, len);
+    std::string Client::store_result(const char *ptr, size_t len)
+    {
+      return storage::store(result_filename(), ptr, len);
     }
 
   }
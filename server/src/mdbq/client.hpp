@@ -29,11 +29,6 @@
 namespace mongo {
   class BSONObj;
 }
-namespace boost {
-  namespace asio {
-    class io_service;
-  }
-}
 
 namespace epidb {
   namespace mdbq {
@@ -83,11 +78,13 @@ namespace epidb {
       void finish(const mongo::BSONObj &result, bool ok = 1);
 
       /**
-       * register with the main loop
+       * process the tasks, never returns.
+       * the client wakes up when a task is queued by this process,
+       * the tasks queued by other processes are found by polling.
        *
-       * @param interval querying interval in seconds
+       * @param interval polling interval in seconds
        */
-      void reg(boost::asio::io_service &io_service, float interval);
+      void serve(float interval);
 
       /**
        * get the log of a task (mainly for testing)
@@ -110,6 +107,11 @@ namespace epidb {
        */
        std::string store_result(const char *ptr, size_t len);
 
+      /**
+       * Name of the file where the result of the current task is stored
+       */
+      std::string result_filename();
+
       /**
        * Destroy client.
        */
@@ -124,6 +126,12 @@ namespace epidb {
         m_verbose = v;
       }
     };
+
+    /**
+     * wake up one client of this process waiting for a task.
+     * called after a task is queued or set to be reprocessed.
+     */
+    void notify_new_task();
   }
 }
 #endif /* __MDBQ_CLIENT_HPP__ */
@@ -36,6 +36,14 @@ namespace epidb {
       _TS_END,
       _TS_FIRST = TS_NEW
     };
+
+    // Scheduling class of a job, the lower classes are taken first
+    enum JobClass {
+      JC_INTERACTIVE, // 0
+      JC_NORMAL,      // 1
+      JC_HEAVY,       // 2
+      _JC_END
+    };
   }
 }
 #endif /* __MDBQ_COMMON_HPP__ */
@@ -25,6 +25,7 @@
 
 #include <mongo/client/dbclient.h>
 
+#include "client.hpp"
 #include "hub.hpp"
 
 #include "../config/config.hpp"
@@ -166,12 +167,15 @@ namespace epidb {
                       << "refresh_time" << mongo::Undefined
                       << "misc"        << job
                       << "nfailed"     << (int)0
+                      << "class"       << job_class(job)
                       << "state"       << TS_NEW
                       << "version"     << (int)0
                     )
                );
       CHECK_DB_ERR_RETURN(c, msg);
       c.done();
+
+      notify_new_task();
       return true;
     }
 
@@ -204,6 +208,8 @@ namespace epidb {
       }
 
       c.done();
+
+      notify_new_task();
       return true;
     }
 
@@ -404,6 +410,63 @@ namespace epidb {
       }
     }
 
+    JobClass Hub::job_class(const mongo::BSONObj &job)
+    {
+      const std::string command = job["command"].str();
+
+      if (command == "count_regions" || command == "get_experiments_by_query") {
+        return JC_INTERACTIVE;
+      }
+      if (command == "lola" || command == "enrich_regions_fast" || command == "calculate_enrichment") {
+        return JC_HEAVY;
+      }
+      // The uploads are long and do not have a user waiting for their result
+      if (command == "add_experiment" || command == "add_annotation") {
+        return JC_HEAVY;
+      }
+      // The matrix cells are the query regions times the experiments
+      if (command == "score_matrix" && job.hasField("experiments_formats") &&
+          job["experiments_formats"].Obj().nFields() > SCORE_MATRIX_HEAVY_EXPERIMENTS) {
+        return JC_HEAVY;
+      }
+      return JC_NORMAL;
+    }
+
+    JobClass Hub::get_class(const mongo::BSONObj &o)
+    {
+      // Jobs queued before the classes existed
+      if (!o.hasField("class")) {
+        return JC_NORMAL;
+      }
+      return static_cast<JobClass>(o["class"].numberInt());
+    }
+
+    std::string Hub::class_name(const int job_class)
+    {
+      switch (job_class) {
+      case JC_INTERACTIVE:
+        return "interactive";
+      case JC_NORMAL:
+        return "normal";
+      case JC_HEAVY:
+        return "heavy";
+      default :
+        return "Invalid Class: " + epidb::utils::integer_to_string(job_class);
+      }
+    }
+
+    long Hub::get_wait_time(const mongo::BSONObj &o)
+    {
+      const int state = o["state"].numberInt();
+      if (state == TS_NEW || state == TS_RENEW || state == TS_REPROCESS) {
+        return (epidb::extras::universal_date_time() - get_create_time(o)).total_seconds();
+      }
+      if (o["book_time"].type() != mongo::Date) {
+        return 0;
+      }
+      return (epidb::extras::to_ptime(o["book_time"].Date()) - get_create_time(o)).total_seconds();
+    }
+
     boost::posix_time::ptime Hub::get_create_time(const mongo::BSONObj& o)
     {
       return epidb::extras::to_ptime(o["create_time"].Date());
@@ -46,6 +46,9 @@ namespace epidb {
   namespace mdbq {
     struct HubImpl;
 
+    // Above this number of experiments a score matrix is a heavy job
+    const int SCORE_MATRIX_HEAVY_EXPERIMENTS = 16;
+
     /**
      * MongoDB Queue Hub
      *
@@ -155,6 +158,23 @@ namespace epidb {
 
       static std::string state_message(const mongo::BSONObj& o);
 
+      /*
+      * \brief Scheduling class of a job description, from its command and estimated cost
+      */
+      static JobClass job_class(const mongo::BSONObj& job);
+
+      /*
+      * \brief Get the scheduling class of a request
+      */
+      static JobClass get_class(const mongo::BSONObj& o);
+
+      static std::string class_name(const int job_class);
+
+      /*
+      * \brief Seconds the request waited in the queue, until now when it is still waiting
+      */
+      static long get_wait_time(const mongo::BSONObj& o);
+
       /*
       * \brief Get the time at which a request was created
       */
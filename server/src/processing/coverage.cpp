@@ -36,7 +36,7 @@ namespace epidb {
       IS_PROCESSING_CANCELLED(status);
       processing::RunningOp runningOp =  status->start_operation(PROCESS_COVERAGE);
 
-      ChromosomeRegionsList chromosomeRegionsList;
+      ChromosomeRegionsListPtr chromosomeRegionsList;
       if (!dba::query::retrieve_query(user, query_id, status, chromosomeRegionsList, msg)) {
         return false;
       }
@@ -50,10 +50,10 @@ namespace epidb {
 
       size_t total_genome = 0;
       size_t genome_size = 0;
-      for (ChromosomeRegionsList::iterator it = chromosomeRegionsList.begin();
-           it != chromosomeRegionsList.end(); it++) {
-        std::string &chromosome = it->first;
-        Regions &regions = it->second;
+      for (ChromosomeRegionsList::const_iterator it = chromosomeRegionsList->begin();
+           it != chromosomeRegionsList->end(); it++) {
+        const std::string &chromosome = it->first;
+        const Regions &regions = it->second;
 
         genome_chromosomes.erase(chromosome);
 
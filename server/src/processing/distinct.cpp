@@ -38,22 +38,15 @@ namespace epidb {
       processing::RunningOp runningOp =  status->start_operation(PROCESS_DISTINCT);
 
 
-      ChromosomeRegionsList chromosomeRegionsList;
+      ChromosomeRegionsListPtr chromosomeRegionsList;
       if (!dba::query::retrieve_query(user, query_id, status, chromosomeRegionsList, msg)) {
         return false;
       }
 
-      size_t total_size = 0;
-      for (const auto& chromosomeRegions: chromosomeRegionsList) {
-        total_size += chromosomeRegions.second.size();
-      }
-
-      Regions all_regions(total_size);
-
       std::unordered_map<std::string, size_t> counter;
 
-      for (const auto& chromosomeRegions: chromosomeRegionsList) {
-        Regions regions = std::move(chromosomeRegions.second);
+      for (const auto& chromosomeRegions: *chromosomeRegionsList) {
+        const Regions &regions = chromosomeRegions.second;
 
         for (const RegionPtr& region: regions) {
           int column_pos;
@@ -19,15 +19,14 @@
 //
 
 
-#include <bitset>
-#include <future>
 #include <string>
-#include <sstream>
-#include <thread>
 
 #include <mongo/bson/bson.h>
 #include <mongo/client/dbclient.h>
 
+#include "../algorithms/interval_index.hpp"
+#include "../algorithms/signature.hpp"
+
 #include "../connection/connection.hpp"
 
 #include "../datatypes/user.hpp"
@@ -41,32 +40,29 @@
 #include "../extras/math.hpp"
 #include "../extras/utils.hpp"
 
-#include "../threading/semaphore.hpp"
-
-#include <boost/serialization/bitset.hpp>
-
-#include <boost/archive/binary_oarchive.hpp>
-#include <boost/archive/binary_iarchive.hpp>
+#include "../threading/executor.hpp"
 
 #include "enrichment_result.hpp"
 
 #include "../log.hpp"
 
-#define BITMAP_SIZE (1024 * 1024)
+// Approximate number of tiles of the genome, that are the universe of the signatures
+#define SIGNATURE_TILES (1024 * 1024)
 
 namespace epidb {
 
   namespace processing {
 
-    bool store(const std::string &id, const std::bitset<BITMAP_SIZE>& bitmap,  processing::StatusPtr status, std::string& msg);
+    bool store(const std::string &id, const std::string& data,  processing::StatusPtr status, std::string& msg);
 
-    bool load(const std::string &id, std::bitset<BITMAP_SIZE>& bitset,  processing::StatusPtr status, std::string& msg);
+    bool load(const std::string &id, const size_t universe, mongo::BSONObj& obj, algorithms::Signature& signature,
+              processing::StatusPtr status, std::string& msg);
 
     ProcessOverlapResult compare_to(const datatypes::User& user,
-                                    const std::bitset<BITMAP_SIZE>& query_bitmap,
+                                    const algorithms::Signature& query_signature,
                                     const utils::IdName& exp,
                                     const ChromosomeRegionsList& bitmap_regions,
-                                    processing::StatusPtr status, threading::SemaphorePtr sem,
+                                    processing::StatusPtr status,
                                     std::string& msg);
 
     bool get_bitmap_regions(const datatypes::User& user, const std::string &query_id,
@@ -75,14 +71,23 @@ namespace epidb {
 
     bool process_bitmap_query(const datatypes::User& user, const std::string &query_id,
                               const ChromosomeRegionsList& bitmap_regions,
-                              std::bitset<BITMAP_SIZE>& out_bitmap,
+                              std::string& out_data,
                               processing::StatusPtr status, std::string& msg);
 
     bool process_bitmap_experiment(const datatypes::User& user, const std::string &id,
                                    const ChromosomeRegionsList& bitmap_regions,
-                                   std::bitset<BITMAP_SIZE>& out_bitmap,
+                                   std::string& out_data,
                                    processing::StatusPtr status, std::string& msg);
 
+    // Each tile of the genome is one position of the signatures
+    size_t universe_size(const ChromosomeRegionsList& bitmap_regions)
+    {
+      size_t size = 0;
+      for (const auto& chromosome : bitmap_regions) {
+        size += chromosome.second.size();
+      }
+      return size;
+    }
 
 
     bool enrich_regions_fast(const datatypes::User& user, const std::string& query_id, const std::vector<utils::IdName>& names,
@@ -99,45 +104,39 @@ namespace epidb {
         return false;
       }
 
-      std::bitset<BITMAP_SIZE> query_bitmap;
-      if (!load(query_id, query_bitmap, status, msg)) {
-        if (!process_bitmap_query(user, query_id, bitmap_regions, query_bitmap, status,  msg)) {
+      // The query signature refers to the data of the loaded object or of the built signature
+      mongo::BSONObj query_obj;
+      std::string query_data;
+      algorithms::Signature query_signature;
+      if (!load(query_id, universe_size(bitmap_regions), query_obj, query_signature, status, msg)) {
+        if (!process_bitmap_query(user, query_id, bitmap_regions, query_data, status,  msg)) {
+          return false;
+        }
+        if (!store(query_id, query_data, status, msg)) {
           return false;
         }
-        if (!store(query_id, query_bitmap, status, msg)) {
+        if (!query_signature.load(query_data.data(), query_data.size(), msg)) {
           return false;
         }
       }
 
-      std::vector<std::future<ProcessOverlapResult > > threads;
-
-
       runningOp.set_total_steps(names.size());
 
-      threading::SemaphorePtr sem = threading::build_semaphore(16);
-      for (const auto& exp: names) {
-        utils::IdNameCount result;
-
-        sem->down();
-        auto t = std::async(std::launch::async, &compare_to,
-                            std::ref(user),
-                            std::ref(query_bitmap), std::ref(exp),
-                            std::ref(bitmap_regions),
-                            status, sem,
-                            std::ref(msg));
-
-        threads.emplace_back(std::move(t));
+      std::vector<ProcessOverlapResult> results(names.size());
+      threading::TaskGroup tasks(status->task_limit());
+      for (size_t i = 0; i < names.size(); ++i) {
+        tasks.spawn([&, i]() {
+          std::string task_msg;
+          results[i] = compare_to(user, query_signature, names[i], bitmap_regions, status, task_msg);
+        });
       }
+      tasks.wait();
 
       std::vector<std::tuple<std::string, size_t>> datasets_support;
       std::vector<std::tuple<std::string, double>> datasets_log_score;
       std::vector<std::tuple<std::string, double>> datasets_odds_score;
 
-      std::vector<ProcessOverlapResult> results;
-
-      for (size_t i = 0; i < threads.size(); ++i) {
-        threads[i].wait();
-        auto result = threads[i].get();
+      for (const auto& result : results) {
         runningOp.increment_step();
         std::string dataset = std::get<0>(result);
 
@@ -145,8 +144,6 @@ namespace epidb {
         datasets_log_score.push_back(std::make_tuple(dataset, std::get<6>(result)));
         datasets_odds_score.push_back(std::make_tuple(dataset, std::get<7>(result)));
         datasets_support.push_back(std::make_tuple(dataset, std::get<8>(result)));
-
-        results.emplace_back(std::move(result));
       }
 
       std::vector<std::shared_ptr<ExperimentResult>> experiment_results =
@@ -173,10 +170,10 @@ namespace epidb {
     }
 
     ProcessOverlapResult compare_to(const datatypes::User& user,
-                                    const std::bitset<BITMAP_SIZE>& query_bitmap,
+                                    const algorithms::Signature& query_signature,
                                     const utils::IdName& exp,
                                     const ChromosomeRegionsList& bitmap_regions,
-                                    processing::StatusPtr status, threading::SemaphorePtr sem,
+                                    processing::StatusPtr status,
                                     std::string& msg)
     {
       processing::RunningOp runningOp = status->start_operation(processing::PROCESS_ENRICH_REGIONS_FAST_COMPARE_TO);
@@ -184,22 +181,25 @@ namespace epidb {
         return std::make_tuple(exp.name, "", "", "", -1.0, "", -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, true, msg);
       }
 
-      std::bitset<BITMAP_SIZE> exp_bitmap;
+      const size_t universe = query_signature.universe();
 
-      if (!load(exp.id, exp_bitmap, status, msg)) {
-        if (!process_bitmap_experiment(user, exp.id, bitmap_regions, exp_bitmap, status, msg)) {
-          sem->up();
+      mongo::BSONObj exp_obj;
+      std::string exp_data;
+      algorithms::Signature exp_signature;
+      if (!load(exp.id, universe, exp_obj, exp_signature, status, msg)) {
+        if (!process_bitmap_experiment(user, exp.id, bitmap_regions, exp_data, status, msg)) {
+          return std::make_tuple(exp.name, "", "", "", -1.0, "", -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, true, msg);
+        }
+        if (!store(exp.id, exp_data, status, msg)) {
           return std::make_tuple(exp.name, "", "", "", -1.0, "", -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, true, msg);
         }
-        if (!store(exp.id, exp_bitmap, status, msg)) {
-          sem->up();
+        if (!exp_signature.load(exp_data.data(), exp_data.size(), msg)) {
           return std::make_tuple(exp.name, "", "", "", -1.0, "", -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, true, msg);
         }
       }
 
       mongo::BSONObj experiment_obj;
       if (!dba::experiments::by_name(exp.name, experiment_obj, msg)) {
-        sem->up();
         return std::make_tuple(exp.name, "", "", "", -1.0, "", -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, true, msg);
       }
 
@@ -212,19 +212,18 @@ namespace epidb {
         description = experiment_obj["description"].String();
       }
 
-      size_t count = (query_bitmap & exp_bitmap).count();
+      size_t count = query_signature.and_count(exp_signature);
 
       double a = count;
-      double b = exp_bitmap.count() - a;
+      double b = exp_signature.count() - a;
 
       if (b < 0) {
-        sem->up();
         msg = "Negative b entry in table. This means either: 1) Your user sets contain items outside your universe; or 2) your universe has a region that overlaps multiple user set regions, interfering with the universe set overlap calculation.";
         return std::make_tuple(exp.name, biosource, epigenetic_mark, description, -1, "", -1, -1, -1, -1, -1, -1, true, msg);
       }
 
-      double c = query_bitmap.count()  - a;
-      double d = BITMAP_SIZE - a - b - c;
+      double c = query_signature.count()  - a;
+      double d = universe - a - b - c;
 
       double p_value = math::fisher_test(a, b, c, d);
 
@@ -240,45 +239,35 @@ namespace epidb {
         odds_score = a_b/c_d;
       }
 
-      sem->up();
-      return std::make_tuple(exp.name, biosource, epigenetic_mark, "", BITMAP_SIZE, "", negative_natural_log, odds_score, a, b, c, d, false, msg);
+      return std::make_tuple(exp.name, biosource, epigenetic_mark, "", universe, "", negative_natural_log, odds_score, a, b, c, d, false, msg);
     }
 
-    bool store(const std::string &id, const std::bitset<BITMAP_SIZE>& bitmap, processing::StatusPtr status, std::string& msg)
+    bool store(const std::string &id, const std::string& data, processing::StatusPtr status, std::string& msg)
     {
       processing::RunningOp runningOp = status->start_operation(processing::PROCESS_ENRICH_REGIONS_FAST_STORE_BITMAP);
       if (processing::is_canceled(status, msg)) {
         return false;
       }
 
-      std::stringstream stream;
-      boost::archive::binary_oarchive ar(stream, boost::archive::no_header);
-      ar & bitmap;
-
-      size_t size = stream.str().size();
-      const char* data = stream.str().data();
-
       mongo::BSONObjBuilder bob;
       bob.append("_id", id);
-      bob.appendBinData("data", size, mongo::BinDataGeneral, (void *) data);
+      bob.appendBinData("data", data.size(), mongo::BinDataGeneral, data.data());
 
+      // Upsert, replacing the signatures of the previous format or of another universe
       Connection c;
-      try {
-        c->insert(dba::helpers::collection_name(dba::Collections::SIGNATURES()), bob.obj());
-      } catch (const mongo::OperationException& e ) {
-        const auto& info = e.obj();
-        if (info["code"].Int() == 11000) {
-          EPIDB_LOG_TRACE("Error while inserting the bitmap for the ID:" + id + ". It was already inserted.");
-        } else {
-          throw e;
-        }
+      c->update(dba::helpers::collection_name(dba::Collections::SIGNATURES()), BSON("_id" << id), bob.obj(), true, false);
+      if (!c->getLastError().empty()) {
+        msg = c->getLastError();
+        c.done();
+        return false;
       }
       c.done();
 
       return true;
     }
 
-    bool load(const std::string &id, std::bitset<BITMAP_SIZE>& bitset, processing::StatusPtr status, std::string& msg)
+    bool load(const std::string &id, const size_t universe, mongo::BSONObj& obj, algorithms::Signature& signature,
+              processing::StatusPtr status, std::string& msg)
     {
       processing::RunningOp runningOp = status->start_operation(processing::PROCESS_ENRICH_REGIONS_FAST_LOAD_BITMAP);
       if (processing::is_canceled(status, msg)) {
@@ -286,25 +275,30 @@ namespace epidb {
       }
 
       auto query = BSON("_id" << id);
-      mongo::BSONObj result;
-      if (!dba::helpers::get_one(dba::Collections::SIGNATURES(), query, result)) {
+      if (!dba::helpers::get_one(dba::Collections::SIGNATURES(), query, obj)) {
         msg = Error::m(ERR_INVALID_EXPERIMENT_ID, id);
         return false;
       }
 
+      // The signature is read in place, in the data of obj
       int size;
-      const auto data = result["data"].binData(size);
-      std::istringstream ss(std::string(data,size));
+      const char* data = obj["data"].binData(size);
+      if (!signature.load(data, size, msg)) {
+        EPIDB_LOG_TRACE("Rebuilding the signature of " + id + ": " + msg);
+        return false;
+      }
 
-      boost::archive::binary_iarchive ar(ss, boost::archive::no_header);
-      ar & bitset;
+      if (signature.universe() != universe) {
+        msg = "The signature of " + id + " was built for another universe";
+        return false;
+      }
 
       return true;
     }
 
 
     bool build_bitmap(const Regions& ranges, const Regions& data,
-                      size_t &pos, std::bitset<BITMAP_SIZE>& bitmap,
+                      size_t &pos, algorithms::SignatureBuilder& builder,
                       processing::StatusPtr status, std::string& msg)
     {
       processing::RunningOp runningOp = status->start_operation(processing::PROCESS_ENRICH_REGIONS_FAST_BUILD_BITMAP);
@@ -312,35 +306,19 @@ namespace epidb {
         return false;
       }
 
-      auto it_ranges = ranges.begin();
-      auto it_data_begin = data.begin();
-
-      while (it_ranges != ranges.end()) {
-        bool overlap = false;
-        while ( it_data_begin != data.end()
-                && (*it_data_begin)->end() < (*it_ranges)->start() )  {
-          it_data_begin++;
-        }
-
-        auto it_data = it_data_begin;
-        while (it_data != data.end() &&
-               (*it_ranges)->end() >= (*it_data)->start() ) {
+      const algorithms::IntervalIndex index(data);
 
-          if (((*it_ranges)->start() <= (*it_data)->end()) && ((*it_ranges)->end() >= (*it_data)->start())) {
-            overlap = true;
-          }
-          it_data++;
-        }
+      for (const auto &range : ranges) {
+        const bool overlap = index.any_overlap(range->start(), range->end());
         if (overlap) {
-          if (pos >= BITMAP_SIZE) {
+          if (pos >= builder.universe()) {
             msg = "Invalid position - " + utils::integer_to_string(pos);
             return false;
           }
-          bitmap.set(pos);
+          builder.add(pos);
         }
 
         pos++;
-        it_ranges++;
       }
 
       return true;
@@ -379,7 +357,7 @@ namespace epidb {
         total_genome_size += chromosome.size;
       }
 
-      size_t d = total_genome_size / BITMAP_SIZE;
+      size_t d = total_genome_size / SIGNATURE_TILES;
       size_t tiling_size = d + chromosomes.size() + 1;
 
       auto tiling_query = BSON("args" <<
@@ -396,7 +374,7 @@ namespace epidb {
 
     bool process_bitmap_query(const datatypes::User& user, const std::string &query_id,
                               const ChromosomeRegionsList& bitmap_regions,
-                              std::bitset<BITMAP_SIZE>& out_bitmap,
+                              std::string& out_data,
                               processing::StatusPtr status, std::string& msg)
     {
       processing::RunningOp runningOp = status->start_operation(processing::PROCESS_ENRICH_REGIONS_FAST_BITMAP_QUERY);
@@ -405,6 +383,7 @@ namespace epidb {
       }
 
       size_t pos = 0;
+      algorithms::SignatureBuilder builder(universe_size(bitmap_regions));
       ChromosomeRegionsList data_regions;
       if (!dba::query::retrieve_query(user, query_id, status, data_regions, msg, true)) {
         return false;
@@ -414,7 +393,7 @@ namespace epidb {
         bool found = false;
         for (auto &datum: data_regions) {
           if (chromosome.first == datum.first) {
-            if (!build_bitmap(chromosome.second, datum.second, pos, out_bitmap, status, msg)) {
+            if (!build_bitmap(chromosome.second, datum.second, pos, builder, status, msg)) {
               msg += " (Query ID: " + query_id + ", chromosome: " + chromosome.first + ")";
               return false;
             }
@@ -426,18 +405,19 @@ namespace epidb {
         }
         if (!found) {
           Regions empty_data;
-          if (!build_bitmap(chromosome.second, empty_data, pos, out_bitmap, status, msg)) {
+          if (!build_bitmap(chromosome.second, empty_data, pos, builder, status, msg)) {
             msg += " (Query ID: " + query_id + ", chromosome: " + chromosome.first + "(empty))";
             return false;
           }
         }
       }
+      out_data = builder.serialize();
       return true;
     }
 
     bool process_bitmap_experiment(const datatypes::User& user, const std::string &id,
                                    const ChromosomeRegionsList& bitmap_regions,
-                                   std::bitset<BITMAP_SIZE>& out_bitmap,
+                                   std::string& out_data,
                                    processing::StatusPtr status, std::string& msg)
     {
       processing::RunningOp runningOp = status->start_operation(processing::PROCESS_ENRICH_REGIONS_FAST_BITMAP_EXPERIMENT);
@@ -453,6 +433,7 @@ namespace epidb {
       const std::string& norm_genome = experiment_obj["norm_genome"].String();
 
       size_t pos = 0;
+      algorithms::SignatureBuilder builder(universe_size(bitmap_regions));
       for (auto &chromosome : bitmap_regions) {
         mongo::BSONObj regions_query;
         if (!dba::query::build_experiment_query(-1, -1, norm_exp_name, regions_query, msg)) {
@@ -464,7 +445,7 @@ namespace epidb {
           return false;
         }
 
-        if (!build_bitmap(chromosome.second, data,  pos, out_bitmap, status, msg)) {
+        if (!build_bitmap(chromosome.second, data,  pos, builder, status, msg)) {
           msg += " (Query ID: " + id + ", chromosome: " + chromosome.first + "(empty))";
           return false;
         }
@@ -474,6 +455,8 @@ namespace epidb {
         }
       }
 
+      out_data = builder.serialize();
+
       return true;
     }
   };
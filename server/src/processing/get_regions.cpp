@@ -27,6 +27,7 @@
 
 #include "../datatypes/column_types_def.hpp"
 #include "../datatypes/regions.hpp"
+#include "../datatypes/regions_block.hpp"
 
 #include "../dba/dba.hpp"
 #include "../dba/column_types.hpp"
@@ -42,9 +43,16 @@
 namespace epidb {
   namespace processing {
 
-    static inline bool format_region(StringBuilder &sb, const std::string &chromosome, RegionPtr region,
+    static inline bool format_region(StringBuilder &sb, const std::string &chromosome, const AbstractRegion *region,
                                      const parser::FileFormat &format, dba::Metafield &metafield, processing::StatusPtr status, std::string &msg);
 
+    static inline bool format_region(StringBuilder &sb, const std::string &chromosome, const RegionsBlock &block, const size_t row,
+                                     const parser::FileFormat &format, dba::Metafield &metafield, processing::StatusPtr status, std::string &msg);
+
+    static bool get_dataset_format(const std::string &output_format, const DatasetId dataset_id,
+                                   std::unordered_map<DatasetId, parser::FileFormat> &datasets_formats,
+                                   processing::StatusPtr status, parser::FileFormat &format, std::string &msg);
+
     bool get_regions(const datatypes::User& user,
                      const std::string &query_id, const std::string &format,
                      processing::StatusPtr status, StringBuilder &sb, std::string &msg)
@@ -52,12 +60,26 @@ namespace epidb {
       IS_PROCESSING_CANCELLED(status);
       processing::RunningOp runningOp =  status->start_operation(PROCESS_GET_REGIONS);
 
-      ChromosomeRegionsList chromosomeRegionsList;
+      bool columnar;
+      dba::query::QueryObjects queries;
+      if (!dba::query::is_columnar_query(query_id, columnar, queries, msg)) {
+        return false;
+      }
+
+      if (columnar) {
+        ChromosomeRegionsBlockList chromosomeRegionsBlockList;
+        if (!dba::query::retrieve_query(user, query_id, queries, status, chromosomeRegionsBlockList, msg)) {
+          return false;
+        }
+        return format_regions(format, chromosomeRegionsBlockList, status, sb, msg);
+      }
+
+      ChromosomeRegionsListPtr chromosomeRegionsList;
       if (!dba::query::retrieve_query(user, query_id, status, chromosomeRegionsList, msg)) {
         return false;
       }
 
-      if (!format_regions(format, chromosomeRegionsList, status, sb, msg)) {
+      if (!format_regions(format, *chromosomeRegionsList, status, sb, msg)) {
         return false;
       }
 
@@ -65,7 +87,7 @@ namespace epidb {
     }
 
 
-    bool format_regions(const std::string &output_format, ChromosomeRegionsList &chromosomeRegionsList, processing::StatusPtr status,
+    bool format_regions(const std::string &output_format, const ChromosomeRegionsList &chromosomeRegionsList, processing::StatusPtr status,
                         StringBuilder &sb, std::string &msg)
     {
       std::unordered_map<DatasetId, parser::FileFormat> datasets_formats;
@@ -74,10 +96,10 @@ namespace epidb {
       DatasetId actual_id = -1;
       parser::FileFormat format;
 
-      for (ChromosomeRegionsList::iterator it = chromosomeRegionsList.begin();
+      for (ChromosomeRegionsList::const_iterator it = chromosomeRegionsList.begin();
            it != chromosomeRegionsList.end(); it++) {
-        std::string &chromosome = it->first;
-        Regions &regions = it->second;
+        const std::string &chromosome = it->first;
+        const Regions &regions = it->second;
 
         if (regions.empty()) {
           continue;
@@ -106,37 +128,87 @@ namespace epidb {
           }
           // ***
 
-          if (!status->is_allowed_size(sb.size())) {
+          // The streamed output is bounded by the compression queue, only the kept output is checked
+          if (!sb.streams() && !status->is_allowed_size(sb.size())) {
             msg = "The output string ("  + utils::size_t_to_string(sb.size()/1024/1024) + "MBytes) is bigger than the size that you are allowed to use: '" + utils::size_t_to_string(status->maximum_size()/1024/1024) +
                   " MBytes'. We recomend you to select fewer experiments, chromosomes, or check the metafields that you are using, for example the @SEQUENCE metafield.";
             return false;
           }
 
-          RegionPtr region = std::move(*cit);
+          const AbstractRegion *region = cit->get();
           DatasetId dataset_id = region->dataset_id();
 
           if (actual_id != dataset_id) {
-            std::vector<mongo::BSONObj> columns;
-            auto it = datasets_formats.find(dataset_id);
-            if (it == datasets_formats.end()) {
-              if (!cache::get_columns_from_dataset(dataset_id, columns, msg)) {
-                return false;
-              }
-              parser::FileFormat new_format;
-              if (!parser::FileFormatBuilder::build_for_outout(output_format, columns, status, new_format, msg)) {
-                return false;
-              }
-              datasets_formats[dataset_id] = new_format;
-              format = new_format;
-
-            } else {
-              auto format_it = datasets_formats.find(dataset_id);
-              format = format_it->second;
+            if (!get_dataset_format(output_format, dataset_id, datasets_formats, status, format, msg)) {
+              return false;
+            }
+            actual_id = dataset_id;
+          }
+
+          if (!format_region(sb, chromosome, region, format, metafield, status, msg)) {
+            return false;
+          }
+        }
+      }
+      return true;
+    }
+
+    bool format_regions(const std::string &output_format, ChromosomeRegionsBlockList &chromosomeRegionsBlockList, processing::StatusPtr status,
+                        StringBuilder &sb, std::string &msg)
+    {
+      std::unordered_map<DatasetId, parser::FileFormat> datasets_formats;
+      dba::Metafield metafield;
+
+      DatasetId actual_id = -1;
+      parser::FileFormat format;
+
+      for (auto it = chromosomeRegionsBlockList.begin(); it != chromosomeRegionsBlockList.end(); it++) {
+        const std::string &chromosome = it->first;
+        const RegionsBlock &block = it->second;
+
+        if (block.empty()) {
+          continue;
+        }
+
+        processing::RunningOp runningOp = status->start_operation(processing::FORMAT_OUTPUT,
+                                          BSON("format" << output_format << "chromosome" << chromosome << "regions" << (long long) block.size()));
+
+        if (it != chromosomeRegionsBlockList.begin()) {
+          sb.endLine();
+        }
+
+        for (size_t row = 0; row < block.size(); row++) {
+          if (row > 0) {
+            sb.endLine();
+          }
+
+          // Check if processing was canceled
+          bool is_canceled = false;
+          if (!status->is_canceled(is_canceled, msg)) {
+            return true;
+          }
+          if (is_canceled) {
+            msg = Error::m(ERR_REQUEST_CANCELED);
+            return false;
+          }
+          // ***
+
+          // The streamed output is bounded by the compression queue, only the kept output is checked
+          if (!sb.streams() && !status->is_allowed_size(sb.size())) {
+            msg = "The output string ("  + utils::size_t_to_string(sb.size()/1024/1024) + "MBytes) is bigger than the size that you are allowed to use: '" + utils::size_t_to_string(status->maximum_size()/1024/1024) +
+                  " MBytes'. We recomend you to select fewer experiments, chromosomes, or check the metafields that you are using, for example the @SEQUENCE metafield.";
+            return false;
+          }
+
+          DatasetId dataset_id = block.dataset_id(row);
+          if (actual_id != dataset_id) {
+            if (!get_dataset_format(output_format, dataset_id, datasets_formats, status, format, msg)) {
+              return false;
             }
             actual_id = dataset_id;
           }
 
-          if (!format_region(sb, chromosome, std::move(region), format, metafield, status, msg)) {
+          if (!format_region(sb, chromosome, block, row, format, metafield, status, msg)) {
             return false;
           }
         }
@@ -144,7 +216,91 @@ namespace epidb {
       return true;
     }
 
-    static inline bool format_region(StringBuilder &sb, const std::string &chromosome, RegionPtr region,
+    static bool get_dataset_format(const std::string &output_format, const DatasetId dataset_id,
+                                   std::unordered_map<DatasetId, parser::FileFormat> &datasets_formats,
+                                   processing::StatusPtr status, parser::FileFormat &format, std::string &msg)
+    {
+      auto it = datasets_formats.find(dataset_id);
+      if (it != datasets_formats.end()) {
+        format = it->second;
+        return true;
+      }
+
+      std::vector<mongo::BSONObj> columns;
+      if (!cache::get_columns_from_dataset(dataset_id, columns, msg)) {
+        return false;
+      }
+      parser::FileFormat new_format;
+      if (!parser::FileFormatBuilder::build_for_outout(output_format, columns, status, new_format, msg)) {
+        return false;
+      }
+      datasets_formats[dataset_id] = new_format;
+      format = new_format;
+      return true;
+    }
+
+    // The region object is only built when a metafield or calculated column needs it.
+    static inline bool format_region(StringBuilder &sb, const std::string &chromosome, const RegionsBlock &block, const size_t row,
+                                     const parser::FileFormat &format, dba::Metafield &metafield, processing::StatusPtr status, std::string &msg)
+    {
+      RegionPtr region;
+
+      for (parser::FileFormat::const_iterator it =  format.begin(); it != format.end(); it++) {
+        const dba::columns::ColumnTypePtr &column = *it;
+
+        if (it != format.begin()) {
+          sb.tab();
+        }
+
+        if ( column->name() == "CHROMOSOME") {
+          sb.append(chromosome);
+
+        } else if (column->name() == "START") {
+          sb.append(utils::integer_to_string(block.start(row)));
+
+        } else if (column->name() == "END") {
+          sb.append(utils::integer_to_string(block.end(row)));
+
+        } else if (dba::Metafield::is_meta(column->name()) || column->type() == datatypes::COLUMN_CALCULATED) {
+          if (!region) {
+            region = block.region(row);
+          }
+
+          std::string result;
+          if (column->type() == datatypes::COLUMN_CALCULATED) {
+            if (!column->execute(chromosome, region.get(), metafield, result, msg)) {
+              return false;
+            }
+          } else if (!metafield.process(column->name(), chromosome, region.get(), status, result, msg)) {
+            return false;
+          }
+          if (!result.empty()) {
+            sb.append(std::move(result));
+          }
+
+        } else if (column->type() == datatypes::COLUMN_INTEGER) {
+          const Score v = block.value(row, column->pos());
+          if (v != std::numeric_limits<Score>::min()) {
+            sb.append(utils::integer_to_string((int)v));
+          }
+
+        } else if ( ( column->type() == datatypes::COLUMN_DOUBLE) ||  (column->type() == datatypes::COLUMN_RANGE)) {
+          const Score v = block.value(row, column->pos());
+          if (v != std::numeric_limits<Score>::min()) {
+            sb.append(utils::score_to_string(v));
+          }
+
+        } else {
+          const std::string &o = block.get_string(row, column->pos());
+          if (!o.empty()) {
+            sb.append(o);
+          }
+        }
+      }
+      return true;
+    }
+
+    static inline bool format_region(StringBuilder &sb, const std::string &chromosome, const AbstractRegion *region,
                                      const parser::FileFormat &format, dba::Metafield &metafield, processing::StatusPtr status, std::string &msg)
     {
       for (parser::FileFormat::const_iterator it =  format.begin(); it != format.end(); it++) {
@@ -167,7 +323,7 @@ namespace epidb {
 
         } else if (dba::Metafield::is_meta(column->name())) {
           std::string result;
-          if (!metafield.process(column->name(), chromosome, region.get(), status, result, msg)) {
+          if (!metafield.process(column->name(), chromosome, region, status, result, msg)) {
             return false;
           }
           if (!result.empty()) {
@@ -176,7 +332,7 @@ namespace epidb {
 
         } else if (column->type() == datatypes::COLUMN_CALCULATED) {
           std::string result;
-          if (!column->execute(chromosome, region.get(), metafield, result, msg)) {
+          if (!column->execute(chromosome, region, metafield, result, msg)) {
             return false;
           }
           sb.append(std::move(result));
@@ -19,10 +19,8 @@
 //
 
 #include <algorithm> // for min and max
-#include <future>
 #include <iterator>
 #include <string>
-#include <thread>
 
 #include "../algorithms/algorithms.hpp"
 
@@ -36,7 +34,7 @@
 #include "../extras/math.hpp"
 #include "../extras/utils.hpp"
 
-#include "../threading/semaphore.hpp"
+#include "../threading/executor.hpp"
 
 #include "enrichment_result.hpp"
 
@@ -50,7 +48,7 @@ namespace epidb {
                                          const std::string dataset_name, const std::string description,
                                          const std::string database_name,
                                          const ChromosomeRegionsList &universe_regions, const long total_universe_regions,
-                                         processing::StatusPtr status, threading::SemaphorePtr sem,
+                                         processing::StatusPtr status,
                                          std::string& msg)
     {
       ChromosomeRegionsList database_regions;
@@ -60,21 +58,18 @@ namespace epidb {
 
       if (utils::is_id(dataset_name, "q")) {
         if (!dba::query::retrieve_query(user, dataset_name, status, database_regions, msg, /* reduced_mode */ true)) {
-          sem->up();
           return std::make_tuple(dataset_name, biosource, epigenetic_mark, description, -1, database_name, -1, -1, -1, -1, -1, -1, true, msg);
         }
 
         std::vector<std::string> exp_biosources;
         const std::string bs_field_name = "sample_info.biosource_name";
         if (!dba::query::get_main_experiment_data(user, dataset_name, bs_field_name, status, exp_biosources, msg)) {
-          sem->up();
           return std::make_tuple(dataset_name, biosource, epigenetic_mark, description, -1, database_name, -1, -1, -1, -1, -1, -1, true, msg);
         }
 
         std::vector<std::string> exp_epigenetic_marks;
         const std::string em_field_name = "epigenetic_mark";
         if (!dba::query::get_main_experiment_data(user, dataset_name, em_field_name, status, exp_epigenetic_marks, msg)) {
-          sem->up();
           return std::make_tuple(dataset_name, biosource, epigenetic_mark, description, -1, database_name, -1, -1, -1, -1, -1, -1, true, msg);
         }
 
@@ -84,18 +79,15 @@ namespace epidb {
         mongo::BSONObj regions_query;
 
         if (!dba::query::build_experiment_query(-1, -1, utils::normalize_name(dataset_name), regions_query, msg)) {
-          sem->up();
           return std::make_tuple(dataset_name, biosource, epigenetic_mark, description, -1, database_name, -1, -1, -1, -1, -1, -1, true, msg);
         }
 
         if (!dba::retrieve::get_regions(genome, chromosomes, regions_query, false, status, database_regions, msg, /* reduced_mode */ true)) {
-          sem->up();
           return std::make_tuple(dataset_name, biosource, epigenetic_mark, description, -1, database_name, -1, -1, -1, -1, -1, -1, true, msg);
         }
 
         mongo::BSONObj experiment_obj;
         if (!dba::experiments::by_name(dataset_name, experiment_obj, msg)) {
-          sem->up();
           return std::make_tuple(dataset_name, biosource, epigenetic_mark, description, -1, database_name, -1, -1, -1, -1, -1, -1, true, msg);
         }
 
@@ -114,8 +106,7 @@ namespace epidb {
       // Turn results into an overlap matrix. It is
       // dbSets (rows) by userSets (columns), counting overlap.
       size_t query_overlap_total;
-      if (!algorithms::intersect_count(redefined_universe_overlap_query, database_regions, query_overlap_total)) {
-        sem->up();
+      if (!algorithms::intersect_count(redefined_universe_overlap_query, database_regions, status, query_overlap_total)) {
         return std::make_tuple(dataset_name, biosource, epigenetic_mark, description, count_database_regions, database_name, -1, -1, -1, -1, -1, -1, true, msg);
       }
       double a = query_overlap_total;
@@ -125,8 +116,7 @@ namespace epidb {
       // less the support; This is the number of items in the universe
       // that are in the dbSet ONLY (not in userSet)
       size_t universe_overlap_with_database_total;
-      if (!algorithms::intersect_count(universe_regions, database_regions, universe_overlap_with_database_total)) {
-        sem->up();
+      if (!algorithms::intersect_count(universe_regions, database_regions, status, universe_overlap_with_database_total)) {
         return std::make_tuple(dataset_name, biosource, epigenetic_mark, description, count_database_regions, database_name, -1, -1, -1, -1, -1, -1, true, msg);
       }
       double b = universe_overlap_with_database_total - a;
@@ -142,13 +132,11 @@ namespace epidb {
 
 
       if (b < 0) {
-        sem->up();
         msg = "Negative b entry in table. This means either: 1) Your user sets contain items outside your universe; or 2) your universe has a region that overlaps multiple user set regions, interfering with the universe set overlap calculation. Dataset: " + dataset_name;
         return std::make_tuple(dataset_name, biosource, epigenetic_mark, description, count_database_regions, database_name, -1, -1, a, b, c, d, true, msg);
       }
 
       if (d < 0) {
-        sem->up();
         msg = "Negative d entry in table. This means either: 1) Your user sets contain items outside your universe; or 2) your universe has a region that overlaps multiple user set regions, interfering with the universe set overlap calculation. Dataset: " + dataset_name ;
         return std::make_tuple(dataset_name, biosource, epigenetic_mark, description, count_database_regions, database_name, -1, -1, a, b, c, d, true, msg);
       }
@@ -177,7 +165,6 @@ namespace epidb {
 
       status->subtract_size(total_size_to_remove);
 
-      sem->up();
       return std::make_tuple(dataset_name, biosource, epigenetic_mark, description, count_database_regions, database_name, negative_natural_log, odds_score, a, b, c, d, false, "");
     }
 
@@ -191,6 +178,12 @@ namespace epidb {
       IS_PROCESSING_CANCELLED(status);
       processing::RunningOp runningOp =  status->start_operation(PROCESS_ENRICH_REGIONS_OVERLAP);
 
+      // The universe usually contains the query, their common sub-queries are evaluated once.
+      if (!dba::query::plan_query(query_id, status, msg) ||
+          !dba::query::plan_query(universe_query_id, status, msg)) {
+        return false;
+      }
+
       ChromosomeRegionsList query_regions;
       if (!dba::query::retrieve_query(user, query_id, status, query_regions, msg, /* reduced_mode */ true)) {
         return false;
@@ -203,7 +196,7 @@ namespace epidb {
       }
       size_t total_universe_regions = count_regions(universe_regions);
 
-      ChromosomeRegionsList disjoin_set = algorithms::disjoin(std::move(universe_regions));
+      ChromosomeRegionsList disjoin_set = algorithms::disjoin(std::move(universe_regions), status);
       size_t disjoin_set_count = count_regions(disjoin_set);
 
       universe_regions = std::move(disjoin_set);
@@ -225,10 +218,6 @@ namespace epidb {
       std::vector<std::tuple<std::string, double>> datasets_log_score;
       std::vector<std::tuple<std::string, double>> datasets_odds_score;
 
-      std::vector<std::future<ProcessOverlapResult > > threads;
-
-      threading::SemaphorePtr sem = threading::build_semaphore(128);
-
       std::vector<std::pair<mongo::BSONObj, std::string>> all_datasets;
 
       auto databases_it = databases.begin();
@@ -251,39 +240,31 @@ namespace epidb {
 
 
 
-      for (const auto& dataset_database : all_datasets) {
-        const auto dataset = dataset_database.first;
-        const auto database_name = dataset_database.second;
-        const auto dataset_name = dataset["name"].String();
-        const auto description = dataset["description"].String();
-
-        sem->down();
-        auto t = std::async(std::launch::async, &process_overlap,
-                            std::ref(user),
-                            std::ref(genome), std::ref(chromosomes),
-                            std::ref(redefined_universe_overlap_query), count_redefined_universe_overlap_query,
-                            dataset_name, description, database_name,
-                            std::ref(universe_regions), total_universe_regions,
-                            status, sem,
-                            std::ref(msg));
-
-        threads.emplace_back(std::move(t));
+      std::vector<ProcessOverlapResult> results(all_datasets.size());
+      threading::TaskGroup tasks(status->task_limit());
+      for (size_t i = 0; i < all_datasets.size(); ++i) {
+        tasks.spawn([&, i]() {
+          const auto& dataset = all_datasets[i].first;
+          const auto& database_name = all_datasets[i].second;
+          const auto dataset_name = dataset["name"].String();
+          const auto description = dataset["description"].String();
 
+          std::string task_msg;
+          results[i] = process_overlap(user, genome, chromosomes,
+                                       redefined_universe_overlap_query, count_redefined_universe_overlap_query,
+                                       dataset_name, description, database_name,
+                                       universe_regions, total_universe_regions,
+                                       status, task_msg);
+        });
       }
+      tasks.wait();
 
-      std::vector<ProcessOverlapResult> results;
-
-      for (size_t i = 0; i < threads.size(); ++i) {
-        threads[i].wait();
-        auto result = threads[i].get();
-
+      for (const auto& result : results) {
         std::string dataset = std::get<0>(result);
 
         datasets_log_score.push_back(std::make_tuple(dataset, std::get<6>(result)));
         datasets_odds_score.push_back(std::make_tuple(dataset, std::get<7>(result)));
         datasets_support.push_back(std::make_tuple(dataset, std::get<8>(result)));
-
-        results.emplace_back(std::move(result));
       }
 
       std::vector<std::shared_ptr<ExperimentResult>> experiment_results =
@@ -32,6 +32,7 @@
 
 #include "processing.hpp"
 #include "running_cache.hpp"
+#include "telemetry.hpp"
 
 #include "../extras/date_time.hpp"
 
@@ -83,6 +84,9 @@ namespace epidb {
       m[PROCESS_ENRICH_REGIONS_FAST_GET_BITMAP_REGIONS] = "" STR(PROCESS_ENRICH_REGIONS_FAST_GET_BITMAP_REGIONS);
       m[PROCESS_ENRICH_REGIONS_FAST_BITMAP_QUERY]       = "" STR(PROCESS_ENRICH_REGIONS_FAST_BITMAP_QUERY);
       m[PROCESS_ENRICH_REGIONS_FAST_BITMAP_EXPERIMENT]  = "" STR(PROCESS_ENRICH_REGIONS_FAST_BITMAP_EXPERIMENT);
+      // Upload
+      m[PROCESS_UPLOAD_PARSE]                           = "" STR(PROCESS_UPLOAD_PARSE);
+      m[PROCESS_UPLOAD_INSERT]                          = "" STR(PROCESS_UPLOAD_INSERT);
 
       return m;
     }
@@ -100,8 +104,6 @@ namespace epidb {
       _steps(0),
       _actual_step(0)
     {
-      Connection c;
-
       mongo::BSONObj insert;
       if (param.isEmpty()) {
         insert = BSON("_id" << _id <<
@@ -117,42 +119,31 @@ namespace epidb {
                       "params" << param <<
                       "s" << extras::to_mongo_date(_start_time));
       }
-      c->insert(dba::helpers::collection_name(dba::Collections::PROCESSING_OPS()), insert);
-      c.done();
+      telemetry().insert(Telemetry::PROCESSING_OPS, insert);
     }
 
     RunningOp::~RunningOp()
     {
-      Connection c;
       boost::posix_time::ptime now = extras::universal_date_time();
       boost::posix_time::time_duration  total = now - _start_time;
       mongo::BSONObj query = BSON("_id" << _id);
-      mongo::BSONObj update_value = BSON("$set" << BSON("e" << extras::to_mongo_date(now) << "t" << (long long) total.total_milliseconds()));
-      c->update(dba::helpers::collection_name(dba::Collections::PROCESSING_OPS()), query, update_value, false, false);
-      c.done();
+      telemetry().set(Telemetry::PROCESSING_OPS, query, BSON("e" << extras::to_mongo_date(now) << "t" << (long long) total.total_milliseconds()));
     }
 
     void RunningOp::set_total_steps(size_t steps)
     {
       _steps = steps;
 
-      Connection c;
       mongo::BSONObj query = BSON("_id" << _processing_id);
-      mongo::BSONObj update_value = BSON("$set" << BSON("total_steps" << (long long) _steps));
-      c->update(dba::helpers::collection_name(dba::Collections::PROCESSING_OPS()), query, update_value, false, false);
-      c.done();
-
+      telemetry().set(Telemetry::PROCESSING_OPS, query, BSON("total_steps" << (long long) _steps));
     }
 
     void RunningOp::increment_step()
     {
       ++_actual_step;
 
-      Connection c;
       mongo::BSONObj query = BSON("_id" << _processing_id);
-      mongo::BSONObj update_value = BSON("$set" << BSON("completed_steps" << (long long) _actual_step));
-      c->update(dba::helpers::collection_name(dba::Collections::PROCESSING_OPS()), query, update_value, false, false);
-      c.done();
+      telemetry().set(Telemetry::PROCESSING_OPS, query, BSON("completed_steps" << (long long) _actual_step));
     }
 
 
@@ -165,8 +156,11 @@ namespace epidb {
       _total_stored_data(0),
       _total_stored_data_compressed(0),
       _last_update(std::chrono::duration_cast< std::chrono::seconds >( std::chrono::system_clock::now().time_since_epoch())),
+      _last_progress_update(0),
       _update_time_out(1),
-      _running_cache(std::unique_ptr<RunningCache>(new RunningCache()))
+      _running_cache(std::unique_ptr<RunningCache>(new RunningCache())),
+      _query_memo(std::unique_ptr<QueryMemo>(new QueryMemo())),
+      _task_limit(threading::build_task_limit())
     {
       if (_request_id != DUMMY_REQUEST) {
         std::string msg;
@@ -175,21 +169,15 @@ namespace epidb {
         dba::helpers::notify_change_occurred("processing", msg);
         _processing_id = "pc" + utils::integer_to_string(id);
 
-        Connection c;
-        mongo::BSONObj b = BSON("_id" << _processing_id << "request_id" << _request_id);
-        c->insert(dba::helpers::collection_name(dba::Collections::PROCESSING()), b);
-        c.done();
+        telemetry().insert(Telemetry::PROCESSING, BSON("_id" << _processing_id << "request_id" << _request_id));
       }
     }
 
     Status::~Status()
     {
       if (_request_id != DUMMY_REQUEST) {
-        Connection c;
         mongo::BSONObj query = BSON("_id" << _processing_id);
-        mongo::BSONObj update_value = BSON("$set" << BSON("total_regions" << (long long) _total_regions.load() << "total_size" << (long long) _total_size.load()));
-        c->update(dba::helpers::collection_name(dba::Collections::PROCESSING()), query, update_value, false, false);
-        c.done();
+        telemetry().set(Telemetry::PROCESSING, query, BSON("total_regions" << (long long) _total_regions.load() << "total_size" << (long long) _total_size.load()));
       }
     }
 
@@ -205,15 +193,9 @@ namespace epidb {
         _last_update = current_second;
 
         mongo::BSONObj query = BSON("_id" << _processing_id);
-        mongo::BSONObj update_value = BSON("$set" <<
-                                           BSON("total_regions" << (long long) _total_regions.load() <<
-                                                "total_size" << (long long) _total_size.load())
-                                          );
-
-        Connection c;
-        c->update(dba::helpers::collection_name(dba::Collections::PROCESSING()), query, update_value, false, false);
-        c.done();
-
+        telemetry().set(Telemetry::PROCESSING, query,
+                        BSON("total_regions" << (long long) _total_regions.load() <<
+                             "total_size" << (long long) _total_size.load()));
       }
     }
 
@@ -282,21 +264,34 @@ namespace epidb {
     {
       _total_stored_data = size;
 
-      Connection c;
       mongo::BSONObj query = BSON("_id" << _processing_id);
-      mongo::BSONObj update_value = BSON("$set" << BSON("total_stored_data" << (long long) _total_stored_data.load()));
-      c->update(dba::helpers::collection_name(dba::Collections::PROCESSING()), query, update_value, false, false);
-      c.done();
+      telemetry().set(Telemetry::PROCESSING, query, BSON("total_stored_data" << (long long) _total_stored_data.load()));
     }
 
     void Status::set_total_stored_data_compressed(const long long size)
     {
       _total_stored_data_compressed = size;
 
-      Connection c;
       mongo::BSONObj query = BSON("_id" << _processing_id);
-      mongo::BSONObj update_value = BSON("$set" << BSON("total_stored_data_compressed" << (long long) _total_stored_data_compressed.load()));
-      c->update(dba::helpers::collection_name(dba::Collections::PROCESSING()), query, update_value, false, false);
+      telemetry().set(Telemetry::PROCESSING, query, BSON("total_stored_data_compressed" << (long long) _total_stored_data_compressed.load()));
+    }
+
+    void Status::set_progress(const std::string &step, const long long done, const long long total)
+    {
+      if (_request_id == DUMMY_REQUEST) {
+        return;
+      }
+
+      // The last update of a step is always stored
+      auto current_second = std::chrono::duration_cast< std::chrono::seconds >(std::chrono::system_clock::now().time_since_epoch());
+      if (done < total && current_second - _last_progress_update <= _update_time_out) {
+        return;
+      }
+      _last_progress_update = current_second;
+
+      Connection c;
+      c->update(dba::helpers::collection_name(dba::Collections::JOBS()), BSON("_id" << _request_id),
+                BSON("$set" << BSON("progress" << BSON("step" << step << "done" << done << "total" << total))));
       c.done();
     }
 
@@ -345,6 +340,16 @@ namespace epidb {
       return _running_cache;
     }
 
+    std::unique_ptr<QueryMemo>& Status::query_memo()
+    {
+      return _query_memo;
+    }
+
+    threading::TaskLimitPtr Status::task_limit()
+    {
+      return _task_limit;
+    }
+
     typedef std::shared_ptr<Status> StatusPtr;
 
     StatusPtr build_status(const std::string& _id, const long long maximum_memory)
@@ -23,15 +23,19 @@
 
 #include <atomic>
 #include <chrono>
+#include <istream>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "../datatypes/regions.hpp"
+#include "../datatypes/regions_block.hpp"
 #include "../datatypes/user.hpp"
 
 #include "../extras/utils.hpp"
 
+#include "../threading/executor.hpp"
+
 #include "../errors.hpp"
 
 namespace epidb {
@@ -49,6 +53,10 @@ namespace epidb {
 
   class StringBuilder;
 
+  namespace storage {
+    class DecompressedFileStream;
+  }
+
   namespace processing {
 
     extern std::string DUMMY_REQUEST;
@@ -91,6 +99,9 @@ namespace epidb {
       PROCESS_ENRICH_REGIONS_FAST_BITMAP_QUERY,
       PROCESS_ENRICH_REGIONS_FAST_BITMAP_EXPERIMENT,
 
+      PROCESS_UPLOAD_PARSE,
+      PROCESS_UPLOAD_INSERT,
+
       FORMAT_OUTPUT,
       BUILDING_OUTPUT,
       COMPRESSING_OUTPUT,
@@ -121,6 +132,7 @@ namespace epidb {
     };
 
     class RunningCache;
+    class QueryMemo;
 
     class Status {
       std::string _request_id;
@@ -128,16 +140,19 @@ namespace epidb {
 
       const long long _maximum_memory;
 
-      bool _canceled;
+      std::atomic<bool> _canceled;
 
       std::atomic_llong _total_regions;
       std::atomic_llong _total_size;
       std::atomic_llong _total_stored_data;
       std::atomic_llong _total_stored_data_compressed;
       std::chrono::seconds _last_update;
+      std::chrono::seconds _last_progress_update;
       const std::chrono::seconds _update_time_out;
 
       std::unique_ptr<RunningCache> _running_cache;
+      std::unique_ptr<QueryMemo> _query_memo;
+      threading::TaskLimitPtr _task_limit;
 
       mongo::BSONObj toBson();
 
@@ -153,6 +168,8 @@ namespace epidb {
       long long subtract_size(const long long qtd);
       void set_total_stored_data(long long size);
       void set_total_stored_data_compressed(long long size);
+      // Progress of the current step of the request, stored in its job
+      void set_progress(const std::string &step, const long long done, const long long total);
       long long total_regions();
       long long total_size();
       long long maximum_size();
@@ -160,6 +177,8 @@ namespace epidb {
       bool sum_and_check_size(size_t to_sum);
       bool is_canceled(bool& ret, std::string& msg);
       std::unique_ptr<RunningCache>& running_cache();
+      std::unique_ptr<QueryMemo>& query_memo();
+      threading::TaskLimitPtr task_limit();
     };
 
     typedef std::shared_ptr<Status> StatusPtr;
@@ -197,9 +216,13 @@ namespace epidb {
                      const std::string &query_id, const std::string &format,
                      processing::StatusPtr status, StringBuilder &sb, std::string &msg);
 
+    // Output formats of the score matrix
+    const std::string SCORE_MATRIX_TEXT = "tsv";
+    const std::string SCORE_MATRIX_BINARY = "binary";
+
     bool score_matrix(const datatypes::User& user,
                       const std::vector<std::pair<std::string, std::string>> &experiments_formats, const std::string &aggregation_function,
-                      const std::string &regions_query_id,
+                      const std::string &regions_query_id, const std::string &output_format,
                       processing::StatusPtr status, StringBuilder &sb, std::string &msg);
 
 
@@ -216,7 +239,19 @@ namespace epidb {
                                   const std::string &query_id,
                                   processing::StatusPtr status, std::vector<utils::IdName>& experiments, std::string &msg);
 
-    bool format_regions(const std::string &output_format, ChromosomeRegionsList &chromosomeRegionsList, processing::StatusPtr status, StringBuilder &sb, std::string &msg);
+    // Parse the data of an add_experiment or add_annotation and insert the dataset described by the command.
+    // The stored uploads are checked for read errors, that the parsers take as the end of the data.
+    bool insert_dataset(const datatypes::User& user, const std::string& command, const mongo::BSONObj& dataset,
+                        std::unique_ptr<std::istream> &&input, const storage::DecompressedFileStream *stored,
+                        processing::StatusPtr status, std::string& id, std::string& msg);
+
+    // Parse the data of a queued add_experiment or add_annotation and insert the dataset
+    bool upload_dataset(const datatypes::User& user, const mongo::BSONObj& job,
+                        processing::StatusPtr status, std::string& id, std::string& msg);
+
+    bool format_regions(const std::string &output_format, const ChromosomeRegionsList &chromosomeRegionsList, processing::StatusPtr status, StringBuilder &sb, std::string &msg);
+
+    bool format_regions(const std::string &output_format, ChromosomeRegionsBlockList &chromosomeRegionsBlockList, processing::StatusPtr status, StringBuilder &sb, std::string &msg);
 
     bool is_canceled(processing::StatusPtr status, std::string& msg);
   }
@@ -18,6 +18,9 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <algorithm>
+#include <exception>
+#include <future>
 #include <memory>
 #include <boost/regex.hpp>
 #include <string>
@@ -27,6 +30,8 @@
 #include "../dba/sequence_retriever.hpp"
 #include "../dba/key_mapper.hpp"
 
+#include "../extras/utils.hpp"
+
 #include "processing.hpp"
 
 #include "running_cache.hpp"
@@ -41,7 +46,13 @@ namespace epidb {
         return false;
       }
 
-      return dba::retrieve::SequenceRetriever::singleton().retrieve(_genome, chromosome, 0, size, _sequence, msg);
+      // A failed retrieve may leave a part of the sequence
+      current_chromosome.clear();
+      if (!dba::retrieve::SequenceRetriever::singleton().retrieve(_genome, chromosome, 0, size, _sequence, msg)) {
+        return false;
+      }
+      current_chromosome = chromosome;
+      return true;
     }
 
     bool DatasetCache::count_regions(const std::string& pattern,
@@ -55,15 +66,11 @@ namespace epidb {
 
       count = 0;
 
-      if (chromosome != current_chromosome) {
-        if (!load_sequence(chromosome, msg)) {
-          return false;
-        }
-        current_chromosome = chromosome;
+      std::string sub;
+      if (!get_sequence(chromosome, start, end, sub, msg)) {
+        return false;
       }
 
-      std::string sub = _sequence.substr(start, end - start);
-
       boost::regex e(pattern);
       boost::match_results<std::string::const_iterator> what;
       std::string::const_iterator begin_it = sub.begin();
@@ -80,38 +87,162 @@ namespace epidb {
     bool DatasetCache::get_sequence(const std::string& chromosome, const Position start, const Position end,
                                     std::string& sequence, std::string& msg)
     {
+      std::lock_guard<std::mutex> lock(_mutex);
       if (chromosome != current_chromosome) {
         if (!load_sequence(chromosome, msg)) {
           return false;
         }
-        current_chromosome = chromosome;
       }
 
       sequence = _sequence.substr(start, end - start);
       return true;
     }
 
+    DatasetCache& RunningCache::dataset_cache(const std::string& norm_genome, StatusPtr status)
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      std::unique_ptr<DatasetCache>& cache = caches[norm_genome];
+      if (!cache) {
+        cache = std::unique_ptr<DatasetCache>(new DatasetCache(norm_genome, status));
+      }
+      return *cache;
+    }
 
     bool RunningCache::get_sequence(const std::string & norm_genome, const std::string & chromosome,
                                     const Position start, const Position end, std::string & sequence,
                                     StatusPtr status, std::string & msg)
     {
-      if (caches.find(norm_genome) == caches.end()) {
-        caches[norm_genome] = std::unique_ptr<DatasetCache>(new DatasetCache(norm_genome, status));
-      }
-
-      return caches[norm_genome]->get_sequence(chromosome, start, end, sequence, msg);
+      return dataset_cache(norm_genome, status).get_sequence(chromosome, start, end, sequence, msg);
     }
 
     bool RunningCache::count_regions(const std::string & norm_genome, const std::string & chromosome, const std::string & pattern,
                                      const Position start, const Position end, size_t& count,
                                      StatusPtr status, std::string & msg)
     {
-      if (caches.find(norm_genome) == caches.end()) {
-        caches[norm_genome] = std::unique_ptr<DatasetCache>(new DatasetCache(norm_genome, status));
+      return dataset_cache(norm_genome, status).count_regions(pattern, chromosome, start, end, count, msg);
+    }
+
+    bool QueryMemo::planned_query(const std::string &query_id, mongo::BSONObj &query)
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      auto it = _planned.find(query_id);
+      if (it == _planned.end()) {
+        return false;
+      }
+      query = it->second.query;
+      return true;
+    }
+
+    bool QueryMemo::is_known(const std::string &query_id)
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _planned.find(query_id) != _planned.end() || _entries.find(query_id) != _entries.end();
+    }
+
+    void QueryMemo::add_plan(const Plan &plan)
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      for (const auto &planned : plan) {
+        auto it = _planned.find(planned.first);
+        if (it == _planned.end()) {
+          _planned.emplace(planned.first, planned.second);
+        } else {
+          it->second.uses += planned.second.uses;
+        }
+      }
+    }
+
+    bool QueryMemo::claim_single(const std::string &query_id)
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_entries.find(query_id) != _entries.end()) {
+        return false;
+      }
+      auto it = _planned.find(query_id);
+      if (it != _planned.end()) {
+        if (it->second.uses > 1) {
+          return false;
+        }
+        _planned.erase(it);
+      }
+      return true;
+    }
+
+    bool QueryMemo::get(const std::string &query_id, const Evaluate &evaluate,
+                        StatusPtr status, ChromosomeRegionsList &regions, std::string &msg)
+    {
+      std::shared_ptr<std::promise<Result>> promise;
+      std::shared_future<Result> future;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto planned = _planned.find(query_id);
+        if (planned != _planned.end() && --planned->second.uses == 0) {
+          _planned.erase(planned);
+        }
+
+        auto it = _entries.find(query_id);
+        if (it == _entries.end()) {
+          promise = std::make_shared<std::promise<Result>>();
+          Entry entry;
+          entry.result = promise->get_future().share();
+          entry.active = 0;
+          it = _entries.emplace(query_id, entry).first;
+        }
+        it->second.active++;
+        future = it->second.result;
+      }
+
+      if (promise) {
+        Result result;
+        result.size = 0;
+        std::shared_ptr<ChromosomeRegionsList> evaluated = std::make_shared<ChromosomeRegionsList>();
+        try {
+          result.success = evaluate(*evaluated, result.msg);
+        } catch (...) {
+          promise->set_exception(std::current_exception());
+          throw;
+        }
+        if (result.success) {
+          for (const auto &chromosome : *evaluated) {
+            for (const auto &region : chromosome.second) {
+              result.size += region->size();
+            }
+          }
+          result.regions = evaluated;
+        }
+        promise->set_value(result);
+      }
+
+      const Result &result = future.get();
+
+      bool take;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        take = _planned.find(query_id) == _planned.end() && _entries[query_id].active == 1;
+      }
+
+      bool success = result.success;
+      if (!success) {
+        msg = result.msg;
+      } else if (take) {
+        // No other use can read it anymore
+        regions = std::move(*std::const_pointer_cast<ChromosomeRegionsList>(result.regions));
+      } else if (!status->sum_and_check_size(result.size)) {
+        msg = "Memory exhausted. Used "  + utils::size_t_to_string(status->total_size()) + "bytes of " + utils::size_t_to_string(status->maximum_size()) + "bytes allowed. Please, select a smaller initial dataset, for example, selecting fewer chromosomes)";
+        success = false;
+      } else {
+        regions = *result.regions;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Entry &entry = _entries[query_id];
+        if (--entry.active == 0 && _planned.find(query_id) == _planned.end()) {
+          _entries.erase(query_id);
+        }
       }
 
-      return caches[norm_genome]->count_regions(pattern, chromosome, start, end, count, msg);
+      return success;
     }
   }
 }
@@ -21,8 +21,16 @@
 #ifndef EPIDB_RUNNING_CACHE_HPP
 #define EPIDB_RUNNING_CACHE_HPP
 
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+
+#include <mongo/bson/bson.h>
+
+#include "../datatypes/regions.hpp"
 
 namespace epidb {
   namespace processing {
@@ -30,11 +38,16 @@ namespace epidb {
     class Status;
     typedef std::shared_ptr<Status> StatusPtr;
 
+    //
+    // The caches of a request are shared by its sub-queries, that run at the same time:
+    // the sequence of the current chromosome is loaded and read under the lock.
+    //
     class DatasetCache {
 
     private:
       std::string _genome;
       StatusPtr _status;
+      std::mutex _mutex;
       std::string current_chromosome;
       std::string _sequence;
 
@@ -56,8 +69,11 @@ namespace epidb {
 
     class RunningCache {
     private:
+      std::mutex _mutex;
       std::unordered_map<std::string, std::unique_ptr<DatasetCache>> caches;
 
+      DatasetCache& dataset_cache(const std::string& norm_genome, StatusPtr status);
+
     public:
       bool count_regions(const std::string& genome, const std::string& chromosome, const std::string& pattern,
                          const Position start, const Position end, size_t& count,
@@ -67,6 +83,64 @@ namespace epidb {
                                     const Position start, const Position end, std::string & sequence,
                                     StatusPtr status, std::string & msg);
     };
+
+    //
+    // Results of the sub-queries used more than once by the request.
+    // The number of uses of each query is counted walking the query tree before its processing,
+    // so every sub-query is evaluated once and the result is kept only until its last use.
+    // Only the uses not yet claimed are kept: a query retrieved again after all its uses
+    // is planned and evaluated again.
+    //
+    class QueryMemo {
+    public:
+      typedef std::function<bool(ChromosomeRegionsList &, std::string &)> Evaluate;
+
+      struct Planned {
+        size_t uses;
+        // Query object loaded while planning
+        mongo::BSONObj query;
+      };
+
+      typedef std::unordered_map<std::string, Planned> Plan;
+
+    private:
+      struct Result {
+        bool success;
+        ChromosomeRegionsListPtr regions;
+        size_t size;
+        std::string msg;
+      };
+
+      struct Entry {
+        std::shared_future<Result> result;
+        // Uses still reading the result
+        size_t active;
+      };
+
+      std::mutex _mutex;
+      // Uses not yet claimed
+      Plan _planned;
+      std::unordered_map<std::string, Entry> _entries;
+
+    public:
+      // Returns false if the query has no use to claim, otherwise its loaded object
+      bool planned_query(const std::string &query_id, mongo::BSONObj &query);
+
+      // The query has uses to claim or its result is being read.
+      // Its sub-queries were counted by the plan that counted it.
+      bool is_known(const std::string &query_id);
+
+      // Add the uses counted by the plan of a query
+      void add_plan(const Plan &plan);
+
+      // Claim the use of a query that is not shared. Returns false if it is shared.
+      bool claim_single(const std::string &query_id);
+
+      // Evaluate the query on its first use and copy the result on the following ones.
+      // The last use takes the result without copying it.
+      bool get(const std::string &query_id, const Evaluate &evaluate,
+               StatusPtr status, ChromosomeRegionsList &regions, std::string &msg);
+    };
   }
 }
 
@@ -18,13 +18,15 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 
-#include <future>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <map>
 #include <sstream>
 #include <string>
 #include <vector>
-#include <thread>
-#include <tuple>
+
+#include <format.h>
 
 #include "../algorithms/accumulator.hpp"
 
@@ -42,8 +44,10 @@
 #include "../engine/commands.hpp"
 
 #include "../extras/serialize.hpp"
+#include "../extras/stringbuilder.hpp"
+#include "../extras/utils.hpp"
 
-#include "../threading/semaphore.hpp"
+#include "../threading/executor.hpp"
 
 #include "../errors.hpp"
 #include "../log.hpp"
@@ -52,129 +56,428 @@
 namespace epidb {
   namespace processing {
 
-    //         Okay,    msg,   experiment name, chromosome,  regions
-    std::tuple<bool, std::string, std::string, std::string, std::shared_ptr<std::vector<std::string>>>
-    summarize_experiment(const std::string& aggregation_function, const std::string& norm_genome,
-                         const std::pair<std::string, dba::columns::ColumnTypePtr>& experiment_format,
-                         const ChromosomeRegions& chromosome, threading::SemaphorePtr sem,
-                         processing::StatusPtr status)
+    // Ranges of the first window of a chromosome
+    const size_t WINDOW_RANGES = 16 * 1024;
+    const size_t MIN_WINDOW_RANGES = 256;
+    // The next windows are sized to retrieve about this number of experiment regions
+    const size_t WINDOW_DATA = 1024 * 1024;
+
+    //
+    // Ranges [range_begin, range_end) of the sorted ranges and the experiment regions overlapping them
+    //
+    struct Window {
+      size_t range_begin;
+      size_t range_end;
+      RegionsBlock data;
+      bool ok;
+      std::string msg;
+    };
+
+    static void retrieve_window(const std::string& norm_genome, const std::string& norm_experiment_name,
+                                const std::string& chromosome, const Regions& ranges, const std::vector<size_t>& order,
+                                processing::StatusPtr status, Window& window)
     {
-      processing::RunningOp threadRunningOp = status->start_operation(PROCESS_SCORE_MATRIX_THREAD);
+      Position start = ranges[order[window.range_begin]]->start();
+      Position end = start;
+      for (size_t i = window.range_begin; i < window.range_end; i++) {
+        end = std::max(end, ranges[order[i]]->end());
+      }
 
-      std::string msg;
-      std::shared_ptr<std::vector<std::string>> regions_accs = std::make_shared<std::vector<std::string>>();
+      mongo::BSONObj regions_query;
+      window.ok = dba::query::build_experiment_query(start, end, norm_experiment_name, regions_query, window.msg) &&
+                  dba::retrieve::get_regions(norm_genome, chromosome, regions_query, false, status, window.data, window.msg);
+    }
 
-      algorithms::GetDataPtr data_ptr = algorithms::get_function_data(aggregation_function);
-      if (!data_ptr && aggregation_function != "acc") {
-        msg = "Aggregation function " + aggregation_function + " is invalid.";
-        return std::make_tuple(false, msg, "", "", regions_accs);
+    static void release_window(processing::StatusPtr status, Window& window)
+    {
+      if (!window.data.empty()) {
+        status->subtract_size(window.data.size() * window.data.row_size());
+        status->subtract_regions(window.data.size());
       }
+      window.data = RegionsBlock();
+    }
+
+    //
+    // Cells of the matrix: one row for each range, in the order of the chromosomes
+    // and of their ranges, and one column for each experiment.
+    // The cells without experiment data keep the NO_DATA value.
+    // The "acc" aggregation keeps the values list of the cells as strings.
+    //
+    struct ScoreMatrix {
+      size_t rows;
+      size_t columns;
+      std::vector<Score> cells;
+      std::vector<std::string> acc_cells;
+
+      size_t cell(const size_t row, const size_t column) const
+      {
+        return row * columns + column;
+      }
+    };
+
+    // Quiet NaN, compared by its bits, because the fast math build assumes finite values
+    const uint32_t NO_DATA_BITS = 0x7fc00000u;
+
+    static Score no_data()
+    {
+      Score s;
+      memcpy(&s, &NO_DATA_BITS, sizeof(s));
+      return s;
+    }
 
-      const int BLOCK_SIZE = 100;
-      size_t region_pos = 0;
+    static bool is_no_data(const Score s)
+    {
+      uint32_t bits;
+      memcpy(&bits, &s, sizeof(bits));
+      return bits == NO_DATA_BITS;
+    }
+
+    static size_t store_cell(ScoreMatrix& matrix, const size_t cell, const Score value)
+    {
+      matrix.cells[cell] = value;
+      return 0;
+    }
 
-      while (region_pos < chromosome.second.size()) {
+    // Returns the memory used by the values list
+    static size_t store_cell(ScoreMatrix& matrix, const size_t cell, std::string&& value)
+    {
+      matrix.acc_cells[cell] = std::move(value);
+      return matrix.acc_cells[cell].capacity();
+    }
+
+    //
+    // The experiment regions of the chromosome are retrieved in large windows of ranges,
+    // the next window while the current one is aggregated, and swept against the ranges
+    // in the start order. The regions that end before a range can not overlap the
+    // next ranges, so only the regions still active are checked for each range.
+    // The cells are stored in the column of the experiment, from the first row of the chromosome.
+    // The loop is compiled for each aggregation Function, so only its statistics are accumulated.
+    //
+    template <typename Function>
+    bool summarize_experiment(const std::string& norm_genome,
+                              const std::pair<std::string, dba::columns::ColumnTypePtr>& experiment_format,
+                              const ChromosomeRegions& chromosome, const size_t column, const size_t first_row,
+                              ScoreMatrix& matrix, processing::StatusPtr status, std::string& msg)
+    {
+      processing::RunningOp threadRunningOp = status->start_operation(PROCESS_SCORE_MATRIX_THREAD);
+
+      const Regions &ranges = chromosome.second;
+
+      if (ranges.empty()) {
+        return true;
+      }
+
+      // Positions of the ranges in the start order
+      std::vector<size_t> order(ranges.size());
+      for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+      }
+      std::stable_sort(order.begin(), order.end(), [&](const size_t lhs, const size_t rhs) {
+        return ranges[lhs]->start() < ranges[rhs]->start();
+      });
+
+      const std::string norm_experiment_name = utils::normalize_name(experiment_format.first);
+      const size_t column_pos = experiment_format.second->pos();
+
+      auto current = std::make_shared<Window>();
+      current->range_begin = 0;
+      current->range_end = std::min(ranges.size(), WINDOW_RANGES);
+      retrieve_window(norm_genome, norm_experiment_name, chromosome.first, ranges, order, status, *current);
+
+      std::vector<size_t> active;
+      while (true) {
+        if (!current->ok) {
+          release_window(status, *current);
+          msg = current->msg;
+          return false;
+        }
 
         // Check if processing was canceled
         bool is_canceled = false;
         if (!status->is_canceled(is_canceled, msg)) {
-          sem->up();
-          return std::make_tuple(false, msg, "", "", regions_accs);
+          release_window(status, *current);
+          return false;
         }
         if (is_canceled) {
+          release_window(status, *current);
           msg = Error::m(ERR_REQUEST_CANCELED);
-          sem->up();
-          return std::make_tuple(false, msg, "", "", regions_accs);
+          return false;
         }
         ////////////////////////////////////////////////////////////
 
-        Regions ranges;
-        for (size_t i = 0; i < BLOCK_SIZE && region_pos < chromosome.second.size(); i++, region_pos++) {
-          ranges.emplace_back(chromosome.second[region_pos]->clone());
-        }
-
-        mongo::BSONObj regions_query;
-        if (!dba::query::build_experiment_query(ranges[0]->start(), ranges[ranges.size() - 1]->end(),
-                                                utils::normalize_name(experiment_format.first), regions_query, msg)) {
-          sem->up();
-          return std::make_tuple(false, msg, "", "", regions_accs);
-        }
+        // Prefetch the next window, sized by the density of the current one
+        std::shared_ptr<Window> next;
+        threading::TaskPtr prefetch;
+        if (current->range_end < ranges.size()) {
+          const size_t window_ranges = current->range_end - current->range_begin;
+          size_t next_ranges = window_ranges;
+          if (current->data.size() > 0) {
+            next_ranges = std::max(MIN_WINDOW_RANGES, (size_t) ((double) window_ranges * WINDOW_DATA / current->data.size()));
+            next_ranges = std::min(next_ranges, window_ranges * 2);
+          } else {
+            next_ranges = window_ranges * 2;
+          }
 
-        Regions data;
-        if (!dba::retrieve::get_regions(norm_genome, chromosome.first, regions_query, false, status, data, msg)) {
-          sem->up();
-          return std::make_tuple(false, msg, "", "", regions_accs);
+          next = std::make_shared<Window>();
+          next->range_begin = current->range_end;
+          next->range_end = std::min(ranges.size(), current->range_end + next_ranges);
+          const std::string chromosome_name = chromosome.first;
+          prefetch = std::make_shared<threading::Task>([=, &ranges, &order]() {
+            retrieve_window(norm_genome, norm_experiment_name, chromosome_name, ranges, order, status, *next);
+          });
+          threading::executor().submit(prefetch, status->task_limit()->priority());
         }
 
-        auto it_ranges = ranges.begin();
-        auto it_data_begin = data.begin();
+        const RegionsBlock &data = current->data;
+        size_t data_pos = 0;
+        size_t acc_size = 0;
+        active.clear();
 
-        while (it_ranges != ranges.end()) {
-          algorithms::Accumulator acc;
+        for (size_t i = current->range_begin; i < current->range_end; i++) {
+          const RegionPtr &range = ranges[order[i]];
+          const Position range_start = range->start();
+          const Position range_end = range->end();
 
-          while ( it_data_begin != data.end()
-                  && (*it_data_begin)->end() < (*it_ranges)->start() )  {
-            it_data_begin++;
+          while (data_pos < data.size() && data.start(data_pos) <= range_end) {
+            active.push_back(data_pos++);
           }
 
-          auto it_data = it_data_begin;
-          while (it_data != data.end() &&
-                 (*it_ranges)->end() >= (*it_data)->start() ) {
+          typename Function::Accumulator acc;
+          size_t kept = 0;
+          for (const size_t pos : active) {
+            if (data.end(pos) < range_start) {
+              continue;
+            }
+            active[kept++] = pos;
+
+            if (data.start(pos) > range_end) {
+              continue;
+            }
 
-            auto begin = std::max((*it_data)->start(), (*it_ranges)->start());
-            auto end =  std::min((*it_data)->end(), (*it_ranges)->end());
+            auto begin = std::max(data.start(pos), range_start);
+            auto end =  std::min(data.end(pos), range_end);
 
             double overlap_length = end - begin;
-            double original_length = (*it_data)->end() - (*it_data)->start();
+            double original_length = data.end(pos) - data.start(pos);
 
             auto correct_offset = (overlap_length / original_length );
 
+            acc.push(data.value(pos, column_pos) * correct_offset);
+          }
+          active.resize(kept);
 
-            if (((*it_ranges)->start() <= (*it_data)->end()) && ((*it_ranges)->end() >= (*it_data)->start())) {
-              acc.push((*it_data)->value(experiment_format.second->pos()) * correct_offset);
-            }
+          if (!acc.count()) {
+            continue;
+          }
+
+          const size_t cell = matrix.cell(first_row + order[i], column);
+          acc_size += store_cell(matrix, cell, Function::value(acc));
+        }
 
-            it_data++;
+        status->sum_regions(current->range_end - current->range_begin);
+        if (!status->sum_and_check_size(acc_size)) {
+          msg = "Memory exhausted. Used "  + utils::size_t_to_string(status->total_size()) + "bytes of " + utils::size_t_to_string(status->maximum_size()) + "bytes allowed. Please, select a smaller initial dataset, for example, selecting fewer chromosomes)"; // TODO: put a better error msg.
+          release_window(status, *current);
+          if (prefetch) {
+            prefetch->wait();
+            release_window(status, *next);
           }
+          return false;
+        }
+
+        release_window(status, *current);
+        if (!prefetch) {
+          break;
+        }
+        prefetch->wait();
+        current = next;
+      }
+
+      return true;
+    }
+
+    bool summarize_experiment(const algorithms::AggregationFunction function, const std::string& norm_genome,
+                              const std::pair<std::string, dba::columns::ColumnTypePtr>& experiment_format,
+                              const ChromosomeRegions& chromosome, const size_t column, const size_t first_row,
+                              ScoreMatrix& matrix, processing::StatusPtr status, std::string& msg)
+    {
+      using namespace algorithms;
+
+      switch (function) {
+      case AGGREGATION_MIN:
+        return summarize_experiment<Aggregation<AGGREGATION_MIN>>(norm_genome, experiment_format, chromosome, column, first_row, matrix, status, msg);
+      case AGGREGATION_MAX:
+        return summarize_experiment<Aggregation<AGGREGATION_MAX>>(norm_genome, experiment_format, chromosome, column, first_row, matrix, status, msg);
+      case AGGREGATION_SUM:
+        return summarize_experiment<Aggregation<AGGREGATION_SUM>>(norm_genome, experiment_format, chromosome, column, first_row, matrix, status, msg);
+      case AGGREGATION_MEAN:
+        return summarize_experiment<Aggregation<AGGREGATION_MEAN>>(norm_genome, experiment_format, chromosome, column, first_row, matrix, status, msg);
+      case AGGREGATION_VAR:
+        return summarize_experiment<Aggregation<AGGREGATION_VAR>>(norm_genome, experiment_format, chromosome, column, first_row, matrix, status, msg);
+      case AGGREGATION_SD:
+        return summarize_experiment<Aggregation<AGGREGATION_SD>>(norm_genome, experiment_format, chromosome, column, first_row, matrix, status, msg);
+      case AGGREGATION_MEDIAN:
+        return summarize_experiment<Aggregation<AGGREGATION_MEDIAN>>(norm_genome, experiment_format, chromosome, column, first_row, matrix, status, msg);
+      case AGGREGATION_COUNT:
+        return summarize_experiment<Aggregation<AGGREGATION_COUNT>>(norm_genome, experiment_format, chromosome, column, first_row, matrix, status, msg);
+      case AGGREGATION_BOOLEAN:
+        return summarize_experiment<Aggregation<AGGREGATION_BOOLEAN>>(norm_genome, experiment_format, chromosome, column, first_row, matrix, status, msg);
+      case AGGREGATION_ACC:
+        return summarize_experiment<Aggregation<AGGREGATION_ACC>>(norm_genome, experiment_format, chromosome, column, first_row, matrix, status, msg);
+      }
+
+      return false;
+    }
+
+    //
+    // Text output: one line for each row, with its chromosome, start, end and the cells of the experiments.
+    //
+    static bool format_text(const std::vector<std::pair<std::string, std::string>> &experiments_formats,
+                            const ChromosomeRegionsList &range_regions, const ScoreMatrix &matrix,
+                            processing::StatusPtr status, StringBuilder &sb, std::string &msg)
+    {
+      sb.append("CHROMOSOME\t");
+      sb.append("START\t");
+      sb.append("END\t");
+
+      bool first = true;
+      for (auto &experiments_format : experiments_formats) {
+        if (!first) {
+          sb.tab();
+        }
+        sb.append(experiments_format.first);
+        first = false;
+      }
+      sb.endLine();
+
+      const bool acc = !matrix.acc_cells.empty();
+      char score[utils::SCORE_CHARS];
+      size_t row = 0;
+
+      for (auto &chromosome : range_regions) {
+        const auto &chromosome_name = chromosome.first;
+        const auto &regions = chromosome.second;
 
-          std::string value;
-          if (acc.count()) {
-            if (data_ptr) {
-              value = utils::score_to_string( (acc.*data_ptr)() );
-            } else {
-              value = acc.string("|");
+        for (const auto& region : regions) {
+          // Check if processing was canceled
+          if (row % 1024 == 0) {
+            bool is_canceled = false;
+            if (!status->is_canceled(is_canceled, msg)) {
+              return true;
+            }
+            if (is_canceled) {
+              msg = Error::m(ERR_REQUEST_CANCELED);
+              return false;
             }
           }
 
-          size_t value_size = sizeof(std::string) + (value.capacity() * sizeof(char));
-          status->sum_regions(1);
-          if (!status->sum_and_check_size(value_size)) {
-            msg = "Memory exhausted. Used "  + utils::size_t_to_string(status->total_size()) + "bytes of " + utils::size_t_to_string(status->maximum_size()) + "bytes allowed. Please, select a smaller initial dataset, for example, selecting fewer chromosomes)"; // TODO: put a better error msg.
-            return std::make_tuple(false, msg, "", "", regions_accs);
+          sb.append(chromosome_name);
+          sb.tab();
+          fmt::FormatInt start(region->start());
+          sb.append(start.data(), start.size());
+          sb.tab();
+          fmt::FormatInt end(region->end());
+          sb.append(end.data(), end.size());
+          sb.tab();
+
+          for (size_t column = 0; column < matrix.columns; column++) {
+            if (column) {
+              sb.tab();
+            }
+            const size_t cell = matrix.cell(row, column);
+            if (acc) {
+              sb.append(matrix.acc_cells[cell]);
+            } else if (!is_no_data(matrix.cells[cell])) {
+              sb.append(score, utils::score_to_chars(matrix.cells[cell], score));
+            }
           }
-
-          regions_accs->push_back(value);
-          it_ranges++;
+          sb.endLine();
+          row++;
         }
+      }
+
+      return true;
+    }
+
+    template <typename T>
+    static void append_binary(StringBuilder &sb, const T value)
+    {
+      sb.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
 
-        // Remove the size of the region, ranges
-        for (const auto& r : data) {
-          status->subtract_size(r->size());
+    static void append_binary(StringBuilder &sb, const std::string &value)
+    {
+      append_binary(sb, (uint32_t) value.size());
+      sb.append(value);
+    }
+
+    //
+    // Binary output, little endian, for the clients that load the matrix in arrays:
+    //   "DBSM", version (uint32), rows (uint64), columns (uint64)
+    //   the experiment names, each one as its size (uint32) and chars
+    //   number of chromosomes (uint32), and for each one its name and number of rows (uint64)
+    //   the starts (int32[rows]), the ends (int32[rows])
+    //   the cells (float32[rows][columns]), NaN where the experiment has no data
+    //
+    static bool format_binary(const std::vector<std::pair<std::string, std::string>> &experiments_formats,
+                              const ChromosomeRegionsList &range_regions, const ScoreMatrix &matrix,
+                              StringBuilder &sb, std::string &msg)
+    {
+      if (!matrix.acc_cells.empty()) {
+        msg = "The aggregation function acc is not available for the binary output.";
+        return false;
+      }
+
+      sb.append("DBSM", 4);
+      append_binary(sb, (uint32_t) 1);
+      append_binary(sb, (uint64_t) matrix.rows);
+      append_binary(sb, (uint64_t) matrix.columns);
+
+      for (auto &experiments_format : experiments_formats) {
+        append_binary(sb, experiments_format.first);
+      }
+
+      append_binary(sb, (uint32_t) range_regions.size());
+      for (auto &chromosome : range_regions) {
+        append_binary(sb, chromosome.first);
+        append_binary(sb, (uint64_t) chromosome.second.size());
+      }
+
+      for (auto &chromosome : range_regions) {
+        for (const auto& region : chromosome.second) {
+          append_binary(sb, (int32_t) region->start());
+        }
+      }
+      for (auto &chromosome : range_regions) {
+        for (const auto& region : chromosome.second) {
+          append_binary(sb, (int32_t) region->end());
         }
-        status->subtract_regions(data.size());
       }
 
-      sem->up();
-      return std::make_tuple(true, "", experiment_format.first, chromosome.first, regions_accs);
+      static_assert(sizeof(Score) == 4, "The binary score matrix cells are float32");
+      const char *cells = reinterpret_cast<const char *>(matrix.cells.data());
+      const size_t cells_size = matrix.cells.size() * sizeof(Score);
+      const size_t PART = 1024 * 1024;
+      for (size_t pos = 0; pos < cells_size; pos += PART) {
+        sb.append(cells + pos, std::min(PART, cells_size - pos));
+      }
+
+      return true;
     }
 
     bool score_matrix(const datatypes::User& user,
                       const std::vector<std::pair<std::string, std::string>> &experiments_formats,
                       const std::string & aggregation_function, const std::string & regions_query_id,
+                      const std::string & output_format,
                       processing::StatusPtr status, StringBuilder &sb, std::string & msg)
     {
       processing::RunningOp runningOp = status->start_operation(PROCESS_SCORE_MATRIX);
 
+      if (output_format != SCORE_MATRIX_TEXT && output_format != SCORE_MATRIX_BINARY) {
+        msg = "Invalid score matrix output format " + output_format + ". The formats are " + SCORE_MATRIX_TEXT + " and " + SCORE_MATRIX_BINARY + ".";
+        return false;
+      }
+
       ChromosomeRegionsList range_regions;
       if (!dba::query::retrieve_query(user, regions_query_id, status, range_regions, msg)) {
         return false;
@@ -222,94 +525,63 @@ namespace epidb {
         norm_genome = experiment["norm_genome"].String();
       }
 
-      std::map<std::string, std::map<std::string, std::shared_ptr<std::vector<std::string>>>> chromosome_accs;
-
-      // We only allow 32 simultaneous threads
-      threading::SemaphorePtr sem = threading::build_semaphore(32);
-
-      std::vector<std::future<std::tuple<bool, std::string, std::string, std::string, std::shared_ptr<std::vector<std::string>>>>> threads;
-      for (auto &experiment_format : norm_experiments_formats) {
-        for (auto &chromosome : range_regions) {
-          sem->down();
-          auto t = std::async(std::launch::async, &summarize_experiment,
-                              std::ref(aggregation_function), std::ref(norm_genome),
-                              std::ref(experiment_format), std::ref(chromosome),
-                              sem, status);
-          threads.push_back(std::move(t));
-        }
+      algorithms::AggregationFunction function;
+      if (!algorithms::get_function_data(aggregation_function, function)) {
+        msg = "Aggregation function " + aggregation_function + " is invalid.";
+        return false;
       }
 
-      size_t thread_count = threads.size();
-      for (size_t i = 0; i < thread_count; ++i) {
-        threads[i].wait();
-        const auto& result = threads[i].get();
-        bool okay = std::get<0>(result);
-        if (!okay) {
-          msg = std::get<1>(result);
-          return false;
-        }
-        chromosome_accs[std::get<2>(result)][std::get<3>(result)] = std::get<4>(result);
+      ScoreMatrix matrix;
+      matrix.rows = total_rows;
+      matrix.columns = total_columns;
+      size_t matrix_size;
+      if (function == algorithms::AGGREGATION_ACC) {
+        matrix.acc_cells.resize(total_cells);
+        matrix_size = total_cells * sizeof(std::string);
+      } else {
+        matrix.cells.assign(total_cells, no_data());
+        matrix_size = total_cells * sizeof(Score);
+      }
+      if (!status->sum_and_check_size(matrix_size)) {
+        msg = "Memory exhausted. Used "  + utils::size_t_to_string(status->total_size()) + "bytes of " + utils::size_t_to_string(status->maximum_size()) + "bytes allowed. Please, select a smaller initial dataset, for example, selecting fewer chromosomes)"; // TODO: put a better error msg.
+        return false;
       }
 
+      std::vector<size_t> first_rows;
+      size_t rows = 0;
+      for (auto &chromosome : range_regions) {
+        first_rows.push_back(rows);
+        rows += chromosome.second.size();
+      }
 
-      {
-        processing::RunningOp formatOp = status->start_operation(FORMAT_OUTPUT);
-
-        sb.append("CHROMOSOME\t");
-        sb.append("START\t");
-        sb.append("END\t");
-
-        bool first = true;
-        for (auto &experiments_format : experiments_formats) {
-          if (!first) {
-            sb.tab();
-          }
-          sb.append(experiments_format.first);
-          first = false;
+      const size_t summaries = norm_experiments_formats.size() * range_regions.size();
+      std::vector<std::string> errors(summaries);
+      std::vector<char> success(summaries, false);
+      threading::TaskGroup tasks(status->task_limit());
+      size_t pos = 0;
+      for (size_t column = 0; column < norm_experiments_formats.size(); column++) {
+        for (size_t c = 0; c < range_regions.size(); c++) {
+          tasks.spawn([&, pos, column, c]() {
+            success[pos] = summarize_experiment(function, norm_genome, norm_experiments_formats[column],
+                                                range_regions[c], column, first_rows[c], matrix, status, errors[pos]);
+          });
+          pos++;
         }
-        sb.endLine();
-
-        for (auto &chromosome : range_regions) {
-          size_t pos = 0;
-          const auto &chromosome_name = chromosome.first;
-          const auto &regions = chromosome.second;
-
-          for (const auto& region : regions) {
-            // Check if processing was canceled
-            bool is_canceled = false;
-            if (!status->is_canceled(is_canceled, msg)) {
-              return true;
-            }
-            if (is_canceled) {
-              msg = Error::m(ERR_REQUEST_CANCELED);
-              return false;
-            }
+      }
+      tasks.wait();
 
-            // ***
-            sb.append(chromosome_name);
-            sb.tab();
-            sb.append(utils::integer_to_string(region->start()));
-            sb.tab();
-            sb.append(utils::integer_to_string(region->end()));
-            sb.tab();
-
-            bool first = true;
-            for (auto &experiment_format : norm_experiments_formats) {
-              auto *acc = &chromosome_accs[experiment_format.first][chromosome_name]->at(pos);
-              if (!first) {
-                sb.tab();
-              } else {
-                first = false;
-              }
-              sb.append(*acc);
-            }
-            sb.endLine();
-            pos++;
-          }
+      for (size_t i = 0; i < summaries; i++) {
+        if (!success[i]) {
+          msg = errors[i];
+          return false;
         }
       }
 
-      return true;
+      processing::RunningOp formatOp = status->start_operation(FORMAT_OUTPUT);
+      if (output_format == SCORE_MATRIX_BINARY) {
+        return format_binary(experiments_formats, range_regions, matrix, sb, msg);
+      }
+      return format_text(experiments_formats, range_regions, matrix, status, sb, msg);
     }
   }
-}
\ No newline at end of file
+}
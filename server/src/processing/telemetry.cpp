@@ -0,0 +1,219 @@
+//
+//  telemetry.cpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <exception>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../connection/connection.hpp"
+#include "../dba/collections.hpp"
+#include "../dba/helpers.hpp"
+
+#include "../log.hpp"
+
+#include "telemetry.hpp"
+
+namespace epidb {
+  namespace processing {
+
+    static const std::chrono::milliseconds FLUSH_INTERVAL(500);
+
+    Telemetry::Telemetry() :
+      _events(CAPACITY),
+      _dropped(0),
+      _reported_dropped(0),
+      _stop(false)
+    {
+      _writer = std::thread(&Telemetry::work, this);
+    }
+
+    Telemetry::~Telemetry()
+    {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+      }
+      _cv.notify_one();
+      _writer.join();
+    }
+
+    void Telemetry::push(Event event)
+    {
+      if (!_events.push(std::move(event))) {
+        _dropped++;
+        return;
+      }
+      // Without the lock the writer may miss it, and write it after FLUSH_INTERVAL
+      if (_events.size() >= FLUSH_SIZE) {
+        _cv.notify_one();
+      }
+    }
+
+    void Telemetry::insert(const Collection collection, const mongo::BSONObj &document)
+    {
+      push(Event{ collection, true, document.getOwned(), mongo::BSONObj() });
+    }
+
+    void Telemetry::set(const Collection collection, const mongo::BSONObj &query, const mongo::BSONObj &fields)
+    {
+      push(Event{ collection, false, query.getOwned(), fields.getOwned() });
+    }
+
+    void Telemetry::work()
+    {
+      while (true) {
+        bool stop;
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          _cv.wait_for(lock, FLUSH_INTERVAL, [this] { return _stop || _events.size() >= FLUSH_SIZE; });
+          stop = _stop;
+        }
+
+        std::vector<Event> events;
+        Event event;
+        while (events.size() < MAX_BATCH && _events.pop(event)) {
+          events.push_back(std::move(event));
+        }
+        if (!events.empty()) {
+          // A failed write loses its events, but not the writer
+          try {
+            write(events);
+          } catch (const std::exception &e) {
+            EPIDB_LOG_ERR("Error writing the processing telemetry: " << e.what());
+            _dropped += events.size();
+          }
+        }
+
+        const size_t dropped = _dropped;
+        if (dropped != _reported_dropped) {
+          EPIDB_LOG_WARN("Telemetry: " << dropped - _reported_dropped << " processing writes were dropped.");
+          _reported_dropped = dropped;
+        }
+
+        if (stop && _events.size() == 0) {
+          return;
+        }
+      }
+    }
+
+    static const std::string &collection_name(const Telemetry::Collection collection)
+    {
+      static const std::string processing = dba::helpers::collection_name(dba::Collections::PROCESSING());
+      static const std::string processing_ops = dba::helpers::collection_name(dba::Collections::PROCESSING_OPS());
+      return collection == Telemetry::PROCESSING ? processing : processing_ops;
+    }
+
+    //
+    // The writes of each document are merged in the order they were queued:
+    // an insert followed by updates becomes one insert with the updated fields,
+    // the updates of a document inserted before become one update.
+    //
+    void Telemetry::write(std::vector<Event> &events)
+    {
+      struct Document {
+        Collection collection;
+        mongo::BSONObj insert;
+        mongo::BSONObj query;
+        // The elements point to the events documents, kept until the end
+        std::map<std::string, mongo::BSONElement> fields;
+        std::vector<std::string> order;
+      };
+
+      std::vector<Document> documents;
+      std::map<std::pair<int, std::string>, size_t> positions;
+
+      for (const auto &event : events) {
+        const std::pair<int, std::string> key((int) event.collection, event.document["_id"].toString(false));
+        auto it = positions.find(key);
+        if (event.insert || it == positions.end()) {
+          Document document;
+          document.collection = event.collection;
+          if (event.insert) {
+            document.insert = event.document;
+          } else {
+            document.query = event.document;
+          }
+          positions[key] = documents.size();
+          documents.push_back(std::move(document));
+          it = positions.find(key);
+        }
+        if (event.insert) {
+          continue;
+        }
+
+        Document &document = documents[it->second];
+        mongo::BSONObjIterator fields(event.fields);
+        while (fields.more()) {
+          const mongo::BSONElement e = fields.next();
+          if (document.fields.find(e.fieldName()) == document.fields.end()) {
+            document.order.push_back(e.fieldName());
+          }
+          document.fields[e.fieldName()] = e;
+        }
+      }
+
+      std::vector<mongo::BSONObj> inserts[2];
+      for (const auto &document : documents) {
+        if (document.insert.isEmpty()) {
+          continue;
+        }
+        mongo::BSONObjBuilder builder;
+        mongo::BSONObjIterator fields(document.insert);
+        while (fields.more()) {
+          const mongo::BSONElement e = fields.next();
+          if (document.fields.find(e.fieldName()) == document.fields.end()) {
+            builder.append(e);
+          }
+        }
+        for (const auto &name : document.order) {
+          builder.append(document.fields.at(name));
+        }
+        inserts[document.collection].push_back(builder.obj());
+      }
+
+      Connection c;
+      for (int collection = PROCESSING; collection <= PROCESSING_OPS; collection++) {
+        if (!inserts[collection].empty()) {
+          c->insert(collection_name((Collection) collection), inserts[collection]);
+        }
+      }
+
+      // Updates of documents inserted by previous writes
+      for (const auto &document : documents) {
+        if (!document.insert.isEmpty() || document.order.empty()) {
+          continue;
+        }
+        mongo::BSONObjBuilder builder;
+        for (const auto &name : document.order) {
+          builder.append(document.fields.at(name));
+        }
+        c->update(collection_name(document.collection), document.query, BSON("$set" << builder.obj()), false, false);
+      }
+      c.done();
+    }
+
+    Telemetry &telemetry()
+    {
+      static Telemetry instance;
+      return instance;
+    }
+  }
+}
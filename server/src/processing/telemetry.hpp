@@ -0,0 +1,93 @@
+//
+//  telemetry.hpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef EPIDB_PROCESSING_TELEMETRY_HPP
+#define EPIDB_PROCESSING_TELEMETRY_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mongo/bson/bson.h>
+
+#include "../threading/ring_buffer.hpp"
+
+namespace epidb {
+  namespace processing {
+
+    //
+    // Writes of the processing and processing operations documents.
+    // They are queued in a ring buffer and a background thread sends them to the
+    // database every FLUSH_INTERVAL, or earlier when FLUSH_SIZE writes are waiting.
+    // The updates of a document sent together are merged, also into its insert,
+    // so a short operation is stored with a single insert.
+    // When the buffer is full, or the database write fails, the writes are dropped and counted.
+    //
+    class Telemetry {
+    public:
+      enum Collection {
+        PROCESSING,
+        PROCESSING_OPS
+      };
+
+    private:
+      static const size_t CAPACITY = 64 * 1024;
+      static const size_t FLUSH_SIZE = 1024;
+      static const size_t MAX_BATCH = 8 * 1024;
+
+      struct Event {
+        Collection collection;
+        bool insert;
+        // The document to insert, or the query of the update
+        mongo::BSONObj document;
+        // Fields set by the update
+        mongo::BSONObj fields;
+      };
+
+      threading::RingBuffer<Event> _events;
+      std::atomic<size_t> _dropped;
+      size_t _reported_dropped;
+
+      std::mutex _mutex;
+      std::condition_variable _cv;
+      bool _stop;
+      std::thread _writer;
+
+      void push(Event event);
+      void work();
+      void write(std::vector<Event> &events);
+
+    public:
+      Telemetry();
+      ~Telemetry();
+
+      void insert(const Collection collection, const mongo::BSONObj &document);
+      void set(const Collection collection, const mongo::BSONObj &query, const mongo::BSONObj &fields);
+    };
+
+    Telemetry &telemetry();
+  }
+}
+
+#endif
@@ -0,0 +1,282 @@
+//
+//  upload_dataset.cpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../datatypes/metadata.hpp"
+#include "../datatypes/user.hpp"
+
+#include "../dba/exists.hpp"
+#include "../dba/insert.hpp"
+
+#include "../extras/utils.hpp"
+
+#include "../parser/parser_factory.hpp"
+#include "../parser/bedgraph_parser.hpp"
+#include "../parser/wig_parser.hpp"
+#include "../parser/wig.hpp"
+
+#include "../storage/compression.hpp"
+
+#include "processing.hpp"
+
+#include "../errors.hpp"
+
+namespace epidb {
+  namespace processing {
+
+    // Lines parsed between the checks of the request cancellation
+    static const size_t CANCEL_CHECK_LINES = 1 << 16;
+
+    //
+    // Open the uploaded data: stored compressed in the GridFS, or a local file of the server.
+    // The stored data is read and decompressed ahead by the executor threads while it is parsed.
+    //
+    static bool open_upload(const mongo::BSONObj &job, processing::StatusPtr status,
+                            std::unique_ptr<std::istream> &input, storage::DecompressedFileStream *&stored, std::string &msg)
+    {
+      const mongo::BSONObj dataset = job["dataset"].Obj();
+      stored = nullptr;
+
+      if (dataset.hasField("local_file")) {
+        const std::string file_name = dataset["local_file"].str();
+        input = std::unique_ptr<std::istream>(new std::ifstream(file_name.c_str()));
+        if (!input->good()) {
+          msg = "File " + file_name + " does not exist or it is not accessible.";
+          return false;
+        }
+        return true;
+      }
+
+      storage::Codec codec;
+      if (!storage::codec_from_name(job["codec"].str(), codec, msg)) {
+        return false;
+      }
+
+      std::vector<long long> frames;
+      for (const mongo::BSONElement &e : job["frames"].Array()) {
+        frames.push_back(e.numberLong());
+      }
+
+      const long long size = job["size"].numberLong();
+      stored = new storage::DecompressedFileStream(codec, frames, [status, size](size_t read) {
+        status->set_progress(op_name(PROCESS_UPLOAD_PARSE), read, size);
+      });
+      input = std::unique_ptr<std::istream>(stored);
+
+      return stored->open(job["upload"].str(), msg);
+    }
+
+    // The parser stops at a read error as at the end of the data
+    static bool check_read(const storage::DecompressedFileStream *stored, std::string &msg)
+    {
+      if (stored != nullptr && stored->failed(msg)) {
+        msg = "Error while reading the uploaded data: " + msg;
+        return false;
+      }
+      return true;
+    }
+
+    // The parsers own the input, so the stored data is checked before they are destroyed
+    static bool parse_wig(std::unique_ptr<std::istream> &&input, const storage::DecompressedFileStream *stored,
+                          const std::string &format, parser::WigPtr &wig, std::string &msg)
+    {
+      if (format == "wig") {
+        parser::WIGParser wig_parser(std::move(input));
+        return wig_parser.get(wig, msg) && check_read(stored, msg);
+      }
+      parser::BedGraphParser bedgraph_parser(std::move(input));
+      return bedgraph_parser.get(wig, msg) && check_read(stored, msg);
+    }
+
+    static bool parse_regions(std::unique_ptr<std::istream> &&input, const storage::DecompressedFileStream *stored,
+                              parser::FileFormat &file_format, processing::StatusPtr status,
+                              parser::ChromosomeRegionsMap &map_regions, size_t &count, std::string &msg)
+    {
+      parser::Parser parser(std::move(input), file_format);
+      if (!parser.check_format(msg)) {
+        return false;
+      }
+
+      count = 0;
+      while (!parser.eof()) {
+        if (count % CANCEL_CHECK_LINES == 0) {
+          IS_PROCESSING_CANCELLED(status);
+        }
+
+        parser::BedLine bed_line;
+        msg.clear();
+        if (!parser.parse_line(bed_line, msg)) {
+          // Ignore Empty Line Error
+          if (msg != "Empty line") {
+            std::stringstream m;
+            m << "Error while reading the BED file. Line: ";
+            m << parser.actual_line();
+            m << ". - '";
+            m << msg;
+            m << "'";
+            msg = m.str();
+            return false;
+          }
+        }
+
+        // Ignore empty line
+        if (msg == "Empty line") {
+          continue;
+        }
+
+        if (!parser.check_length(bed_line)) {
+          std::stringstream m;
+          m << "Error while reading the BED file. Line: ";
+          m << parser.actual_line();
+          m << ". - '";
+          m << parser.actual_line_content();
+          m << "'. The number of tokens (" ;
+          m << bed_line.size() ;
+          m << ") is different from the format size (" ;
+          m << parser.count_fields();
+          m << ") - ";
+          m << file_format.format();
+          msg = m.str();
+          return false;
+        }
+
+        map_regions.insert(std::move(bed_line));
+        count++;
+      }
+
+      if (!check_read(stored, msg)) {
+        return false;
+      }
+
+      map_regions.finish();
+      return true;
+    }
+
+    // The names were normalized by the command, that stored them in the dataset
+    template <typename... Regions>
+    static bool insert_parsed(const datatypes::User &user, const std::string &command, const mongo::BSONObj &dataset,
+                              std::string &id, std::string &msg, const Regions &... regions)
+    {
+      const std::string name = dataset["name"].str();
+      const std::string norm_name = dataset["norm_name"].str();
+      const std::string genome = dataset["genome"].str();
+      const std::string norm_genome = dataset["norm_genome"].str();
+      const std::string description = dataset["description"].str();
+      const std::string norm_description = dataset["norm_description"].str();
+      const std::string ip = dataset["ip"].str();
+      const datatypes::Metadata extra_metadata = datatypes::bson_to_metadata(dataset["extra_metadata"].Obj());
+
+      if (command == "add_annotation") {
+        return dba::insert_annotation(user, name, norm_name, genome, norm_genome, description, norm_description, extra_metadata,
+                                      ip, regions..., id, msg);
+      }
+
+      return dba::insert_experiment(user, name, norm_name, genome, norm_genome,
+                                    dataset["epigenetic_mark"].str(), dataset["norm_epigenetic_mark"].str(),
+                                    dataset["sample"].str(),
+                                    dataset["technique"].str(), dataset["norm_technique"].str(),
+                                    dataset["project"].str(), dataset["norm_project"].str(),
+                                    description, norm_description,
+                                    extra_metadata, ip, regions..., id, msg);
+    }
+
+    bool insert_dataset(const datatypes::User& user, const std::string& command, const mongo::BSONObj& dataset,
+                        std::unique_ptr<std::istream> &&input, const storage::DecompressedFileStream *stored,
+                        processing::StatusPtr status, std::string& id, std::string& msg)
+    {
+      const std::string format = dataset["format"].str();
+
+      if (format == "wig" || format == "bedgraph") {
+        parser::WigPtr wig;
+        {
+          processing::RunningOp runningOp = status->start_operation(PROCESS_UPLOAD_PARSE, BSON("format" << format));
+          if (!parse_wig(std::move(input), stored, format, wig, msg)) {
+            return false;
+          }
+        }
+        IS_PROCESSING_CANCELLED(status);
+
+        processing::RunningOp runningOp = status->start_operation(PROCESS_UPLOAD_INSERT);
+        status->set_progress(op_name(PROCESS_UPLOAD_INSERT), 0, 1);
+        if (!insert_parsed(user, command, dataset, id, msg, wig)) {
+          return false;
+        }
+        status->set_progress(op_name(PROCESS_UPLOAD_INSERT), 1, 1);
+        return true;
+      }
+
+      parser::FileFormat file_format;
+      if (!parser::FileFormatBuilder::build(format, file_format, msg)) {
+        return false;
+      }
+
+      parser::ChromosomeRegionsMap map_regions;
+      size_t count;
+      {
+        processing::RunningOp runningOp = status->start_operation(PROCESS_UPLOAD_PARSE, BSON("format" << format));
+        if (!parse_regions(std::move(input), stored, file_format, status, map_regions, count, msg)) {
+          return false;
+        }
+      }
+      IS_PROCESSING_CANCELLED(status);
+
+      processing::RunningOp runningOp = status->start_operation(PROCESS_UPLOAD_INSERT, BSON("regions" << (long long) count));
+      status->set_progress(op_name(PROCESS_UPLOAD_INSERT), 0, count);
+      if (!insert_parsed(user, command, dataset, id, msg, map_regions, file_format)) {
+        return false;
+      }
+      status->set_progress(op_name(PROCESS_UPLOAD_INSERT), count, count);
+      return true;
+    }
+
+    bool upload_dataset(const datatypes::User& user, const mongo::BSONObj& job,
+                        processing::StatusPtr status, std::string& id, std::string& msg)
+    {
+      IS_PROCESSING_CANCELLED(status);
+
+      const std::string command = job["command"].str();
+      const mongo::BSONObj dataset = job["dataset"].Obj();
+
+      // A dataset with the same name may be inserted while the job was waiting
+      if (command == "add_annotation") {
+        if (dba::exists::annotation(dataset["norm_name"].str(), dataset["norm_genome"].str())) {
+          msg = "The annotation name " + dataset["name"].str() + " is already being used for the genome " + dataset["genome"].str();
+          return false;
+        }
+      } else if (dba::exists::experiment(dataset["norm_name"].str())) {
+        msg = Error::m(ERR_DUPLICATED_EXPERIMENT_NAME, dataset["name"].str());
+        return false;
+      }
+
+      std::unique_ptr<std::istream> input;
+      storage::DecompressedFileStream *stored;
+      if (!open_upload(job, status, input, stored, msg)) {
+        return false;
+      }
+
+      return insert_dataset(user, command, dataset, std::move(input), stored, status, id, msg);
+    }
+  }
+}
@@ -0,0 +1,550 @@
+//
+//  compression.cpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <minilzo.h>
+
+#include "compression.hpp"
+
+#include "../threading/executor.hpp"
+
+namespace epidb {
+  namespace storage {
+
+    // LZO frame: magic, original size and compressed size, then the data.
+    // The data is stored uncompressed when both sizes are equal.
+    static const char LZO_MAGIC[4] = { 'D', 'B', 'L', 'Z' };
+    static const size_t LZO_HEADER_SIZE = 12;
+
+    static Codec result_codec = CODEC_BZIP2;
+
+    bool codec_from_name(const std::string &name, Codec &codec, std::string &msg)
+    {
+      if (name == "bzip2") {
+        codec = CODEC_BZIP2;
+        return true;
+      }
+      if (name == "lzo") {
+        codec = CODEC_LZO;
+        return true;
+      }
+      msg = "Invalid compression codec '" + name + "'. The valid codecs are: bzip2, lzo.";
+      return false;
+    }
+
+    std::string codec_name(const Codec codec)
+    {
+      switch (codec) {
+      case CODEC_LZO:
+        return "lzo";
+      default:
+        return "bzip2";
+      }
+    }
+
+    void set_result_codec(const Codec codec)
+    {
+      result_codec = codec;
+    }
+
+    Codec get_result_codec()
+    {
+      return result_codec;
+    }
+
+    static void put_uint32(char *ptr, const uint32_t value)
+    {
+      for (int i = 0; i < 4; i++) {
+        ptr[i] = (value >> (8 * i)) & 0xff;
+      }
+    }
+
+    static uint32_t get_uint32(const char *ptr)
+    {
+      uint32_t value = 0;
+      for (int i = 0; i < 4; i++) {
+        value |= uint32_t((unsigned char) ptr[i]) << (8 * i);
+      }
+      return value;
+    }
+
+    static void compress_frame(const Codec codec, const std::string &data, std::string &out)
+    {
+      if (codec == CODEC_LZO) {
+        std::vector<unsigned char> wrkmem(LZO1X_1_MEM_COMPRESS);
+        out.resize(LZO_HEADER_SIZE + data.size() + data.size() / 16 + 64 + 3);
+        lzo_uint out_size;
+        int r = lzo1x_1_compress(reinterpret_cast<const lzo_bytep>(data.data()), data.size(),
+                                 reinterpret_cast<lzo_bytep>(&out[LZO_HEADER_SIZE]), &out_size, wrkmem.data());
+        if (r != LZO_E_OK || out_size >= data.size()) {
+          out_size = data.size();
+          memcpy(&out[LZO_HEADER_SIZE], data.data(), data.size());
+        }
+        memcpy(&out[0], LZO_MAGIC, 4);
+        put_uint32(&out[4], data.size());
+        put_uint32(&out[8], out_size);
+        out.resize(LZO_HEADER_SIZE + out_size);
+        return;
+      }
+
+      boost::iostreams::filtering_ostream os;
+      os.push(boost::iostreams::bzip2_compressor());
+      os.push(boost::iostreams::back_inserter(out));
+      os.write(data.data(), data.size());
+      os.reset();
+    }
+
+    static bool decompress_frame(const Codec codec, const char *data, const size_t size, std::string &out, std::string &msg)
+    {
+      if (codec == CODEC_LZO) {
+        if (size < LZO_HEADER_SIZE || memcmp(data, LZO_MAGIC, 4) != 0) {
+          msg = "Invalid LZO frame in the result data.";
+          return false;
+        }
+        const size_t original_size = get_uint32(data + 4);
+        const size_t compressed_size = get_uint32(data + 8);
+        if (compressed_size != size - LZO_HEADER_SIZE) {
+          msg = "Invalid LZO frame size in the result data.";
+          return false;
+        }
+        if (compressed_size == original_size) {
+          out.assign(data + LZO_HEADER_SIZE, compressed_size);
+          return true;
+        }
+        out.resize(original_size);
+        lzo_uint out_size = original_size;
+        int r = lzo1x_decompress_safe(reinterpret_cast<const lzo_bytep>(data + LZO_HEADER_SIZE), compressed_size,
+                                      reinterpret_cast<lzo_bytep>(&out[0]), &out_size, NULL);
+        if (r != LZO_E_OK || out_size != original_size) {
+          msg = "Error decompressing the LZO frame of the result data.";
+          return false;
+        }
+        return true;
+      }
+
+      try {
+        boost::iostreams::filtering_ostream os;
+        os.push(boost::iostreams::bzip2_decompressor());
+        os.push(boost::iostreams::back_inserter(out));
+        os.write(data, size);
+        os.reset();
+      } catch (const std::exception &e) {
+        msg = std::string("Error decompressing the result data: ") + e.what();
+        return false;
+      }
+      return true;
+    }
+
+    struct CompressedFileWriter::Block {
+      std::string data;
+      std::string compressed;
+      threading::TaskPtr task;
+    };
+
+    CompressedFileWriter::CompressedFileWriter(const std::string &filename, const Codec codec) :
+      _codec(codec),
+      _max_blocks(2 * threading::executor().size()),
+      _file(filename),
+      _original_size(0),
+      _finish(false),
+      _abort(false),
+      _failed(false)
+    {
+      _current.reserve(BLOCK_SIZE);
+      _thread = std::thread(&CompressedFileWriter::store, this);
+    }
+
+    CompressedFileWriter::~CompressedFileWriter()
+    {
+      if (_thread.joinable()) {
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _abort = true;
+        }
+        _not_empty.notify_one();
+        _thread.join();
+      }
+    }
+
+    void CompressedFileWriter::write(std::string &&data)
+    {
+      _original_size += data.size();
+
+      size_t pos = 0;
+      while (pos < data.size()) {
+        size_t part = std::min(data.size() - pos, BLOCK_SIZE - _current.size());
+        _current.append(data, pos, part);
+        pos += part;
+        if (_current.size() == BLOCK_SIZE) {
+          submit_block();
+        }
+      }
+    }
+
+    void CompressedFileWriter::submit_block()
+    {
+      BlockPtr block = std::make_shared<Block>();
+      block->data.swap(_current);
+      _current.reserve(BLOCK_SIZE);
+
+      // The block is not kept alive by its task, it is discarded when the file is aborted
+      std::weak_ptr<Block> weak = block;
+      const Codec codec = _codec;
+      block->task = std::make_shared<threading::Task>([weak, codec]() {
+        BlockPtr b = weak.lock();
+        if (b) {
+          compress_frame(codec, b->data, b->compressed);
+          std::string().swap(b->data);
+        }
+      });
+
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _not_full.wait(lock, [this] { return _blocks.size() < _max_blocks; });
+        _blocks.push_back(block);
+      }
+      _not_empty.notify_one();
+
+      threading::executor().submit(block->task, threading::PRIORITY_LOW);
+    }
+
+    void CompressedFileWriter::store()
+    {
+      while (true) {
+        BlockPtr block;
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          _not_empty.wait(lock, [this] { return !_blocks.empty() || _finish || _abort; });
+          if (_abort) {
+            return;
+          }
+          if (_blocks.empty()) {
+            return;
+          }
+          block = _blocks.front();
+        }
+
+        // Compressed here when no executor thread took it yet
+        try {
+          block->task->wait();
+        } catch (const std::exception &e) {
+          _failed = true;
+          _msg = std::string("Error compressing the result: ") + e.what();
+        }
+
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _blocks.pop_front();
+        }
+        _not_full.notify_one();
+
+        // After a failure the blocks are only consumed, so the producer does not wait forever
+        if (!_failed) {
+          if (_file.write(block->compressed.data(), block->compressed.size(), _msg)) {
+            _frames.push_back(block->compressed.size());
+          } else {
+            _failed = true;
+          }
+        }
+      }
+    }
+
+    bool CompressedFileWriter::close(size_t &original_size, size_t &compressed_size, std::vector<long long> &frames, std::string &msg)
+    {
+      if (!_current.empty()) {
+        submit_block();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _finish = true;
+      }
+      _not_empty.notify_one();
+      _thread.join();
+
+      if (_failed) {
+        msg = _msg;
+        return false;
+      }
+
+      if (!_file.close(msg)) {
+        return false;
+      }
+
+      original_size = _original_size;
+      compressed_size = _file.size();
+      frames = _frames;
+      return true;
+    }
+
+    struct DecompressedFileReader::Frame {
+      std::string compressed;
+      std::string data;
+      bool ok;
+      std::string msg;
+      threading::TaskPtr task;
+    };
+
+    DecompressedFileReader::DecompressedFileReader(const Codec codec, const std::vector<long long> &frames) :
+      _codec(codec),
+      _frames(frames),
+      _max_frames(threading::executor().size()),
+      _buffer_pos(0),
+      _file_pos(0),
+      _next_frame(0)
+    { }
+
+    bool DecompressedFileReader::open(const std::string &filename, std::string &msg)
+    {
+      return _file.open(filename, msg);
+    }
+
+    bool DecompressedFileReader::fill(const size_t size, std::string &msg)
+    {
+      if (_buffer.size() - _buffer_pos >= size) {
+        return true;
+      }
+
+      _buffer.erase(0, _buffer_pos);
+      _buffer_pos = 0;
+      std::string data;
+      while (_buffer.size() < size) {
+        if (_file_pos >= _file.size()) {
+          msg = "The result data is smaller than its frames.";
+          return false;
+        }
+        // Until the end of the chunk, so each chunk is read once
+        if (!_file.read(_file_pos, _file.size() - _file_pos, data, msg)) {
+          return false;
+        }
+        _file_pos += data.size();
+        _buffer += data;
+      }
+      return true;
+    }
+
+    bool DecompressedFileReader::read_frame(FramePtr &frame, std::string &msg)
+    {
+      frame.reset();
+      const size_t remaining = _file.size() - _file_pos + _buffer.size() - _buffer_pos;
+
+      size_t size;
+      if (!_frames.empty()) {
+        if (_next_frame == _frames.size()) {
+          return true;
+        }
+        size = _frames[_next_frame++];
+      } else if (remaining == 0) {
+        return true;
+      } else if (_codec == CODEC_LZO) {
+        if (remaining < LZO_HEADER_SIZE || !fill(LZO_HEADER_SIZE, msg)) {
+          msg = "Invalid LZO frame in the result data.";
+          return false;
+        }
+        size = std::min(remaining, LZO_HEADER_SIZE + get_uint32(_buffer.data() + _buffer_pos + 8));
+      } else {
+        size = remaining;
+      }
+
+      if (!fill(size, msg)) {
+        return false;
+      }
+
+      frame = std::make_shared<Frame>();
+      frame->compressed.assign(_buffer, _buffer_pos, size);
+      frame->ok = false;
+      _buffer_pos += size;
+      return true;
+    }
+
+    bool DecompressedFileReader::next(std::string &part, std::string &msg)
+    {
+      while (_pending.size() < _max_frames) {
+        FramePtr frame;
+        if (!read_frame(frame, msg)) {
+          return false;
+        }
+        if (!frame) {
+          break;
+        }
+
+        // The frame is not kept alive by its task, it is discarded when the reader is
+        std::weak_ptr<Frame> weak = frame;
+        const Codec codec = _codec;
+        frame->task = std::make_shared<threading::Task>([weak, codec]() {
+          FramePtr f = weak.lock();
+          if (f) {
+            f->ok = decompress_frame(codec, f->compressed.data(), f->compressed.size(), f->data, f->msg);
+            std::string().swap(f->compressed);
+          }
+        });
+        _pending.push_back(frame);
+        threading::executor().submit(frame->task, threading::PRIORITY_HIGH);
+      }
+
+      part.clear();
+      if (_pending.empty()) {
+        return true;
+      }
+
+      FramePtr frame = _pending.front();
+      _pending.pop_front();
+      // Decompressed here when no executor thread took it yet
+      frame->task->wait();
+      if (!frame->ok) {
+        msg = frame->msg;
+        return false;
+      }
+      part.swap(frame->data);
+      return true;
+    }
+
+    DecompressedFileStream::Buffer::Buffer(const Codec codec, const std::vector<long long> &frames,
+                                           std::function<void(size_t)> progress) :
+      _reader(codec, frames),
+      _progress(std::move(progress)),
+      _read(0),
+      _failed(false)
+    { }
+
+    DecompressedFileStream::Buffer::int_type DecompressedFileStream::Buffer::underflow()
+    {
+      if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+      }
+      if (_failed) {
+        return traits_type::eof();
+      }
+
+      if (!_reader.next(_part, _msg)) {
+        _failed = true;
+        return traits_type::eof();
+      }
+      if (_part.empty()) {
+        return traits_type::eof();
+      }
+
+      _read += _part.size();
+      if (_progress) {
+        _progress(_read);
+      }
+
+      char *data = &_part[0];
+      setg(data, data, data + _part.size());
+      return traits_type::to_int_type(*gptr());
+    }
+
+    DecompressedFileStream::DecompressedFileStream(const Codec codec, const std::vector<long long> &frames,
+        std::function<void(size_t)> progress) :
+      std::istream(nullptr),
+      _buffer(codec, frames, std::move(progress))
+    {
+      rdbuf(&_buffer);
+    }
+
+    bool DecompressedFileStream::open(const std::string &filename, std::string &msg)
+    {
+      return _buffer._reader.open(filename, msg);
+    }
+
+    bool DecompressedFileStream::failed(std::string &msg) const
+    {
+      if (_buffer._failed) {
+        msg = _buffer._msg;
+      }
+      return _buffer._failed;
+    }
+
+    bool decompress(const std::string &content, const Codec codec, const std::vector<long long> &frames,
+                    std::string &out, std::string &msg)
+    {
+      // Position and size of each frame
+      std::vector<std::pair<size_t, size_t>> parts;
+      if (codec == CODEC_LZO) {
+        size_t pos = 0;
+        while (pos < content.size()) {
+          if (content.size() - pos < LZO_HEADER_SIZE) {
+            msg = "Invalid LZO frame in the result data.";
+            return false;
+          }
+          size_t size = LZO_HEADER_SIZE + get_uint32(content.data() + pos + 8);
+          parts.emplace_back(pos, std::min(size, content.size() - pos));
+          pos += size;
+        }
+      } else if (frames.empty()) {
+        parts.emplace_back(0, content.size());
+      } else {
+        size_t pos = 0;
+        for (const long long size : frames) {
+          if (pos + size > content.size()) {
+            msg = "The result data is smaller than its frames.";
+            return false;
+          }
+          parts.emplace_back(pos, size);
+          pos += size;
+        }
+      }
+
+      std::vector<std::string> outputs(parts.size());
+      std::mutex error_mutex;
+      bool failed = false;
+
+      threading::TaskGroup group(threading::build_task_limit());
+      for (size_t i = 0; i < parts.size(); i++) {
+        group.spawn([&, i]() {
+          std::string frame_msg;
+          if (!decompress_frame(codec, content.data() + parts[i].first, parts[i].second, outputs[i], frame_msg)) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!failed) {
+              failed = true;
+              msg = frame_msg;
+            }
+          }
+        });
+      }
+      group.wait();
+
+      if (failed) {
+        return false;
+      }
+
+      size_t total = 0;
+      for (const auto &output : outputs) {
+        total += output.size();
+      }
+      out.clear();
+      out.reserve(total);
+      for (auto &output : outputs) {
+        out += output;
+        std::string().swap(output);
+      }
+      return true;
+    }
+  }
+}
@@ -0,0 +1,185 @@
+//
+//  compression.hpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef EPIDB_STORAGE_COMPRESSION_HPP
+#define EPIDB_STORAGE_COMPRESSION_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "storage.hpp"
+
+namespace epidb {
+  namespace storage {
+
+    enum Codec {
+      CODEC_BZIP2,
+      CODEC_LZO
+    };
+
+    bool codec_from_name(const std::string &name, Codec &codec, std::string &msg);
+    std::string codec_name(const Codec codec);
+
+    // Codec of the new results, set at the server start
+    void set_result_codec(const Codec codec);
+    Codec get_result_codec();
+
+    //
+    // Stores a file compressed while its content is produced.
+    // The content is split in blocks that are compressed as independent frames by
+    // the executor threads: a bzip2 stream each, so the file is a valid multi-stream
+    // bzip2 file, or a LZO frame with its sizes in a header.
+    // A writer thread stores the frames in order in the GridFS, as the chunks fill.
+    // The producer waits when too many blocks are being compressed, so the memory used
+    // does not depend on the file size.
+    //
+    class CompressedFileWriter {
+    private:
+      // A bzip2 block at the maximum compression level
+      static const size_t BLOCK_SIZE = 900 * 1000;
+
+      struct Block;
+      typedef std::shared_ptr<Block> BlockPtr;
+
+      const Codec _codec;
+      const size_t _max_blocks;
+      FileWriter _file;
+
+      std::string _current;
+      std::deque<BlockPtr> _blocks;
+      size_t _original_size;
+      bool _finish;
+      bool _abort;
+
+      // Set by the writer thread
+      std::vector<long long> _frames;
+      bool _failed;
+      std::string _msg;
+
+      std::mutex _mutex;
+      std::condition_variable _not_empty;
+      std::condition_variable _not_full;
+      std::thread _thread;
+
+      void submit_block();
+      void store();
+
+    public:
+      CompressedFileWriter(const std::string &filename, const Codec codec);
+      // Discards the file if it was not closed
+      ~CompressedFileWriter();
+
+      void write(std::string &&data);
+
+      // frames are the compressed sizes of the frames, in the file order
+      bool close(size_t &original_size, size_t &compressed_size, std::vector<long long> &frames, std::string &msg);
+    };
+
+    //
+    // Reads a compressed file decompressed, one frame at a time. The next frames
+    // are decompressed ahead by the executor threads while the current one is used,
+    // so the memory used does not depend on the file size.
+    // A bzip2 file without the frame sizes is decompressed whole.
+    //
+    class DecompressedFileReader {
+    private:
+      struct Frame;
+      typedef std::shared_ptr<Frame> FramePtr;
+
+      const Codec _codec;
+      const std::vector<long long> _frames;
+      const size_t _max_frames;
+      FileReader _file;
+
+      // Compressed data read from the file, from _buffer_pos, and the next position to read
+      std::string _buffer;
+      size_t _buffer_pos;
+      size_t _file_pos;
+      size_t _next_frame;
+      std::deque<FramePtr> _pending;
+
+      bool fill(const size_t size, std::string &msg);
+      bool read_frame(FramePtr &frame, std::string &msg);
+
+    public:
+      DecompressedFileReader(const Codec codec, const std::vector<long long> &frames);
+
+      DecompressedFileReader(const DecompressedFileReader &) = delete;
+      DecompressedFileReader &operator=(const DecompressedFileReader &) = delete;
+
+      bool open(const std::string &filename, std::string &msg);
+
+      // The next decompressed part of the file, empty at its end
+      bool next(std::string &part, std::string &msg);
+    };
+
+    //
+    // Input stream over a compressed file, to parse it while it is read and decompressed.
+    // progress is called with the decompressed size read so far, at each part.
+    //
+    class DecompressedFileStream : public std::istream {
+    private:
+      class Buffer : public std::streambuf {
+      private:
+        DecompressedFileReader _reader;
+        std::function<void(size_t)> _progress;
+        std::string _part;
+        size_t _read;
+        bool _failed;
+        std::string _msg;
+
+      protected:
+        int_type underflow();
+
+      public:
+        Buffer(const Codec codec, const std::vector<long long> &frames, std::function<void(size_t)> progress);
+
+        friend class DecompressedFileStream;
+      };
+
+      Buffer _buffer;
+
+    public:
+      DecompressedFileStream(const Codec codec, const std::vector<long long> &frames,
+                             std::function<void(size_t)> progress = nullptr);
+
+      bool open(const std::string &filename, std::string &msg);
+
+      // Error that ended the stream before the end of the file
+      bool failed(std::string &msg) const;
+    };
+
+    //
+    // Decompress the frames of a file in parallel.
+    // Without the frame sizes, a bzip2 file is decompressed as a single stream.
+    //
+    bool decompress(const std::string &content, const Codec codec, const std::vector<long long> &frames,
+                    std::string &out, std::string &msg);
+  }
+}
+
+#endif
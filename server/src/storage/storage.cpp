@@ -19,9 +19,12 @@
 //
 
 
+#include <algorithm>
+
 #include <mongo/client/dbclient.h>
 #include <mongo/client/gridfs.h>
 
+#include "storage.hpp"
 
 #include "../config/config.hpp"
 
@@ -33,6 +36,17 @@
 namespace epidb {
   namespace storage {
 
+    static bool check_error(Connection &c, std::string &msg)
+    {
+      std::string e = c->getLastError();
+      if (!e.empty()) {
+        msg = "Error storing the result: " + e;
+        EPIDB_LOG_ERR(msg);
+        return false;
+      }
+      return true;
+    }
+
     void clear_all()
     {
       Connection c;
@@ -122,5 +136,134 @@ namespace epidb {
       content = ss.str();
       return true;
     }
+  
+    FileReader::FileReader() :
+      _chunk_size(0),
+      _file_size(0)
+    { }
+
+    bool FileReader::open(const std::string &filename, std::string &msg)
+    {
+      _filename = filename;
+      return get_file_info(filename, _oid, _chunk_size, _file_size, msg);
+    }
+
+    bool FileReader::read(const size_t pos, const size_t len, std::string &data, std::string &msg)
+    {
+      if (pos >= _file_size || _chunk_size == 0) {
+        msg = "Invalid position " + std::to_string(pos) + " in the file " + _filename + ".";
+        return false;
+      }
+
+      const long long n = pos / _chunk_size;
+      mongo::BSONObj projection = BSON("data" << 1);
+
+      Connection c;
+      mongo::Query q(BSON("files_id" << _oid << "n" << n));
+      auto data_cursor = c->query(config::DATABASE_NAME() + ".fs.chunks", q, 0, 0, &projection);
+      if (!data_cursor->more()) {
+        msg = "Chunk for file " + _filename + " not found.";
+        c.done();
+        return false;
+      }
+
+      int read;
+      const char *chunk = data_cursor->next().getField("data").binData(read);
+      const size_t offset = pos - n * _chunk_size;
+      if (offset >= (size_t) read) {
+        msg = "Chunk for file " + _filename + " is smaller than expected.";
+        c.done();
+        return false;
+      }
+      data.assign(chunk + offset, std::min(len, read - offset));
+      c.done();
+
+      return true;
+    }
+
+    FileWriter::FileWriter(const std::string &filename) :
+      _filename(filename),
+      _oid(mongo::OID::gen()),
+      _n(0),
+      _length(0),
+      _closed(false)
+    {
+      _chunk.reserve(CHUNK_SIZE);
+    }
+
+    FileWriter::~FileWriter()
+    {
+      if (_closed || _n == 0) {
+        return;
+      }
+      try {
+        Connection c;
+        c->remove(config::DATABASE_NAME() + ".fs.chunks", BSON("files_id" << _oid));
+        c.done();
+      } catch (const std::exception &e) {
+        EPIDB_LOG_ERR("Error removing the chunks of " << _filename << ": " << e.what());
+      }
+    }
+
+    bool FileWriter::write_chunk(std::string &msg)
+    {
+      mongo::BSONObjBuilder bob;
+      bob.append("files_id", _oid);
+      bob.append("n", _n);
+      bob.appendBinData("data", _chunk.size(), mongo::BinDataGeneral, _chunk.data());
+
+      Connection c;
+      c->insert(config::DATABASE_NAME() + ".fs.chunks", bob.obj());
+      if (!check_error(c, msg)) {
+        c.done();
+        return false;
+      }
+      c.done();
+
+      _n++;
+      _chunk.clear();
+      return true;
+    }
+
+    bool FileWriter::write(const char *ptr, size_t len, std::string &msg)
+    {
+      while (len > 0) {
+        size_t part = std::min(len, CHUNK_SIZE - _chunk.size());
+        _chunk.append(ptr, part);
+        _length += part;
+        ptr += part;
+        len -= part;
+
+        if (_chunk.size() == CHUNK_SIZE && !write_chunk(msg)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool FileWriter::close(std::string &msg)
+    {
+      if (!_chunk.empty() && !write_chunk(msg)) {
+        return false;
+      }
+
+      mongo::BSONObjBuilder bob;
+      bob.append("_id", _oid);
+      bob.append("filename", _filename);
+      bob.append("chunkSize", (int) CHUNK_SIZE);
+      bob.appendDate("uploadDate", mongo::jsTime());
+      bob.append("length", (long long) _length);
+
+      Connection c;
+      c->insert(config::DATABASE_NAME() + ".fs.files", bob.obj());
+      if (!check_error(c, msg)) {
+        c.done();
+        return false;
+      }
+      c.done();
+
+      _closed = true;
+      return true;
+    }
   }
 }
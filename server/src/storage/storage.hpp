@@ -34,6 +34,64 @@ namespace epidb {
     std::string store(const std::string filename, const char *ptr, size_t len);
 
     bool load(const std::string &filename, std::string &content, std::string &msg);
+
+    //
+    // Reads a file of the GridFS by chunks, without loading it whole.
+    //
+    class FileReader {
+    private:
+      std::string _filename;
+      mongo::OID _oid;
+      size_t _chunk_size;
+      size_t _file_size;
+
+    public:
+      FileReader();
+
+      bool open(const std::string &filename, std::string &msg);
+
+      size_t size() const
+      {
+        return _file_size;
+      }
+
+      // Read the data from pos until the end of its chunk, at most len bytes
+      bool read(const size_t pos, const size_t len, std::string &data, std::string &msg);
+    };
+
+    //
+    // Stores a file in the GridFS chunk by chunk, as the data is written.
+    // The file is visible only after it is closed. The chunks of a file that
+    // is not closed are removed by the destructor.
+    //
+    class FileWriter {
+    private:
+      std::string _filename;
+      mongo::OID _oid;
+      std::string _chunk;
+      long long _n;
+      size_t _length;
+      bool _closed;
+
+      bool write_chunk(std::string &msg);
+
+    public:
+      static const size_t CHUNK_SIZE = 2 << 22; // 8MB
+
+      explicit FileWriter(const std::string &filename);
+      ~FileWriter();
+
+      FileWriter(const FileWriter &) = delete;
+      FileWriter &operator=(const FileWriter &) = delete;
+
+      bool write(const char *ptr, size_t len, std::string &msg);
+      bool close(std::string &msg);
+
+      size_t size() const
+      {
+        return _length;
+      }
+    };
   }
 }
 
@@ -0,0 +1,341 @@
+//
+//  executor.cpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "executor.hpp"
+
+namespace epidb {
+  namespace threading {
+
+    // Executor and worker of the current thread, when it is an executor thread
+    static thread_local Executor *current_executor = nullptr;
+    static thread_local size_t current_worker = 0;
+
+    Task::Task(std::function<void()> fn) :
+      _fn(std::move(fn)),
+      _started(false),
+      _done(false)
+    { }
+
+    bool Task::started() const
+    {
+      return _started;
+    }
+
+    bool Task::try_run()
+    {
+      bool expected = false;
+      if (!_started.compare_exchange_strong(expected, true)) {
+        return false;
+      }
+
+      try {
+        _fn();
+      } catch (...) {
+        _exception = std::current_exception();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _done = true;
+      }
+      _cv.notify_all();
+      return true;
+    }
+
+    void Task::wait()
+    {
+      if (!try_run()) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this] { return _done; });
+      }
+
+      if (_exception) {
+        std::rethrow_exception(_exception);
+      }
+    }
+
+    Executor::Executor(size_t threads) :
+      _stop(false),
+      _queued(0),
+      _active(0),
+      _executed(0),
+      _steals(0)
+    {
+      for (size_t i = 0; i < threads; i++) {
+        _workers.emplace_back(new Worker());
+      }
+      for (size_t i = 0; i < threads; i++) {
+        _threads.emplace_back(&Executor::work, this, i);
+      }
+    }
+
+    Executor::~Executor()
+    {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+      }
+      _cv.notify_all();
+      for (auto &t : _threads) {
+        t.join();
+      }
+    }
+
+    size_t Executor::size() const
+    {
+      return _workers.size();
+    }
+
+    void Executor::submit(TaskPtr task, const Priority priority)
+    {
+      if (current_executor == this) {
+        Worker &worker = *_workers[current_worker];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.deque.push_back(task);
+        _queued++;
+      } else {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queues[priority].push_back(task);
+        _queued++;
+      }
+
+      {
+        // Do not notify between the check and the wait of an idle thread
+        std::lock_guard<std::mutex> lock(_mutex);
+      }
+      _cv.notify_one();
+    }
+
+    bool Executor::pop(const size_t worker, TaskPtr &task)
+    {
+      {
+        Worker &own = *_workers[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.deque.empty()) {
+          task = own.deque.back();
+          own.deque.pop_back();
+          _queued--;
+          return true;
+        }
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &queue : _queues) {
+          if (!queue.empty()) {
+            task = queue.front();
+            queue.pop_front();
+            _queued--;
+            return true;
+          }
+        }
+      }
+
+      for (size_t i = 1; i < _workers.size(); i++) {
+        Worker &victim = *_workers[(worker + i) % _workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.deque.empty()) {
+          task = victim.deque.front();
+          victim.deque.pop_front();
+          _queued--;
+          _steals++;
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    void Executor::work(const size_t worker)
+    {
+      current_executor = this;
+      current_worker = worker;
+
+      while (true) {
+        TaskPtr task;
+        if (pop(worker, task)) {
+          _active++;
+          // The task may already be executed by the thread waiting for it
+          if (task->try_run()) {
+            _executed++;
+          }
+          _active--;
+          continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this] { return _stop || _queued > 0; });
+        if (_stop && _queued == 0) {
+          return;
+        }
+      }
+    }
+
+    void Executor::stats(size_t &threads, size_t &queued, size_t &active, size_t &executed, size_t &steals) const
+    {
+      threads = _workers.size();
+      queued = _queued;
+      active = _active;
+      executed = _executed;
+      steals = _steals;
+    }
+
+    Executor &executor()
+    {
+      static Executor instance(std::max(2u, std::thread::hardware_concurrency()));
+      return instance;
+    }
+
+    TaskLimit::TaskLimit(const size_t max_running, const Priority priority) :
+      _free(max_running),
+      _priority(priority)
+    { }
+
+    bool TaskLimit::acquire()
+    {
+      long free = _free;
+      while (free > 0) {
+        if (_free.compare_exchange_weak(free, free - 1)) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void TaskLimit::release()
+    {
+      _free++;
+    }
+
+    Priority TaskLimit::priority() const
+    {
+      return static_cast<Priority>(_priority.load());
+    }
+
+    void TaskLimit::set_priority(const Priority priority)
+    {
+      _priority = priority;
+    }
+
+    TaskLimitPtr build_task_limit()
+    {
+      return std::make_shared<TaskLimit>(std::max<size_t>(2, executor().size() / 2), PRIORITY_NORMAL);
+    }
+
+    TaskGroup::TaskGroup(TaskLimitPtr limit) :
+      _limit(limit)
+    { }
+
+    TaskGroup::~TaskGroup()
+    {
+      // The tasks may use the stack of the thread that created the group
+      try {
+        wait();
+      } catch (...) {
+      }
+    }
+
+    void TaskGroup::spawn(std::function<void()> fn)
+    {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const size_t pos = _tasks.size();
+        _tasks.push_back(std::make_shared<Task>([this, pos, fn]() {
+          try {
+            fn();
+          } catch (...) {
+            finished(pos);
+            throw;
+          }
+          finished(pos);
+        }));
+        _submitted.push_back(false);
+        _pending.push_back(pos);
+      }
+      submit_pending();
+    }
+
+    void TaskGroup::submit_pending()
+    {
+      while (true) {
+        TaskPtr task;
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          // Skip the tasks already executed by the waiting thread
+          while (!_pending.empty() && _tasks[_pending.front()]->started()) {
+            _pending.pop_front();
+          }
+          if (_pending.empty() || !_limit->acquire()) {
+            return;
+          }
+          const size_t pos = _pending.front();
+          _pending.pop_front();
+          _submitted[pos] = true;
+          task = _tasks[pos];
+        }
+        executor().submit(task, _limit->priority());
+      }
+    }
+
+    void TaskGroup::finished(const size_t pos)
+    {
+      bool submitted;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        submitted = _submitted[pos];
+      }
+      if (submitted) {
+        _limit->release();
+        submit_pending();
+      }
+    }
+
+    void TaskGroup::wait()
+    {
+      std::exception_ptr exception;
+      for (size_t pos = 0; ; pos++) {
+        TaskPtr task;
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          if (pos >= _tasks.size()) {
+            break;
+          }
+          task = _tasks[pos];
+        }
+        try {
+          task->wait();
+        } catch (...) {
+          if (!exception) {
+            exception = std::current_exception();
+          }
+        }
+      }
+
+      if (exception) {
+        std::rethrow_exception(exception);
+      }
+    }
+  }
+}
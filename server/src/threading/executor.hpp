@@ -0,0 +1,167 @@
+//
+//  executor.hpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef EPIDB_THREADING_EXECUTOR_HPP
+#define EPIDB_THREADING_EXECUTOR_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace epidb {
+  namespace threading {
+
+    enum Priority {
+      PRIORITY_HIGH,
+      PRIORITY_NORMAL,
+      PRIORITY_LOW,
+      PRIORITIES
+    };
+
+    //
+    // A function executed only once, either by an executor thread or
+    // by the thread that waits for it, when it was not started yet.
+    // Waiting for a task therefore never blocks on a busy executor,
+    // and tasks can wait for other tasks (e.g. the query sub-trees).
+    //
+    class Task {
+    private:
+      std::function<void()> _fn;
+      std::atomic<bool> _started;
+      bool _done;
+      std::exception_ptr _exception;
+      std::mutex _mutex;
+      std::condition_variable _cv;
+
+    public:
+      explicit Task(std::function<void()> fn);
+
+      bool started() const;
+
+      // Run the function if no one started it yet.
+      bool try_run();
+
+      // Run the function here if not started yet, otherwise wait until it is finished.
+      // An exception thrown by the function is thrown again here.
+      void wait();
+    };
+
+    typedef std::shared_ptr<Task> TaskPtr;
+
+    //
+    // Work stealing executor with a fixed number of threads.
+    // Tasks submitted by an executor thread go to its own deque and are executed
+    // newest first, the idle threads steal the oldest ones.
+    // Tasks submitted by other threads are executed by priority, in FIFO order.
+    //
+    class Executor {
+    private:
+      struct Worker {
+        std::deque<TaskPtr> deque;
+        std::mutex mutex;
+      };
+
+      std::vector<std::unique_ptr<Worker>> _workers;
+      std::vector<std::thread> _threads;
+      std::deque<TaskPtr> _queues[PRIORITIES];
+      std::mutex _mutex;
+      std::condition_variable _cv;
+      bool _stop;
+
+      std::atomic<size_t> _queued;
+      std::atomic<size_t> _active;
+      std::atomic<size_t> _executed;
+      std::atomic<size_t> _steals;
+
+      bool pop(const size_t worker, TaskPtr &task);
+      void work(const size_t worker);
+
+    public:
+      explicit Executor(size_t threads);
+      ~Executor();
+
+      size_t size() const;
+
+      void submit(TaskPtr task, const Priority priority = PRIORITY_NORMAL);
+
+      void stats(size_t &threads, size_t &queued, size_t &active, size_t &executed, size_t &steals) const;
+    };
+
+    // Process wide executor, sized by the number of hardware threads.
+    Executor &executor();
+
+    //
+    // Tasks of a request executed at the same time by the executor, and their priority.
+    // Shared by all task groups of the request.
+    //
+    class TaskLimit {
+    private:
+      std::atomic<long> _free;
+      std::atomic<int> _priority;
+
+    public:
+      TaskLimit(const size_t max_running, const Priority priority);
+
+      bool acquire();
+      void release();
+
+      Priority priority() const;
+      void set_priority(const Priority priority);
+    };
+
+    typedef std::shared_ptr<TaskLimit> TaskLimitPtr;
+
+    // Half of the executor threads, so a request leaves room for the others.
+    TaskLimitPtr build_task_limit();
+
+    //
+    // Tasks of a request step, e.g. one per chromosome.
+    // The tasks beyond the request limit wait in the group and are submitted
+    // when one of its tasks finishes, or are executed by the thread waiting for the group.
+    //
+    class TaskGroup {
+    private:
+      TaskLimitPtr _limit;
+      std::mutex _mutex;
+      std::vector<TaskPtr> _tasks;
+      std::vector<bool> _submitted;
+      std::deque<size_t> _pending;
+
+      void submit_pending();
+      void finished(const size_t pos);
+
+    public:
+      explicit TaskGroup(TaskLimitPtr limit);
+      ~TaskGroup();
+
+      void spawn(std::function<void()> fn);
+
+      // Wait for all tasks. The first exception thrown by them is thrown again here.
+      void wait();
+    };
+  }
+}
+
+#endif
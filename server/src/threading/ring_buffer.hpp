@@ -0,0 +1,138 @@
+//
+//  ring_buffer.hpp
+//  DeepBlue Epigenomic Data Server
+//  Copyright (c) 2016 Max Planck Institute for Informatics. All rights reserved.
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef EPIDB_THREADING_RING_BUFFER_HPP
+#define EPIDB_THREADING_RING_BUFFER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace epidb {
+  namespace threading {
+
+    //
+    // Bounded lock-free queue for many producers and consumers (D. Vyukov).
+    // Each cell has a sequence number telling if it is free for the producer
+    // of a position or filled for its consumer, so a push or a pop only
+    // contends on the position counters. The capacity is rounded up to a power of two.
+    //
+    template <typename T>
+    class RingBuffer {
+    private:
+      struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+      };
+
+      size_t _mask;
+      std::unique_ptr<Cell[]> _cells;
+      std::atomic<size_t> _enqueue_pos;
+      std::atomic<size_t> _dequeue_pos;
+
+    public:
+      explicit RingBuffer(size_t capacity) :
+        _enqueue_pos(0),
+        _dequeue_pos(0)
+      {
+        size_t size = 2;
+        while (size < capacity) {
+          size <<= 1;
+        }
+        _mask = size - 1;
+        _cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++) {
+          _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+      }
+
+      RingBuffer(const RingBuffer &) = delete;
+      RingBuffer &operator=(const RingBuffer &) = delete;
+
+      size_t capacity() const
+      {
+        return _mask + 1;
+      }
+
+      // Approximated, the producers and consumers may be moving
+      size_t size() const
+      {
+        const size_t enqueue = _enqueue_pos.load(std::memory_order_relaxed);
+        const size_t dequeue = _dequeue_pos.load(std::memory_order_relaxed);
+        return enqueue > dequeue ? enqueue - dequeue : 0;
+      }
+
+      // Returns false when the buffer is full
+      bool push(T value)
+      {
+        Cell *cell;
+        size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+          cell = &_cells[pos & _mask];
+          const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+          const intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+          if (diff == 0) {
+            if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+              break;
+            }
+          } else if (diff < 0) {
+            return false;
+          } else {
+            pos = _enqueue_pos.load(std::memory_order_relaxed);
+          }
+        }
+
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+
+      // Returns false when the buffer is empty
+      bool pop(T &value)
+      {
+        Cell *cell;
+        size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+          cell = &_cells[pos & _mask];
+          const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+          const intptr_t diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+          if (diff == 0) {
+            if (_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+              break;
+            }
+          } else if (diff < 0) {
+            return false;
+          } else {
+            pos = _dequeue_pos.load(std::memory_order_relaxed);
+          }
+        }
+
+        value = std::move(cell->value);
+        cell->value = T();
+        cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+        return true;
+      }
+    };
+  }
+}
+
+#endif
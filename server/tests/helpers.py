@@ -1,9 +1,11 @@
+import bz2
 import gzip
 import inspect
 import subprocess
 import os.path
 import time
 import unittest
+import urllib2
 import time
 import sys
 
@@ -341,12 +343,7 @@ class TestCase(unittest.TestCase):
 
     return data["count"]
 
-  def __get_regions_request(self, req, status=["done"]):
-    if req[0] is not 'r':
-      print "Invalid request " + req
-      return
-
-    epidb = DeepBlueClient(address="localhost", port=31415)
+  def __wait_request(self, epidb, req, status):
     sleep = 0.1
     count = 0
     (s, ss) = epidb.info(req, self.admin_key)
@@ -358,6 +355,13 @@ class TestCase(unittest.TestCase):
       if count > 5:
         print ss
 
+  def __get_regions_request(self, req, status=["done"]):
+    if req[0] is not 'r':
+      print "Invalid request " + req
+      return
+
+    epidb = DeepBlueClient(address="localhost", port=31415)
+    self.__wait_request(epidb, req, status)
     (s, data) = epidb.get_request_data(req, self.admin_key)
     return (s, data)
 
@@ -370,3 +374,25 @@ class TestCase(unittest.TestCase):
     (s, data) = self.__get_regions_request(req, status=["failed"])
     self.assertFailure(s, data)
     return data
+
+  def get_request_data_error(self, req):
+    (s, data) = self.__get_regions_request(req)
+    self.assertFailure(s, data)
+    return data
+
+  def download_request_data(self, req):
+    epidb = DeepBlueClient(address="localhost", port=31415)
+    self.__wait_request(epidb, req, ["done"])
+
+    url = "http://localhost:31415/download?r_id=%s&key=%s" % (req, self.admin_key)
+    data = urllib2.urlopen(url).read()
+    if not data.startswith("BZh"):
+      return data
+
+    # the stored data may have several bzip2 streams, one for each compressed block
+    content = []
+    while data:
+      decompressor = bz2.BZ2Decompressor()
+      content.append(decompressor.decompress(data))
+      data = decompressor.unused_data
+    return "".join(content)
@@ -81,3 +81,65 @@ class TestAdminCommands(helpers.TestCase):
 
     res, msg = epidb.add_user("user2", "test2@example.com", "test", u1[1])
     self.assertFailure(res, msg)
+
+  def test_query_cache_stats(self):
+    epidb = DeepBlueClient(address="localhost", port=31415)
+    self.init_base(epidb)
+
+    sample_id = self.sample_ids[0]
+    self.insert_experiment(epidb, "hg19_chr1_1", sample_id)
+    res, qid = epidb.select_experiments("hg19_chr1_1", "chr1", None, None, self.admin_key)
+    self.assertSuccess(res, qid)
+    res, qid_cached = epidb.query_cache(qid, True, self.admin_key)
+    self.assertSuccess(res, qid_cached)
+
+    res, before = epidb.query_cache_stats(self.admin_key)
+    self.assertSuccess(res, before)
+
+    # distinct requests, identical ones are answered by the same request
+    res, req = epidb.count_regions(qid_cached, self.admin_key)
+    self.assertSuccess(res, req)
+    self.count_request(req)
+
+    res, req = epidb.get_regions(qid_cached, "CHROMOSOME,START,END", self.admin_key)
+    self.assertSuccess(res, req)
+    self.get_regions_request(req)
+
+    res, after = epidb.query_cache_stats(self.admin_key)
+    self.assertSuccess(res, after)
+    self.assertTrue(after["misses"] + after["hits"] >= before["misses"] + before["hits"] + 2)
+    self.assertTrue(after["hits"] >= before["hits"] + 1)
+    self.assertTrue(after["bytes"] <= after["max_bytes"])
+
+    res, u1 = epidb.add_user("user1", "test1@example.com", "test", self.admin_key)
+    self.assertSuccess(res, u1)
+    res, msg = epidb.query_cache_stats(u1[1])
+    self.assertFailure(res, msg)
+
+  def test_executor_stats(self):
+    epidb = DeepBlueClient(address="localhost", port=31415)
+    self.init_base(epidb)
+
+    sample_id = self.sample_ids[0]
+    self.insert_experiment(epidb, "hg19_chr1_1", sample_id)
+    res, qid_1 = epidb.select_experiments("hg19_chr1_1", None, None, None, self.admin_key)
+    self.assertSuccess(res, qid_1)
+    res, qid_2 = epidb.tiling_regions(10000, "hg19", "chr1", self.admin_key)
+    self.assertSuccess(res, qid_2)
+    res, qid_3 = epidb.intersection(qid_1, qid_2, self.admin_key)
+    self.assertSuccess(res, qid_3)
+
+    res, req = epidb.count_regions(qid_3, self.admin_key)
+    self.assertSuccess(res, req)
+    self.count_request(req)
+
+    res, stats = epidb.executor_stats(self.admin_key)
+    self.assertSuccess(res, stats)
+    self.assertTrue(stats["threads"] >= 2)
+    self.assertTrue(stats["executed"] > 0)
+    self.assertTrue(stats["steals"] >= 0)
+
+    res, u1 = epidb.add_user("user1", "test1@example.com", "test", self.admin_key)
+    self.assertSuccess(res, u1)
+    res, msg = epidb.executor_stats(u1[1])
+    self.assertFailure(res, msg)
@@ -134,6 +134,123 @@ class TestExperiments(helpers.TestCase):
 
     self.assertEqual(data1, data2)
 
+  def test_insert_async(self):
+    epidb = DeepBlueClient(address="localhost", port=31415)
+    self.init_base(epidb)
+    sample_id = self.sample_ids[0]
+    regions_data = helpers.load_bed("hg19_chr1_1")
+    format = data_info.EXPERIMENTS["hg19_chr1_1"]["format"]
+
+    (res, _id) = epidb.add_experiment("test_exp1", "hg19", "Methylation", sample_id, "tech1",
+              "ENCODE", "desc1", regions_data, format, None, self.admin_key)
+    self.assertSuccess(res, _id)
+
+    # the upload is queued and its request returns the id of the experiment
+    (res, req) = epidb.add_experiment("test_exp_async", "hg19", "Methylation", sample_id, "tech1",
+              "ENCODE", "desc1", regions_data, format, {"__async__": ""}, self.admin_key)
+    self.assertSuccess(res, req)
+
+    (s, ss) = epidb.info(req, self.admin_key)
+    self.assertSuccess(s, ss)
+    self.assertEqual(ss[0]["command"], "add_experiment")
+    self.assertEqual(ss[0]["name"], "test_exp_async")
+
+    result = self.get_regions_request(req)
+    async_id = result["id"]
+
+    (s, info) = epidb.info(async_id, self.admin_key)
+    self.assertSuccess(s, info)
+    self.assertEqual(info[0]["name"], "test_exp_async")
+    self.assertFalse("__async__" in info[0]["extra_metadata"])
+
+    res, qid1 = epidb.select_regions(_id, None, None, None, None, None, None, None, None, self.admin_key)
+    self.assertSuccess(res, qid1)
+    (s, req1) = epidb.get_regions(qid1, "CHROMOSOME,START,END", self.admin_key)
+    self.assertSuccess(s, req1)
+    data1 = self.get_regions_request(req1)
+
+    res, qid2 = epidb.select_regions(async_id, None, None, None, None, None, None, None, None, self.admin_key)
+    self.assertSuccess(res, qid2)
+    (s, req2) = epidb.get_regions(qid2, "CHROMOSOME,START,END", self.admin_key)
+    self.assertSuccess(s, req2)
+    data2 = self.get_regions_request(req2)
+
+    self.assertEqual(data1, data2)
+
+    # the data is validated when the request is processed
+    (res, req) = epidb.add_experiment("test_exp_async_fail", "hg19", "Methylation", sample_id, "tech1",
+              "ENCODE", "desc1", "chr1\t10\tinvalid\n", format, {"__async__": ""}, self.admin_key)
+    self.assertSuccess(res, req)
+    msg = self.get_regions_request_error(req)
+
+    # the data of the failed upload is kept, and processed again
+    (res, r) = epidb.reprocess(req, self.admin_key)
+    self.assertSuccess(res, r)
+    self.assertEqual(self.get_regions_request_error(req), msg)
+
+  def test_insert_blocks(self):
+    epidb = DeepBlueClient(address="localhost", port=31415)
+    self.init_base(epidb)
+
+    # many chromosomes, each one with more lines than a block
+    self.insert_experiment(epidb, "hg19_big_1")
+
+    regions_data = helpers.load_bed("hg19_big_1")
+    expected = sorted("\t".join(l.split("\t")[:3]) for l in regions_data.split("\n") if l)
+
+    res, qid = epidb.select_regions("hg19_big_1", "hg19", None, None, None, None, None, None, None, self.admin_key)
+    self.assertSuccess(res, qid)
+    (s, req) = epidb.get_regions(qid, "CHROMOSOME,START,END", self.admin_key)
+    self.assertSuccess(s, req)
+    data = self.get_regions_request(req)
+
+    self.assertEqual(sorted(l for l in data.split("\n") if l), expected)
+
+  def test_insert_block_size(self):
+    epidb = DeepBlueClient(address="localhost", port=31415)
+    self.init_base(epidb)
+    sample_id = self.sample_ids[0]
+    regions_data = helpers.load_bed("hg19_chr1_1")
+    format = data_info.EXPERIMENTS["hg19_chr1_1"]["format"]
+
+    (res, _id) = epidb.add_experiment("test_exp1", "hg19", "Methylation", sample_id, "tech1",
+              "ENCODE", "desc1", regions_data, format, None, self.admin_key)
+    self.assertSuccess(res, _id)
+
+    # the 21 regions in blocks of 4, inserted in bulks of 2 blocks
+    (res, small_id) = epidb.add_experiment("test_exp_small_blocks", "hg19", "Methylation", sample_id, "tech1",
+              "ENCODE", "desc1", regions_data, format, {"__block_size__": "4", "__bulk_size__": "2"}, self.admin_key)
+    self.assertSuccess(res, small_id)
+
+    (s, info) = epidb.info(small_id, self.admin_key)
+    self.assertSuccess(s, info)
+    self.assertFalse("__block_size__" in info[0]["extra_metadata"])
+    self.assertFalse("__bulk_size__" in info[0]["extra_metadata"])
+
+    res, qid1 = epidb.select_regions(_id, None, None, None, None, None, None, None, None, self.admin_key)
+    self.assertSuccess(res, qid1)
+    (s, req1) = epidb.get_regions(qid1, "CHROMOSOME,START,END,SCORE,STRAND", self.admin_key)
+    self.assertSuccess(s, req1)
+    data1 = self.get_regions_request(req1)
+
+    res, qid2 = epidb.select_regions(small_id, None, None, None, None, None, None, None, None, self.admin_key)
+    self.assertSuccess(res, qid2)
+    (s, req2) = epidb.get_regions(qid2, "CHROMOSOME,START,END,SCORE,STRAND", self.admin_key)
+    self.assertSuccess(s, req2)
+    data2 = self.get_regions_request(req2)
+
+    self.assertEqual(data1, data2)
+
+    res = epidb.add_experiment("test_exp_invalid_block", "hg19", "Methylation", sample_id, "tech1",
+              "ENCODE", "desc1", regions_data, format, {"__block_size__": "0"}, self.admin_key)
+    self.assertFailure(res)
+    self.assertEqual(res[1], "The __block_size__ must be an integer between 1 and 10000.")
+
+    res = epidb.add_experiment("test_exp_invalid_bulk", "hg19", "Methylation", sample_id, "tech1",
+              "ENCODE", "desc1", regions_data, format, {"__bulk_size__": "many"}, self.admin_key)
+    self.assertFailure(res)
+    self.assertEqual(res[1], "The __bulk_size__ must be an integer between 1 and 100000.")
+
   def test_double_experiment_same_user_fail(self):
     epidb = DeepBlueClient(address="localhost", port=31415)
     self.init_base(epidb)
@@ -40,6 +40,36 @@ class TestFilterCommand(helpers.TestCase):
     regions = self.get_regions_request(req)
     self.assertEqual(regions, 'chr1\t713520\t713670\t-\nchr1\t761180\t761330\t-\nchr1\t762420\t762570\t.\nchr1\t762820\t762970\t-\nchr1\t763020\t763170\t-\nchr1\t840600\t840750\t-\nchr1\t858880\t859030\t.\nchr1\t859600\t859750\t.\nchr1\t861040\t861190\t-\nchr1\t875900\t876050\t-')
 
+  def test_filter_regions_column(self):
+    epidb = DeepBlueClient(address="localhost", port=31415)
+    self.init_full(epidb)
+
+    res, qid = epidb.select_regions("hg19_chr1_1", "hg19", None, None, None,
+                                 None, None, None, None, self.admin_key)
+    self.assertSuccess(res, qid)
+
+    res, qid2 = epidb.filter_regions(qid, "P_VALUE",  ">", "70", "number", self.admin_key)
+    self.assertSuccess(res, qid2)
+
+    res, req = epidb.get_regions(qid2, "CHROMOSOME,START,END,P_VALUE", self.admin_key)
+    self.assertSuccess(res, req)
+    regions = self.get_regions_request(req)
+    self.assertEqual(regions, 'chr1\t713900\t714050\t71.2352\nchr1\t714160\t714310\t101.8740\nchr1\t714540\t714690\t105.3120\nchr1\t762420\t762570\t72.1622\nchr1\t762820\t762970\t72.1622\nchr1\t860240\t860390\t72.8732')
+
+    # No region of the block matches
+    res, qid3 = epidb.filter_regions(qid, "P_VALUE",  ">", "1000", "number", self.admin_key)
+    self.assertSuccess(res, qid3)
+    res, req = epidb.count_regions(qid3, self.admin_key)
+    self.assertSuccess(res, req)
+    self.assertEqual(self.count_request(req), 0)
+
+    # All regions of the block match
+    res, qid4 = epidb.filter_regions(qid, "P_VALUE",  ">=", "0", "number", self.admin_key)
+    self.assertSuccess(res, qid4)
+    res, req = epidb.count_regions(qid4, self.admin_key)
+    self.assertSuccess(res, req)
+    self.assertEqual(self.count_request(req), 21)
+
   def test_remove_full_chromosome_data(self):
     epidb = DeepBlueClient(address="localhost", port=31415)
     self.init_full(epidb)
@@ -63,3 +63,31 @@ class TestListRequests(helpers.TestCase):
 
         self.assertEquals(requests, requests_ids)
 
+
+
+    def test_request_class(self):
+        """
+        Test the scheduling class and queue wait time of the requests
+        """
+        epidb = DeepBlueClient(address="localhost", port=31415)
+        self.init_full(epidb)
+
+        s, query_id = epidb.select_regions(None, "hg19", None, None, None, None, "chr1", None, None, self.admin_key)
+        self.assertSuccess(s, query_id)
+
+        s, req_count = epidb.count_regions(query_id, self.admin_key)
+        self.assertSuccess(s, req_count)
+        s, req_regions = epidb.get_regions(query_id, "CHROMOSOME,START,END", self.admin_key)
+        self.assertSuccess(s, req_regions)
+
+        self.count_request(req_count)
+        self.get_regions_request(req_regions)
+
+        s, info = epidb.info(req_count, self.admin_key)
+        self.assertSuccess(s, info)
+        self.assertEquals(info[0]["class"], "interactive")
+        self.assertTrue(int(info[0]["wait_time"]) >= 0)
+
+        s, info = epidb.info(req_regions, self.admin_key)
+        self.assertSuccess(s, info)
+        self.assertEquals(info[0]["class"], "normal")
@@ -1,5 +1,7 @@
 import helpers
 import difflib
+import math
+import struct
 
 from deepblue_client import DeepBlueClient
 
@@ -77,6 +79,92 @@ class TestScoreMatrixCommand(helpers.TestCase):
     rs = self.get_regions_request(req)
     self.assertEquals(rs, expected)
 
+  def test_score_matrix_binary(self):
+    epidb = DeepBlueClient(address="localhost", port=31415)
+    self.init_base(epidb)
+
+    sample_id = self.sample_ids[0]
+    self.insert_experiment(epidb, "hg19_chr1_1", sample_id)
+
+    (s, q_tiling) = epidb.tiling_regions(1000000, "hg19", "chr1", self.admin_key)
+    self.assertSuccess(s, q_tiling)
+
+    (s, req) = epidb.score_matrix({"hg19_chr1_1":"SCORE", "__output_format__":"numpy"}, "mean",  q_tiling, self.admin_key)
+    self.assertFailure(s, req)
+    self.assertEquals(req, "Invalid score matrix output format numpy. The formats are tsv and binary.")
+
+    (s, req) = epidb.score_matrix({"hg19_chr1_1":"SCORE", "__output_format__":"binary"}, "mean",  q_tiling, self.admin_key)
+    self.assertSuccess(s, req)
+
+    # the binary matrix is only available with the download URL
+    data = self.get_request_data_error(req)
+    self.assertEquals(data, "The result of the request " + req + " is binary. Download it with /download?r_id=" + req + "&key=USER_KEY")
+
+    # the downloaded matrix has the same rows and cells of the text matrix
+    self.insert_experiment(epidb, "hg19_chr1_2", sample_id)
+
+    (s, q_tiling) = epidb.tiling_regions(100000, "hg19", "chr1", self.admin_key)
+    self.assertSuccess(s, q_tiling)
+
+    experiments_columns = {"hg19_chr1_1":"SIGNAL_VALUE", "hg19_chr1_2":"SIGNAL_VALUE"}
+    (s, req_text) = epidb.score_matrix(experiments_columns, "mean", q_tiling, self.admin_key)
+    self.assertSuccess(s, req_text)
+    lines = self.get_regions_request(req_text).split("\n")[:-1]
+
+    experiments_columns["__output_format__"] = "binary"
+    (s, req) = epidb.score_matrix(experiments_columns, "mean", q_tiling, self.admin_key)
+    self.assertSuccess(s, req)
+    data = self.download_request_data(req)
+
+    self.assertEquals(data[:4], "DBSM")
+    (version, rows, columns) = struct.unpack_from("<IQQ", data, 4)
+    pos = 24
+    self.assertEquals(version, 1)
+    self.assertEquals(columns, 2)
+
+    def read_string(pos):
+      (size,) = struct.unpack_from("<I", data, pos)
+      return (data[pos + 4:pos + 4 + size], pos + 4 + size)
+
+    names = []
+    for column in range(columns):
+      (name, pos) = read_string(pos)
+      names.append(name)
+
+    (chromosomes_count,) = struct.unpack_from("<I", data, pos)
+    pos += 4
+    chromosomes = []
+    for i in range(chromosomes_count):
+      (chromosome, pos) = read_string(pos)
+      (chromosome_rows,) = struct.unpack_from("<Q", data, pos)
+      pos += 8
+      chromosomes += [chromosome] * chromosome_rows
+    self.assertEquals(len(chromosomes), rows)
+
+    starts = struct.unpack_from("<%di" % rows, data, pos)
+    pos += 4 * rows
+    ends = struct.unpack_from("<%di" % rows, data, pos)
+    pos += 4 * rows
+    cells = struct.unpack_from("<%df" % (rows * columns), data, pos)
+    pos += 4 * rows * columns
+    self.assertEquals(pos, len(data))
+
+    self.assertEquals(lines[0], "\t".join(["CHROMOSOME", "START", "END"] + names))
+    self.assertEquals(len(lines) - 1, rows)
+
+    values = 0
+    for row in range(rows):
+      fields = lines[row + 1].split("\t")
+      self.assertEquals(fields[:3], [chromosomes[row], str(starts[row]), str(ends[row])])
+      for column in range(columns):
+        cell = cells[row * columns + column]
+        if fields[3 + column] == "":
+          self.assertTrue(math.isnan(cell))
+        else:
+          self.assertEquals("%.4f" % cell, fields[3 + column])
+          values += 1
+    self.assertTrue(values > 0)
+
   def test_score_matrix_wrong_experiment(self):
     epidb = DeepBlueClient(address="localhost", port=31415)
     self.init_base(epidb)